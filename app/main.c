@@ -6,10 +6,465 @@
 // main.c - Entry point for traffic utility
 //
 
+#define _POSIX_C_SOURCE 200809L // for clock_gettime, sigaction, st_mtim
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
 #include <traffic.h>
 
-int main(int argc, const char *argv[])
+// Configs compile, by default, to their own path with this on the end
+//
+#define TRAFFIC_COMPILED_SUFFIX ".bin"
+
+// Set when the network should be brought down
+//
+static volatile sig_atomic_t g_stop = 0;
+
+// Set when the config should be reloaded
+//
+static volatile sig_atomic_t g_reload = 0;
+
+static double traffic_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void traffic_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s <config>\n"
+            "       %s compile <config> [output]\n"
+            "       %s gen <topology> [-s seed] [-p prefix] [-l latency]\n"
+            "       [-v variance] [-d droprate]\n"
+            "\n"
+            "Brings up the network a config describes, and keeps it up until\n"
+            "interrupted. If the config has been compiled to config" TRAFFIC_COMPILED_SUFFIX "\n"
+            "since it last changed, loads the compiled topology instead.\n"
+            "SIGHUP reloads the config (or compiled topology) into the running\n"
+            "network, changing only what changed in it.\n"
+            "\n"
+            "compile compiles a config into a binary topology, which loads\n"
+            "much faster, at config" TRAFFIC_COMPILED_SUFFIX " unless told otherwise.\n"
+            "\n"
+            "gen builds a topology into a network and reports its size and how\n"
+            "long it took to build and bind. Topologies are:\n"
+            "\n"
+            "  ring N            N nodes in a cycle\n"
+            "  torus X Y [Z]     2D or 3D torus\n"
+            "  fat-tree K        K-ary fat tree (K even)\n"
+            "  star ARMS LEAVES  hub linked to ARMS stars of LEAVES nodes\n"
+            "  er N P            Erdos-Renyi G(N, P)\n"
+            "  ba N M            Barabasi-Albert, M links per new node\n"
+            "\n"
+            "Latency and variance are in ms, and apply to every link.\n",
+            prog, prog, prog);
+}
+
+// Counts the network's links, from how many each interface is on
+//
+static unsigned long long traffic_count_links(tr_network net)
+{
+    unsigned int numnodes = tr_net_num_nodes(net);
+    tr_node *nodes = (tr_node *)malloc(numnodes * sizeof(tr_node));
+    unsigned long long ends = 0;
+
+    if (nodes && tr_net_nodes(net, nodes, numnodes) >= 0) {
+        for (unsigned int n = 0; n < numnodes; ++n) {
+            unsigned int numifaces = tr_node_num_ifaces(nodes[n]);
+            tr_iface *ifaces = (tr_iface *)malloc(numifaces * sizeof(tr_iface));
+
+            if (ifaces && tr_node_ifaces(nodes[n], ifaces, numifaces) >= 0) {
+                for (unsigned int i = 0; i < numifaces; ++i) {
+                    ends += tr_iface_num_links(ifaces[i]);
+                }
+            }
+
+            free(ifaces);
+        }
+    }
+
+    free(nodes);
+    return ends / 2;
+}
+
+// Builds the topology named by args into the network, into err. Returns
+// false if args don't name a topology.
+//
+static bool traffic_generate(tr_network net, const char **args, int numargs,
+                             const tr_genopts *opts, tr_err *err)
+{
+    const char *kind = args[0];
+    unsigned long n = numargs > 1 ? strtoul(args[1], NULL, 10) : 0;
+    unsigned long m = numargs > 2 ? strtoul(args[2], NULL, 10) : 0;
+
+    if (strcmp(kind, "ring") == 0 && numargs == 2) {
+        *err = tr_gen_ring(net, n, opts);
+    }
+    else if (strcmp(kind, "torus") == 0 && (numargs == 3 || numargs == 4)) {
+        unsigned dims[3] = { n, m, 0 };
+        if (numargs == 4) {
+            dims[2] = strtoul(args[3], NULL, 10);
+        }
+
+        *err = tr_gen_torus(net, dims, numargs - 1, opts);
+    }
+    else if (strcmp(kind, "fat-tree") == 0 && numargs == 2) {
+        *err = tr_gen_fat_tree(net, n, opts);
+    }
+    else if (strcmp(kind, "star") == 0 && numargs == 3) {
+        *err = tr_gen_star_of_stars(net, n, m, opts);
+    }
+    else if (strcmp(kind, "er") == 0 && numargs == 3) {
+        *err = tr_gen_erdos_renyi(net, n, atof(args[2]), opts);
+    }
+    else if (strcmp(kind, "ba") == 0 && numargs == 3) {
+        *err = tr_gen_barabasi_albert(net, n, m, opts);
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+static int traffic_gen(const char *prog, int argc, const char *argv[])
 {
+    tr_genopts opts = { 0, NULL, 0, 0, 0 };
+    const char *args[4];
+    int numargs = 0;
+
+    for (int a = 0; a < argc; ++a) {
+        const char *arg = argv[a];
+        bool hasvalue = a + 1 < argc;
+
+        if (strcmp(arg, "-s") == 0 && hasvalue) {
+            opts.seed = strtoull(argv[++a], NULL, 10);
+        }
+        else if (strcmp(arg, "-p") == 0 && hasvalue) {
+            opts.prefix = argv[++a];
+        }
+        else if (strcmp(arg, "-l") == 0 && hasvalue) {
+            opts.latency = atol(argv[++a]);
+        }
+        else if (strcmp(arg, "-v") == 0 && hasvalue) {
+            opts.variance = atol(argv[++a]);
+        }
+        else if (strcmp(arg, "-d") == 0 && hasvalue) {
+            opts.droprate = atof(argv[++a]);
+        }
+        else if (arg[0] == '-' || numargs == 4) {
+            traffic_usage(prog);
+            return 2;
+        }
+        else {
+            args[numargs++] = arg;
+        }
+    }
+
+    if (numargs == 0) {
+        traffic_usage(prog);
+        return 2;
+    }
+
+    tr_network net = tr_net_create(args[0]);
+    if (!net) {
+        fprintf(stderr, "Can't create a network: %s\n", tr_errstr(TR_ENOMEM));
+        return 1;
+    }
+
+    tr_err err = TR_OK;
+    double start = traffic_now();
+    bool known = traffic_generate(net, args, numargs, &opts, &err);
+    double built = traffic_now();
+
+    if (!known) {
+        tr_net_delete(net);
+        traffic_usage(prog);
+        return 2;
+    }
+
+    if (err >= 0) {
+        err = tr_net_bind(net);
+    }
+
+    double bound = traffic_now();
+
+    if (err < 0) {
+        fprintf(stderr, "Can't build %s: %s\n", args[0], tr_errstr(err));
+        tr_net_delete(net);
+        return 1;
+    }
+
+    tr_memstats mem;
+    tr_mem_stats(TR_MEM_TOPOLOGY, &mem);
+
+    printf("%s: %u nodes, %llu links\n", args[0], tr_net_num_nodes(net),
+           traffic_count_links(net));
+    printf("  built in %.3f s, bound in %.3f s\n", built - start, bound - built);
+    printf("  topology memory: %.1f MB\n", mem.bytes / (1024.0 * 1024.0));
+
+    tr_net_unbind(net);
+    tr_net_delete(net);
     return 0;
 }
 
+// Says why a config (or compiled topology) couldn't be read
+//
+static void traffic_conf_error(const char *path, tr_err err,
+                               const tr_conferror *error)
+{
+    if (error->line) {
+        fprintf(stderr, "%s:%u:%u: %s\n", path, error->line, error->column,
+                error->message);
+    }
+    else {
+        fprintf(stderr, "%s: %s\n", path,
+                error->message[0] ? error->message : tr_errstr(err));
+    }
+}
+
+// Gets the path a config compiles to by default, in a new buffer
+//
+static char *traffic_compiled_path(const char *config)
+{
+    size_t len = strlen(config) + sizeof(TRAFFIC_COMPILED_SUFFIX);
+    char *path = (char *)malloc(len);
+
+    if (path) {
+        snprintf(path, len, "%s%s", config, TRAFFIC_COMPILED_SUFFIX);
+    }
+
+    return path;
+}
+
+// Indicates whether the file at path exists, and changed after the one at
+// other did (or other doesn't exist)
+//
+static bool traffic_is_newer(const char *path, const char *other)
+{
+    struct stat st, otherst;
+
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+
+    if (stat(other, &otherst) != 0) {
+        return true;
+    }
+
+    return st.st_mtim.tv_sec > otherst.st_mtim.tv_sec ||
+           (st.st_mtim.tv_sec == otherst.st_mtim.tv_sec &&
+            st.st_mtim.tv_nsec > otherst.st_mtim.tv_nsec);
+}
+
+// Loads the network a config describes: from its compiled topology, if
+// that's up to date, or else from the config itself
+//
+static tr_err traffic_load(const char *config, tr_network *net)
+{
+    char *compiled = traffic_compiled_path(config);
+    tr_conferror error;
+    tr_err err = TR_ENOTFOUND;
+
+    if (compiled && traffic_is_newer(compiled, config)) {
+        err = tr_conf_parse(compiled, net, &error);
+
+        if (err < 0) {
+            traffic_conf_error(compiled, err, &error);
+            fprintf(stderr, "Reading %s instead\n", config);
+        }
+    }
+
+    free(compiled);
+
+    if (err < 0) {
+        err = tr_conf_parse(config, net, &error);
+
+        if (err < 0) {
+            traffic_conf_error(config, err, &error);
+        }
+    }
+
+    return err;
+}
+
+// Reloads a running network's config, from its compiled topology if that's
+// up to date, as traffic_load does. If the config can't be read, the
+// network runs on as it was; if it can't all be applied, it runs on partly
+// changed, restarted if that left it unbound.
+//
+static void traffic_reload(const char *config, tr_network net)
+{
+    char *compiled = traffic_compiled_path(config);
+    tr_confchanges c;
+    tr_conferror error;
+    tr_err err = TR_ENOTFOUND;
+    double start = traffic_now();
+
+    if (compiled && traffic_is_newer(compiled, config)) {
+        err = tr_conf_reload(net, compiled, &c, &error);
+
+        if (err < 0) {
+            traffic_conf_error(compiled, err, &error);
+            fprintf(stderr, "Reloading %s instead\n", config);
+        }
+    }
+
+    free(compiled);
+
+    if (err < 0) {
+        err = tr_conf_reload(net, config, &c, &error);
+
+        if (err < 0) {
+            traffic_conf_error(config, err, &error);
+        }
+    }
+
+    if (err >= 0) {
+        printf("Reloaded %s in %.3f s\n", tr_net_name(net), traffic_now() - start);
+        printf("  nodes: %u added, %u removed\n", c.addednodes, c.removednodes);
+        printf("  interfaces: %u added, %u removed, %u readdressed\n",
+               c.addedifaces, c.removedifaces, c.readdressedifaces);
+        printf("  links: %u added, %u removed, %u changed\n", c.addedlinks,
+               c.removedlinks, c.changedlinks);
+        fflush(stdout);
+    }
+
+    if (!tr_net_is_simulating(net)) {
+        err = tr_net_start(net);
+        if (err < 0) {
+            fprintf(stderr, "Can't restart %s: %s\n", config, tr_errstr(err));
+        }
+    }
+}
+
+static void traffic_on_stop(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static void traffic_on_reload(int sig)
+{
+    (void)sig;
+    g_reload = 1;
+}
+
+static int traffic_run(const char *config)
+{
+    tr_network net = NULL;
+    double start = traffic_now();
+
+    if (traffic_load(config, &net) < 0) {
+        return 1;
+    }
+
+    double loaded = traffic_now();
+    tr_err err = tr_net_start(net);
+    double started = traffic_now();
+
+    if (err < 0) {
+        fprintf(stderr, "Can't start %s: %s\n", config, tr_errstr(err));
+        tr_net_delete(net);
+        return 1;
+    }
+
+    printf("%s: %u nodes, %llu links\n", tr_net_name(net),
+           tr_net_num_nodes(net), traffic_count_links(net));
+    printf("  loaded in %.3f s, started in %.3f s\n", loaded - start,
+           started - loaded);
+    fflush(stdout);
+
+    // The signals are blocked except while waiting for them, so one can't
+    // slip in between checking for it and waiting
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = traffic_on_stop;
+    sigemptyset(&sa.sa_mask);
+
+    sigset_t waiting, blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGHUP);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting);
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = traffic_on_reload;
+    sigaction(SIGHUP, &sa, NULL);
+
+    while (!g_stop) {
+        sigsuspend(&waiting);
+
+        if (g_reload && !g_stop) {
+            g_reload = 0;
+            traffic_reload(config, net);
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &waiting, NULL);
+
+    printf("Bringing down %s\n", tr_net_name(net));
+    tr_net_stop(net);
+    tr_net_unbind(net);
+    tr_net_delete(net);
+    return 0;
+}
+
+static int traffic_compile(const char *prog, int argc, const char *argv[])
+{
+    if (argc < 1 || argc > 2) {
+        traffic_usage(prog);
+        return 2;
+    }
+
+    const char *config = argv[0];
+    char *output = argc > 1 ? NULL : traffic_compiled_path(config);
+    const char *dest = argc > 1 ? argv[1] : output;
+
+    if (!dest) {
+        fprintf(stderr, "Can't compile %s: %s\n", config, tr_errstr(TR_ENOMEM));
+        return 1;
+    }
+
+    tr_conferror error;
+    double start = traffic_now();
+    tr_err err = tr_conf_compile(config, dest, &error);
+    double compiled = traffic_now();
+
+    if (err < 0) {
+        traffic_conf_error(config, err, &error);
+    }
+    else {
+        printf("Compiled %s to %s in %.3f s\n", config, dest, compiled - start);
+    }
+
+    free(output);
+    return err < 0 ? 1 : 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "gen") == 0) {
+        return traffic_gen(argv[0], argc - 2, argv + 2);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "compile") == 0) {
+        return traffic_compile(argv[0], argc - 2, argv + 2);
+    }
+
+    if (argc == 2 && argv[1][0] != '-') {
+        return traffic_run(argv[1]);
+    }
+
+    traffic_usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,129 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// bench.h - Benchmark declarations and utilities
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+// Gets the current time from a monotonic clock, in seconds
+//
+double bench_now();
+
+// Reports the result of a timed run of a benchmark.
+// ops is the number of operations performed in the given number of seconds.
+//
+void bench_report(const char *name, unsigned long ops, double seconds);
+
+// Reports a single measured value (e.g. a latency) for a benchmark
+//
+void bench_report_value(const char *name, double value, const char *unit);
+
+// Keeps the compiler from optimizing away a computed value
+//
+void bench_consume(unsigned long value);
+
+// The original coalesced tr_hash engine, for comparison (legacy_hash.c)
+//
+#include "hash.h"
+
+typedef void *legacy_hash;
+
+legacy_hash legacy_hash_create(unsigned int keysize,
+                               unsigned int valuesize,
+                               tr_hashfunc hashfunc,
+                               tr_equalfunc equalfunc);
+legacy_hash legacy_inthash_create(unsigned int itemsize);
+tr_err legacy_hash_delete(legacy_hash hash);
+bool legacy_hash_contains(legacy_hash hash, const void *key);
+void *legacy_hash_get(legacy_hash hash, const void *key);
+tr_err legacy_hash_set(legacy_hash hash, const void *key, const void *value);
+tr_err legacy_hash_clear(legacy_hash hash, const void *key);
+unsigned int legacy_hash_num_keys(legacy_hash hash);
+
+//
+// Benchmark declarations
+// Add new items to the table in main.c
+//
+
+
+// Benchmarks for memory allocator
+//
+void bench_mem_churn();
+void bench_net_build_teardown();
+
+// Benchmarks for network modeling
+//
+void bench_net_freeze();
+void bench_net_link();
+void bench_net_build_bulk();
+void bench_net_generate();
+
+// Benchmarks for psychic routing
+//
+void bench_route_prepare();
+void bench_route_flap();
+
+// Benchmarks for thread placement
+//
+void bench_part_torus();
+void bench_part_scale_free();
+void bench_part_fat_tree();
+
+// Benchmarks for config files
+//
+void bench_conf_lex();
+void bench_conf_read();
+void bench_conf_load();
+void bench_conf_reload();
+
+// Benchmarks for vector utility
+//
+void bench_vec_build();
+void bench_vec_pushpop();
+
+// Benchmarks for list utility
+//
+void bench_list_build();
+
+// Benchmarks for hashtable utility
+//
+void bench_hash_insert();
+void bench_hash_lookup_hit();
+void bench_hash_lookup_miss();
+void bench_hash_remove();
+void bench_strhash_lookup();
+void bench_hash_insert_latency();
+void bench_hash_iterate();
+void bench_hashfunc_throughput();
+void bench_hashfunc_spread();
+
+// Benchmarks for typed container generators
+//
+void bench_typed_machash();
+void bench_typed_vec();
+
+// Benchmarks for hash set utility
+//
+void bench_intset_dense();
+
+// Benchmarks for concurrent hashtable utility
+//
+void bench_chash_scaling();
+
+// Benchmarks for ring buffer utility
+//
+void bench_ring_throughput();
+void bench_ring_latency();
+
+// Benchmarks for timing wheel utility
+//
+void bench_wheel_inflight();
+void bench_wheel_cancel();
+
+#endif
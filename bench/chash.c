@@ -0,0 +1,145 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// chash.c - Concurrent hashtable benchmarks
+//
+
+#define _POSIX_C_SOURCE 200112L // for sysconf
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "chash.h"
+#include "hash.h"
+
+// Number of keys in the table, and operations run by each thread
+//
+static const int g_keys = 100000;
+static const int g_ops = 1000000;
+
+// Percentage of operations that are writes
+//
+static const int g_writepcts[] = { 0, 10, 50 };
+static const int g_numwritepcts = sizeof(g_writepcts) / sizeof(g_writepcts[0]);
+
+struct _chashbench
+{
+    tr_chash chash;             // The table under test, or NULL...
+    tr_hash hash;               // ...for a tr_hash behind one big lock
+    pthread_mutex_t *lock;
+    int writepct;
+    unsigned int seed;
+    unsigned long sum;
+};
+
+typedef struct _chashbench chashbench;
+
+static void *bench_chash_worker(void *arg)
+{
+    chashbench *b = (chashbench *)arg;
+    unsigned int seed = b->seed;
+    unsigned long sum = 0;
+
+    for (int i = 0; i < g_ops; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 8) % (unsigned int)g_keys);
+        bool write = (int)((seed >> 4) % 100) < b->writepct;
+
+        if (b->chash) {
+            if (write) {
+                tr_intchash_set(b->chash, key, &i);
+            }
+            else {
+                int value = 0;
+                tr_intchash_get(b->chash, key, &value);
+                sum += value;
+            }
+        }
+        else {
+            pthread_mutex_lock(b->lock);
+            if (write) {
+                tr_inthash_set(b->hash, key, &i);
+            }
+            else {
+                int *value = (int *)tr_inthash_get(b->hash, key);
+                sum += value ? *value : 0;
+            }
+            pthread_mutex_unlock(b->lock);
+        }
+    }
+
+    b->sum = sum;
+    return NULL;
+}
+
+// Runs nthreads workers against one table, and reports their combined
+// throughput
+//
+static void bench_chash_run(const char *engine, tr_chash chash, tr_hash hash,
+                            int nthreads, int writepct)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t threads[nthreads];
+    chashbench ctx[nthreads];
+
+    double start = bench_now();
+    for (int t = 0; t < nthreads; ++t) {
+        chashbench b = { chash, hash, &lock, writepct, 1234u + t, 0 };
+        ctx[t] = b;
+        pthread_create(&threads[t], NULL, bench_chash_worker, &ctx[t]);
+    }
+
+    for (int t = 0; t < nthreads; ++t) {
+        pthread_join(threads[t], NULL);
+        bench_consume(ctx[t].sum);
+    }
+    double seconds = bench_now() - start;
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s threads=%d writes=%d%%",
+             engine, nthreads, writepct);
+    bench_report(name, (unsigned long)nthreads * g_ops, seconds);
+}
+
+void bench_chash_scaling()
+{
+    // Up to one thread per CPU; TR_BENCH_THREADS overrides
+    int maxthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("TR_BENCH_THREADS");
+    if (env) {
+        maxthreads = atoi(env);
+    }
+
+    if (maxthreads < 1) {
+        maxthreads = 1;
+    }
+
+    tr_chash chash = tr_intchash_create(sizeof(int));
+    tr_hash hash = tr_inthash_create(sizeof(int));
+
+    for (int i = 0; i < g_keys; ++i) {
+        tr_intchash_set(chash, i, &i);
+        tr_inthash_set(hash, i, &i);
+    }
+
+    for (int w = 0; w < g_numwritepcts; ++w) {
+        for (int n = 1; ; n = n * 2 < maxthreads ? n * 2 : maxthreads) {
+            bench_chash_run("tr_chash", chash, NULL, n, g_writepcts[w]);
+            bench_chash_run("locked tr_hash", NULL, hash, n, g_writepcts[w]);
+
+            if (n == maxthreads) {
+                break;
+            }
+        }
+    }
+
+    tr_chash_delete(chash);
+    tr_hash_delete(hash);
+}
@@ -0,0 +1,245 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf.c - Config file benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "conf.h"
+
+#define BENCH_CONF_PATH "bench_conf.conf"
+#define BENCH_CONF_IMAGE "bench_conf.topo"
+#define BENCH_CONF_NODES 250000
+#define BENCH_CONF_IFACES 4
+#define BENCH_CONF_ROUTES 16    // Destinations routed to across reloads
+
+// Versions of the config, for reloading
+//
+#define BENCH_CONF_BASE 0       // As written
+#define BENCH_CONF_RETUNED 1    // With one link's latency changed
+#define BENCH_CONF_GROWN 2      // With one more node, linked in
+
+// Writes a config with BENCH_CONF_NODES nodes of BENCH_CONF_IFACES
+// interfaces each. Nodes are linked in a ring, and to a node further round
+// it, so half the links name interfaces that haven't been declared yet.
+//
+static bool bench_conf_write_version(int version)
+{
+    FILE *f = fopen(BENCH_CONF_PATH, "w");
+    if (!f) {
+        return false;
+    }
+
+    fputs("# A generated config, for benchmarking\n", f);
+
+    for (unsigned int i = 0; i < BENCH_CONF_NODES; ++i) {
+        fprintf(f, "node 'n%u' {\n", i);
+
+        for (unsigned int k = 0; k < BENCH_CONF_IFACES; ++k) {
+            if (k == 0) {
+                fprintf(f, "    interface 'n%u-%u' { ip '10.%u.%u.%u' subnet '8' }\n",
+                        i, k, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+            }
+            else {
+                fprintf(f, "    interface 'n%u-%u'\n", i, k);
+            }
+        }
+
+        fputs("    switch { strategy 'psychic' }\n}\n", f);
+
+        unsigned int next = (i + 1) % BENCH_CONF_NODES;
+        unsigned int far = (i + 1000) % BENCH_CONF_NODES;
+        unsigned int latency = 1 + i % 50;
+        if (version == BENCH_CONF_RETUNED && i == 0) {
+            latency = 100;
+        }
+
+        fprintf(f, "link { from 'n%u-0' to 'n%u-1' latency '%u ms' }\n",
+                i, next, latency);
+        fprintf(f, "link { from 'n%u-2' to 'n%u-3' droprate '0.5%%' }\n",
+                i, far);
+    }
+
+    if (version == BENCH_CONF_GROWN) {
+        fputs("node 'extra' { interface 'extra-0' }\n"
+              "link { from 'extra-0' to 'n0-3' }\n", f);
+    }
+
+    return fclose(f) == 0;
+}
+
+static bool bench_conf_write()
+{
+    return bench_conf_write_version(BENCH_CONF_BASE);
+}
+
+// Writes the config and maps it
+//
+static bool bench_conf_map(confmap *map)
+{
+    return bench_conf_write() && tr_conf_map(BENCH_CONF_PATH, map) >= 0;
+}
+
+void bench_conf_lex()
+{
+    confmap map;
+    if (!bench_conf_map(&map)) {
+        return;
+    }
+
+    conflexer lex;
+    conftoken tok;
+    unsigned long tokens = 0;
+
+    double start = bench_now();
+    tr_conf_lex_init(&lex, map.text, map.len);
+    do {
+        tr_conf_lex(&lex, &tok);
+        ++tokens;
+    } while (tok.type != TR_TOK_END && tok.type != TR_TOK_BAD);
+    double elapsed = bench_now() - start;
+
+    bench_report_value("conf lex tokens", (double)tokens, "tokens");
+    bench_report_value("conf lex throughput", map.len / elapsed / 1e6, "MB/s");
+
+    tr_conf_unmap(&map);
+    remove(BENCH_CONF_PATH);
+}
+
+void bench_conf_read()
+{
+    confmap map;
+    if (!bench_conf_map(&map)) {
+        return;
+    }
+
+    size_t len = map.len;
+    tr_conf_unmap(&map);
+
+    tr_network net = NULL;
+    double start = bench_now();
+    tr_err err = tr_conf_read(BENCH_CONF_PATH, &net);
+    double elapsed = bench_now() - start;
+    remove(BENCH_CONF_PATH);
+
+    if (err < 0) {
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "conf read ifaces=%u",
+             BENCH_CONF_NODES * BENCH_CONF_IFACES);
+    bench_report_value(name, elapsed * 1e3, "ms");
+    bench_report_value("conf read throughput", len / elapsed / 1e6, "MB/s");
+
+    tr_net_delete(net);
+}
+
+void bench_conf_load()
+{
+    if (!bench_conf_write()) {
+        return;
+    }
+
+    double start = bench_now();
+    tr_err err = tr_conf_compile(BENCH_CONF_PATH, BENCH_CONF_IMAGE, NULL);
+    double compiled = bench_now() - start;
+    remove(BENCH_CONF_PATH);
+
+    confmap map;
+    if (err < 0 || tr_conf_map(BENCH_CONF_IMAGE, &map) < 0) {
+        remove(BENCH_CONF_IMAGE);
+        return;
+    }
+
+    size_t len = map.len;
+    tr_conf_unmap(&map);
+
+    tr_network net = NULL;
+    start = bench_now();
+    err = tr_conf_read(BENCH_CONF_IMAGE, &net);
+    double elapsed = bench_now() - start;
+    remove(BENCH_CONF_IMAGE);
+
+    if (err < 0) {
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "conf load ifaces=%u",
+             BENCH_CONF_NODES * BENCH_CONF_IFACES);
+    bench_report_value(name, elapsed * 1e3, "ms");
+    bench_report_value("conf compile", compiled * 1e3, "ms");
+    bench_report_value("conf image size", len / 1e6, "MB");
+
+    tr_net_delete(net);
+}
+
+// Reloads the given version of the config into the network, reporting how
+// long it took
+//
+static void bench_conf_reload_version(tr_network net, int version,
+                                      const char *name)
+{
+    if (!bench_conf_write_version(version)) {
+        return;
+    }
+
+    double start = bench_now();
+    tr_err err = tr_conf_reload(net, BENCH_CONF_PATH, NULL, NULL);
+    double elapsed = bench_now() - start;
+
+    if (err >= 0) {
+        bench_report_value(name, elapsed * 1e3, "ms");
+    }
+}
+
+void bench_conf_reload()
+{
+    tr_network net = NULL;
+    tr_err err = bench_conf_write() ? tr_conf_read(BENCH_CONF_PATH, &net) : TR_EIO;
+
+    // Routes to a few destinations are worked out up front, so reloads
+    // have routes to carry over
+    tr_node dests[BENCH_CONF_ROUTES];
+    for (unsigned int k = 0; err >= 0 && k < BENCH_CONF_ROUTES; ++k) {
+        char name[32];
+        snprintf(name, sizeof(name), "n%u", k * (BENCH_CONF_NODES / BENCH_CONF_ROUTES));
+        dests[k] = tr_net_node(net, name);
+    }
+
+    if (err >= 0) {
+        err = tr_net_prepare_routes(net, dests, BENCH_CONF_ROUTES);
+    }
+
+    // Reading and comparing the config is the same work either way; a
+    // changed link is then patched in place, while a new node recompiles
+    // the topology
+    if (err >= 0) {
+        bench_conf_reload_version(net, BENCH_CONF_BASE, "conf reload unchanged");
+        bench_conf_reload_version(net, BENCH_CONF_RETUNED, "conf reload one link");
+        bench_conf_reload_version(net, BENCH_CONF_GROWN, "conf reload one node");
+
+        // The routes were carried over, so they don't need working out again
+        tr_node from = tr_net_node(net, "extra");
+        double start = bench_now();
+        for (unsigned int k = 0; k < BENCH_CONF_ROUTES; ++k) {
+            tr_node_hops(from, dests[k]);
+        }
+
+        bench_report_value("conf reload routes after", (bench_now() - start) * 1e3, "ms");
+    }
+
+    remove(BENCH_CONF_PATH);
+
+    if (net) {
+        tr_net_unbind(net);
+        tr_net_delete(net);
+    }
+}
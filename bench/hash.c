@@ -0,0 +1,305 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// hash.c - Hashtable benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "hash.h"
+#include "memory.h"
+
+// Table sizes to run each benchmark at
+//
+static const int g_sizes[] = { 1000, 100000, 1000000 };
+static const int g_numsizes = sizeof(g_sizes) / sizeof(g_sizes[0]);
+
+// Builds 2n distinct keys: keys in [0, n) are hits; keys in [n, 2n) are
+// misses. Each half is shuffled, so neither engine gets a sequential (and
+// prefetcher-friendly) access pattern.
+//
+static int *bench_hash_keys(int n)
+{
+    int *keys = (int*)malloc(2 * n * sizeof(int));
+    for (int i = 0; i < 2 * n; ++i) {
+        keys[i] = (int)((unsigned int)i * 2654435761u);
+    }
+
+    unsigned int seed = 12345;
+    for (int half = 0; half < 2; ++half) {
+        int *k = keys + half * n;
+
+        for (int i = n - 1; i > 0; --i) {
+            seed = seed * 1103515245u + 12345u;
+            int j = (int)((seed >> 8) % (unsigned int)(i + 1));
+
+            int tmp = k[i];
+            k[i] = k[j];
+            k[j] = tmp;
+        }
+    }
+
+    return keys;
+}
+
+static void bench_hash_report(const char *engine, const char *what,
+                              int n, double seconds)
+{
+    char name[128];
+    snprintf(name, sizeof(name), "%s %s n=%d", engine, what, n);
+    bench_report(name, n, seconds);
+}
+
+void bench_hash_insert()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int *keys = bench_hash_keys(n);
+
+        tr_hash hash = tr_inthash_create(sizeof(int));
+        double start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            tr_hash_set(hash, &keys[i], &i);
+        }
+        bench_hash_report("tr_hash", "insert", n, bench_now() - start);
+        tr_hash_delete(hash);
+
+        legacy_hash old = legacy_inthash_create(sizeof(int));
+        start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            legacy_hash_set(old, &keys[i], &i);
+        }
+        bench_hash_report("legacy", "insert", n, bench_now() - start);
+        legacy_hash_delete(old);
+
+        free(keys);
+    }
+}
+
+void bench_hash_lookup_hit()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int *keys = bench_hash_keys(n);
+        unsigned long sum = 0;
+
+        tr_hash hash = tr_inthash_create(sizeof(int));
+        legacy_hash old = legacy_inthash_create(sizeof(int));
+        for (int i = 0; i < n; ++i) {
+            tr_hash_set(hash, &keys[i], &i);
+            legacy_hash_set(old, &keys[i], &i);
+        }
+
+        double start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            sum += *(int*)tr_hash_get(hash, &keys[i]);
+        }
+        bench_hash_report("tr_hash", "lookup hit", n, bench_now() - start);
+
+        start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            sum += *(int*)legacy_hash_get(old, &keys[i]);
+        }
+        bench_hash_report("legacy", "lookup hit", n, bench_now() - start);
+
+        bench_consume(sum);
+        tr_hash_delete(hash);
+        legacy_hash_delete(old);
+        free(keys);
+    }
+}
+
+void bench_hash_lookup_miss()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int *keys = bench_hash_keys(n);
+        unsigned long found = 0;
+
+        tr_hash hash = tr_inthash_create(sizeof(int));
+        legacy_hash old = legacy_inthash_create(sizeof(int));
+        for (int i = 0; i < n; ++i) {
+            tr_hash_set(hash, &keys[i], &i);
+            legacy_hash_set(old, &keys[i], &i);
+        }
+
+        double start = bench_now();
+        for (int i = n; i < 2 * n; ++i) {
+            found += tr_hash_contains(hash, &keys[i]);
+        }
+        bench_hash_report("tr_hash", "lookup miss", n, bench_now() - start);
+
+        start = bench_now();
+        for (int i = n; i < 2 * n; ++i) {
+            found += legacy_hash_contains(old, &keys[i]);
+        }
+        bench_hash_report("legacy", "lookup miss", n, bench_now() - start);
+
+        bench_consume(found);
+        tr_hash_delete(hash);
+        legacy_hash_delete(old);
+        free(keys);
+    }
+}
+
+void bench_hash_remove()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int *keys = bench_hash_keys(n);
+
+        tr_hash hash = tr_inthash_create(sizeof(int));
+        legacy_hash old = legacy_inthash_create(sizeof(int));
+        for (int i = 0; i < n; ++i) {
+            tr_hash_set(hash, &keys[i], &i);
+            legacy_hash_set(old, &keys[i], &i);
+        }
+
+        double start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            tr_hash_clear(hash, &keys[i]);
+        }
+        bench_hash_report("tr_hash", "remove", n, bench_now() - start);
+
+        start = bench_now();
+        for (int i = 0; i < n; ++i) {
+            legacy_hash_clear(old, &keys[i]);
+        }
+        bench_hash_report("legacy", "remove", n, bench_now() - start);
+
+        tr_hash_delete(hash);
+        legacy_hash_delete(old);
+        free(keys);
+    }
+}
+
+void bench_strhash_lookup()
+{
+    // Entity-style IDs, as a 100k-node topology would have
+    static const int n = 100000;
+
+    char **names = (char**)malloc(n * sizeof(char*));
+    for (int i = 0; i < n; ++i) {
+        names[i] = (char*)malloc(32);
+        snprintf(names[i], 32, "node-%d", i);
+    }
+
+    tr_hash hash = tr_strhash_create(sizeof(int));
+    for (int i = 0; i < n; ++i) {
+        tr_strhash_set(hash, names[i], &i);
+    }
+
+    unsigned long sum = 0;
+    double start = bench_now();
+    for (int i = 0; i < n; ++i) {
+        sum += *(int*)tr_strhash_get(hash, names[i]);
+    }
+    bench_hash_report("tr_strhash", "lookup hit", n, bench_now() - start);
+
+    bench_consume(sum);
+    tr_strhash_delete(hash);
+
+    for (int i = 0; i < n; ++i) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+static int bench_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Times every insert individually and reports the tail of the distribution
+//
+static void bench_hash_latency_run(const char *engine, int n, bool incremental)
+{
+    double *times = (double*)malloc(n * sizeof(double));
+
+    tr_hash hash = tr_inthash_create(sizeof(int));
+    tr_hash_set_incremental(hash, incremental);
+
+    double total = bench_now();
+    for (int i = 0; i < n; ++i) {
+        int key = (int)((unsigned int)i * 2654435761u);
+
+        double start = bench_now();
+        tr_hash_set(hash, &key, &i);
+        times[i] = bench_now() - start;
+    }
+    total = bench_now() - total;
+
+    tr_hash_delete(hash);
+    qsort(times, n, sizeof(double), bench_compare_doubles);
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s insert n=%d", engine, n);
+    bench_report(name, n, total);
+
+    snprintf(name, sizeof(name), "%s insert p99 n=%d", engine, n);
+    bench_report_value(name, times[(int)(n * 0.99)] * 1e9, "ns");
+
+    snprintf(name, sizeof(name), "%s insert p99.99 n=%d", engine, n);
+    bench_report_value(name, times[(int)(n * 0.9999)] * 1e9, "ns");
+
+    snprintf(name, sizeof(name), "%s insert max n=%d", engine, n);
+    bench_report_value(name, times[n - 1] * 1e9, "ns");
+
+    free(times);
+}
+
+void bench_hash_insert_latency()
+{
+    static const int sizes[] = { 100000, 4000000 };
+
+    for (int s = 0; s < 2; ++s) {
+        bench_hash_latency_run("tr_hash", sizes[s], false);
+        bench_hash_latency_run("tr_hash incremental", sizes[s], true);
+    }
+}
+
+void bench_hash_iterate()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int *keys = bench_hash_keys(n);
+        int rounds = 10000000 / n;
+
+        tr_hash hash = tr_inthash_create(sizeof(int));
+        for (int i = 0; i < n; ++i) {
+            tr_hash_set(hash, &keys[i], &i);
+        }
+
+        unsigned long sum = 0;
+        double start = bench_now();
+        for (int r = 0; r < rounds; ++r) {
+            tr_hash_iter it;
+            tr_hash_foreach(it, hash) {
+                sum += *(int *)it.value;
+            }
+        }
+        bench_hash_report("cursor", "iterate", n, (bench_now() - start) / rounds);
+
+        start = bench_now();
+        for (int r = 0; r < rounds; ++r) {
+            tr_vector values = tr_inthash_values(hash);
+            tr_vec_foreach(int *, value, values) {
+                sum += *value;
+            }
+            tr_vec_delete(values);
+        }
+        bench_hash_report("tr_hash_values", "iterate", n, (bench_now() - start) / rounds);
+
+        bench_consume(sum);
+        tr_hash_delete(hash);
+        free(keys);
+    }
+}
@@ -0,0 +1,191 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// hashfunc.c - Hash function benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "hash.h"
+
+// Bytes hashed per throughput run
+//
+static const unsigned long g_bytes = 256ul * 1024 * 1024;
+
+// Keys per distribution run, and buckets they're spread over
+//
+static const unsigned int g_keys = 1 << 20;
+#define NUM_BUCKETS (1 << 16)
+
+void bench_hashfunc_throughput()
+{
+    static const unsigned int lengths[] = { 8, 16, 32, 64, 256, 4096 };
+    static const int numlengths = sizeof(lengths) / sizeof(lengths[0]);
+
+    char *buf = (char *)malloc(4096 + 1);
+    for (int i = 0; i < 4096; ++i) {
+        buf[i] = 'a' + i % 26;
+    }
+
+    for (int l = 0; l < numlengths; ++l) {
+        unsigned int len = lengths[l];
+        unsigned long count = g_bytes / len;
+        unsigned long sum = 0;
+        char name[128];
+
+        // djb2 needs a terminated string; vary where it starts so the
+        // compiler can't hoist the hash out of the loop
+        buf[len] = '\0';
+
+        double start = bench_now();
+        for (unsigned long i = 0; i < count; ++i) {
+            const char *str = buf + (i & 1);
+            sum += tr_hashfunc_str(&str);
+        }
+        double seconds = bench_now() - start;
+
+        snprintf(name, sizeof(name), "djb2 len=%u", len);
+        bench_report(name, count, seconds);
+
+        start = bench_now();
+        for (unsigned long i = 0; i < count; ++i) {
+            sum += tr_hash64_bytes(buf + (i & 1), len, i);
+        }
+        seconds = bench_now() - start;
+
+        snprintf(name, sizeof(name), "hash64 len=%u", len);
+        bench_report(name, count, seconds);
+        bench_report_value("hash64 throughput", len * count / seconds / 1e9, "GB/s");
+
+        buf[len] = 'a' + len % 26;
+        bench_consume(sum);
+    }
+
+    unsigned long sum = 0;
+    unsigned long count = g_bytes / 4;
+
+    double start = bench_now();
+    for (unsigned int i = 0; i < count; ++i) {
+        sum += tr_hashfunc64_int(&i, 42);
+    }
+    double seconds = bench_now() - start;
+    bench_report("hash64 int", count, seconds);
+
+    // Hash MACs out of a table, as they would be from packet headers
+    unsigned char (*macs)[6] = malloc(4096 * 6);
+    for (unsigned int i = 0; i < 4096; ++i) {
+        unsigned char mac[6] = { 0x02, 0, 0, 0, i >> 8, i };
+        memcpy(macs[i], mac, 6);
+    }
+
+    start = bench_now();
+    for (unsigned int i = 0; i < count; ++i) {
+        sum += tr_hashfunc64_mac(macs[i & 4095], 42);
+    }
+    seconds = bench_now() - start;
+    bench_report("hash64 mac", count, seconds);
+
+    bench_consume(sum);
+    free(macs);
+    free(buf);
+}
+
+// Fills a key's bytes for the i'th key of a distribution run.
+// Returns the key's length.
+//
+typedef unsigned int (*keygen)(unsigned int i, char *key);
+
+// Hashes a key the way tables did before seeded hashes
+//
+typedef uint64_t (*oldhash)(const char *key, unsigned int len);
+
+static uint64_t bench_old_identity(const char *key, unsigned int len)
+{
+    return tr_hashfunc_int(key);
+}
+
+static uint64_t bench_old_djb2(const char *key, unsigned int len)
+{
+    // djb2 as in tr_hashfunc_str, but over bytes, since MACs contain NULs
+    unsigned int h = 5381;
+    for (unsigned int i = 0; i < len; ++i) {
+        h = (h << 5) + h + (unsigned char)key[i];
+    }
+
+    return h;
+}
+
+static unsigned int bench_key_seqint(unsigned int i, char *key)
+{
+    memcpy(key, &i, sizeof(i));
+    return sizeof(i);
+}
+
+static unsigned int bench_key_mac(unsigned int i, char *key)
+{
+    unsigned char mac[6] = { 0x00, 0x1b, 0x21, i >> 16, i >> 8, i };
+    memcpy(key, mac, 6);
+    return 6;
+}
+
+static unsigned int bench_key_ipstr(unsigned int i, char *key)
+{
+    return sprintf(key, "10.%u.%u.%u", (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+}
+
+// Reports how evenly a hash's low 16 bits spread a set of keys, as
+// chi-squared per degree of freedom (about 1 for a random function; higher
+// is worse) and the fullest bucket's load relative to the mean
+//
+// With old NULL, uses tr_hash64_bytes
+//
+static void bench_hash_spread(const char *name, keygen gen, oldhash old)
+{
+    unsigned int *buckets = (unsigned int *)calloc(NUM_BUCKETS, sizeof(unsigned int));
+    char key[64];
+
+    for (unsigned int i = 0; i < g_keys; ++i) {
+        unsigned int len = gen(i, key);
+        uint64_t h = old ? old(key, len) : tr_hash64_bytes(key, len, 42);
+
+        buckets[h & (NUM_BUCKETS - 1)]++;
+    }
+
+    double expected = (double)g_keys / NUM_BUCKETS;
+    double chi2 = 0;
+    unsigned int max = 0;
+
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+        double d = buckets[b] - expected;
+        chi2 += d * d / expected;
+        if (buckets[b] > max) {
+            max = buckets[b];
+        }
+    }
+
+    char label[128];
+    snprintf(label, sizeof(label), "%s chi2/df", name);
+    bench_report_value(label, chi2 / (NUM_BUCKETS - 1), "");
+    snprintf(label, sizeof(label), "%s max/mean", name);
+    bench_report_value(label, max / expected, "");
+
+    free(buckets);
+}
+
+void bench_hashfunc_spread()
+{
+    bench_hash_spread("identity seqint", bench_key_seqint, bench_old_identity);
+    bench_hash_spread("hash64 seqint", bench_key_seqint, NULL);
+    bench_hash_spread("djb2 mac", bench_key_mac, bench_old_djb2);
+    bench_hash_spread("hash64 mac", bench_key_mac, NULL);
+    bench_hash_spread("djb2 ipstr", bench_key_ipstr, bench_old_djb2);
+    bench_hash_spread("hash64 ipstr", bench_key_ipstr, NULL);
+}
@@ -0,0 +1,367 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// legacy_hash.c - The original coalesced hashtable, kept for comparison
+//
+
+// This is the coalesced-hashing engine tr_hash used before it moved to
+// group-probed open addressing. It's preserved verbatim (modulo renaming)
+// so the hash benchmarks can report old-vs-new numbers side by side.
+//
+
+#include <assert.h> // for assert()
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset
+
+#include "bench.h"
+#include "hash.h"
+#include "memory.h"
+
+struct _legacy_hashitem;
+struct _legacy_hashtable;
+
+typedef struct _legacy_hashitem hashitem;
+typedef struct _legacy_hashtable hashtable;
+
+struct _legacy_hashitem
+{
+    unsigned int occupied;  // Boolean indicating whether slot is in use
+    hashitem *next;         // Next item that shares the same hash value
+    // Next hashtable->keysize bytes contain the key
+    // Then hashtable->valuesize bytes containing the value
+};
+
+struct _legacy_hashtable
+{
+    unsigned int keysize;   // Size of each key, in bytes
+    unsigned int valuesize; // Size of each value, in bytes
+
+    tr_hashfunc hashfunc;   // Uniformly hashes input keys
+    tr_equalfunc equalfunc; // Determines whether two keys are equivalent
+
+    unsigned int capacity;  // Number of items in the table
+    unsigned int numused;   // Number of occupied items in the table
+    unsigned int cellar;    // Start of the cellar region (see below)
+
+    void *items;            // Table of hashitems
+};
+
+// The portion of the hashtable that is reserved for the 'cellar.'
+//
+// In coalesced hashing, the cellar is a portion of the table reserved for
+// items whose hashes conflict with another item already in the table.
+// By separating out this part of the table, we guarantee that chains of
+// values with different hash addresses don't coalesce until the cellar 
+// is full.
+//
+static const double CELLAR = .14;
+
+// Gets the index in the hashtable's item table for the given key
+//
+static unsigned int legacy_hash_addr(hashtable *hash, const void *key)
+{
+    // % hash->cellar: hash to any bucket before the cellar starts
+    return hash->hashfunc(key) % hash->cellar;
+}
+
+// Gets the i'th item from the hashtable's item table
+//
+static hashitem *legacy_hash_item(hashtable *hash, unsigned int i)
+{
+    unsigned int size = sizeof(hashitem) + hash->keysize + hash->valuesize;
+    return (hashitem*)((char*)hash->items + i * size);
+}
+
+// Gets the key for a hash table item
+//
+static void *legacy_hashitem_key(hashtable *hash, hashitem *item)
+{
+    return (char*)item + sizeof(hashitem);
+}
+
+// Gets the value for a hash table item
+//
+static void *legacy_hashitem_value(hashtable *hash, hashitem *item)
+{
+    return (char*)item + sizeof(hashitem) + hash->keysize;
+}
+
+// Sets an item in the hash, without resizing it
+//
+static tr_err legacy_hash_set_without_resizing(hashtable *hash, 
+                                           const void *key, 
+                                           const void *value);
+
+// Resizes an existing hash, migrating over any existing data
+//
+static void legacy_hash_resize(hashtable *hash, unsigned int capacity)
+{
+    assert(hash->numused < capacity);
+
+    // Store the old item table
+    unsigned int prevcap = hash->capacity;
+    void *previtems = hash->items;
+
+    // Allocate the new item table
+    unsigned int itemsize = sizeof(hashitem) + hash->keysize + hash->valuesize;
+    hash->items = tr_malloc(capacity * itemsize);
+    memset(hash->items, 0, capacity * itemsize);
+
+    hash->numused = 0;
+    hash->capacity = capacity;
+    hash->cellar = capacity - CELLAR * capacity;
+
+    if (previtems) {
+
+        // Migrate the existing items to the new table
+        for (unsigned int i = 0; i < prevcap; ++i) {
+
+            hashitem *item = (hashitem*)((char*)previtems + i * itemsize);
+            if (item->occupied) {
+
+                void *key = ((char*)item + sizeof(hashitem));
+                void *value = ((char*)key + hash->keysize);
+
+                legacy_hash_set_without_resizing(hash, key, value);
+            }
+        }
+
+        // Clean up the old item table
+        tr_free(previtems);
+    }
+}
+
+// Resizes the hashtable's intenral item table if needed.
+// Follows the same resize rules as tr_vector.
+//
+static void legacy_hash_resize_if_needed(hashtable *hash)
+{
+    if (hash->numused >= hash->capacity / 2) {
+        legacy_hash_resize(hash, 2 * hash->capacity);
+    }
+    else if (hash->numused <= hash->capacity / 4) {
+        legacy_hash_resize(hash, hash->capacity / 2);
+    }
+}
+
+// Gets the next free hashitem in the cellar.
+// If the cellar is full, returns NULL.
+//
+static hashitem *legacy_hash_next_cellar(hashtable *hash)
+{
+    for (unsigned int i = hash->cellar; i < hash->capacity; ++i) {
+
+        hashitem *item = legacy_hash_item(hash, i);
+        if (!item->occupied) {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+// Stores the given key and value in the given hash item.
+//
+static void legacy_hashitem_claim(hashtable *hash, hashitem *item, 
+                              const void *key, const void *value)
+{
+    assert(!item->occupied);
+    item->occupied = true;
+
+    memcpy(legacy_hashitem_key(hash, item), key, hash->keysize);
+    memcpy(legacy_hashitem_value(hash, item), value, hash->valuesize);
+
+    hash->numused += 1;
+}
+
+legacy_hash legacy_hash_create(unsigned int keysize, 
+                       unsigned int valuesize,
+                       tr_hashfunc hashfunc,
+                       tr_equalfunc equalfunc)
+{
+    hashtable *hash = (hashtable*)tr_malloc(sizeof(hashtable));
+    hash->keysize = keysize;
+    hash->valuesize = valuesize;
+    hash->hashfunc = hashfunc;
+    hash->equalfunc = equalfunc;
+    hash->capacity = 0;
+    hash->numused = 0;
+    hash->cellar = 0;
+    hash->items = NULL;
+
+    legacy_hash_resize(hash, 2);
+    return hash;
+}
+
+tr_err legacy_hash_delete(legacy_hash trh)
+{
+    if (!trh) return TR_EPOINTER;
+
+    hashtable *hash = (hashtable *)trh;
+    tr_free(hash->items);
+    tr_free(hash);
+
+    return TR_OK;
+}
+
+bool legacy_hash_contains(legacy_hash trh, const void *key)
+{
+    if (!trh) return false;
+
+    hashtable *hash = (hashtable*)trh;
+    unsigned int i = legacy_hash_addr(hash, key);
+    hashitem *bucket = legacy_hash_item(hash, i);
+
+    for (hashitem *item = bucket; item; item = item->next) {
+
+        if (!item->occupied) {
+            return false;
+        }
+
+        if (hash->equalfunc(key, legacy_hashitem_key(hash, item))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void *legacy_hash_get(legacy_hash trh, const void *key)
+{
+    if (!trh) return NULL;
+
+    hashtable *hash = (hashtable*)trh;
+    unsigned int i = legacy_hash_addr(hash, key);
+    hashitem *bucket = legacy_hash_item(hash, i);
+
+    for (hashitem *item = bucket; item; item = item->next) {
+        void *itemkey = legacy_hashitem_key(hash, item);
+
+        if (hash->equalfunc(key, itemkey)) {
+            return legacy_hashitem_value(hash, item);
+        }
+    }
+
+    return NULL;
+}
+
+tr_err legacy_hash_set(legacy_hash trh, const void *key, const void *value)
+{
+    if (!trh) return TR_EPOINTER;
+    hashtable *hash = (hashtable*)trh;
+
+    tr_err err = legacy_hash_set_without_resizing(hash, key, value);
+    if (err < 0) {
+        return err;
+    }
+
+    legacy_hash_resize_if_needed(hash);
+    return err;
+}
+
+static tr_err legacy_hash_set_without_resizing(hashtable *hash, 
+                                           const void *key, 
+                                           const void *value)
+{
+    // Insert the item into its bucket if the bucket is free
+    unsigned int i = legacy_hash_addr(hash, key);
+    hashitem *bucket = legacy_hash_item(hash, i);
+
+    if (!bucket->occupied) {
+        legacy_hashitem_claim(hash, bucket, key, value);
+        return TR_OK;
+    }
+
+    // The bucket is occupied; try adding to the cellar
+    hashitem *cellar = legacy_hash_next_cellar(hash);
+    if (cellar) {
+
+        assert(!cellar->occupied);
+        legacy_hashitem_claim(hash, cellar, key, value);
+
+        cellar->next = bucket->next;
+        bucket->next = cellar;
+
+        return TR_OK;
+    }
+
+    // The cellar is full; use open addressing
+    for (unsigned int i = 0; i < hash->capacity; ++i) {
+
+        hashitem *item = legacy_hash_item(hash, i);
+        if (!item->occupied) {
+
+            legacy_hashitem_claim(hash, item, key, value);
+
+            item->next = bucket->next;
+            bucket->next = item;
+
+            return TR_OK;
+        }
+    }
+
+    // The hash itself is full (this should never happen)
+    assert(0 && "Hash is full. Possible bug with legacy_hash_resize_if_needed()");
+    return TR_EINTERNAL;
+}
+
+tr_err legacy_hash_clear(legacy_hash trh, const void *key)
+{
+    if (!trh) return TR_EPOINTER;
+
+    hashtable *hash = (hashtable*)trh;
+    unsigned int i = legacy_hash_addr(hash, key);
+    hashitem *bucket = legacy_hash_item(hash, i);
+
+    hashitem *item = bucket;
+    hashitem *prev = NULL;
+    while (item) {
+
+        void *itemkey = legacy_hashitem_key(hash, item);
+        if (hash->equalfunc(key, itemkey)) {
+
+            item->occupied = false;
+            if (prev) {
+                prev->next = item->next;
+            }
+
+            hash->numused -= 1;
+            legacy_hash_resize_if_needed(hash);
+
+            return TR_OK;
+        }
+
+        prev = item;
+        item = item->next;
+    }
+
+    return TR_ENOTFOUND;
+}
+
+unsigned int legacy_hash_num_keys(legacy_hash trh)
+{
+    if (!trh) return 0;
+
+    hashtable *hash = (hashtable *)trh;
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < hash->capacity; ++i) {
+        hashitem *item = legacy_hash_item(hash, i);
+
+        if (item->occupied) {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+legacy_hash legacy_inthash_create(unsigned int itemsize)
+{
+    return legacy_hash_create(sizeof(int),
+                              itemsize,
+                              tr_hashfunc_int,
+                              tr_equalfunc_int);
+}
@@ -0,0 +1,69 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// list.c - Linked list benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "list.h"
+
+// List lengths to run each benchmark at
+//
+static const int g_sizes[] = { 1000, 100000 };
+static const int g_numsizes = sizeof(g_sizes) / sizeof(g_sizes[0]);
+
+// Total items appended per run, whatever the list length
+//
+static const int g_total = 2000000;
+
+void bench_list_build()
+{
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int rounds = g_total / n;
+        double append = 0, walk = 0, drain = 0;
+        unsigned long sum = 0;
+        char name[128];
+
+        for (int r = 0; r < rounds; ++r) {
+            tr_list list = tr_list_create(sizeof(int));
+
+            double start = bench_now();
+            for (int i = 0; i < n; ++i) {
+                tr_list_append(list, &i);
+            }
+            double built = bench_now();
+
+            tr_list_foreach(int *, item, list) {
+                sum += *item;
+            }
+            double walked = bench_now();
+
+            while (!tr_list_empty(list)) {
+                tr_list_remove_first(list);
+            }
+            double drained = bench_now();
+
+            tr_list_delete(list);
+
+            append += built - start;
+            walk += walked - built;
+            drain += drained - walked;
+        }
+
+        snprintf(name, sizeof(name), "list append n=%d", n);
+        bench_report(name, (unsigned long)rounds * n, append);
+        snprintf(name, sizeof(name), "list walk n=%d", n);
+        bench_report(name, (unsigned long)rounds * n, walk);
+        snprintf(name, sizeof(name), "list remove_first n=%d", n);
+        bench_report(name, (unsigned long)rounds * n, drain);
+
+        bench_consume(sum);
+    }
+}
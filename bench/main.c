@@ -0,0 +1,510 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// main.c - Entry point for benchmark suite
+//
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h> // for waitpid
+#include <unistd.h> // for fork, pipe
+
+#include "bench.h"
+
+static volatile unsigned long g_sink = 0;
+
+// Each benchmark runs in a process of its own, so that what one leaves in
+// the allocator's pools (free lists scrambled by a churn benchmark, say)
+// can't skew the next, and results don't depend on which others ran.
+//
+// In its process, a benchmark runs g_warmup times with its results thrown
+// away, to get caches, the pools and the CPU's clock up to speed, and then
+// g_repeats times. Each reported measurement is summarized across the
+// repeats by its median and spread.
+//
+static int g_warmup = 1;
+static int g_repeats = 5;
+
+// Results slower than the baseline by more than this fraction regress
+//
+static double g_threshold = 0.10;
+
+#define MAX_REPEATS 64
+#define MAX_RESULTS 64
+#define MAX_BASELINE 1024
+
+// One measurement reported by a benchmark, across its repeats
+//
+struct _result
+{
+    char name[96];
+    char unit[16];
+    unsigned long ops;      // Operations per run, for ns/op results
+    int count;              // Number of samples
+    double samples[MAX_REPEATS];
+};
+
+typedef struct _result result;
+
+// A measurement from a baseline file
+//
+struct _baseline
+{
+    char bench[64];
+    char name[96];
+    double p50;
+};
+
+typedef struct _baseline baseline;
+
+static result g_results[MAX_RESULTS];
+static int g_numresults = 0;
+static bool g_recording = false;
+
+static baseline *g_baseline = NULL;
+static int g_numbaseline = 0;
+
+
+typedef void (*benchfunc)();
+
+struct _bench
+{
+    const char *name;
+    benchfunc func;
+};
+
+typedef struct _bench bench;
+
+
+static bench g_benches[] =
+{
+    { "mem_churn", bench_mem_churn },
+    { "net_build_teardown", bench_net_build_teardown },
+    { "net_freeze", bench_net_freeze },
+    { "net_link", bench_net_link },
+    { "net_build_bulk", bench_net_build_bulk },
+    { "net_generate", bench_net_generate },
+
+    { "route_prepare", bench_route_prepare },
+    { "route_flap", bench_route_flap },
+    { "part_torus", bench_part_torus },
+    { "part_scale_free", bench_part_scale_free },
+    { "part_fat_tree", bench_part_fat_tree },
+    { "conf_lex", bench_conf_lex },
+    { "conf_read", bench_conf_read },
+    { "conf_load", bench_conf_load },
+    { "conf_reload", bench_conf_reload },
+
+    { "vec_build", bench_vec_build },
+    { "vec_pushpop", bench_vec_pushpop },
+
+    { "list_build", bench_list_build },
+
+    { "hash_insert", bench_hash_insert },
+    { "hash_lookup_hit", bench_hash_lookup_hit },
+    { "hash_lookup_miss", bench_hash_lookup_miss },
+    { "hash_remove", bench_hash_remove },
+    { "strhash_lookup", bench_strhash_lookup },
+    { "hash_insert_latency", bench_hash_insert_latency },
+    { "hash_iterate", bench_hash_iterate },
+    { "hashfunc_throughput", bench_hashfunc_throughput },
+    { "hashfunc_spread", bench_hashfunc_spread },
+
+    { "typed_machash", bench_typed_machash },
+    { "typed_vec", bench_typed_vec },
+
+    { "intset_dense", bench_intset_dense },
+
+    { "chash_scaling", bench_chash_scaling },
+
+    { "ring_throughput", bench_ring_throughput },
+    { "ring_latency", bench_ring_latency },
+
+    { "wheel_inflight", bench_wheel_inflight },
+    { "wheel_cancel", bench_wheel_cancel },
+};
+
+
+double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Records a sample for the named measurement of the current benchmark
+//
+static void bench_record(const char *name, const char *unit,
+                         unsigned long ops, double sample)
+{
+    if (!g_recording) {
+        return;
+    }
+
+    result *r = NULL;
+    for (int i = 0; i < g_numresults && !r; ++i) {
+        if (strcmp(g_results[i].name, name) == 0) {
+            r = &g_results[i];
+        }
+    }
+
+    if (!r) {
+        if (g_numresults == MAX_RESULTS) {
+            return;
+        }
+
+        r = &g_results[g_numresults++];
+        snprintf(r->name, sizeof(r->name), "%s", name);
+        snprintf(r->unit, sizeof(r->unit), "%s", unit);
+        r->count = 0;
+    }
+
+    r->ops = ops;
+    if (r->count < MAX_REPEATS) {
+        r->samples[r->count++] = sample;
+    }
+}
+
+void bench_report(const char *name, unsigned long ops, double seconds)
+{
+    bench_record(name, "ns/op", ops, seconds * 1e9 / (ops ? ops : 1));
+}
+
+void bench_report_value(const char *name, double value, const char *unit)
+{
+    bench_record(name, unit, 0, value);
+}
+
+void bench_consume(unsigned long value)
+{
+    g_sink += value;
+}
+
+static int bench_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Gets the p'th percentile of sorted samples, by nearest rank
+//
+static double bench_percentile(const double *sorted, int count, int p)
+{
+    int rank = (p * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Gets the string value of a key on a line of JSON written by bench_write
+//
+static bool bench_json_string(const char *line, const char *key,
+                              char *value, size_t size)
+{
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+
+    const char *start = strstr(line, pattern);
+    if (!start) {
+        return false;
+    }
+
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || (size_t)(end - start) >= size) {
+        return false;
+    }
+
+    memcpy(value, start, end - start);
+    value[end - start] = '\0';
+    return true;
+}
+
+// Gets the numeric value of a key on a line of JSON written by bench_write
+//
+static bool bench_json_number(const char *line, const char *key, double *value)
+{
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+    const char *start = strstr(line, pattern);
+    if (!start) {
+        return false;
+    }
+
+    char *end;
+    *value = strtod(start + strlen(pattern), &end);
+    return end != start + strlen(pattern);
+}
+
+// Loads the ns/op medians from a results file written by an earlier run.
+// Only reads the one-result-per-line layout bench_write produces.
+//
+static bool bench_load_baseline(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    g_baseline = (baseline *)malloc(MAX_BASELINE * sizeof(baseline));
+
+    char line[1024], unit[16];
+    while (fgets(line, sizeof(line), file) && g_numbaseline < MAX_BASELINE) {
+        baseline *b = &g_baseline[g_numbaseline];
+
+        if (bench_json_string(line, "bench", b->bench, sizeof(b->bench)) &&
+            bench_json_string(line, "name", b->name, sizeof(b->name)) &&
+            bench_json_string(line, "unit", unit, sizeof(unit)) &&
+            bench_json_number(line, "p50", &b->p50) &&
+            strcmp(unit, "ns/op") == 0) {
+            g_numbaseline++;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static baseline *bench_find_baseline(const char *bench, const char *name)
+{
+    for (int i = 0; i < g_numbaseline; ++i) {
+        if (strcmp(g_baseline[i].bench, bench) == 0 &&
+            strcmp(g_baseline[i].name, name) == 0) {
+            return &g_baseline[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Prints a summary of each of the benchmark's results, and writes them to
+// json (if it isn't NULL), one object per line. Returns the number that
+// regressed.
+//
+static int bench_summarize(const char *bench, FILE *json)
+{
+    int regressions = 0;
+
+    for (int i = 0; i < g_numresults; ++i) {
+        result *r = &g_results[i];
+        qsort(r->samples, r->count, sizeof(double), bench_compare_doubles);
+
+        double p50 = bench_percentile(r->samples, r->count, 50);
+        double p90 = bench_percentile(r->samples, r->count, 90);
+        double min = r->samples[0];
+        double max = r->samples[r->count - 1];
+
+        if (r->ops) {
+            printf("    %-40s %12lu ops %10.2f ns/op  [min %.2f, p90 %.2f]",
+                   r->name, r->ops, p50, min, p90);
+        }
+        else {
+            printf("    %-40s %12.2f %s  [min %.2f, p90 %.2f]",
+                   r->name, p50, r->unit, min, p90);
+        }
+
+        baseline *b = r->ops ? bench_find_baseline(bench, r->name) : NULL;
+        if (b && b->p50 > 0) {
+            double change = (p50 - b->p50) / b->p50;
+            bool regressed = change > g_threshold;
+
+            printf("  %+.1f%%%s", change * 100, regressed ? " REGRESSED" : "");
+            regressions += regressed;
+        }
+
+        printf("\n");
+
+        if (json) {
+            fprintf(json, "{ \"bench\": \"%s\", \"name\": \"%s\", "
+                          "\"unit\": \"%s\", \"ops\": %lu, "
+                          "\"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, "
+                          "\"max\": %.4f, \"samples\": [",
+                    bench, r->name, r->unit, r->ops, min, p50, p90, max);
+
+            for (int s = 0; s < r->count; ++s) {
+                fprintf(json, "%s%.4f", s ? ", " : "", r->samples[s]);
+            }
+
+            fprintf(json, "] }\n");
+        }
+    }
+
+    return regressions;
+}
+
+// Runs a benchmark's warm-ups and repeats, and summarizes its results.
+// Returns the number that regressed.
+//
+static int bench_run(bench b, FILE *json)
+{
+    g_recording = false;
+    for (int w = 0; w < g_warmup; ++w) {
+        b.func();
+    }
+
+    g_numresults = 0;
+    g_recording = true;
+    for (int r = 0; r < g_repeats; ++r) {
+        b.func();
+    }
+
+    return bench_summarize(b.name, json);
+}
+
+// Runs a benchmark in a child process, copying the JSON lines it produces
+// into json as elements of its results array. Returns the number of its
+// results that regressed.
+//
+static int bench_run_isolated(bench b, FILE *json, bool *first)
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return bench_run(b, NULL);
+    }
+
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return bench_run(b, NULL);
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        FILE *out = fdopen(fds[1], "w");
+        int regressions = bench_run(b, out);
+
+        fclose(out);
+        fflush(stdout);
+        _exit(regressions < 255 ? regressions : 255);
+    }
+
+    close(fds[1]);
+    FILE *in = fdopen(fds[0], "r");
+
+    char line[8192];
+    while (fgets(line, sizeof(line), in)) {
+        if (json) {
+            fprintf(json, "%s\n    %.*s", *first ? "" : ",",
+                    (int)strcspn(line, "\n"), line);
+            *first = false;
+        }
+    }
+
+    fclose(in);
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        printf("    (%s crashed)\n", b.name);
+        return 1;
+    }
+
+    return WEXITSTATUS(status);
+}
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-w warmups] [-r repeats] [-o results.json]\n"
+            "       [-b baseline.json] [-t threshold%%] [filter...]\n"
+            "\n"
+            "Runs the benchmarks whose names contain one of the filters (or\n"
+            "all of them), and exits nonzero if any ns/op median is more than\n"
+            "threshold%% slower than in the baseline.\n", prog);
+}
+
+int main(int argc, const char *argv[])
+{
+    int count = sizeof(g_benches) / sizeof(g_benches[0]);
+    const char *output = NULL;
+    const char *filters[64];
+    int numfilters = 0;
+
+    for (int a = 1; a < argc; ++a) {
+        const char *arg = argv[a];
+        bool hasvalue = a + 1 < argc;
+
+        if (strcmp(arg, "-w") == 0 && hasvalue) {
+            g_warmup = atoi(argv[++a]);
+        }
+        else if (strcmp(arg, "-r") == 0 && hasvalue) {
+            g_repeats = atoi(argv[++a]);
+        }
+        else if (strcmp(arg, "-o") == 0 && hasvalue) {
+            output = argv[++a];
+        }
+        else if (strcmp(arg, "-b") == 0 && hasvalue) {
+            const char *path = argv[++a];
+            if (!bench_load_baseline(path)) {
+                fprintf(stderr, "Can't read baseline %s\n", path);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "-t") == 0 && hasvalue) {
+            g_threshold = atof(argv[++a]) / 100;
+        }
+        else if (arg[0] == '-' || numfilters == 64) {
+            bench_usage(argv[0]);
+            return 2;
+        }
+        else {
+            filters[numfilters++] = arg;
+        }
+    }
+
+    if (g_warmup < 0) g_warmup = 0;
+    if (g_repeats < 1) g_repeats = 1;
+    if (g_repeats > MAX_REPEATS) g_repeats = MAX_REPEATS;
+
+    FILE *json = NULL;
+    if (output) {
+        json = fopen(output, "w");
+        if (!json) {
+            fprintf(stderr, "Can't write %s\n", output);
+            return 2;
+        }
+
+        fprintf(json, "{ \"warmup\": %d, \"repeats\": %d, \"results\": [",
+                g_warmup, g_repeats);
+    }
+
+    bool first = true;
+    int regressions = 0;
+
+    // With filters, only run the benchmarks whose names contain one of them
+    for (int i = 0; i < count; ++i) {
+        bench b = g_benches[i];
+
+        bool selected = numfilters == 0;
+        for (int f = 0; f < numfilters; ++f) {
+            selected = selected || strstr(b.name, filters[f]) != NULL;
+        }
+
+        if (!selected) {
+            continue;
+        }
+
+        printf("%d/%d: %s\n", i + 1, count, b.name);
+        regressions += bench_run_isolated(b, json, &first);
+    }
+
+    if (json) {
+        fprintf(json, "\n] }\n");
+        fclose(json);
+    }
+
+    if (g_baseline) {
+        printf("%d result%s regressed more than %.0f%% against the baseline.\n",
+               regressions, regressions == 1 ? "" : "s", g_threshold * 100);
+        free(g_baseline);
+    }
+
+    return regressions ? 1 : 0;
+}
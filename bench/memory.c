@@ -0,0 +1,100 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// memory.c - Allocator benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "memory.h"
+
+// Number of live objects kept around by the churn benchmarks
+//
+static const int g_live = 100000;
+
+// Number of allocate/free pairs per churn run
+//
+static const int g_churn = 5000000;
+
+void bench_mem_churn()
+{
+    static const unsigned int sizes[] = { 24, 64, 200 };
+    void **live = (void **)malloc(g_live * sizeof(void *));
+
+    for (int s = 0; s < 3; ++s) {
+        unsigned int size = sizes[s];
+        char name[128];
+
+        // Free and reallocate objects in a scattered order, so neither
+        // allocator sees a simple stack pattern
+        for (int i = 0; i < g_live; ++i) live[i] = tr_malloc(size);
+        double start = bench_now();
+        for (int i = 0; i < g_churn; ++i) {
+            unsigned int j = ((unsigned int)i * 2654435761u) % g_live;
+            tr_free(live[j]);
+            live[j] = tr_malloc(size);
+        }
+        snprintf(name, sizeof(name), "tr_malloc churn size=%u", size);
+        bench_report(name, g_churn, bench_now() - start);
+        for (int i = 0; i < g_live; ++i) tr_free(live[i]);
+
+        for (int i = 0; i < g_live; ++i) live[i] = malloc(size);
+        start = bench_now();
+        for (int i = 0; i < g_churn; ++i) {
+            unsigned int j = ((unsigned int)i * 2654435761u) % g_live;
+            free(live[j]);
+            live[j] = malloc(size);
+        }
+        snprintf(name, sizeof(name), "malloc churn size=%u", size);
+        bench_report(name, g_churn, bench_now() - start);
+        for (int i = 0; i < g_live; ++i) free(live[i]);
+    }
+
+    free(live);
+}
+
+void bench_net_build_teardown()
+{
+    static const int sizes[] = { 1000, 10000, 100000 };
+    static const int ifacesPerNode = 4;
+
+    for (int s = 0; s < 3; ++s) {
+        int n = sizes[s];
+        char id[64], name[128];
+
+        tr_memstats empty, full;
+        tr_mem_stats(TR_MEM_TOPOLOGY, &empty);
+
+        double start = bench_now();
+        tr_network net = tr_net_create("bench");
+        for (int i = 0; i < n; ++i) {
+            snprintf(id, sizeof(id), "node-%d", i);
+            tr_node node = tr_node_create(net, id);
+
+            for (int f = 0; f < ifacesPerNode; ++f) {
+                snprintf(id, sizeof(id), "node-%d-eth%d", i, f);
+                tr_iface_create(node, id);
+            }
+        }
+        double built = bench_now();
+
+        snprintf(name, sizeof(name), "net build n=%d", n);
+        bench_report(name, n * (1 + ifacesPerNode), built - start);
+
+        // What each node (and its interfaces) costs to keep around
+        tr_mem_stats(TR_MEM_TOPOLOGY, &full);
+        snprintf(name, sizeof(name), "net footprint n=%d", n);
+        bench_report_value(name, (double)(full.bytes - empty.bytes) / n, "B/node");
+
+        tr_net_delete(net);
+
+        snprintf(name, sizeof(name), "net teardown n=%d", n);
+        bench_report(name, n * (1 + ifacesPerNode), bench_now() - built);
+    }
+}
@@ -0,0 +1,228 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// network.c - Network topology benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "iface.h"
+#include "network.h"
+#include "node.h"
+#include "snapshot.h"
+
+void bench_net_freeze()
+{
+    static const int sizes[] = { 10000, 100000 };
+    static const int ifacesPerNode = 4;
+    static const int walks = 20;
+
+    for (int s = 0; s < 2; ++s) {
+        int n = sizes[s];
+        char id[64], name[128];
+
+        tr_network net = tr_net_create("bench");
+        for (int i = 0; i < n; ++i) {
+            snprintf(id, sizeof(id), "node-%d", i);
+            tr_node node = tr_node_create(net, id);
+
+            for (int f = 0; f < ifacesPerNode; ++f) {
+                snprintf(id, sizeof(id), "node-%d-eth%d", i, f);
+                tr_iface_create(node, id);
+            }
+        }
+
+        unsigned long ifaces = (unsigned long)n * ifacesPerNode;
+        unsigned long sum = 0;
+
+        // Visit every interface of every node through the model's tables,
+        // as route computation would have to without a snapshot
+        tr_node *nodes = (tr_node *)malloc(n * sizeof(tr_node));
+        tr_iface found[16];
+
+        double start = bench_now();
+        for (int w = 0; w < walks; ++w) {
+            tr_net_nodes(net, nodes, n);
+            for (int i = 0; i < n; ++i) {
+                unsigned int count = tr_node_num_ifaces(nodes[i]);
+                tr_node_ifaces(nodes[i], found, 16);
+
+                for (unsigned int f = 0; f < count; ++f) {
+                    sum += tr_iface_get(found[f])->id;
+                }
+            }
+        }
+        snprintf(name, sizeof(name), "net walk model n=%d", n);
+        bench_report(name, walks * ifaces, bench_now() - start);
+
+        start = bench_now();
+        tr_net_bind(net);
+        snprintf(name, sizeof(name), "net freeze n=%d", n);
+        bench_report(name, n * (1 + ifacesPerNode), bench_now() - start);
+
+        // The same walk over the snapshot
+        snapshot *snap = ((network *)net)->frozen;
+
+        start = bench_now();
+        for (int w = 0; w < walks; ++w) {
+            for (unsigned int i = 0; i < snap->num_nodes; ++i) {
+                unsigned int end = snap->node_ifaces[i + 1];
+                for (unsigned int f = snap->node_ifaces[i]; f < end; ++f) {
+                    sum += snap->ifaces[f]->id;
+                }
+            }
+        }
+        snprintf(name, sizeof(name), "net walk snapshot n=%d", n);
+        bench_report(name, walks * ifaces, bench_now() - start);
+
+        bench_consume(sum);
+        free(nodes);
+
+        tr_net_unbind(net);
+        tr_net_delete(net);
+    }
+}
+
+// Links one hub with many ports to as many leaves, then a dense mesh, and
+// looks every link up again by its pair of interfaces
+//
+static void bench_net_link_topology(const char *label, int hubs, int ports)
+{
+    char id[64], name[128];
+    tr_network net = tr_net_create("bench");
+
+    int n = hubs + ports;
+    tr_iface *ifaces = (tr_iface *)malloc(n * ports * sizeof(tr_iface));
+    for (int i = 0; i < n; ++i) {
+        snprintf(id, sizeof(id), "node-%d", i);
+        tr_node node = tr_node_create(net, id);
+
+        int count = i < hubs ? ports : hubs;
+        for (int f = 0; f < count; ++f) {
+            snprintf(id, sizeof(id), "node-%d-eth%d", i, f);
+            ifaces[i * ports + f] = tr_iface_create(node, id);
+        }
+    }
+
+    // Hub h's port p goes to leaf p's interface h
+    unsigned long links = (unsigned long)hubs * ports;
+
+    double start = bench_now();
+    for (int h = 0; h < hubs; ++h) {
+        for (int p = 0; p < ports; ++p) {
+            tr_net_link(net, ifaces[h * ports + p], ifaces[(hubs + p) * ports + h], NULL);
+        }
+    }
+    snprintf(name, sizeof(name), "net link %s", label);
+    bench_report(name, links, bench_now() - start);
+
+    unsigned long found = 0;
+
+    start = bench_now();
+    for (int h = 0; h < hubs; ++h) {
+        for (int p = 0; p < ports; ++p) {
+            found += tr_iface_has_link(ifaces[(hubs + p) * ports + h], ifaces[h * ports + p]);
+        }
+    }
+    snprintf(name, sizeof(name), "net has_link %s", label);
+    bench_report(name, links, bench_now() - start);
+
+    bench_consume(found);
+    free(ifaces);
+    tr_net_delete(net);
+}
+
+void bench_net_link()
+{
+    bench_net_link_topology("hub ports=10000", 1, 10000);
+    bench_net_link_topology("mesh 300x300", 300, 300);
+}
+
+// Builds a million interfaces (and a ring of links through them) one call
+// at a time, and then through the bulk API
+//
+void bench_net_build_bulk()
+{
+    static const int n = 250000;
+    static const int ifacesPerNode = 4;
+
+    char id[64];
+    tr_node *nodes = (tr_node *)malloc(n * sizeof(tr_node));
+    tr_iface *ifaces = (tr_iface *)malloc(n * ifacesPerNode * sizeof(tr_iface));
+    tr_iface *ends = (tr_iface *)malloc(2 * n * sizeof(tr_iface));
+    unsigned long entities = (unsigned long)n * (1 + ifacesPerNode) + n;
+
+    double start = bench_now();
+    tr_network net = tr_net_create("bench");
+    for (int i = 0; i < n; ++i) {
+        snprintf(id, sizeof(id), "node-%d", i);
+        nodes[i] = tr_node_create(net, id);
+
+        for (int f = 0; f < ifacesPerNode; ++f) {
+            snprintf(id, sizeof(id), "node-%d-eth%d", i, f);
+            ifaces[i * ifacesPerNode + f] = tr_iface_create(nodes[i], id);
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        tr_net_link(net, ifaces[i * ifacesPerNode],
+                    ifaces[((i + 1) % n) * ifacesPerNode + 1], NULL);
+    }
+
+    double elapsed = bench_now() - start;
+    bench_report("net build one-by-one ifaces=1000000", entities, elapsed);
+    bench_report_value("net build one-by-one total", elapsed * 1e3, "ms");
+    tr_net_delete(net);
+
+    start = bench_now();
+    net = tr_net_create("bench");
+    tr_net_reserve(net, n, n * ifacesPerNode, n);
+    tr_node_create_seq(net, "node-", 0, n, nodes);
+
+    tr_iface_create_seq(nodes, n, "-eth", 0, ifacesPerNode, ifaces);
+
+    for (int i = 0; i < n; ++i) {
+        ends[2 * i] = ifaces[i * ifacesPerNode];
+        ends[2 * i + 1] = ifaces[((i + 1) % n) * ifacesPerNode + 1];
+    }
+
+    tr_net_link_many(net, ends, n, NULL);
+
+    elapsed = bench_now() - start;
+    bench_report("net build bulk ifaces=1000000", entities, elapsed);
+    bench_report_value("net build bulk total", elapsed * 1e3, "ms");
+    tr_net_delete(net);
+
+    free(ends);
+    free(ifaces);
+    free(nodes);
+}
+
+void bench_net_generate()
+{
+    double start = bench_now();
+    tr_network net = tr_net_create("bench");
+    tr_gen_fat_tree(net, 48, NULL);
+    double elapsed = bench_now() - start;
+
+    // A 48-ary fat tree has 2880 switches, 27648 hosts and 82944 links
+    unsigned long entities = 2880 + 27648 + 3 * 82944;
+    bench_report("gen fat-tree k=48", entities, elapsed);
+    tr_net_delete(net);
+
+    tr_genopts opts = { 1, NULL, 0, 0, 0 };
+    start = bench_now();
+    net = tr_net_create("bench");
+    tr_gen_barabasi_albert(net, 100000, 3, &opts);
+    elapsed = bench_now() - start;
+
+    entities = 100000 + 3 * (6 + 99996 * 3);
+    bench_report("gen barabasi-albert n=100000 m=3", entities, elapsed);
+    tr_net_delete(net);
+}
@@ -0,0 +1,66 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part.c - Thread placement benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+
+#include "bench.h"
+
+// Places the network on 2 to 64 threads, reporting how long it takes, how
+// much of its traffic crosses between threads, and how uneven threads are
+//
+static void bench_part_network(const char *label, tr_network net)
+{
+    static const unsigned parts[] = { 2, 8, 64 };
+
+    tr_net_bind(net);
+
+    for (unsigned int i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i) {
+        char name[128];
+        tr_partinfo info;
+
+        double start = bench_now();
+        tr_net_partition(net, parts[i], 0.03f, &info);
+        double elapsed = bench_now() - start;
+
+        snprintf(name, sizeof(name), "part %s k=%u time", label, parts[i]);
+        bench_report_value(name, elapsed * 1e3, "ms");
+
+        snprintf(name, sizeof(name), "part %s k=%u cut", label, parts[i]);
+        bench_report_value(name, 100.0 * info.cut / info.traffic, "%");
+
+        snprintf(name, sizeof(name), "part %s k=%u imbalance", label, parts[i]);
+        bench_report_value(name, 100.0 * info.imbalance, "%");
+    }
+
+    tr_net_delete(net);
+}
+
+void bench_part_torus()
+{
+    static const unsigned dims[3] = { 37, 37, 37 };
+
+    tr_network net = tr_net_create("bench");
+    tr_gen_torus(net, dims, 3, NULL);
+    bench_part_network("torus nodes=50653", net);
+}
+
+void bench_part_scale_free()
+{
+    tr_network net = tr_net_create("bench");
+    tr_gen_barabasi_albert(net, 50000, 3, NULL);
+    bench_part_network("ba nodes=50000", net);
+}
+
+void bench_part_fat_tree()
+{
+    tr_network net = tr_net_create("bench");
+    tr_gen_fat_tree(net, 24, NULL);
+    bench_part_network("fat-tree k=24", net);
+}
@@ -0,0 +1,188 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ring.c - Ring buffer benchmarks
+//
+
+#define _POSIX_C_SOURCE 200112L // for sched_yield
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "ring.h"
+
+// Items pushed through the ring per throughput run, and round trips per
+// latency run
+//
+static const unsigned long g_items = 4000000;
+static const int g_roundtrips = 100000;
+
+static const unsigned int g_capacity = 1024;
+
+#define MAX_BATCH 64
+#define MAX_PRODUCERS 4
+
+struct _ringbench
+{
+    tr_ring ring;
+    unsigned long count;    // Items this producer pushes
+    unsigned int batch;     // Items per push_n call
+};
+
+typedef struct _ringbench ringbench;
+
+static void *bench_ring_producer(void *arg)
+{
+    ringbench *b = (ringbench *)arg;
+    unsigned long items[MAX_BATCH];
+    unsigned long sent = 0;
+
+    while (sent < b->count) {
+        unsigned int n = b->batch;
+        if (n > b->count - sent) {
+            n = (unsigned int)(b->count - sent);
+        }
+
+        for (unsigned int i = 0; i < n; ++i) {
+            items[i] = sent + i;
+        }
+
+        unsigned int pushed = tr_ring_push_n(b->ring, items, n);
+        if (pushed == 0) {
+            sched_yield();
+        }
+
+        sent += pushed;
+    }
+
+    return NULL;
+}
+
+// Pushes g_items through a ring from nproducers threads, consuming on this
+// one, and reports the throughput
+//
+static void bench_ring_run(bool multi, int nproducers, unsigned int batch)
+{
+    tr_ring ring = multi ? tr_ring_create_mpsc(sizeof(unsigned long), g_capacity)
+                         : tr_ring_create_spsc(sizeof(unsigned long), g_capacity);
+
+    pthread_t threads[MAX_PRODUCERS];
+    ringbench ctx[MAX_PRODUCERS];
+    unsigned long items[MAX_BATCH];
+    unsigned long sum = 0;
+
+    double start = bench_now();
+    for (int t = 0; t < nproducers; ++t) {
+        ringbench b = { ring, g_items / nproducers, batch };
+        ctx[t] = b;
+        pthread_create(&threads[t], NULL, bench_ring_producer, &ctx[t]);
+    }
+
+    unsigned long remaining = (g_items / nproducers) * nproducers;
+    while (remaining > 0) {
+        unsigned int n = tr_ring_pop_n(ring, items, batch);
+        if (n == 0) {
+            tr_ring_wait(ring, -1);
+            continue;
+        }
+
+        sum += items[0];
+        remaining -= n;
+    }
+
+    for (int t = 0; t < nproducers; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    double seconds = bench_now() - start;
+
+    bench_consume(sum);
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s producers=%d batch=%u",
+             multi ? "mpsc" : "spsc", nproducers, batch);
+    bench_report(name, g_items, seconds);
+
+    tr_ring_delete(ring);
+}
+
+void bench_ring_throughput()
+{
+    static const unsigned int batches[] = { 1, 32 };
+
+    for (int i = 0; i < 2; ++i) {
+        bench_ring_run(false, 1, batches[i]);
+    }
+
+    for (int n = 1; n <= MAX_PRODUCERS; n *= 2) {
+        for (int i = 0; i < 2; ++i) {
+            bench_ring_run(true, n, batches[i]);
+        }
+    }
+}
+
+struct _pingpong
+{
+    tr_ring ping;
+    tr_ring pong;
+};
+
+typedef struct _pingpong pingpong;
+
+// Echoes everything from ping back on pong, sleeping when there's nothing
+//
+static void *bench_ring_echo(void *arg)
+{
+    pingpong *pp = (pingpong *)arg;
+
+    for (int i = 0; i < g_roundtrips; ++i) {
+        unsigned long item;
+        while (tr_ring_pop(pp->ping, &item) != TR_OK) {
+            tr_ring_wait(pp->ping, -1);
+        }
+
+        tr_ring_push(pp->pong, &item);
+    }
+
+    return NULL;
+}
+
+// Bounces one item back and forth between two threads. Each hop goes
+// through an empty ring, so this measures the cost of waking a sleeping
+// consumer, not just the queue operations.
+//
+void bench_ring_latency()
+{
+    pingpong pp;
+    pp.ping = tr_ring_create_spsc(sizeof(unsigned long), 16);
+    pp.pong = tr_ring_create_spsc(sizeof(unsigned long), 16);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, bench_ring_echo, &pp);
+
+    double start = bench_now();
+    for (int i = 0; i < g_roundtrips; ++i) {
+        unsigned long item = (unsigned long)i;
+        tr_ring_push(pp.ping, &item);
+
+        while (tr_ring_pop(pp.pong, &item) != TR_OK) {
+            tr_ring_wait(pp.pong, -1);
+        }
+
+        bench_consume(item);
+    }
+    double seconds = bench_now() - start;
+
+    pthread_join(thread, NULL);
+
+    bench_report_value("spsc one-way latency",
+                       seconds * 1e9 / (2.0 * g_roundtrips), "ns");
+
+    tr_ring_delete(pp.ping);
+    tr_ring_delete(pp.pong);
+}
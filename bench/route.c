@@ -0,0 +1,127 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route.c - Psychic routing benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+
+#include "bench.h"
+#include "link.h"
+#include "network.h"
+#include "snapshot.h"
+
+// A 37x37x37 torus has 50653 nodes, every one 6 links from its neighbors
+//
+static tr_network bench_route_torus()
+{
+    static const unsigned dims[3] = { 37, 37, 37 };
+
+    tr_network net = tr_net_create("bench");
+    tr_gen_torus(net, dims, 3, NULL);
+    return net;
+}
+
+void bench_route_prepare()
+{
+    static const unsigned numdests = 256;
+
+    tr_network net = bench_route_torus();
+    unsigned int n = tr_net_num_nodes(net);
+    tr_node *nodes = (tr_node *)malloc(n * sizeof(tr_node));
+    tr_net_nodes(net, nodes, n);
+
+    double start = bench_now();
+    tr_net_bind(net);
+    bench_report_value("route bind nodes=50653", (bench_now() - start) * 1e3, "ms");
+
+    // Spread the destinations over the whole torus
+    tr_node *dests = (tr_node *)malloc(numdests * sizeof(tr_node));
+    for (unsigned int k = 0; k < numdests; ++k) {
+        dests[k] = nodes[(unsigned long)k * n / numdests];
+    }
+
+    start = bench_now();
+    tr_net_prepare_routes(net, dests, numdests);
+    double elapsed = bench_now() - start;
+
+    bench_report("route prepare per tree nodes=50653", numdests, elapsed);
+    bench_report_value("route prepare dests=256", elapsed * 1e3, "ms");
+
+    // Lookups from everywhere to everywhere prepared
+    unsigned long hops = 0;
+    unsigned long lookups = 0;
+    start = bench_now();
+    for (unsigned int k = 0; k < numdests; ++k) {
+        for (unsigned int i = 0; i < n; i += 7) {
+            hops += tr_node_next_hop(nodes[i], dests[k]) != NULL;
+            ++lookups;
+        }
+    }
+
+    bench_report("route next hop", lookups, bench_now() - start);
+    bench_consume(hops);
+
+    tr_net_unbind(net);
+    tr_net_delete(net);
+    free(dests);
+    free(nodes);
+}
+
+void bench_route_flap()
+{
+    static const unsigned numdests = 256;
+    static const int flaps = 200;
+
+    tr_network net = bench_route_torus();
+    unsigned int n = tr_net_num_nodes(net);
+    tr_node *nodes = (tr_node *)malloc(n * sizeof(tr_node));
+    tr_node *dests = (tr_node *)malloc(numdests * sizeof(tr_node));
+    tr_net_nodes(net, nodes, n);
+
+    for (unsigned int k = 0; k < numdests; ++k) {
+        dests[k] = nodes[(unsigned long)k * n / numdests];
+    }
+
+    tr_net_prepare_routes(net, dests, numdests);
+
+    // Flap links next to the destinations, which every tree routes over,
+    // and random ones, which few do
+    snapshot *snap = ((network *)net)->frozen;
+    unsigned int seed = 7;
+    double near = 0, far = 0;
+
+    for (int k = 0; k < flaps; ++k) {
+        seed = seed * 1103515245 + 12345;
+
+        tr_link l = tr_link_handle(snap->links[(seed >> 8) % snap->num_links]);
+        if (k % 2 == 0) {
+            tr_iface i = tr_node_next_hop(nodes[(seed >> 4) % n], dests[k % numdests]);
+            tr_iface_links(i, &l, 1);
+        }
+
+        double start = bench_now();
+        tr_link_disable(l);
+        tr_link_enable(l);
+        double elapsed = bench_now() - start;
+
+        if (k % 2 == 0) {
+            near += elapsed;
+        }
+        else {
+            far += elapsed;
+        }
+    }
+
+    bench_report("route flap on path dests=256 nodes=50653", flaps / 2, near);
+    bench_report("route flap random dests=256 nodes=50653", flaps / 2, far);
+
+    tr_net_unbind(net);
+    tr_net_delete(net);
+    free(dests);
+    free(nodes);
+}
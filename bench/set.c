@@ -0,0 +1,74 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// set.c - Hash set benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "set.h"
+
+static const int g_items = 1000000;
+static const int g_rounds = 10;
+
+// Adds, looks up and iterates g_items ints, spaced stride apart. Stride 1
+// gives a dense (bitmap) intset; wide strides keep it a hashtable.
+//
+static void bench_intset_run(int stride)
+{
+    char name[128];
+    tr_set set = tr_intset_create();
+
+    double start = bench_now();
+    for (int i = 0; i < g_items; ++i) {
+        tr_intset_add(set, i * stride);
+    }
+    double seconds = bench_now() - start;
+
+    snprintf(name, sizeof(name), "add stride=%d%s", stride,
+             tr_intset_dense(set) ? " (bitmap)" : "");
+    bench_report(name, g_items, seconds);
+
+    unsigned long found = 0;
+    unsigned int seed = 1234;
+
+    start = bench_now();
+    for (int i = 0; i < g_items; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        found += tr_intset_contains(set, (int)((seed >> 8) % (unsigned int)g_items) * stride);
+    }
+    seconds = bench_now() - start;
+
+    bench_consume(found);
+    snprintf(name, sizeof(name), "contains stride=%d", stride);
+    bench_report(name, g_items, seconds);
+
+    unsigned long sum = 0;
+
+    start = bench_now();
+    for (int r = 0; r < g_rounds; ++r) {
+        tr_set_iter it;
+        tr_set_foreach(it, set) {
+            sum += *(int *)it.key;
+        }
+    }
+    seconds = bench_now() - start;
+
+    bench_consume(sum);
+    snprintf(name, sizeof(name), "iterate stride=%d", stride);
+    bench_report(name, (unsigned long)g_items * g_rounds, seconds);
+
+    tr_intset_delete(set);
+}
+
+void bench_intset_dense()
+{
+    bench_intset_run(1);
+    bench_intset_run(4);
+    bench_intset_run(1000);
+}
@@ -0,0 +1,165 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// typed.c - Typed container benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "hash.h"
+#include "typed.h"
+#include "vector.h"
+
+struct _benchmac
+{
+    unsigned char bytes[6];
+};
+
+typedef struct _benchmac benchmac;
+
+#define benchmac_hash(m, seed) tr_hash64_mac((m).bytes, (seed))
+#define benchmac_equal(m1, m2) (memcmp((m1).bytes, (m2).bytes, 6) == 0)
+
+TR_HASH_DEFINE(benchmachash, benchmac, int, benchmac_hash, benchmac_equal)
+
+// A forwarding table's worth of MAC addresses
+//
+static const int g_macs = 100000;
+static const int g_lookups = 10000000;
+
+// Builds n distinct MACs, scattered across the address space
+//
+static benchmac *bench_typed_macs(int n)
+{
+    benchmac *macs = (benchmac *)malloc(n * sizeof(benchmac));
+    for (int i = 0; i < n; ++i) {
+        unsigned int r = (unsigned int)i * 2654435761u;
+        benchmac mac = { { 0x02, 0x00, r >> 24, r >> 16, r >> 8, r } };
+        macs[i] = mac;
+    }
+
+    return macs;
+}
+
+static void bench_typed_report(const char *engine, const char *what,
+                               unsigned long ops, double seconds)
+{
+    char name[128];
+    snprintf(name, sizeof(name), "%s %s", engine, what);
+    bench_report(name, ops, seconds);
+}
+
+void bench_typed_machash()
+{
+    benchmac *macs = bench_typed_macs(g_macs);
+    unsigned long sum = 0;
+
+    // The generic table, as a MAC table would have to use it
+    tr_hash generic = tr_hash_create_seeded(sizeof(benchmac), sizeof(int),
+                                            tr_hashfunc64_mac, tr_equalfunc_mac);
+
+    double start = bench_now();
+    for (int i = 0; i < g_macs; ++i) {
+        tr_hash_set(generic, &macs[i], &i);
+    }
+    bench_typed_report("tr_hash", "insert", g_macs, bench_now() - start);
+
+    start = bench_now();
+    for (int i = 0; i < g_lookups; ++i) {
+        sum += *(int *)tr_hash_get(generic, &macs[((unsigned int)i * 7919u) % g_macs]);
+    }
+    bench_typed_report("tr_hash", "lookup", g_lookups, bench_now() - start);
+
+    tr_hash_delete(generic);
+
+    // The same table, specialized
+    tr_benchmachash *typed = tr_benchmachash_create();
+
+    start = bench_now();
+    for (int i = 0; i < g_macs; ++i) {
+        tr_benchmachash_set(typed, macs[i], i);
+    }
+    bench_typed_report("typed", "insert", g_macs, bench_now() - start);
+
+    start = bench_now();
+    for (int i = 0; i < g_lookups; ++i) {
+        sum += *tr_benchmachash_get(typed, macs[((unsigned int)i * 7919u) % g_macs]);
+    }
+    bench_typed_report("typed", "lookup", g_lookups, bench_now() - start);
+
+    tr_benchmachash_delete(typed);
+
+    bench_consume(sum);
+    free(macs);
+}
+
+// A packet descriptor, as a per-link queue would hold it
+//
+struct _benchpkt
+{
+    unsigned int id;
+    unsigned int len;
+    unsigned long long sent;
+};
+
+typedef struct _benchpkt benchpkt;
+
+TR_VEC_DEFINE(benchpktvec, benchpkt)
+
+void bench_typed_vec()
+{
+    static const int count = 1000;
+    static const int rounds = 20000;
+
+    unsigned long sum = 0;
+
+    // Fill and drain a queue of packets, as a link does every tick
+    tr_vector generic = tr_vec_create(sizeof(benchpkt), count);
+
+    double start = bench_now();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < count; ++i) {
+            benchpkt pkt = { i, 64 + i, r };
+            tr_vec_append(generic, &pkt);
+        }
+
+        for (int i = 0; i < count; ++i) {
+            sum += ((benchpkt *)tr_vec_item(generic, i))->len;
+        }
+
+        tr_vec_remove_range(generic, 0, count);
+    }
+    bench_typed_report("tr_vector", "append+scan", (unsigned long)rounds * count,
+                       bench_now() - start);
+
+    tr_vec_delete(generic);
+
+    tr_benchpktvec *typed = tr_benchpktvec_create(count);
+
+    start = bench_now();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < count; ++i) {
+            benchpkt pkt = { i, 64 + i, r };
+            tr_benchpktvec_append(typed, pkt);
+        }
+
+        for (int i = 0; i < count; ++i) {
+            sum += tr_benchpktvec_item(typed, i)->len;
+        }
+
+        tr_benchpktvec_clear(typed);
+    }
+    bench_typed_report("typed", "append+scan", (unsigned long)rounds * count,
+                       bench_now() - start);
+
+    tr_benchpktvec_delete(typed);
+
+    bench_consume(sum);
+}
@@ -0,0 +1,102 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// vector.c - Vector benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "vector.h"
+
+// Total items added per build pattern
+//
+static const int g_total = 4000000;
+
+// Vector sizes to build, from a node's interface list up to a big table
+//
+static const int g_sizes[] = { 4, 64, 100000 };
+static const int g_numsizes = sizeof(g_sizes) / sizeof(g_sizes[0]);
+
+static void bench_vec_report(const char *what, int n, double seconds)
+{
+    char name[128];
+    snprintf(name, sizeof(name), "vec %s n=%d", what, n);
+    bench_report(name, g_total, seconds);
+}
+
+void bench_vec_build()
+{
+    int *items = (int*)malloc(g_sizes[g_numsizes - 1] * sizeof(int));
+    for (int i = 0; i < g_sizes[g_numsizes - 1]; ++i) {
+        items[i] = i;
+    }
+
+    for (int s = 0; s < g_numsizes; ++s) {
+        int n = g_sizes[s];
+        int rounds = g_total / n;
+        unsigned long sum = 0;
+
+        // One item at a time, from an empty vector
+        double start = bench_now();
+        for (int r = 0; r < rounds; ++r) {
+            tr_vector vec = tr_vec_create(sizeof(int), 0);
+            for (int i = 0; i < n; ++i) {
+                tr_vec_append(vec, &items[i]);
+            }
+            sum += tr_vec_size(vec);
+            tr_vec_delete(vec);
+        }
+        bench_vec_report("append", n, bench_now() - start);
+
+        // One item at a time, into a vector created at the right size
+        start = bench_now();
+        for (int r = 0; r < rounds; ++r) {
+            tr_vector vec = tr_vec_create(sizeof(int), n);
+            for (int i = 0; i < n; ++i) {
+                tr_vec_append(vec, &items[i]);
+            }
+            sum += tr_vec_size(vec);
+            tr_vec_delete(vec);
+        }
+        bench_vec_report("append presized", n, bench_now() - start);
+
+        // All at once
+        start = bench_now();
+        for (int r = 0; r < rounds; ++r) {
+            tr_vector vec = tr_vec_create(sizeof(int), 0);
+            tr_vec_append_n(vec, items, n);
+            sum += tr_vec_size(vec);
+            tr_vec_delete(vec);
+        }
+        bench_vec_report("append_n", n, bench_now() - start);
+
+        bench_consume(sum);
+    }
+
+    free(items);
+}
+
+void bench_vec_pushpop()
+{
+    // Hover around a size where the old halve-at-a-quarter policy resized
+    // on nearly every operation
+    tr_vector vec = tr_vec_create(sizeof(int), 0);
+    int value = 0;
+
+    double start = bench_now();
+    for (int i = 0; i < g_total / 4; ++i) {
+        tr_vec_push(vec, &value);
+        tr_vec_push(vec, &value);
+        tr_vec_pop(vec);
+        tr_vec_pop(vec);
+    }
+    bench_vec_report("push/pop", 0, bench_now() - start);
+
+    tr_vec_delete(vec);
+}
@@ -0,0 +1,100 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// wheel.c - Timing wheel benchmarks
+//
+
+#include <traffic.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "wheel.h"
+
+// A link carrying g_rate packets per microsecond with 200ms +/- 50ms of
+// latency keeps around a million packets in flight
+//
+static const uint64_t g_tick = 1000;            // 1us
+static const uint64_t g_latency = 200000000;    // 200ms
+static const uint64_t g_variance = 50000000;    // 50ms
+static const int g_rate = 5;
+static const int g_duration = 600000;           // In ticks
+
+#define POOL_SIZE 2000000
+
+static void bench_wheel_deliver(tr_timer *timer, void *ctx)
+{
+    (*(unsigned long *)ctx)++;
+}
+
+void bench_wheel_inflight()
+{
+    tr_wheel wheel = tr_wheel_create(g_tick);
+    tr_timer *pool = (tr_timer *)malloc(POOL_SIZE * sizeof(tr_timer));
+    unsigned long delivered = 0;
+    unsigned long sent = 0;
+    unsigned int seed = 1234;
+
+    for (int i = 0; i < POOL_SIZE; ++i) {
+        tr_timer_init(&pool[i], bench_wheel_deliver, &delivered);
+    }
+
+    unsigned int maxinflight = 0;
+
+    double start = bench_now();
+    for (int t = 1; t <= g_duration; ++t) {
+        for (int p = 0; p < g_rate; ++p) {
+            seed = seed * 1103515245u + 12345u;
+            uint64_t jitter = ((uint64_t)seed * (2 * g_variance)) >> 32;
+
+            tr_timer *timer = &pool[sent++ % POOL_SIZE];
+            tr_wheel_schedule(wheel, timer, g_latency - g_variance + jitter);
+        }
+
+        tr_wheel_advance(wheel, (uint64_t)t * g_tick);
+
+        if (tr_wheel_num_timers(wheel) > maxinflight) {
+            maxinflight = tr_wheel_num_timers(wheel);
+        }
+    }
+    double seconds = bench_now() - start;
+
+    bench_report("schedule+deliver", sent + delivered, seconds);
+    bench_report_value("peak packets in flight", maxinflight, "timers");
+
+    tr_wheel_delete(wheel);
+    free(pool);
+}
+
+void bench_wheel_cancel()
+{
+    static const int count = 1000000;
+
+    tr_wheel wheel = tr_wheel_create(g_tick);
+    tr_timer *timers = (tr_timer *)malloc(count * sizeof(tr_timer));
+    unsigned int seed = 1234;
+
+    double start = bench_now();
+    for (int i = 0; i < count; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        tr_timer_init(&timers[i], NULL, NULL);
+        tr_wheel_schedule(wheel, &timers[i], (uint64_t)(seed >> 8) * g_tick);
+    }
+    double seconds = bench_now() - start;
+
+    bench_report("schedule", count, seconds);
+
+    start = bench_now();
+    for (int i = 0; i < count; ++i) {
+        tr_wheel_cancel(wheel, &timers[i]);
+    }
+    seconds = bench_now() - start;
+
+    bench_report("cancel", count, seconds);
+
+    tr_wheel_delete(wheel);
+    free(timers);
+}
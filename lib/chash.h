@@ -0,0 +1,74 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// chash.h - Concurrent sharded hashtable
+//
+
+#ifndef CHASH_H
+#define CHASH_H
+
+#include <traffic.h>
+
+#include "hash.h" // for tr_hashfunc and tr_equalfunc
+
+// A tr_chash has the same model as tr_hash (fixed-size keys and values,
+// caller-supplied hash and equality functions), but can be used from many
+// threads at once. Keys are spread across shards; writers lock only their
+// key's shard, and readers don't lock at all.
+//
+// Because another thread may change or remove an item at any time, lookups
+// copy values out rather than returning pointers into the table.
+//
+// Keys are compared on consistent snapshots only, but those snapshots may
+// be of keys that have since been removed; keys that point at other memory
+// (e.g. strings) must keep that memory alive while any thread might still
+// be looking them up.
+//
+typedef void *tr_chash;
+
+// Updates a value in place. isnew is set if the key wasn't in the table, in
+// which case the value starts out zeroed.
+typedef void (*tr_chash_updatefunc)(void *value, bool isnew, void *ctx);
+
+// Returns NULL if memory runs out
+tr_chash tr_chash_create(unsigned int keysize,
+                         unsigned int valuesize,
+                         tr_hashfunc hashfunc,
+                         tr_equalfunc equalfunc);
+
+// No other thread may be using the table when it's deleted. Waits for the
+// tables it outgrew to be freed, which takes until other tables' readers
+// are done with their current lookups.
+tr_err tr_chash_delete(tr_chash hash);
+
+bool tr_chash_contains(tr_chash hash, const void *key);
+
+// Copies the key's value into value (if it's not NULL).
+// Returns TR_ENOTFOUND if the key isn't in the table.
+tr_err tr_chash_get(tr_chash hash, const void *key, void *value);
+
+tr_err tr_chash_set(tr_chash hash, const void *key, const void *value);
+tr_err tr_chash_clear(tr_chash hash, const void *key);
+
+// Atomically reads, modifies and writes a key's value, inserting the key
+// first if needed. func runs with the key's shard locked, so it must be
+// quick and must not touch the table itself.
+tr_err tr_chash_update(tr_chash hash, const void *key,
+                       tr_chash_updatefunc func, void *ctx);
+
+// The count is exact only while no other thread is writing
+unsigned int tr_chash_num_keys(tr_chash hash);
+
+
+tr_chash tr_intchash_create(unsigned int itemsize);
+
+bool tr_intchash_contains(tr_chash hash, int key);
+tr_err tr_intchash_get(tr_chash hash, int key, void *value);
+tr_err tr_intchash_set(tr_chash hash, int key, const void *value);
+tr_err tr_intchash_clear(tr_chash hash, int key);
+tr_err tr_intchash_update(tr_chash hash, int key,
+                          tr_chash_updatefunc func, void *ctx);
+
+#endif
@@ -11,4 +11,194 @@
 
 #include <traffic.h>
 
+#include <stddef.h> // for size_t
+#include <stdint.h> // for uint32_t, uint64_t
+#include <stdio.h>  // for FILE
+
+// Config files are parsed in one pass over the file, mapped into memory.
+// Tokens point into the mapping rather than being copied out of it, and
+// names go straight from there into the network's interning table, so
+// parsing allocates nothing per token. Nodes and interfaces are created as
+// they're read; links are created as soon as both their interfaces exist.
+//
+
+// Kinds of tokens
+//
+#define TR_TOK_END 0        // The end of the text
+#define TR_TOK_WORD 1       // A keyword: letters, digits and underscores
+#define TR_TOK_STRING 2     // A quoted string (text excludes the quotes)
+#define TR_TOK_OPEN 3       // {
+#define TR_TOK_CLOSE 4      // }
+#define TR_TOK_BAD 5        // Something that isn't a token
+
+struct _conftoken
+{
+    int type;               // What kind of token this is (TR_TOK_*)
+    const char *text;       // The token's text, in the config's buffer
+    unsigned int len;       // Length of text
+    unsigned int line;      // Line the token starts on, from 1
+    unsigned int column;    // Column the token starts in, from 1
+};
+
+typedef struct _conftoken conftoken;
+
+// Splits config text into tokens. Whitespace and comments (from # to the
+// end of the line) separate tokens. Strings are quoted with ' or `, end at
+// the same kind of quote they start with, and can't span lines; inside
+// one, $( starts a macro that runs to the next ), and can have quotes in it.
+//
+struct _conflexer
+{
+    const char *pos;        // Next character to read
+    const char *end;        // End of the text
+    const char *linestart;  // Start of the line pos is on
+    unsigned int line;      // Line pos is on, from 1
+    const char *error;      // Why the last TR_TOK_BAD token is bad
+};
+
+typedef struct _conflexer conflexer;
+
+// Starts a lexer at the beginning of len characters of text
+//
+void tr_conf_lex_init(conflexer *lex, const char *text, size_t len);
+
+// Reads the next token into tok. At the end of the text, tok is TR_TOK_END
+// (however many more times this is called).
+//
+void tr_conf_lex(conflexer *lex, conftoken *tok);
+
+// A config file mapped into memory
+//
+struct _confmap
+{
+    const char *text;       // The file's contents (not terminated)
+    size_t len;             // Length of the file
+};
+
+typedef struct _confmap confmap;
+
+// Maps the file at path into memory, for reading from start to end.
+// Fails with TR_EIO if it can't be opened or mapped.
+//
+tr_err tr_conf_map(const char *path, confmap *map);
+
+// Unmaps a file mapped by tr_conf_map
+//
+void tr_conf_unmap(confmap *map);
+
+// Parses len characters of config text, building what it describes into
+// net, which must be empty and unbound. On failure, fills error (if it
+// isn't NULL) and leaves net partly built.
+//
+struct _network;
+struct _snapshot;
+
+tr_err tr_conf_parse_text(struct _network *net, const char *text, size_t len,
+                          tr_conferror *error);
+
+// Writes the network, as laid out in the given snapshot of it, as config
+// text. Fails with TR_ESYNTAX if an ID can't be written in a config,
+// because it has both kinds of quote, a newline or $( in it.
+//
+tr_err tr_conf_write_text(struct _network *net, const struct _snapshot *snap,
+                          FILE *f);
+
+// Compiled topologies
+//
+// A compiled topology is a network's snapshot (see snapshot.h) written out
+// as an image: a header, then flat sections of fixed-size records that
+// refer to each other by index, in the machine's own byte order. Loading
+// one maps it and reads the records in place. There's nothing to tokenize
+// and no names to resolve: every name is interned once, and links name
+// their interfaces by index.
+//
+// Every section starts on an 8-byte boundary. Strings are indexes into
+// the string table, or TR_IMAGE_NONE.
+//
+
+#define TR_IMAGE_MAGIC "\177TRTOPO\n"  // The first 8 bytes of every image
+#define TR_IMAGE_VERSION 2              // Bumped whenever the layout changes
+#define TR_IMAGE_BYTEORDER 0x01020304u  // As written by the compiling machine
+#define TR_IMAGE_NONE 0xffffffffu       // A missing string
+
+#define TR_IMAGE_STRINGS 0      // char[]: strings, NUL-terminated, back to back
+#define TR_IMAGE_STROFFS 1      // uint32_t[numstrings]: where each string starts
+#define TR_IMAGE_NODES 2        // uint32_t[numnodes]: each node's name
+#define TR_IMAGE_NODE_IFACES 3  // uint32_t[numnodes + 1]: CSR offsets of
+                                // each node's interfaces
+#define TR_IMAGE_IFACES 4       // imageiface[numifaces], grouped by node
+#define TR_IMAGE_LINKS 5        // imagelink[numlinks]
+#define TR_IMAGE_NAME 6         // char[]: the network's name, NUL-terminated
+                                // (empty if it has none)
+#define TR_IMAGE_NUM_SECTIONS 7
+
+struct _imagesection
+{
+    uint64_t offset;            // Where the section starts in the image
+    uint64_t size;              // Length of the section, in bytes
+};
+
+typedef struct _imagesection imagesection;
+
+struct _imageheader
+{
+    char magic[8];              // TR_IMAGE_MAGIC
+    uint32_t version;           // TR_IMAGE_VERSION
+    uint32_t byteorder;         // TR_IMAGE_BYTEORDER
+    uint32_t numnodes;
+    uint32_t numifaces;
+    uint32_t numlinks;
+    uint32_t numstrings;
+    imagesection sections[TR_IMAGE_NUM_SECTIONS];
+};
+
+typedef struct _imageheader imageheader;
+
+struct _imageiface
+{
+    uint32_t name;              // String index of the interface's ID
+    uint32_t mac;               // String index of its MAC address, or none
+    uint32_t ip;                // String index of its IP address, or none
+    int32_t subnet;             // Its subnet mask, or TR_ANY_SUBNET_MASK
+};
+
+typedef struct _imageiface imageiface;
+
+struct _imagelink
+{
+    uint32_t ends[2];           // Interface indexes of the link's ends
+    int64_t latency;            // Mean latency, in milliseconds
+    int64_t variance;           // Latency variance, in milliseconds
+    float droprate;             // Ratio of packets that are dropped
+    uint32_t traffic;           // Expected traffic
+    uint32_t enabled;           // Whether the link ferries traffic (0 or 1)
+    uint32_t reserved;          // Always 0
+};
+
+typedef struct _imagelink imagelink;
+
+// Indicates whether the len bytes at data look like a compiled topology
+// (whether or not it's one this version can load)
+//
+bool tr_conf_is_image(const char *data, size_t len);
+
+// Gets the name of the network the image was compiled from, or NULL if it
+// had none or the image can't be loaded
+//
+const char *tr_conf_image_name(const char *data, size_t len);
+
+// Loads a compiled topology into net, which must be empty and unbound.
+// Fails with TR_ESYNTAX, and says why in error (if it isn't NULL), if the
+// image is corrupt or from another version. Like tr_conf_parse_text,
+// leaves net partly built on failure.
+//
+tr_err tr_conf_load_image(struct _network *net, const char *data, size_t len,
+                          tr_conferror *error);
+
+// Writes the network, as laid out in the given snapshot of it, as a
+// compiled topology
+//
+tr_err tr_conf_write_image(struct _network *net, const struct _snapshot *snap,
+                           FILE *f);
+
 #endif
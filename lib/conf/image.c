@@ -0,0 +1,541 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf/image.c - Loading and writing compiled topologies
+//
+
+#include <stdarg.h> // for va_list
+#include <stdio.h>  // for fwrite, vsnprintf
+#include <stdlib.h> // for NULL
+#include <string.h> // for memcmp, memcpy, memset, strlen
+
+#include "conf.h"
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "snapshot.h"
+
+// Fails a load because the image is bad, explaining why in error
+//
+static tr_err tr_image_fail(tr_conferror *error, const char *format, ...)
+{
+    if (error) {
+        va_list args;
+        va_start(args, format);
+
+        error->line = 0;
+        error->column = 0;
+        vsnprintf(error->message, sizeof(error->message), format, args);
+
+        va_end(args);
+    }
+
+    return TR_ESYNTAX;
+}
+
+bool tr_conf_is_image(const char *data, size_t len)
+{
+    return len >= 8 && memcmp(data, TR_IMAGE_MAGIC, 8) == 0;
+}
+
+// Finds a section of count records of the given size in the image, or
+// returns NULL if the header puts it anywhere else
+//
+static const void *tr_image_section(const char *data, size_t len,
+                                    const imageheader *h, int section,
+                                    uint64_t count, uint64_t size)
+{
+    const imagesection *s = &h->sections[section];
+
+    if (s->offset % 8 != 0 || s->offset > len || s->size > len - s->offset ||
+        (size && s->size != count * size)) {
+        return NULL;
+    }
+
+    return data + s->offset;
+}
+
+// Finds the network's name in the image, or returns NULL if it isn't a
+// string inside the image
+//
+static const char *tr_image_name(const char *data, size_t len,
+                                 const imageheader *h)
+{
+    uint64_t size = h->sections[TR_IMAGE_NAME].size;
+    const char *name = (const char *)tr_image_section(data, len, h, TR_IMAGE_NAME, 0, 0);
+
+    return name && size && name[size - 1] == '\0' ? name : NULL;
+}
+
+const char *tr_conf_image_name(const char *data, size_t len)
+{
+    if (len < sizeof(imageheader) || !tr_conf_is_image(data, len)) {
+        return NULL;
+    }
+
+    const imageheader *h = (const imageheader *)data;
+    if (h->byteorder != TR_IMAGE_BYTEORDER || h->version != TR_IMAGE_VERSION) {
+        return NULL;
+    }
+
+    const char *name = tr_image_name(data, len, h);
+    return name && name[0] ? name : NULL;
+}
+
+// The sections of an image, once they've been found and checked
+//
+struct _imageview
+{
+    const char *strings;
+    const uint32_t *stroffs;
+    const uint32_t *nodes;
+    const uint32_t *node_ifaces;
+    const imageiface *ifaces;
+    const imagelink *links;
+    const char *name;
+};
+
+typedef struct _imageview imageview;
+
+// Checks every index in the image refers to something, so loading it can't
+// read out of bounds
+//
+static tr_err tr_image_check(const char *data, size_t len, imageview *v,
+                             tr_conferror *error)
+{
+    if (len < sizeof(imageheader) || !tr_conf_is_image(data, len)) {
+        return tr_image_fail(error, "this isn't a compiled topology");
+    }
+
+    const imageheader *h = (const imageheader *)data;
+
+    if (h->byteorder != TR_IMAGE_BYTEORDER) {
+        return tr_image_fail(error, "the topology was compiled on a machine "
+                             "with a different byte order; recompile it");
+    }
+
+    if (h->version != TR_IMAGE_VERSION) {
+        return tr_image_fail(error, "the topology was compiled by a different "
+                             "version of traffic; recompile it");
+    }
+
+    uint64_t nn = h->numnodes, ni = h->numifaces, nl = h->numlinks;
+    uint64_t ns = h->numstrings;
+    uint64_t strsize = h->sections[TR_IMAGE_STRINGS].size;
+
+    v->strings = (const char *)tr_image_section(data, len, h, TR_IMAGE_STRINGS, 0, 0);
+    v->stroffs = (const uint32_t *)tr_image_section(data, len, h, TR_IMAGE_STROFFS,
+                                                    ns, sizeof(uint32_t));
+    v->nodes = (const uint32_t *)tr_image_section(data, len, h, TR_IMAGE_NODES,
+                                                  nn, sizeof(uint32_t));
+    v->node_ifaces = (const uint32_t *)tr_image_section(data, len, h, TR_IMAGE_NODE_IFACES,
+                                                        nn + 1, sizeof(uint32_t));
+    v->ifaces = (const imageiface *)tr_image_section(data, len, h, TR_IMAGE_IFACES,
+                                                     ni, sizeof(imageiface));
+    v->links = (const imagelink *)tr_image_section(data, len, h, TR_IMAGE_LINKS,
+                                                   nl, sizeof(imagelink));
+
+    v->name = tr_image_name(data, len, h);
+
+    if (!v->strings || !v->stroffs || !v->nodes || !v->node_ifaces ||
+        !v->ifaces || !v->links || !v->name) {
+        return tr_image_fail(error, "the compiled topology is truncated or corrupt");
+    }
+
+    // Every string has to end inside the string table
+    if (ns && (strsize == 0 || v->strings[strsize - 1] != '\0')) {
+        return tr_image_fail(error, "the compiled topology's strings are corrupt");
+    }
+
+    for (uint64_t k = 0; k < ns; ++k) {
+        if (v->stroffs[k] >= strsize) {
+            return tr_image_fail(error, "the compiled topology's strings are corrupt");
+        }
+    }
+
+    if (v->node_ifaces[0] != 0 || v->node_ifaces[nn] != ni) {
+        return tr_image_fail(error, "the compiled topology's nodes are corrupt");
+    }
+
+    for (uint64_t n = 0; n < nn; ++n) {
+        if (v->nodes[n] >= ns || v->node_ifaces[n] > v->node_ifaces[n + 1]) {
+            return tr_image_fail(error, "the compiled topology's nodes are corrupt");
+        }
+    }
+
+    for (uint64_t i = 0; i < ni; ++i) {
+        const imageiface *f = &v->ifaces[i];
+        const char *mac = f->mac < ns ? v->strings + v->stroffs[f->mac] : NULL;
+        const char *ip = f->ip < ns ? v->strings + v->stroffs[f->ip] : NULL;
+
+        if (f->name >= ns ||
+            (f->mac != TR_IMAGE_NONE && (!mac || !tr_iface_is_mac(mac, strlen(mac)))) ||
+            (f->ip != TR_IMAGE_NONE && (!ip || !tr_iface_is_ip(ip, strlen(ip)))) ||
+            f->subnet < TR_ANY_SUBNET_MASK || f->subnet > 32) {
+            return tr_image_fail(error, "the compiled topology's interfaces are corrupt");
+        }
+    }
+
+    for (uint64_t k = 0; k < nl; ++k) {
+        const imagelink *l = &v->links[k];
+
+        if (l->ends[0] >= ni || l->ends[1] >= ni || l->ends[0] == l->ends[1] ||
+            l->latency < 0 || l->variance < 0 || l->enabled > 1 ||
+            !(l->droprate >= 0 && l->droprate <= 1)) {
+            return tr_image_fail(error, "the compiled topology's links are corrupt");
+        }
+    }
+
+    return TR_OK;
+}
+
+// Creates the image's nodes and interfaces, recording each interface by
+// index in ifaces
+//
+static tr_err tr_image_load_ifaces(network *net, const imageheader *h,
+                                   const imageview *v, const tr_atom *atoms,
+                                   iface **ifaces)
+{
+    unsigned int nn = h->numnodes, ni = h->numifaces;
+    unsigned int most = nn > ni ? nn : ni;
+
+    tr_atom *ids = (tr_atom *)tr_malloc((most ? most : 1) * sizeof(tr_atom));
+    void **handles = (void **)tr_malloc((most ? most : 1) * sizeof(void *));
+    tr_err err = ids && handles ? TR_OK : TR_ENOMEM;
+
+    for (unsigned int n = 0; err >= 0 && n < nn; ++n) {
+        ids[n] = atoms[v->nodes[n]];
+    }
+
+    if (err >= 0) {
+        err = tr_node_make_many(net, ids, nn, (tr_node *)handles);
+    }
+
+    // Keep the nodes, since the interfaces go in the handles
+    node **nodes = err >= 0 ? (node **)tr_malloc((nn ? nn : 1) * sizeof(node *)) : NULL;
+    if (err >= 0 && !nodes) {
+        err = TR_ENOMEM;
+    }
+
+    for (unsigned int n = 0; err >= 0 && n < nn; ++n) {
+        nodes[n] = tr_node_get((tr_node)handles[n]);
+    }
+
+    for (unsigned int i = 0; err >= 0 && i < ni; ++i) {
+        ids[i] = atoms[v->ifaces[i].name];
+    }
+
+    for (unsigned int n = 0; err >= 0 && n < nn; ++n) {
+        unsigned int first = v->node_ifaces[n];
+        unsigned int count = v->node_ifaces[n + 1] - first;
+
+        if (count) {
+            err = tr_iface_make_many(net, &nodes[n], 1, ids + first, count,
+                                     (tr_iface *)handles + first);
+        }
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < ni; ++k) {
+        const imageiface *f = &v->ifaces[k];
+        iface *i = tr_iface_get((tr_iface)handles[k]);
+
+        i->mac = f->mac == TR_IMAGE_NONE ? TR_NO_ATOM : atoms[f->mac];
+        i->ip = f->ip == TR_IMAGE_NONE ? TR_NO_ATOM : atoms[f->ip];
+        i->subnet = f->subnet;
+        ifaces[k] = i;
+    }
+
+    tr_free(nodes);
+    tr_free(handles);
+    tr_free(ids);
+    return err;
+}
+
+// Creates the image's links between the interfaces, whose links arrays are
+// sized for them up front
+//
+static tr_err tr_image_load_links(network *net, const imageheader *h,
+                                  const imageview *v, iface **ifaces,
+                                  tr_conferror *error)
+{
+    unsigned int ni = h->numifaces, nl = h->numlinks;
+
+    unsigned int *degrees = (unsigned int *)tr_malloc((ni ? ni : 1) * sizeof(unsigned int));
+    if (!degrees) {
+        return TR_ENOMEM;
+    }
+
+    memset(degrees, 0, ni * sizeof(unsigned int));
+    for (unsigned int k = 0; k < nl; ++k) {
+        ++degrees[v->links[k].ends[0]];
+        ++degrees[v->links[k].ends[1]];
+    }
+
+    tr_err err = TR_OK;
+    for (unsigned int i = 0; err >= 0 && i < ni; ++i) {
+        err = tr_iface_reserve_links(ifaces[i], degrees[i]);
+    }
+
+    tr_free(degrees);
+
+    for (unsigned int k = 0; err >= 0 && k < nl; ++k) {
+        const imagelink *il = &v->links[k];
+        link *l = NULL;
+
+        err = tr_link_add(net, ifaces[il->ends[0]], ifaces[il->ends[1]], &l);
+        if (err == TR_ELINKED) {
+            return tr_image_fail(error, "the compiled topology links '%s' and '%s' twice",
+                                 ifaces[il->ends[0]]->name, ifaces[il->ends[1]]->name);
+        }
+
+        if (err >= 0) {
+            l->attrs.latency = (long)il->latency;
+            l->attrs.variance = (long)il->variance;
+            l->attrs.droprate = il->droprate;
+            l->attrs.enabled = il->enabled != 0;
+            l->traffic = il->traffic;
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_conf_load_image(network *net, const char *data, size_t len,
+                          tr_conferror *error)
+{
+    imageview v = { NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    tr_err err = tr_image_check(data, len, &v, error);
+    if (err < 0) {
+        return err;
+    }
+
+    const imageheader *h = (const imageheader *)data;
+    unsigned int ns = h->numstrings, ni = h->numifaces;
+
+    err = tr_net_reserve(net, h->numnodes, ni, h->numlinks);
+    if (err >= 0) {
+        err = tr_intern_reserve(net->ids, tr_intern_count(net->ids) + ns);
+    }
+
+    // Intern every string once, up front, straight out of the image; after
+    // this, everything is referred to by index
+    tr_atom *atoms = (tr_atom *)tr_malloc((ns ? ns : 1) * sizeof(tr_atom));
+    iface **ifaces = (iface **)tr_malloc((ni ? ni : 1) * sizeof(iface *));
+    const char **strs = (const char **)tr_malloc((ns ? ns : 1) * sizeof(const char *));
+    if (err >= 0 && (!atoms || !ifaces || !strs)) {
+        err = TR_ENOMEM;
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < ns; ++k) {
+        strs[k] = v.strings + v.stroffs[k];
+    }
+
+    if (err >= 0) {
+        err = tr_net_intern_all(net, strs, ns, atoms);
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < ns; ++k) {
+        if (atoms[k] == TR_NO_ATOM) {
+            err = TR_ENOMEM;
+        }
+    }
+
+    tr_free(strs);
+
+    if (err >= 0) {
+        err = tr_image_load_ifaces(net, h, &v, atoms, ifaces);
+        if (err == TR_ENAMETAKEN) {
+            err = tr_image_fail(error, "the compiled topology uses a name twice");
+        }
+    }
+
+    if (err >= 0) {
+        err = tr_image_load_links(net, h, &v, ifaces, error);
+    }
+
+    tr_free(ifaces);
+    tr_free(atoms);
+    return err;
+}
+
+//
+// Writing
+//
+
+// Strings are numbered in the order they're first used, so loading an
+// image interns them (and so numbers entities) in the order the original
+// network's snapshot did. Compiling a loaded image again gives the same
+// bytes.
+//
+struct _imagestrings
+{
+    network *net;
+    uint32_t *indexes;      // String index of each of net's atoms, or none
+    tr_atom *atoms;         // Atom of each string
+    uint32_t count;         // Strings numbered so far
+    uint64_t size;          // Bytes the strings take, with terminators
+};
+
+typedef struct _imagestrings imagestrings;
+
+// Gets the index of the string for the given atom, numbering it if it
+// hasn't been used yet
+//
+static uint32_t tr_image_string(imagestrings *s, tr_atom atom)
+{
+    if (atom == TR_NO_ATOM) {
+        return TR_IMAGE_NONE;
+    }
+
+    if (s->indexes[atom] == TR_IMAGE_NONE) {
+        s->indexes[atom] = s->count;
+        s->atoms[s->count++] = atom;
+        s->size += strlen(tr_net_id_str(s->net, atom)) + 1;
+    }
+
+    return s->indexes[atom];
+}
+
+// Pads a section of the given size out to the 8-byte boundary the next one
+// starts on
+//
+static bool tr_image_pad(FILE *f, uint64_t size)
+{
+    static const char padding[8] = { 0 };
+    return size % 8 == 0 || fwrite(padding, 1, 8 - size % 8, f) == 8 - size % 8;
+}
+
+// Writes a section, padded
+//
+static bool tr_image_put(FILE *f, const void *data, uint64_t size)
+{
+    return (size == 0 || fwrite(data, 1, size, f) == size) && tr_image_pad(f, size);
+}
+
+tr_err tr_conf_write_image(network *net, const snapshot *snap, FILE *f)
+{
+    unsigned int nn = snap->num_nodes, ni = snap->num_ifaces, nl = snap->num_links;
+    unsigned int numatoms = tr_intern_count(net->ids);
+
+    imagestrings s = { net, NULL, NULL, 0, 0 };
+    s.indexes = (uint32_t *)tr_malloc((numatoms ? numatoms : 1) * sizeof(uint32_t));
+    s.atoms = (tr_atom *)tr_malloc((numatoms ? numatoms : 1) * sizeof(tr_atom));
+
+    uint32_t *nodes = (uint32_t *)tr_malloc((nn ? nn : 1) * sizeof(uint32_t));
+    uint32_t *stroffs = (uint32_t *)tr_malloc((numatoms ? numatoms : 1) * sizeof(uint32_t));
+    imageiface *ifaces = (imageiface *)tr_malloc((ni ? ni : 1) * sizeof(imageiface));
+    imagelink *links = (imagelink *)tr_malloc((nl ? nl : 1) * sizeof(imagelink));
+
+    tr_err err = s.indexes && s.atoms && nodes && stroffs && ifaces && links
+               ? TR_OK : TR_ENOMEM;
+
+    if (err >= 0) {
+        memset(s.indexes, 0xff, numatoms * sizeof(uint32_t));
+
+        for (unsigned int n = 0; n < nn; ++n) {
+            nodes[n] = tr_image_string(&s, snap->nodes[n]->id);
+        }
+
+        for (unsigned int k = 0; k < ni; ++k) {
+            ifaces[k].name = tr_image_string(&s, snap->ifaces[k]->id);
+        }
+
+        for (unsigned int k = 0; k < ni; ++k) {
+            const iface *i = snap->ifaces[k];
+            ifaces[k].mac = tr_image_string(&s, i->mac);
+            ifaces[k].ip = tr_image_string(&s, i->ip);
+            ifaces[k].subnet = i->subnet;
+        }
+
+        for (unsigned int k = 0; k < nl; ++k) {
+            const link *l = snap->links[k];
+            memset(&links[k], 0, sizeof(imagelink));
+
+            links[k].ends[0] = snap->link_ends[2 * k];
+            links[k].ends[1] = snap->link_ends[2 * k + 1];
+            links[k].latency = l->attrs.latency;
+            links[k].variance = l->attrs.variance;
+            links[k].droprate = l->attrs.droprate;
+            links[k].traffic = l->traffic;
+            links[k].enabled = l->attrs.enabled ? 1 : 0;
+        }
+
+        uint64_t offset = 0;
+        for (uint32_t k = 0; k < s.count; ++k) {
+            stroffs[k] = (uint32_t)offset;
+            offset += strlen(tr_net_id_str(net, s.atoms[k])) + 1;
+        }
+
+        // String offsets are 32 bits
+        if (s.size > 0xffffffffu) {
+            err = TR_EOUTOFRANGE;
+        }
+    }
+
+    const char *name = net->name ? net->name : "";
+
+    imageheader h;
+    if (err >= 0) {
+        const uint64_t sizes[TR_IMAGE_NUM_SECTIONS] = {
+            s.size,
+            (uint64_t)s.count * sizeof(uint32_t),
+            (uint64_t)nn * sizeof(uint32_t),
+            ((uint64_t)nn + 1) * sizeof(uint32_t),
+            (uint64_t)ni * sizeof(imageiface),
+            (uint64_t)nl * sizeof(imagelink),
+            strlen(name) + 1,
+        };
+
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, TR_IMAGE_MAGIC, 8);
+        h.version = TR_IMAGE_VERSION;
+        h.byteorder = TR_IMAGE_BYTEORDER;
+        h.numnodes = nn;
+        h.numifaces = ni;
+        h.numlinks = nl;
+        h.numstrings = s.count;
+
+        uint64_t offset = sizeof(imageheader);
+        for (int k = 0; k < TR_IMAGE_NUM_SECTIONS; ++k) {
+            h.sections[k].offset = offset;
+            h.sections[k].size = sizes[k];
+            offset += (sizes[k] + 7) / 8 * 8;
+        }
+    }
+
+    if (err >= 0) {
+        bool written = tr_image_put(f, &h, sizeof(h));
+
+        // The string table is written string by string, straight from the
+        // interning table
+        for (uint32_t k = 0; written && k < s.count; ++k) {
+            const char *str = tr_net_id_str(net, s.atoms[k]);
+            size_t len = strlen(str) + 1;
+            written = fwrite(str, 1, len, f) == len;
+        }
+
+        written = written && tr_image_pad(f, s.size) &&
+                  tr_image_put(f, stroffs, (uint64_t)s.count * sizeof(uint32_t)) &&
+                  tr_image_put(f, nodes, (uint64_t)nn * sizeof(uint32_t)) &&
+                  tr_image_put(f, snap->node_ifaces, ((uint64_t)nn + 1) * sizeof(uint32_t)) &&
+                  tr_image_put(f, ifaces, (uint64_t)ni * sizeof(imageiface)) &&
+                  tr_image_put(f, links, (uint64_t)nl * sizeof(imagelink)) &&
+                  tr_image_put(f, name, strlen(name) + 1);
+
+        if (!written) {
+            err = TR_EIO;
+        }
+    }
+
+    tr_free(links);
+    tr_free(ifaces);
+    tr_free(stroffs);
+    tr_free(nodes);
+    tr_free(s.atoms);
+    tr_free(s.indexes);
+    return err;
+}
@@ -0,0 +1,222 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf/lex.c - Mapping config files, and splitting them into tokens
+//
+
+#define _POSIX_C_SOURCE 200112L // for posix_madvise
+
+#include <fcntl.h>      // for open
+#include <stdlib.h>     // for NULL
+#include <sys/mman.h>   // for mmap, munmap, posix_madvise
+#include <sys/stat.h>   // for fstat
+#include <unistd.h>     // for close
+
+#include "conf.h"
+
+// Classes of characters, for the lexer's inner loops
+//
+#define CH_OTHER 0
+#define CH_SPACE 1      // Whitespace other than newlines
+#define CH_NEWLINE 2
+#define CH_WORD 3       // Letters, digits and underscores
+#define CH_QUOTE 4      // ' and `
+#define CH_COMMENT 5    // #
+
+// Every character's class; the ones not listed are CH_OTHER
+//
+static const unsigned char g_classes[256] =
+{
+    ['a'] = CH_WORD, ['b'] = CH_WORD, ['c'] = CH_WORD, ['d'] = CH_WORD,
+    ['e'] = CH_WORD, ['f'] = CH_WORD, ['g'] = CH_WORD, ['h'] = CH_WORD,
+    ['i'] = CH_WORD, ['j'] = CH_WORD, ['k'] = CH_WORD, ['l'] = CH_WORD,
+    ['m'] = CH_WORD, ['n'] = CH_WORD, ['o'] = CH_WORD, ['p'] = CH_WORD,
+    ['q'] = CH_WORD, ['r'] = CH_WORD, ['s'] = CH_WORD, ['t'] = CH_WORD,
+    ['u'] = CH_WORD, ['v'] = CH_WORD, ['w'] = CH_WORD, ['x'] = CH_WORD,
+    ['y'] = CH_WORD, ['z'] = CH_WORD,
+    ['A'] = CH_WORD, ['B'] = CH_WORD, ['C'] = CH_WORD, ['D'] = CH_WORD,
+    ['E'] = CH_WORD, ['F'] = CH_WORD, ['G'] = CH_WORD, ['H'] = CH_WORD,
+    ['I'] = CH_WORD, ['J'] = CH_WORD, ['K'] = CH_WORD, ['L'] = CH_WORD,
+    ['M'] = CH_WORD, ['N'] = CH_WORD, ['O'] = CH_WORD, ['P'] = CH_WORD,
+    ['Q'] = CH_WORD, ['R'] = CH_WORD, ['S'] = CH_WORD, ['T'] = CH_WORD,
+    ['U'] = CH_WORD, ['V'] = CH_WORD, ['W'] = CH_WORD, ['X'] = CH_WORD,
+    ['Y'] = CH_WORD, ['Z'] = CH_WORD,
+    ['0'] = CH_WORD, ['1'] = CH_WORD, ['2'] = CH_WORD, ['3'] = CH_WORD,
+    ['4'] = CH_WORD, ['5'] = CH_WORD, ['6'] = CH_WORD, ['7'] = CH_WORD,
+    ['8'] = CH_WORD, ['9'] = CH_WORD, ['_'] = CH_WORD,
+    [' '] = CH_SPACE, ['\t'] = CH_SPACE, ['\r'] = CH_SPACE,
+    ['\f'] = CH_SPACE, ['\v'] = CH_SPACE,
+    ['\n'] = CH_NEWLINE,
+    ['\''] = CH_QUOTE, ['`'] = CH_QUOTE,
+    ['#'] = CH_COMMENT,
+};
+
+void tr_conf_lex_init(conflexer *lex, const char *text, size_t len)
+{
+    lex->pos = text;
+    lex->end = text + len;
+    lex->linestart = text;
+    lex->line = 1;
+    lex->error = NULL;
+}
+
+// Reads the rest of a string token, whose opening quote is just before
+// lex->pos. Only the same kind of quote closes it, so either kind can
+// quote the other.
+//
+static void tr_conf_lex_string(conflexer *lex, conftoken *tok, char quote)
+{
+    const char *p = lex->pos, *end = lex->end;
+    tok->text = p;
+
+    while (p < end) {
+        char c = *p;
+
+        if (c == quote) {
+            tok->type = TR_TOK_STRING;
+            tok->len = (unsigned int)(p - tok->text);
+            lex->pos = p + 1;
+            return;
+        }
+
+        if (c == '\n') {
+            break;
+        }
+
+        // Macros can quote names, so skip to their end
+        if (c == '$' && p + 1 < end && p[1] == '(') {
+            while (p < end && *p != ')' && *p != '\n') {
+                ++p;
+            }
+
+            if (p == end || *p == '\n') {
+                tok->type = TR_TOK_BAD;
+                tok->len = (unsigned int)(p - tok->text);
+                lex->pos = p;
+                lex->error = "macro has no closing )";
+                return;
+            }
+        }
+
+        ++p;
+    }
+
+    tok->type = TR_TOK_BAD;
+    tok->len = (unsigned int)(p - tok->text);
+    lex->pos = p;
+    lex->error = "string has no closing quote";
+}
+
+void tr_conf_lex(conflexer *lex, conftoken *tok)
+{
+    const char *p = lex->pos, *end = lex->end;
+
+    // Skip whitespace and comments
+    while (p < end) {
+        unsigned char cls = g_classes[(unsigned char)*p];
+
+        if (cls == CH_SPACE) {
+            ++p;
+        }
+        else if (cls == CH_NEWLINE) {
+            lex->linestart = ++p;
+            ++lex->line;
+        }
+        else if (cls == CH_COMMENT) {
+            while (p < end && *p != '\n') {
+                ++p;
+            }
+        }
+        else {
+            break;
+        }
+    }
+
+    tok->line = lex->line;
+    tok->column = (unsigned int)(p - lex->linestart) + 1;
+    tok->text = p;
+    tok->len = 0;
+
+    if (p == end) {
+        tok->type = TR_TOK_END;
+        lex->pos = p;
+        return;
+    }
+
+    unsigned char c = (unsigned char)*p;
+    switch (g_classes[c]) {
+    case CH_WORD:
+        while (p < end && g_classes[(unsigned char)*p] == CH_WORD) {
+            ++p;
+        }
+
+        tok->type = TR_TOK_WORD;
+        tok->len = (unsigned int)(p - tok->text);
+        lex->pos = p;
+        return;
+
+    case CH_QUOTE:
+        lex->pos = p + 1;
+        tr_conf_lex_string(lex, tok, *p);
+        return;
+
+    default:
+        tok->len = 1;
+        lex->pos = p + 1;
+
+        if (c == '{') {
+            tok->type = TR_TOK_OPEN;
+        }
+        else if (c == '}') {
+            tok->type = TR_TOK_CLOSE;
+        }
+        else {
+            tok->type = TR_TOK_BAD;
+            lex->error = "unexpected character";
+        }
+        return;
+    }
+}
+
+tr_err tr_conf_map(const char *path, confmap *map)
+{
+    map->text = "";
+    map->len = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return TR_EIO;
+    }
+
+    struct stat st;
+    tr_err err = fstat(fd, &st) == 0 ? TR_OK : TR_EIO;
+
+    // An empty file can't be mapped, but doesn't need to be
+    if (err >= 0 && st.st_size > 0) {
+        void *text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (text == MAP_FAILED) {
+            err = TR_EIO;
+        }
+        else {
+            posix_madvise(text, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            map->text = (const char *)text;
+            map->len = (size_t)st.st_size;
+        }
+    }
+
+    close(fd);
+    return err;
+}
+
+void tr_conf_unmap(confmap *map)
+{
+    if (map->len) {
+        munmap((void *)map->text, map->len);
+    }
+
+    map->text = "";
+    map->len = 0;
+}
@@ -0,0 +1,880 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf/read.c - Parsing config files into networks
+//
+
+#include <stdarg.h> // for va_list
+#include <stdio.h>  // for snprintf, vsnprintf
+#include <stdlib.h> // for NULL, strtod
+#include <string.h> // for memcmp, memcpy, strrchr
+
+#include "conf.h"
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+
+// A link whose interfaces weren't all defined when it was read
+//
+struct _conflink
+{
+    conftoken keyword;      // The link keyword, for errors about the link
+    conftoken ends[2];      // Names of the interfaces to link
+    linkattrs attrs;        // The link's characteristics
+    unsigned int traffic;   // The link's expected traffic
+};
+
+typedef struct _conflink conflink;
+
+TR_VEC_DEFINE(conflinks, conflink)
+TR_VEC_DEFINE(confifaces, iface *)
+
+struct _confparser
+{
+    network *net;
+    conflexer lex;
+    conftoken tok;          // The token being looked at
+    tr_conferror *error;    // Where to explain failures, or NULL
+    tr_confifaces *ifaces;  // Interfaces by ID atom (NULL for other atoms)
+    tr_conflinks *pending;  // Links waiting on interfaces defined later
+    unsigned int unnamed;   // Nodes that have been given names so far
+};
+
+typedef struct _confparser confparser;
+
+// Fails the parse because of the given token, explaining why in the
+// parser's error
+//
+static tr_err tr_conf_fail(confparser *p, const conftoken *tok,
+                           const char *format, ...)
+{
+    if (p->error) {
+        va_list args;
+        va_start(args, format);
+
+        p->error->line = tok->line;
+        p->error->column = tok->column;
+        vsnprintf(p->error->message, sizeof(p->error->message), format, args);
+
+        va_end(args);
+    }
+
+    return TR_ESYNTAX;
+}
+
+// Moves on to the next token, failing if it isn't one
+//
+static tr_err tr_conf_advance(confparser *p)
+{
+    tr_conf_lex(&p->lex, &p->tok);
+
+    if (p->tok.type == TR_TOK_BAD) {
+        return tr_conf_fail(p, &p->tok, "%s", p->lex.error);
+    }
+
+    return TR_OK;
+}
+
+// Indicates whether the token is the given keyword
+//
+static bool tr_conf_is(const conftoken *tok, const char *word)
+{
+    unsigned int len = (unsigned int)strlen(word);
+    return tok->type == TR_TOK_WORD && tok->len == len &&
+           memcmp(tok->text, word, len) == 0;
+}
+
+// Indicates whether the token is a string with the given text
+//
+static bool tr_conf_equals(const conftoken *tok, const char *text)
+{
+    unsigned int len = (unsigned int)strlen(text);
+    return tok->len == len && memcmp(tok->text, text, len) == 0;
+}
+
+// Describes a token for an error message: the token itself if it's short,
+// or its kind otherwise
+//
+static const char *tr_conf_describe(const conftoken *tok, char *buf,
+                                    unsigned int size)
+{
+    switch (tok->type) {
+    case TR_TOK_END:   return "the end of the file";
+    case TR_TOK_OPEN:  return "'{'";
+    case TR_TOK_CLOSE: return "'}'";
+    default:
+        if (tok->len > size - 3) {
+            return tok->type == TR_TOK_STRING ? "a string" : "a word";
+        }
+
+        snprintf(buf, size, "'%.*s'", (int)tok->len, tok->text);
+        return buf;
+    }
+}
+
+// Fails the parse because the current token isn't what was expected
+//
+static tr_err tr_conf_expected(confparser *p, const char *what)
+{
+    char buf[48];
+    return tr_conf_fail(p, &p->tok, "expected %s, but found %s", what,
+                        tr_conf_describe(&p->tok, buf, sizeof(buf)));
+}
+
+// Reads the string after a setting's keyword into value
+//
+static tr_err tr_conf_value(confparser *p, const conftoken *keyword,
+                            conftoken *value)
+{
+    tr_err err = tr_conf_advance(p);
+    if (err >= 0 && p->tok.type != TR_TOK_STRING) {
+        char what[48];
+        snprintf(what, sizeof(what), "a quoted value for %.*s",
+                 (int)keyword->len, keyword->text);
+        err = tr_conf_expected(p, what);
+    }
+
+    if (err >= 0) {
+        *value = p->tok;
+        err = tr_conf_advance(p);
+    }
+
+    return err;
+}
+
+// Interns the text of a token as an ID. Returns TR_NO_ATOM if memory runs
+// out.
+//
+static tr_atom tr_conf_intern(confparser *p, const conftoken *tok)
+{
+    return tr_net_intern_n(p->net, tok->text, tok->len);
+}
+
+// Gets the interface with the given ID, or NULL if there isn't one yet
+//
+static iface *tr_conf_find_iface(confparser *p, const conftoken *name)
+{
+    tr_atom id = tr_intern_find_n(p->net->ids, name->text, name->len);
+
+    if (id == TR_NO_ATOM || id >= tr_confifaces_size(p->ifaces)) {
+        return NULL;
+    }
+
+    return *tr_confifaces_item(p->ifaces, id);
+}
+
+// Records an interface by its ID atom
+//
+static tr_err tr_conf_add_iface(confparser *p, iface *i)
+{
+    unsigned int size = tr_confifaces_size(p->ifaces);
+
+    if (i->id >= size) {
+        unsigned int capacity = tr_confifaces_capacity(p->ifaces);
+        while (capacity <= i->id) {
+            capacity = capacity ? 2 * capacity : 1024;
+        }
+
+        tr_err err = tr_confifaces_reserve(p->ifaces, capacity);
+        if (err < 0) {
+            return err;
+        }
+
+        memset(p->ifaces->items + size, 0, (capacity - size) * sizeof(iface *));
+        p->ifaces->size = capacity;
+    }
+
+    *tr_confifaces_item(p->ifaces, i->id) = i;
+    return TR_OK;
+}
+
+//
+// Values
+//
+
+// Parses a whole number of milliseconds: digits, with an optional
+// fraction, then an optional unit (ms or s)
+//
+static bool tr_conf_millis(const conftoken *tok, long *out)
+{
+    const char *s = tok->text, *end = s + tok->len;
+    long long whole = 0, frac = 0, scale = 1;
+    bool digits = false;
+
+    while (s < end && *s >= '0' && *s <= '9') {
+        whole = 10 * whole + (*s++ - '0');
+        digits = true;
+        if (whole > 1000000000000ll) return false;
+    }
+
+    if (s < end && *s == '.') {
+        ++s;
+        while (s < end && *s >= '0' && *s <= '9' && scale < 1000000) {
+            frac = 10 * frac + (*s++ - '0');
+            scale *= 10;
+            digits = true;
+        }
+    }
+
+    while (s < end && *s == ' ') {
+        ++s;
+    }
+
+    unsigned int unitlen = (unsigned int)(end - s);
+    long long perunit = 0;
+
+    if (unitlen == 0 || (unitlen == 2 && memcmp(s, "ms", 2) == 0)) {
+        perunit = 1;
+    }
+    else if (unitlen == 1 && *s == 's') {
+        perunit = 1000;
+    }
+
+    if (!digits || !perunit) {
+        return false;
+    }
+
+    // Fractions of a millisecond can't be represented
+    if ((frac * perunit) % scale != 0) {
+        return false;
+    }
+
+    *out = (long)(whole * perunit + frac * perunit / scale);
+    return true;
+}
+
+// Parses a drop rate: a ratio from 0 to 1, or a percentage
+//
+static bool tr_conf_ratio(const conftoken *tok, float *out)
+{
+    char buf[32];
+    if (tok->len == 0 || tok->len >= sizeof(buf)) {
+        return false;
+    }
+
+    memcpy(buf, tok->text, tok->len);
+    buf[tok->len] = '\0';
+
+    char *end;
+    double value = strtod(buf, &end);
+
+    if (end == buf) {
+        return false;
+    }
+
+    if (*end == '%') {
+        value /= 100;
+        ++end;
+    }
+
+    if (*end != '\0' || !(value >= 0 && value <= 1)) {
+        return false;
+    }
+
+    *out = (float)value;
+    return true;
+}
+
+// Parses a whole number no bigger than max
+//
+static bool tr_conf_number(const conftoken *tok, unsigned long max,
+                           unsigned long *out)
+{
+    unsigned long value = 0;
+
+    if (tok->len == 0 || tok->len > 10) {
+        return false;
+    }
+
+    for (unsigned int k = 0; k < tok->len; ++k) {
+        char c = tok->text[k];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        value = 10 * value + (c - '0');
+    }
+
+    if (value > max) {
+        return false;
+    }
+
+    *out = value;
+    return true;
+}
+
+// Checks the macros in an app command: each is $('iface'.field), where
+// field is ip, mac or subnet
+//
+static tr_err tr_conf_check_macros(confparser *p, const conftoken *command)
+{
+    const char *s = command->text, *end = s + command->len;
+
+    for (; s + 1 < end; ++s) {
+        if (s[0] != '$' || s[1] != '(') {
+            continue;
+        }
+
+        // Strings are on one line, so columns follow from offsets
+        conftoken where = *command;
+        where.column += (unsigned int)(s - command->text) + 1;
+
+        const char *q = s + 2;
+        const char *name = q + 1;
+        const char *close = name;
+
+        while (close < end && *close != '\'' && *close != '`') {
+            ++close;
+        }
+
+        bool ok = q < end && (*q == '\'' || *q == '`') && close < end &&
+                  close > name && close + 1 < end && close[1] == '.';
+
+        const char *field = close + 2;
+        const char *paren = field;
+        while (ok && paren < end && *paren != ')') {
+            ++paren;
+        }
+
+        unsigned int fieldlen = (unsigned int)(paren - field);
+        ok = ok && paren < end &&
+             ((fieldlen == 2 && memcmp(field, "ip", 2) == 0) ||
+              (fieldlen == 3 && memcmp(field, "mac", 3) == 0) ||
+              (fieldlen == 6 && memcmp(field, "subnet", 6) == 0));
+
+        if (!ok) {
+            return tr_conf_fail(p, &where,
+                                "macros look like $('iface'.ip), $('iface'.mac) or $('iface'.subnet)");
+        }
+
+        s = paren;
+    }
+
+    return TR_OK;
+}
+
+//
+// Blocks
+//
+
+// Reads an interface block, adding the interface to the node
+//
+static tr_err tr_conf_interface(confparser *p, node *n, unsigned int index)
+{
+    tr_err err = tr_conf_advance(p);
+    tr_atom id = TR_NO_ATOM;
+
+    if (err >= 0 && p->tok.type == TR_TOK_STRING) {
+        id = tr_conf_intern(p, &p->tok);
+        if (id != TR_NO_ATOM && tr_net_id_taken(p->net, id)) {
+            return tr_conf_fail(p, &p->tok, "the name '%.*s' is already taken",
+                                (int)p->tok.len, p->tok.text);
+        }
+
+        err = tr_conf_advance(p);
+    }
+    else if (err >= 0) {
+        // Unnamed interfaces are named after their node, like generated
+        // ones: node r0's are r0-0, r0-1 and so on
+        char name[256];
+        do {
+            snprintf(name, sizeof(name), "%s-%u", n->name, index++);
+            id = tr_net_intern(p->net, name);
+        } while (id != TR_NO_ATOM && tr_net_id_taken(p->net, id));
+    }
+
+    if (err >= 0 && id == TR_NO_ATOM) {
+        err = TR_ENOMEM;
+    }
+
+    tr_iface handle = NULL;
+    if (err >= 0) {
+        err = tr_iface_make_many(p->net, &n, 1, &id, 1, &handle);
+    }
+
+    iface *i = err >= 0 ? tr_iface_get(handle) : NULL;
+    if (i) {
+        err = tr_conf_add_iface(p, i);
+    }
+
+    if (err < 0 || p->tok.type != TR_TOK_OPEN) {
+        return err;
+    }
+
+    bool hasmac = false, hasip = false, hassubnet = false;
+    err = tr_conf_advance(p);
+
+    while (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+        conftoken setting = p->tok, value;
+        bool *seen = tr_conf_is(&setting, "mac") ? &hasmac
+                   : tr_conf_is(&setting, "ip") ? &hasip
+                   : tr_conf_is(&setting, "subnet") ? &hassubnet
+                   : NULL;
+
+        if (!seen) {
+            return tr_conf_expected(p, "mac, ip, subnet or '}'");
+        }
+
+        if (*seen) {
+            return tr_conf_fail(p, &setting, "%.*s is already set for this interface",
+                                (int)setting.len, setting.text);
+        }
+
+        *seen = true;
+        err = tr_conf_value(p, &setting, &value);
+        if (err < 0 || tr_conf_equals(&value, "auto")) {
+            continue;
+        }
+
+        if (seen == &hasmac) {
+            if (!tr_iface_is_mac(value.text, value.len)) {
+                return tr_conf_fail(p, &value, "a MAC address looks like '01:23:45:67:89:ab'");
+            }
+
+            i->mac = tr_conf_intern(p, &value);
+            err = i->mac == TR_NO_ATOM ? TR_ENOMEM : TR_OK;
+        }
+        else if (seen == &hasip) {
+            if (!tr_iface_is_ip(value.text, value.len)) {
+                return tr_conf_fail(p, &value, "an IP address looks like '10.0.0.1'");
+            }
+
+            i->ip = tr_conf_intern(p, &value);
+            err = i->ip == TR_NO_ATOM ? TR_ENOMEM : TR_OK;
+        }
+        else {
+            unsigned long bits;
+            if (!tr_conf_number(&value, 32, &bits)) {
+                return tr_conf_fail(p, &value, "a subnet mask is a number of bits, from 0 to 32");
+            }
+
+            i->subnet = (int)bits;
+        }
+    }
+
+    return err >= 0 ? tr_conf_advance(p) : err;
+}
+
+// Reads the settings block of a switch, if it has one
+//
+static tr_err tr_conf_switch(confparser *p)
+{
+    static const char *const strategies[] = {
+        "storeAndForward", "cutThrough", "fragmentFree", "psychic"
+    };
+
+    tr_err err = tr_conf_advance(p);
+    if (err < 0 || p->tok.type != TR_TOK_OPEN) {
+        return err;
+    }
+
+    bool hasstrategy = false, hasnoroute = false;
+    err = tr_conf_advance(p);
+
+    while (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+        conftoken setting = p->tok, value;
+        bool *seen = tr_conf_is(&setting, "strategy") ? &hasstrategy
+                   : tr_conf_is(&setting, "noroute") ? &hasnoroute
+                   : NULL;
+
+        if (!seen) {
+            return tr_conf_expected(p, "strategy, noroute or '}'");
+        }
+
+        if (*seen) {
+            return tr_conf_fail(p, &setting, "%.*s is already set for this switch",
+                                (int)setting.len, setting.text);
+        }
+
+        *seen = true;
+        err = tr_conf_value(p, &setting, &value);
+        if (err < 0) {
+            break;
+        }
+
+        bool ok = false;
+        if (seen == &hasstrategy) {
+            for (unsigned int k = 0; k < 4 && !ok; ++k) {
+                ok = tr_conf_equals(&value, strategies[k]);
+            }
+
+            if (!ok) {
+                return tr_conf_fail(p, &value, "strategy must be 'storeAndForward', "
+                                    "'cutThrough', 'fragmentFree' or 'psychic'");
+            }
+        }
+        else if (!tr_conf_equals(&value, "drop") && !tr_conf_equals(&value, "broadcast")) {
+            return tr_conf_fail(p, &value, "noroute must be 'drop' or 'broadcast'");
+        }
+    }
+
+    return err >= 0 ? tr_conf_advance(p) : err;
+}
+
+// Reads an app block
+//
+static tr_err tr_conf_app(confparser *p)
+{
+    tr_err err = tr_conf_advance(p);
+    if (err >= 0 && p->tok.type != TR_TOK_OPEN) {
+        return tr_conf_expected(p, "'{' to start the app's commands");
+    }
+
+    err = err >= 0 ? tr_conf_advance(p) : err;
+
+    while (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+        conftoken setting = p->tok, value;
+
+        if (!tr_conf_is(&setting, "command")) {
+            return tr_conf_expected(p, "command or '}'");
+        }
+
+        err = tr_conf_value(p, &setting, &value);
+        if (err >= 0) {
+            err = tr_conf_check_macros(p, &value);
+        }
+    }
+
+    return err >= 0 ? tr_conf_advance(p) : err;
+}
+
+// Reads a node block, creating the node and its interfaces.
+//
+// Nodes' behavior (hub, switch or app) is checked, but not kept: the
+// library doesn't model what runs on nodes yet.
+//
+static tr_err tr_conf_node(confparser *p)
+{
+    tr_err err = tr_conf_advance(p);
+    tr_atom id = TR_NO_ATOM;
+
+    if (err >= 0 && p->tok.type == TR_TOK_STRING) {
+        id = tr_conf_intern(p, &p->tok);
+        if (id != TR_NO_ATOM && tr_net_id_taken(p->net, id)) {
+            return tr_conf_fail(p, &p->tok, "the name '%.*s' is already taken",
+                                (int)p->tok.len, p->tok.text);
+        }
+
+        err = tr_conf_advance(p);
+    }
+    else if (err >= 0) {
+        char name[32];
+        do {
+            snprintf(name, sizeof(name), "node%u", p->unnamed++);
+            id = tr_net_intern(p->net, name);
+        } while (id != TR_NO_ATOM && tr_net_id_taken(p->net, id));
+    }
+
+    if (err >= 0 && id == TR_NO_ATOM) {
+        err = TR_ENOMEM;
+    }
+
+    tr_node handle = NULL;
+    if (err >= 0) {
+        err = tr_node_make_many(p->net, &id, 1, &handle);
+    }
+
+    if (err < 0 || p->tok.type != TR_TOK_OPEN) {
+        return err;
+    }
+
+    node *n = tr_node_get(handle);
+    unsigned int numifaces = 0;
+    conftoken behavior = { TR_TOK_END, NULL, 0, 0, 0 };
+
+    err = tr_conf_advance(p);
+    while (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+        if (tr_conf_is(&p->tok, "interface")) {
+            err = tr_conf_interface(p, n, numifaces++);
+            continue;
+        }
+
+        bool hub = tr_conf_is(&p->tok, "hub");
+        bool sw = tr_conf_is(&p->tok, "switch");
+        bool app = tr_conf_is(&p->tok, "app");
+
+        if (!hub && !sw && !app) {
+            return tr_conf_expected(p, "interface, hub, switch, app or '}'");
+        }
+
+        if (behavior.text) {
+            return tr_conf_fail(p, &p->tok, "the node is already a%s %.*s",
+                                behavior.text[0] == 'a' ? "n" : "",
+                                (int)behavior.len, behavior.text);
+        }
+
+        behavior = p->tok;
+
+        if (hub) {
+            err = tr_conf_advance(p);
+            if (err >= 0 && p->tok.type == TR_TOK_OPEN) {
+                err = tr_conf_advance(p);
+                if (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+                    return tr_conf_expected(p, "'}' (hubs have no settings)");
+                }
+
+                err = err >= 0 ? tr_conf_advance(p) : err;
+            }
+        }
+        else if (sw) {
+            err = tr_conf_switch(p);
+        }
+        else {
+            err = tr_conf_app(p);
+        }
+    }
+
+    return err >= 0 ? tr_conf_advance(p) : err;
+}
+
+// Links the interfaces a link block names, if they both exist yet. Returns
+// TR_ENOTFOUND if either doesn't.
+//
+static tr_err tr_conf_make_link(confparser *p, const conflink *cl)
+{
+    iface *i1 = tr_conf_find_iface(p, &cl->ends[0]);
+    iface *i2 = tr_conf_find_iface(p, &cl->ends[1]);
+
+    if (!i1 || !i2) {
+        return TR_ENOTFOUND;
+    }
+
+    if (i1 == i2) {
+        return tr_conf_fail(p, &cl->ends[1], "an interface can't be linked to itself");
+    }
+
+    link *l = NULL;
+    tr_err err = tr_link_add(p->net, i1, i2, &l);
+
+    if (err == TR_ELINKED) {
+        return tr_conf_fail(p, &cl->keyword, "'%s' and '%s' are already linked",
+                            i1->name, i2->name);
+    }
+
+    if (err >= 0) {
+        l->attrs = cl->attrs;
+        l->traffic = cl->traffic;
+    }
+
+    return err;
+}
+
+// Reads a link block, and links its interfaces if they're defined already
+// (otherwise they're linked once the whole config has been read)
+//
+static tr_err tr_conf_link(confparser *p)
+{
+    conflink cl;
+    cl.keyword = p->tok;
+    cl.attrs.latency = 0;
+    cl.attrs.variance = 0;
+    cl.attrs.droprate = 0;
+    cl.attrs.enabled = true;
+    cl.traffic = 1;
+
+    // Links can be named, but the name isn't kept: links are known by the
+    // interfaces they connect
+    tr_err err = tr_conf_advance(p);
+    if (err >= 0 && p->tok.type == TR_TOK_STRING) {
+        err = tr_conf_advance(p);
+    }
+
+    if (err >= 0 && p->tok.type != TR_TOK_OPEN) {
+        return tr_conf_expected(p, "'{' to start the link's settings");
+    }
+
+    unsigned int seen = 0;
+    err = err >= 0 ? tr_conf_advance(p) : err;
+
+    while (err >= 0 && p->tok.type != TR_TOK_CLOSE) {
+        static const char *const settings[] = {
+            "from", "to", "latency", "variance", "droprate", "traffic", "enabled"
+        };
+
+        conftoken setting = p->tok, value;
+        unsigned int which = 0;
+
+        while (which < 7 && !tr_conf_is(&setting, settings[which])) {
+            ++which;
+        }
+
+        if (which == 7) {
+            return tr_conf_expected(p, "from, to, latency, variance, droprate, "
+                                    "traffic, enabled or '}'");
+        }
+
+        if (seen & (1u << which)) {
+            return tr_conf_fail(p, &setting, "%s is already set for this link",
+                                settings[which]);
+        }
+
+        seen |= 1u << which;
+        err = tr_conf_value(p, &setting, &value);
+        if (err < 0) {
+            break;
+        }
+
+        unsigned long traffic;
+        switch (which) {
+        case 0:
+        case 1:
+            cl.ends[which] = value;
+            break;
+
+        case 2:
+        case 3:
+            if (!tr_conf_millis(&value, which == 2 ? &cl.attrs.latency : &cl.attrs.variance)) {
+                return tr_conf_fail(p, &value, "%s is a whole number of milliseconds, "
+                                    "like '150 ms' or '1.5 s'", settings[which]);
+            }
+            break;
+
+        case 4:
+            if (!tr_conf_ratio(&value, &cl.attrs.droprate)) {
+                return tr_conf_fail(p, &value, "droprate is a ratio from 0 to 1, "
+                                    "like '0.01' or '1%%'");
+            }
+            break;
+
+        case 5:
+            if (!tr_conf_number(&value, ~0u, &traffic)) {
+                return tr_conf_fail(p, &value, "traffic is a whole number");
+            }
+
+            cl.traffic = (unsigned int)traffic;
+            break;
+
+        default:
+            if (!tr_conf_equals(&value, "true") && !tr_conf_equals(&value, "false")) {
+                return tr_conf_fail(p, &value, "enabled is 'true' or 'false'");
+            }
+
+            cl.attrs.enabled = tr_conf_equals(&value, "true");
+            break;
+        }
+    }
+
+    if (err < 0) {
+        return err;
+    }
+
+    if ((seen & 3) != 3) {
+        return tr_conf_fail(p, &p->tok, "the link needs both a from and a to");
+    }
+
+    err = tr_conf_make_link(p, &cl);
+    if (err == TR_ENOTFOUND) {
+        err = tr_conflinks_append(p->pending, cl);
+    }
+
+    return err >= 0 ? tr_conf_advance(p) : err;
+}
+
+tr_err tr_conf_parse_text(network *net, const char *text, size_t len,
+                          tr_conferror *error)
+{
+    confparser p;
+    p.net = net;
+    p.error = error;
+    p.unnamed = 0;
+    p.ifaces = tr_confifaces_create(0);
+    p.pending = tr_conflinks_create(0);
+
+    tr_conf_lex_init(&p.lex, text, len);
+
+    tr_err err = p.ifaces && p.pending ? tr_conf_advance(&p) : TR_ENOMEM;
+    while (err >= 0 && p.tok.type != TR_TOK_END) {
+        if (tr_conf_is(&p.tok, "node")) {
+            err = tr_conf_node(&p);
+        }
+        else if (tr_conf_is(&p.tok, "link")) {
+            err = tr_conf_link(&p);
+        }
+        else {
+            err = tr_conf_expected(&p, "node or link");
+        }
+    }
+
+    // Make the links that were waiting on interfaces defined later
+    for (unsigned int k = 0; err >= 0 && k < tr_conflinks_size(p.pending); ++k) {
+        conflink *cl = tr_conflinks_item(p.pending, k);
+
+        err = tr_conf_make_link(&p, cl);
+        if (err == TR_ENOTFOUND) {
+            const conftoken *name = tr_conf_find_iface(&p, &cl->ends[0])
+                                  ? &cl->ends[1] : &cl->ends[0];
+            err = tr_conf_fail(&p, name, "there's no interface named '%.*s'",
+                               (int)name->len, name->text);
+        }
+    }
+
+    tr_conflinks_delete(p.pending);
+    tr_confifaces_delete(p.ifaces);
+    return err;
+}
+
+tr_err tr_conf_parse(const char *path, tr_network *trn, tr_conferror *error)
+{
+    if (!path) return TR_EPOINTER;
+    if (!trn) return TR_EPOINTER;
+
+    if (error) {
+        error->line = 0;
+        error->column = 0;
+        error->message[0] = '\0';
+    }
+
+    confmap map;
+    tr_err err = tr_conf_map(path, &map);
+    if (err < 0) {
+        if (error) {
+            snprintf(error->message, sizeof(error->message), "can't read %s", path);
+        }
+
+        return err;
+    }
+
+    // Networks are named after their config file; compiled ones keep the
+    // name of the config they were compiled from
+    bool image = tr_conf_is_image(map.text, map.len);
+    const char *name = image ? tr_conf_image_name(map.text, map.len) : NULL;
+    if (!name) {
+        name = strrchr(path, '/');
+        name = name ? name + 1 : path;
+    }
+
+    network *net = (network *)tr_net_create(name);
+
+    if (!net) {
+        err = TR_ENOMEM;
+    }
+    else {
+        tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+        err = image
+            ? tr_conf_load_image(net, map.text, map.len, error)
+            : tr_conf_parse_text(net, map.text, map.len, error);
+        tr_mem_set_tag(tag);
+    }
+
+    tr_conf_unmap(&map);
+
+    if (err < 0) {
+        if (net) {
+            tr_net_delete(net);
+        }
+
+        return err;
+    }
+
+    *trn = net;
+    return TR_OK;
+}
+
+tr_err tr_conf_read(const char *path, tr_network *trn)
+{
+    return tr_conf_parse(path, trn, NULL);
+}
@@ -0,0 +1,558 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf/reload.c - Applying a changed config to a running network
+//
+
+#include <stdio.h>  // for snprintf
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset, strcmp
+
+#include "conf.h"
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "typed.h"
+
+TR_VEC_DEFINE(reloadnodes, node *)
+TR_VEC_DEFINE(reloadifaces, iface *)
+TR_VEC_DEFINE(reloadlinks, link *)
+
+// The difference between a running network and the same network as its
+// config now describes it. Changed entities are listed in pairs: the
+// running one, then its counterpart in the config.
+//
+struct _confdiff
+{
+    network *cur;               // The running network
+    network *next;              // The network read from the config
+    node **nodematch;           // Running node matching each of next's, by
+    iface **ifacematch;         // index (see tr_conf_number), or NULL
+
+    tr_reloadnodes *addnodes;   // next's nodes that are new
+    tr_reloadnodes *delnodes;   // cur's nodes that are gone
+    tr_reloadifaces *addifaces; // next's interfaces that are new
+    tr_reloadifaces *delifaces; // cur's interfaces that are gone, from
+                                // nodes that aren't
+    tr_reloadifaces *readdress; // Interfaces whose addresses changed, paired
+    tr_reloadlinks *addlinks;   // next's links that are new
+    tr_reloadlinks *dellinks;   // cur's links that are gone, between
+                                // interfaces that aren't
+    tr_reloadlinks *relinks;    // Links whose characteristics changed, paired
+};
+
+typedef struct _confdiff confdiff;
+
+// Finds the node with the given ID in a network, or NULL. IDs are looked
+// up by string, since the two networks intern them separately.
+//
+static node *tr_conf_find_node(network *net, const char *name)
+{
+    tr_atom id = tr_net_find_id(net, name);
+    node **n = id == TR_NO_ATOM ? NULL : (node **)tr_inthash_get(net->nodes, id);
+    return n ? *n : NULL;
+}
+
+static iface *tr_conf_find_iface(node *n, const char *name)
+{
+    tr_atom id = tr_net_find_id(n->net, name);
+    iface **i = id == TR_NO_ATOM ? NULL : (iface **)tr_inthash_get(n->ifaces, id);
+    return i ? *i : NULL;
+}
+
+// Finds the interface in a network that has the same ID as i, from the
+// other network, on a node with the same ID as i's
+//
+static iface *tr_conf_counterpart(network *net, iface *i)
+{
+    node *n = tr_conf_find_node(net, i->node->name);
+    return n ? tr_conf_find_iface(n, i->name) : NULL;
+}
+
+// Indicates whether two address atoms, from different networks, stand for
+// the same address
+//
+static bool tr_conf_same_atom(network *a, tr_atom x, network *b, tr_atom y)
+{
+    if (x == TR_NO_ATOM || y == TR_NO_ATOM) {
+        return x == y;
+    }
+
+    return strcmp(tr_net_id_str(a, x), tr_net_id_str(b, y)) == 0;
+}
+
+static bool tr_conf_same_addrs(network *a, iface *x, network *b, iface *y)
+{
+    return x->subnet == y->subnet &&
+           tr_conf_same_atom(a, x->mac, b, y->mac) &&
+           tr_conf_same_atom(a, x->ip, b, y->ip);
+}
+
+static bool tr_conf_same_link(link *x, link *y)
+{
+    return x->attrs.latency == y->attrs.latency &&
+           x->attrs.variance == y->attrs.variance &&
+           x->attrs.droprate == y->attrs.droprate &&
+           x->attrs.enabled == y->attrs.enabled &&
+           x->traffic == y->traffic;
+}
+
+// Gives the config's nodes and interfaces consecutive indices, in the order
+// they were read. The config's network is never bound, so its entities'
+// snapshot indices are free to use.
+//
+static void tr_conf_number(network *net, unsigned int *nodes, unsigned int *ifaces)
+{
+    *nodes = 0;
+    tr_slotmap_foreach(node *, n, net->nodeslots) {
+        n->index = (*nodes)++;
+    }
+
+    *ifaces = 0;
+    tr_slotmap_foreach(iface *, i, net->ifaceslots) {
+        i->index = (*ifaces)++;
+    }
+}
+
+static tr_err tr_conf_diff_init(confdiff *d, network *cur, network *next)
+{
+    memset(d, 0, sizeof(confdiff));
+    d->cur = cur;
+    d->next = next;
+
+    unsigned int nodes, ifaces;
+    tr_conf_number(next, &nodes, &ifaces);
+
+    d->nodematch = (node **)tr_calloc(nodes ? nodes : 1, sizeof(node *));
+    d->ifacematch = (iface **)tr_calloc(ifaces ? ifaces : 1, sizeof(iface *));
+    d->addnodes = tr_reloadnodes_create(0);
+    d->delnodes = tr_reloadnodes_create(0);
+    d->addifaces = tr_reloadifaces_create(0);
+    d->delifaces = tr_reloadifaces_create(0);
+    d->readdress = tr_reloadifaces_create(0);
+    d->addlinks = tr_reloadlinks_create(0);
+    d->dellinks = tr_reloadlinks_create(0);
+    d->relinks = tr_reloadlinks_create(0);
+
+    bool made = d->nodematch && d->ifacematch && d->addnodes &&
+                d->delnodes && d->addifaces && d->delifaces &&
+                d->readdress && d->addlinks && d->dellinks && d->relinks;
+
+    return made ? TR_OK : TR_ENOMEM;
+}
+
+static void tr_conf_diff_free(confdiff *d)
+{
+    tr_free(d->nodematch);
+    tr_free(d->ifacematch);
+    tr_reloadnodes_delete(d->addnodes);
+    tr_reloadnodes_delete(d->delnodes);
+    tr_reloadifaces_delete(d->addifaces);
+    tr_reloadifaces_delete(d->delifaces);
+    tr_reloadifaces_delete(d->readdress);
+    tr_reloadlinks_delete(d->addlinks);
+    tr_reloadlinks_delete(d->dellinks);
+    tr_reloadlinks_delete(d->relinks);
+}
+
+// Works out what's gone from the running network. Only the kinds of
+// entity the config has fewer matches for than the network has are
+// looked through, so a reload that removes nothing doesn't walk the
+// network at all.
+//
+static tr_err tr_conf_diff_removed(confdiff *d, unsigned int nodes,
+                                   unsigned int ifaces, unsigned int links)
+{
+    network *cur = d->cur, *next = d->next;
+    tr_err err = TR_OK;
+
+    if (nodes < tr_inthash_num_keys(cur->nodes)) {
+        tr_slotmap_foreach(node *, n, cur->nodeslots) {
+            if (err >= 0 && !tr_conf_find_node(next, n->name)) {
+                err = tr_reloadnodes_append(d->delnodes, n);
+            }
+        }
+    }
+
+    // Interfaces and links that go with a node or interface aren't listed
+    if (ifaces < tr_slotmap_count(cur->ifaceslots)) {
+        tr_slotmap_foreach(iface *, i, cur->ifaceslots) {
+            node *n = tr_conf_find_node(next, i->node->name);
+            if (err >= 0 && n && !tr_conf_find_iface(n, i->name)) {
+                err = tr_reloadifaces_append(d->delifaces, i);
+            }
+        }
+    }
+
+    if (links < tr_linkindex_num_keys(cur->links)) {
+        tr_slotmap_foreach(link *, l, cur->linkslots) {
+            iface *a = tr_conf_counterpart(next, l->ends[0]);
+            iface *b = tr_conf_counterpart(next, l->ends[1]);
+
+            if (err >= 0 && a && b && !tr_linkindex_get(next->links, tr_link_key(a, b))) {
+                err = tr_reloadlinks_append(d->dellinks, l);
+            }
+        }
+    }
+
+    return err;
+}
+
+// Works out what's new or changed in the config, by looking each of its
+// entities up in the running network, then what's gone
+//
+static tr_err tr_conf_diff(confdiff *d)
+{
+    network *cur = d->cur, *next = d->next;
+    unsigned int nodes = 0, ifaces = 0, links = 0;
+    tr_err err = TR_OK;
+
+    tr_slotmap_foreach(node *, nn, next->nodeslots) {
+        node *n = tr_conf_find_node(cur, nn->name);
+        d->nodematch[nn->index] = n;
+
+        if (n) {
+            ++nodes;
+        }
+        else if (err >= 0) {
+            err = tr_reloadnodes_append(d->addnodes, nn);
+        }
+    }
+
+    tr_slotmap_foreach(iface *, ni, next->ifaceslots) {
+        node *n = d->nodematch[ni->node->index];
+        iface *i = n ? tr_conf_find_iface(n, ni->name) : NULL;
+        d->ifacematch[ni->index] = i;
+
+        if (err < 0) {
+            continue;
+        }
+
+        if (!i) {
+            err = tr_reloadifaces_append(d->addifaces, ni);
+            continue;
+        }
+
+        ++ifaces;
+        if (!tr_conf_same_addrs(cur, i, next, ni)) {
+            err = tr_reloadifaces_append(d->readdress, i);
+            if (err >= 0) {
+                err = tr_reloadifaces_append(d->readdress, ni);
+            }
+        }
+    }
+
+    tr_slotmap_foreach(link *, nl, next->linkslots) {
+        iface *a = d->ifacematch[nl->ends[0]->index];
+        iface *b = d->ifacematch[nl->ends[1]->index];
+        link **l = a && b ? tr_linkindex_get(cur->links, tr_link_key(a, b)) : NULL;
+
+        if (err < 0) {
+            continue;
+        }
+
+        if (!l) {
+            err = tr_reloadlinks_append(d->addlinks, nl);
+            continue;
+        }
+
+        ++links;
+        if (!tr_conf_same_link(*l, nl)) {
+            err = tr_reloadlinks_append(d->relinks, *l);
+            if (err >= 0) {
+                err = tr_reloadlinks_append(d->relinks, nl);
+            }
+        }
+    }
+
+    return err >= 0 ? tr_conf_diff_removed(d, nodes, ifaces, links) : err;
+}
+
+// Gets the atom in the running network for an address atom from the
+// config's, interning it if needed
+//
+static tr_err tr_conf_copy_atom(confdiff *d, tr_atom from, tr_atom *to)
+{
+    *to = TR_NO_ATOM;
+    if (from == TR_NO_ATOM) {
+        return TR_OK;
+    }
+
+    *to = tr_net_intern(d->cur, tr_net_id_str(d->next, from));
+    return *to == TR_NO_ATOM ? TR_ENOMEM : TR_OK;
+}
+
+static tr_err tr_conf_copy_addrs(confdiff *d, iface *to, iface *from)
+{
+    tr_atom mac, ip;
+    tr_err err = tr_conf_copy_atom(d, from->mac, &mac);
+    if (err >= 0) {
+        err = tr_conf_copy_atom(d, from->ip, &ip);
+    }
+
+    if (err >= 0) {
+        to->mac = mac;
+        to->ip = ip;
+        to->subnet = from->subnet;
+    }
+
+    return err;
+}
+
+// Removes what's gone. Interfaces and links are removed with their nodes
+// and interfaces, so how many went is counted rather than listed.
+//
+static tr_err tr_conf_apply_removals(confdiff *d, tr_confchanges *changes)
+{
+    network *cur = d->cur;
+    unsigned int ifaces = tr_slotmap_count(cur->ifaceslots);
+    unsigned int links = tr_linkindex_num_keys(cur->links);
+    tr_err err = TR_OK;
+
+    for (unsigned int k = 0; k < tr_reloadlinks_size(d->dellinks); ++k) {
+        tr_link_remove(cur, *tr_reloadlinks_item(d->dellinks, k));
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < tr_reloadifaces_size(d->delifaces); ++k) {
+        err = tr_iface_remove(cur, *tr_reloadifaces_item(d->delifaces, k));
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < tr_reloadnodes_size(d->delnodes); ++k) {
+        err = tr_node_remove(cur, *tr_reloadnodes_item(d->delnodes, k));
+        changes->removednodes += err >= 0;
+    }
+
+    changes->removedifaces = ifaces - tr_slotmap_count(cur->ifaceslots);
+    changes->removedlinks = links - tr_linkindex_num_keys(cur->links);
+    return err;
+}
+
+// Adds what's new, nodes first, so interfaces have nodes to go on and
+// links have interfaces to connect
+//
+static tr_err tr_conf_apply_additions(confdiff *d, tr_confchanges *changes)
+{
+    network *cur = d->cur;
+    unsigned int count = tr_reloadnodes_size(d->addnodes);
+    tr_err err = TR_OK;
+
+    if (count) {
+        const char **names = (const char **)tr_malloc(count * sizeof(const char *));
+        tr_atom *ids = (tr_atom *)tr_malloc(count * sizeof(tr_atom));
+        err = names && ids ? TR_OK : TR_ENOMEM;
+
+        for (unsigned int k = 0; err >= 0 && k < count; ++k) {
+            names[k] = (*tr_reloadnodes_item(d->addnodes, k))->name;
+        }
+
+        if (err >= 0) {
+            err = tr_net_intern_all(cur, names, count, ids);
+        }
+
+        if (err >= 0) {
+            err = tr_node_make_many(cur, ids, count, NULL);
+        }
+
+        if (err >= 0) {
+            changes->addednodes = count;
+        }
+
+        tr_free(names);
+        tr_free(ids);
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < tr_reloadifaces_size(d->addifaces); ++k) {
+        iface *ni = *tr_reloadifaces_item(d->addifaces, k);
+        node *n = tr_conf_find_node(cur, ni->node->name);
+        tr_atom id = tr_net_intern(cur, ni->name);
+        tr_iface handle = NULL;
+
+        err = id != TR_NO_ATOM ? TR_OK : TR_ENOMEM;
+        if (err >= 0) {
+            err = tr_iface_make_many(cur, &n, 1, &id, 1, &handle);
+        }
+
+        if (err >= 0) {
+            iface *i = tr_iface_get(handle);
+            d->ifacematch[ni->index] = i;
+            ++changes->addedifaces;
+            err = tr_conf_copy_addrs(d, i, ni);
+        }
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < tr_reloadlinks_size(d->addlinks); ++k) {
+        link *nl = *tr_reloadlinks_item(d->addlinks, k), *l = NULL;
+        err = tr_link_add(cur, d->ifacematch[nl->ends[0]->index],
+                          d->ifacematch[nl->ends[1]->index], &l);
+
+        if (err >= 0) {
+            l->attrs = nl->attrs;
+            l->traffic = nl->traffic;
+            ++changes->addedlinks;
+        }
+    }
+
+    return err;
+}
+
+// Changes links' characteristics. If the snapshot is staying, they're
+// changed in it too, and the links turned on or off are switched in the
+// routes together; a recompiled snapshot picks them up anyway.
+//
+static tr_err tr_conf_apply_relinks(confdiff *d, tr_confchanges *changes,
+                                    bool update)
+{
+    unsigned int count = tr_reloadlinks_size(d->relinks) / 2;
+    if (!count) {
+        return TR_OK;
+    }
+
+    link **links = (link **)tr_malloc(count * sizeof(link *));
+    linkattrs *attrs = (linkattrs *)tr_malloc(count * sizeof(linkattrs));
+    tr_err err = links && attrs ? TR_OK : TR_ENOMEM;
+
+    for (unsigned int k = 0; err >= 0 && k < count; ++k) {
+        link *nl = *tr_reloadlinks_item(d->relinks, 2 * k + 1);
+
+        links[k] = *tr_reloadlinks_item(d->relinks, 2 * k);
+        attrs[k] = nl->attrs;
+    }
+
+    if (err >= 0 && update) {
+        err = tr_link_update_many(links, attrs, count);
+    }
+    else if (err >= 0) {
+        for (unsigned int k = 0; k < count; ++k) {
+            links[k]->attrs = attrs[k];
+        }
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < count; ++k) {
+        links[k]->traffic = (*tr_reloadlinks_item(d->relinks, 2 * k + 1))->traffic;
+    }
+
+    if (err >= 0) {
+        changes->changedlinks = count;
+    }
+
+    tr_free(links);
+    tr_free(attrs);
+    return err;
+}
+
+// Makes the changes the diff lists. If the topology changes and the
+// network is bound, it's recompiled, and the routes are carried over to
+// it; if only links' characteristics change, they're updated in the
+// snapshot in place, and routes are repaired for links that were turned
+// on or off.
+//
+static tr_err tr_conf_apply(confdiff *d, tr_confchanges *changes)
+{
+    network *cur = d->cur;
+    unsigned int numgone = tr_reloadnodes_size(d->delnodes);
+    bool reshape = numgone || tr_reloadnodes_size(d->addnodes) ||
+                   tr_reloadifaces_size(d->delifaces) ||
+                   tr_reloadifaces_size(d->addifaces) ||
+                   tr_reloadlinks_size(d->dellinks) ||
+                   tr_reloadlinks_size(d->addlinks);
+
+    // Removed nodes' places in the snapshot are noted before they're freed
+    unsigned int *gone = NULL;
+    if (cur->frozen && numgone) {
+        gone = (unsigned int *)tr_malloc(numgone * sizeof(unsigned int));
+        if (!gone) {
+            return TR_ENOMEM;
+        }
+
+        for (unsigned int k = 0; k < numgone; ++k) {
+            gone[k] = (*tr_reloadnodes_item(d->delnodes, k))->index;
+        }
+    }
+
+    tr_err err = tr_conf_apply_removals(d, changes);
+    if (err >= 0) {
+        err = tr_conf_apply_additions(d, changes);
+    }
+
+    if (err >= 0) {
+        err = tr_conf_apply_relinks(d, changes, cur->frozen && !reshape);
+    }
+
+    for (unsigned int k = 0; err >= 0 && k < tr_reloadifaces_size(d->readdress); k += 2) {
+        err = tr_conf_copy_addrs(d, *tr_reloadifaces_item(d->readdress, k),
+                                 *tr_reloadifaces_item(d->readdress, k + 1));
+        changes->readdressedifaces += err >= 0;
+    }
+
+    // Whatever did change has to be compiled in, even if something went
+    // wrong partway. If it can't be, the old snapshot still points at
+    // whatever was removed, so the network can't stay bound.
+    if (cur->frozen && reshape) {
+        tr_err frozen = tr_net_refreeze(cur, gone, numgone);
+        if (frozen < 0) {
+            cur->simulating = false;
+            tr_net_thaw(cur);
+        }
+
+        if (err >= 0) {
+            err = frozen;
+        }
+    }
+
+    tr_free(gone);
+    return err;
+}
+
+tr_err tr_conf_reload(tr_network trn, const char *path,
+                      tr_confchanges *changes, tr_conferror *error)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!path) return TR_EPOINTER;
+
+    network *cur = (network *)trn;
+    tr_network next = NULL;
+
+    // Reading and comparing the config leaves the network alone, so a bad
+    // config never gets as far as changing it
+    tr_err err = tr_conf_parse(path, &next, error);
+    if (err < 0) {
+        return err;
+    }
+
+    tr_confchanges counts;
+    memset(&counts, 0, sizeof(counts));
+
+    confdiff d;
+    err = tr_conf_diff_init(&d, cur, (network *)next);
+    if (err >= 0) {
+        err = tr_conf_diff(&d);
+    }
+
+    if (err >= 0) {
+        bool bound = cur->frozen != NULL;
+
+        tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+        err = tr_conf_apply(&d, &counts);
+        tr_mem_set_tag(tag);
+
+        if (err < 0 && error) {
+            snprintf(error->message, sizeof(error->message),
+                     "can't apply all the changes in %s; the network is "
+                     "partly changed%s", path,
+                     bound && !cur->frozen ? ", and was unbound" : "");
+        }
+    }
+
+    tr_conf_diff_free(&d);
+    tr_net_delete(next);
+
+    if (changes) {
+        *changes = counts;
+    }
+
+    return err;
+}
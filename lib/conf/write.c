@@ -0,0 +1,213 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf/write.c - Saving networks as config files and compiled topologies
+//
+
+#include <stdio.h>  // for fopen, fprintf, rename, remove, snprintf
+#include <stdlib.h> // for NULL
+#include <string.h> // for strchr, strlen, strstr
+
+#include "conf.h"
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "snapshot.h"
+
+// Indicates whether an ID can be written as a config string. The lexer
+// ends strings at the kind of quote that opened them or a newline, and
+// skips over macros.
+//
+static bool tr_conf_writable(const char *id)
+{
+    return !(strchr(id, '\'') && strchr(id, '`')) && !strchr(id, '\n') &&
+           !strstr(id, "$(");
+}
+
+// Picks the quote to write an ID in: ', unless the ID has one in it
+//
+static char tr_conf_quote(const char *id)
+{
+    return strchr(id, '\'') ? '`' : '\'';
+}
+
+tr_err tr_conf_write_text(network *net, const snapshot *snap, FILE *f)
+{
+    for (unsigned int k = 0; k < snap->num_ifaces; ++k) {
+        if (!tr_conf_writable(snap->ifaces[k]->name)) {
+            return TR_ESYNTAX;
+        }
+    }
+
+    for (unsigned int n = 0; n < snap->num_nodes; ++n) {
+        if (!tr_conf_writable(snap->nodes[n]->name)) {
+            return TR_ESYNTAX;
+        }
+    }
+
+    fprintf(f, "# %s\n", net->name);
+
+    for (unsigned int n = 0; n < snap->num_nodes; ++n) {
+        unsigned int first = snap->node_ifaces[n], end = snap->node_ifaces[n + 1];
+
+        const char *name = snap->nodes[n]->name;
+        char q = tr_conf_quote(name);
+
+        fprintf(f, "\nnode %c%s%c", q, name, q);
+        if (first == end) {
+            fputc('\n', f);
+            continue;
+        }
+
+        fputs(" {\n", f);
+
+        for (unsigned int k = first; k < end; ++k) {
+            const iface *i = snap->ifaces[k];
+            char iq = tr_conf_quote(i->name);
+            fprintf(f, "    interface %c%s%c", iq, i->name, iq);
+
+            if (i->mac == TR_NO_ATOM && i->ip == TR_NO_ATOM &&
+                i->subnet == TR_ANY_SUBNET_MASK) {
+                fputc('\n', f);
+                continue;
+            }
+
+            fputs(" {", f);
+
+            if (i->mac != TR_NO_ATOM) {
+                fprintf(f, " mac '%s'", tr_net_id_str(net, i->mac));
+            }
+
+            if (i->ip != TR_NO_ATOM) {
+                fprintf(f, " ip '%s'", tr_net_id_str(net, i->ip));
+            }
+
+            if (i->subnet != TR_ANY_SUBNET_MASK) {
+                fprintf(f, " subnet '%d'", i->subnet);
+            }
+
+            fputs(" }\n", f);
+        }
+
+        fputs("}\n", f);
+    }
+
+    if (snap->num_links) {
+        fputc('\n', f);
+    }
+
+    // Only the settings that differ from a new link's are written
+    for (unsigned int k = 0; k < snap->num_links; ++k) {
+        const link *l = snap->links[k];
+
+        const char *from = l->ends[0]->name, *to = l->ends[1]->name;
+        char fq = tr_conf_quote(from), tq = tr_conf_quote(to);
+
+        fprintf(f, "link { from %c%s%c to %c%s%c", fq, from, fq, tq, to, tq);
+
+        if (l->attrs.latency) {
+            fprintf(f, " latency '%ld ms'", l->attrs.latency);
+        }
+
+        if (l->attrs.variance) {
+            fprintf(f, " variance '%ld ms'", l->attrs.variance);
+        }
+
+        // 9 significant digits are enough to read back the same float
+        if (l->attrs.droprate) {
+            fprintf(f, " droprate '%.9g'", l->attrs.droprate);
+        }
+
+        if (l->traffic != 1) {
+            fprintf(f, " traffic '%u'", l->traffic);
+        }
+
+        if (!l->attrs.enabled) {
+            fputs(" enabled 'false'", f);
+        }
+
+        fputs(" }\n", f);
+    }
+
+    return ferror(f) ? TR_EIO : TR_OK;
+}
+
+tr_err tr_conf_write(tr_network trn, const char *path, tr_confformat format)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!path) return TR_EPOINTER;
+    if (format != TR_CONF_TEXT && format != TR_CONF_COMPILED) return TR_EOUTOFRANGE;
+
+    network *net = (network *)trn;
+
+    // Bound networks have a snapshot already; others get a temporary one,
+    // which only numbers the entities (their numbers mean nothing until the
+    // network is bound)
+    snapshot *snap = net->frozen ? net->frozen : tr_snapshot_create(net);
+    if (!snap) {
+        return TR_ENOMEM;
+    }
+
+    // The file is written under another name and renamed into place, so
+    // it's replaced all at once
+    size_t len = strlen(path);
+    char *temp = (char *)tr_malloc(len + 5);
+    tr_err err = temp ? TR_OK : TR_ENOMEM;
+    FILE *f = NULL;
+
+    if (err >= 0) {
+        snprintf(temp, len + 5, "%s.tmp", path);
+        f = fopen(temp, "wb");
+        err = f ? TR_OK : TR_EIO;
+    }
+
+    if (err >= 0) {
+        err = format == TR_CONF_TEXT ? tr_conf_write_text(net, snap, f)
+                                     : tr_conf_write_image(net, snap, f);
+    }
+
+    if (f && fclose(f) != 0 && err >= 0) {
+        err = TR_EIO;
+    }
+
+    if (err >= 0 && rename(temp, path) != 0) {
+        err = TR_EIO;
+    }
+
+    if (f && err < 0) {
+        remove(temp);
+    }
+
+    if (snap != net->frozen) {
+        tr_snapshot_delete(snap);
+    }
+
+    tr_free(temp);
+    return err;
+}
+
+tr_err tr_conf_compile(const char *source, const char *dest, tr_conferror *error)
+{
+    if (!source) return TR_EPOINTER;
+    if (!dest) return TR_EPOINTER;
+
+    tr_network net = NULL;
+    tr_err err = tr_conf_parse(source, &net, error);
+    if (err < 0) {
+        return err;
+    }
+
+    err = tr_conf_write(net, dest, TR_CONF_COMPILED);
+    if (err < 0 && error) {
+        error->line = 0;
+        error->column = 0;
+        snprintf(error->message, sizeof(error->message), "can't write %s", dest);
+    }
+
+    tr_net_delete(net);
+    return err;
+}
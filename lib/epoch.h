@@ -0,0 +1,52 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// epoch.h - Epoch-based reclamation of memory shared between threads
+//
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <traffic.h>
+
+// Lets memory that readers on other threads may still be looking at be
+// freed safely, without the readers ever locking. Readers bracket each
+// read with tr_epoch_enter and tr_epoch_leave, and announce the global
+// epoch as they go in. A writer that has unpublished something (swapped
+// in a replacement with an atomic store, say) hands it to tr_epoch_retire
+// instead of freeing it. Something retired in epoch e is freed once the
+// epoch has advanced twice past it, which can only happen once every
+// reader that could have seen it has left.
+//
+// Reads must be short: a reader that stays in holds up every retirement
+// in the process. Readers can nest.
+//
+
+struct _epochrec;
+typedef struct _epochrec *tr_epoch; // A reader's place in the epoch
+
+// Frees something that was retired. Runs with reclamation locked, so it
+// mustn't retire anything itself.
+typedef void (*tr_retirefunc)(void *ptr);
+
+// Announces that the calling thread is about to read shared memory. Pass
+// what it returns to tr_epoch_leave when done. Never fails: a thread that
+// can't get a record of its own (memory ran out) holds up the epoch for
+// everyone until it leaves instead.
+tr_epoch tr_epoch_enter();
+
+void tr_epoch_leave(tr_epoch epoch);
+
+// Calls func(ptr) once no reader can still be looking at ptr. If memory
+// runs out, waits for that, then calls it, so it must not be called from
+// between tr_epoch_enter and tr_epoch_leave.
+void tr_epoch_retire(void *ptr, tr_retirefunc func);
+
+// Waits for everything retired so far to be freed, e.g. so that none of
+// it outlives whatever it belongs to. Mustn't be called from between
+// tr_epoch_enter and tr_epoch_leave.
+void tr_epoch_drain();
+
+#endif
@@ -19,6 +19,14 @@ static const char *g_errstrs[] =
     /* TR_ESTACKEMPTY */    "Can't pop an empty stack",
     /* TR_EOUTOFRANGE */    "The specified index is out of range",
     /* TR_EINTERNAL */      "libtraffic encountered an internal error",
+    /* TR_ENOMEM */         "libtraffic could not allocate memory",
+    /* TR_EFULL */          "The queue is full",
+    /* TR_EEMPTY */         "The queue is empty",
+    /* TR_ENETBOUND */      "The network's topology can't change while it's bound",
+    /* TR_ELINKED */        "The interfaces are already linked",
+    /* TR_ESTALE */         "The handle refers to something that has been deleted",
+    /* TR_ESYNTAX */        "The config file isn't valid",
+    /* TR_EIO */            "The file couldn't be read or written",
 };
 
 const char *tr_errstr(tr_err error)
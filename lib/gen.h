@@ -0,0 +1,76 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// gen.h - Declarations for the topology generators
+//
+
+#ifndef GEN_H
+#define GEN_H
+
+#include <traffic.h>
+
+#include "typed.h"
+
+// A link the plan calls for, between two of its nodes by index
+//
+struct _genedge
+{
+    unsigned int a;
+    unsigned int b;
+};
+
+typedef struct _genedge genedge;
+
+TR_VEC_DEFINE(genedges, genedge)
+
+// The most groups of nodes a plan can have
+//
+#define TR_GEN_MAX_GROUPS 4
+
+// A topology to build. Generators lay out their nodes and links here, in
+// terms of node indices, and tr_gen_build turns the plan into a network in
+// a handful of bulk calls.
+//
+struct _genplan
+{
+    const char *names[TR_GEN_MAX_GROUPS];   // Each group's name prefix
+    unsigned int counts[TR_GEN_MAX_GROUPS]; // Nodes in each group
+    unsigned int numgroups;                 // Number of groups
+    unsigned int numnodes;                  // Nodes in all groups
+    tr_genedges *edges;                     // Links, in the order to make them
+};
+
+typedef struct _genplan genplan;
+
+// Starts an empty plan for a topology with the given numbers of nodes and
+// links. Fails with TR_EOUTOFRANGE if that's more than a network can hold.
+//
+tr_err tr_gen_plan_init(genplan *plan, unsigned long long numnodes,
+                        unsigned long long numedges);
+
+// Frees the plan's storage
+//
+void tr_gen_plan_free(genplan *plan);
+
+// Adds a group of count nodes named prefix followed by a number, counting
+// up from 0. Returns the index of the group's first node.
+//
+unsigned int tr_gen_plan_nodes(genplan *plan, const char *prefix,
+                               unsigned int count);
+
+// Adds a link between two of the plan's nodes
+//
+tr_err tr_gen_plan_link(genplan *plan, unsigned int a, unsigned int b);
+
+// Checks the options, which may be NULL
+//
+tr_err tr_gen_check_opts(const tr_genopts *opts);
+
+// Builds the plan into the network, all or nothing
+//
+tr_err tr_gen_build(tr_network net, const genplan *plan,
+                    const tr_genopts *opts);
+
+#endif
@@ -0,0 +1,256 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// gen/build.c - Building generated topologies into networks
+//
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for strlen, memcpy
+
+#include "gen.h"
+#include "memory.h"
+
+// The largest topologies the generators build, limited by the scratch
+// space building them takes: a handle per node, and two interface handles
+// per link, each kind in one allocation
+//
+static const unsigned long long MAX_NODES = 1u << 28;
+static const unsigned long long MAX_LINKS = 1u << 27;
+
+tr_err tr_gen_plan_init(genplan *plan, unsigned long long numnodes,
+                        unsigned long long numedges)
+{
+    memset(plan, 0, sizeof(genplan));
+
+    if (numnodes > MAX_NODES || numedges > MAX_LINKS) {
+        return TR_EOUTOFRANGE;
+    }
+
+    plan->edges = tr_genedges_create(numedges);
+    return plan->edges ? TR_OK : TR_ENOMEM;
+}
+
+void tr_gen_plan_free(genplan *plan)
+{
+    if (plan->edges) {
+        tr_genedges_delete(plan->edges);
+        plan->edges = NULL;
+    }
+}
+
+unsigned int tr_gen_plan_nodes(genplan *plan, const char *prefix,
+                               unsigned int count)
+{
+    unsigned int first = plan->numnodes;
+
+    plan->names[plan->numgroups] = prefix;
+    plan->counts[plan->numgroups++] = count;
+    plan->numnodes += count;
+
+    return first;
+}
+
+tr_err tr_gen_plan_link(genplan *plan, unsigned int a, unsigned int b)
+{
+    genedge e = { a, b };
+    return tr_genedges_append(plan->edges, e);
+}
+
+tr_err tr_gen_check_opts(const tr_genopts *opts)
+{
+    if (!opts) return TR_OK;
+    if (opts->latency < 0) return TR_EOUTOFRANGE;
+    if (opts->variance < 0) return TR_EOUTOFRANGE;
+    if (!(opts->droprate >= 0 && opts->droprate <= 1)) return TR_EOUTOFRANGE;
+
+    return TR_OK;
+}
+
+// Creates the plan's nodes, group by group, into nodes
+//
+static tr_err tr_gen_build_nodes(tr_network net, const genplan *plan,
+                                 const char *prefix, tr_node *nodes)
+{
+    unsigned int prefixlen = strlen(prefix);
+    unsigned int first = 0;
+
+    for (unsigned int g = 0; g < plan->numgroups; ++g) {
+        unsigned int namelen = strlen(plan->names[g]);
+        char *name = (char *)tr_malloc(prefixlen + namelen + 1);
+        if (!name) {
+            return TR_ENOMEM;
+        }
+
+        memcpy(name, prefix, prefixlen);
+        memcpy(name + prefixlen, plan->names[g], namelen + 1);
+
+        tr_err err = tr_node_create_seq(net, name, 0, plan->counts[g], nodes + first);
+        tr_free(name);
+
+        if (err < 0) {
+            // Undo the groups that were made
+            for (unsigned int n = 0; n < first; ++n) {
+                tr_node_delete(nodes[n]);
+            }
+
+            return err;
+        }
+
+        first += plan->counts[g];
+    }
+
+    return TR_OK;
+}
+
+// Gives each node one interface per link it's on, into ifaces, where node
+// n's start at ifaces[base[n]]. Runs of nodes with the same number of
+// links get their interfaces in one call.
+//
+static tr_err tr_gen_build_ifaces(const genplan *plan, const tr_node *nodes,
+                                  const unsigned int *base, tr_iface *ifaces)
+{
+    unsigned int n = 0;
+    while (n < plan->numnodes) {
+        unsigned int degree = base[n + 1] - base[n];
+        unsigned int run = 1;
+
+        while (n + run < plan->numnodes &&
+               base[n + run + 1] - base[n + run] == degree) {
+            ++run;
+        }
+
+        if (degree) {
+            tr_err err = tr_iface_create_seq(nodes + n, run, "-", 0, degree,
+                                             ifaces + base[n]);
+            if (err < 0) {
+                return err;
+            }
+        }
+
+        n += run;
+    }
+
+    return TR_OK;
+}
+
+// Gives every link the characteristics in opts
+//
+static tr_err tr_gen_build_attrs(const tr_link *links, unsigned int count,
+                                 const tr_genopts *opts)
+{
+    if (!opts->latency && !opts->variance && !opts->droprate) {
+        return TR_OK;
+    }
+
+    for (unsigned int k = 0; k < count; ++k) {
+        tr_err err = tr_link_set_latency(links[k], opts->latency);
+        if (err >= 0) err = tr_link_set_variance(links[k], opts->variance);
+        if (err >= 0) err = tr_link_set_droprate(links[k], opts->droprate);
+
+        if (err < 0) {
+            return err;
+        }
+    }
+
+    return TR_OK;
+}
+
+// Does the work of tr_gen_build, with scratch space for the nodes, their
+// interfaces, the interfaces to link, the links, and where each node's
+// interfaces start (with an extra entry at the end)
+//
+static tr_err tr_gen_build_all(tr_network net, const genplan *plan,
+                               const tr_genopts *opts, tr_node *nodes,
+                               tr_iface *ifaces, tr_iface *ends,
+                               tr_link *links, unsigned int *base)
+{
+    unsigned int numnodes = plan->numnodes;
+    unsigned int numedges = tr_genedges_size(plan->edges);
+    genedge *edges = tr_genedges_items(plan->edges);
+
+    memset(base, 0, (numnodes + 1) * sizeof(unsigned int));
+    for (unsigned int e = 0; e < numedges; ++e) {
+        ++base[edges[e].a + 1];
+        ++base[edges[e].b + 1];
+    }
+
+    for (unsigned int n = 0; n < numnodes; ++n) {
+        base[n + 1] += base[n];
+    }
+
+    tr_net_reserve(net, tr_net_num_nodes(net) + numnodes, 2 * numedges, numedges);
+
+    tr_err err = tr_gen_build_nodes(net, plan, opts->prefix ? opts->prefix : "", nodes);
+    if (err < 0) {
+        return err;
+    }
+
+    err = tr_gen_build_ifaces(plan, nodes, base, ifaces);
+
+    if (err >= 0) {
+        // Each link takes the next unused interface on each of its nodes;
+        // base[n] counts node n's off as they're used
+        for (unsigned int e = 0; e < numedges; ++e) {
+            ends[2 * e] = ifaces[base[edges[e].a]++];
+            ends[2 * e + 1] = ifaces[base[edges[e].b]++];
+        }
+
+        err = tr_net_link_many(net, ends, numedges, links);
+    }
+
+    if (err >= 0) {
+        err = tr_gen_build_attrs(links, numedges, opts);
+    }
+
+    if (err < 0) {
+        // Deleting the nodes takes their interfaces and links with them
+        for (unsigned int n = 0; n < numnodes; ++n) {
+            tr_node_delete(nodes[n]);
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_build(tr_network net, const genplan *plan,
+                    const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (tr_net_is_bound(net)) return TR_ENETBOUND;
+
+    tr_err err = tr_gen_check_opts(opts);
+    if (err < 0) {
+        return err;
+    }
+
+    static const tr_genopts defaults = { 0, NULL, 0, 0, 0 };
+    if (!opts) {
+        opts = &defaults;
+    }
+
+    unsigned int numnodes = plan->numnodes;
+    unsigned int numedges = tr_genedges_size(plan->edges);
+    if (numnodes > MAX_NODES || numedges > MAX_LINKS) {
+        return TR_EOUTOFRANGE;
+    }
+
+    tr_node *nodes = (tr_node *)tr_malloc(numnodes * sizeof(tr_node));
+    tr_iface *ifaces = (tr_iface *)tr_malloc(2 * numedges * sizeof(tr_iface));
+    tr_iface *ends = (tr_iface *)tr_malloc(2 * numedges * sizeof(tr_iface));
+    tr_link *links = (tr_link *)tr_malloc(numedges * sizeof(tr_link));
+    unsigned int *base = (unsigned int *)tr_malloc((numnodes + 1) * sizeof(unsigned int));
+
+    err = TR_ENOMEM;
+    if (nodes && ifaces && ends && links && base) {
+        err = tr_gen_build_all(net, plan, opts, nodes, ifaces, ends, links, base);
+    }
+
+    tr_free(base);
+    tr_free(links);
+    tr_free(ends);
+    tr_free(ifaces);
+    tr_free(nodes);
+    return err;
+}
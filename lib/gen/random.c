@@ -0,0 +1,240 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// gen/random.c - Generators for random topologies
+//
+
+#include <math.h>   // for log, floor
+#include <stdint.h> // for uint64_t
+#include <stdlib.h> // for NULL
+
+#include "gen.h"
+#include "memory.h"
+
+// Random topologies draw from xoshiro256**, which is fast and small, and
+// only depends on its seed. The state is filled in from the seed with
+// splitmix64, so nearby seeds give unrelated streams.
+//
+struct _genrng
+{
+    uint64_t s[4];
+};
+
+typedef struct _genrng genrng;
+
+static uint64_t tr_rng_splitmix(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void tr_rng_seed(genrng *rng, uint64_t seed)
+{
+    for (unsigned int k = 0; k < 4; ++k) {
+        rng->s[k] = tr_rng_splitmix(&seed);
+    }
+}
+
+static inline uint64_t tr_rng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t tr_rng_next(genrng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = tr_rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = tr_rng_rotl(s[3], 45);
+
+    return result;
+}
+
+// Gets a number in [0, 1)
+//
+static double tr_rng_double(genrng *rng)
+{
+    return (tr_rng_next(rng) >> 11) * (1.0 / (1ull << 53));
+}
+
+// Gets a number in [0, n), without favoring any of them
+//
+static unsigned int tr_rng_below(genrng *rng, unsigned int n)
+{
+    uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+    uint64_t x;
+
+    do {
+        x = tr_rng_next(rng);
+    } while (x >= limit);
+
+    return (unsigned int)(x % n);
+}
+
+// Lays out G(n, p). Rather than rolling the dice for every pair, this
+// draws how many pairs to skip before the next link, which is
+// geometrically distributed (Batagelj and Brandes, 2005). Pairs are visited
+// as (v, w) with w < v, in order.
+//
+static tr_err tr_gen_plan_erdos_renyi(genplan *plan, unsigned int n, double p,
+                                      genrng *rng)
+{
+    tr_gen_plan_nodes(plan, "n", n);
+
+    if (p <= 0) {
+        return TR_OK;
+    }
+
+    tr_err err = TR_OK;
+    if (p >= 1) {
+        for (unsigned int v = 1; v < n; ++v) {
+            for (unsigned int w = 0; w < v && err >= 0; ++w) {
+                err = tr_gen_plan_link(plan, v, w);
+            }
+        }
+
+        return err;
+    }
+
+    double logq = log(1 - p);
+    long long v = 1, w = -1;
+
+    while (v < n && err >= 0) {
+        // A long enough skip runs off the end of the pairs
+        double skip = floor(log(1 - tr_rng_double(rng)) / logq);
+        if (skip >= (double)n * n) {
+            break;
+        }
+
+        w += 1 + (long long)skip;
+
+        // Carry the skip over into the following rows of pairs
+        while (w >= v && v < n) {
+            w -= v;
+            ++v;
+        }
+
+        if (v < n) {
+            err = tr_gen_plan_link(plan, v, w);
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_erdos_renyi(tr_network net, unsigned n, double p,
+                          const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (n < 1) return TR_EOUTOFRANGE;
+    if (!(p >= 0 && p <= 1)) return TR_EOUTOFRANGE;
+
+    genrng rng;
+    tr_rng_seed(&rng, opts ? opts->seed : 0);
+
+    // Makes room for the expected number of links. The plan grows if there
+    // turn out to be more.
+    unsigned long long pairs = (unsigned long long)n * (n - 1) / 2;
+    unsigned long long expected = (unsigned long long)(p * pairs);
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, n, expected);
+
+    if (err >= 0) err = tr_gen_plan_erdos_renyi(&plan, n, p, &rng);
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
+
+// Lays out a preferential attachment graph. Every link adds both of its
+// nodes to targets, so picking a uniformly random entry of targets picks a
+// node in proportion to its number of links (Batagelj and Brandes, 2005).
+//
+static tr_err tr_gen_plan_barabasi_albert(genplan *plan, unsigned int n,
+                                          unsigned int m, genrng *rng,
+                                          unsigned int *targets,
+                                          unsigned int *picked)
+{
+    tr_gen_plan_nodes(plan, "n", n);
+
+    unsigned int numtargets = 0;
+    tr_err err = TR_OK;
+
+    // The first m + 1 nodes are all linked to each other
+    for (unsigned int v = 1; v <= m; ++v) {
+        for (unsigned int w = 0; w < v && err >= 0; ++w) {
+            err = tr_gen_plan_link(plan, v, w);
+            targets[numtargets++] = v;
+            targets[numtargets++] = w;
+        }
+    }
+
+    for (unsigned int v = m + 1; v < n && err >= 0; ++v) {
+        // Pick m distinct nodes before linking any of them, so this node's
+        // own links don't count toward its picks
+        for (unsigned int k = 0; k < m; ++k) {
+            bool repeat = true;
+            while (repeat) {
+                picked[k] = targets[tr_rng_below(rng, numtargets)];
+
+                repeat = false;
+                for (unsigned int j = 0; j < k; ++j) {
+                    repeat = repeat || picked[j] == picked[k];
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < m && err >= 0; ++k) {
+            err = tr_gen_plan_link(plan, v, picked[k]);
+            targets[numtargets++] = v;
+            targets[numtargets++] = picked[k];
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_barabasi_albert(tr_network net, unsigned n, unsigned m,
+                              const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (m < 1 || n <= m) return TR_EOUTOFRANGE;
+
+    genrng rng;
+    tr_rng_seed(&rng, opts ? opts->seed : 0);
+
+    unsigned long long mm = m;
+    unsigned long long numedges = mm * (mm + 1) / 2 + (n - mm - 1) * mm;
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, n, numedges);
+
+    if (err >= 0) {
+        unsigned int *targets = (unsigned int *)tr_malloc(2 * numedges * sizeof(unsigned int));
+        unsigned int *picked = (unsigned int *)tr_malloc(m * sizeof(unsigned int));
+
+        err = TR_ENOMEM;
+        if (targets && picked) {
+            err = tr_gen_plan_barabasi_albert(&plan, n, m, &rng, targets, picked);
+        }
+
+        tr_free(picked);
+        tr_free(targets);
+    }
+
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
@@ -0,0 +1,198 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// gen/regular.c - Generators for regular topologies
+//
+
+#include <stdlib.h> // for NULL
+
+#include "gen.h"
+
+// Lays out a ring of n nodes
+//
+static tr_err tr_gen_plan_ring(genplan *plan, unsigned int n)
+{
+    tr_gen_plan_nodes(plan, "r", n);
+
+    tr_err err = TR_OK;
+    for (unsigned int i = 0; i < n && err >= 0; ++i) {
+        err = tr_gen_plan_link(plan, i, (i + 1) % n);
+    }
+
+    return err;
+}
+
+tr_err tr_gen_ring(tr_network net, unsigned n, const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (n < 3) return TR_EOUTOFRANGE;
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, n, n);
+
+    if (err >= 0) err = tr_gen_plan_ring(&plan, n);
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
+
+// Lays out a torus with the given dimensions (unused ones are 1), linking
+// each node to the next one along each dimension in turn
+//
+static tr_err tr_gen_plan_torus(genplan *plan, const unsigned int dims[3],
+                                unsigned int ndims)
+{
+    unsigned int x = dims[0], y = dims[1], z = dims[2];
+    tr_gen_plan_nodes(plan, "t", x * y * z);
+
+    tr_err err = TR_OK;
+    for (unsigned int k = 0; k < z; ++k) {
+        for (unsigned int j = 0; j < y; ++j) {
+            for (unsigned int i = 0; i < x && err >= 0; ++i) {
+                unsigned int n = i + x * (j + y * k);
+
+                err = tr_gen_plan_link(plan, n, (i + 1) % x + x * (j + y * k));
+                if (err >= 0) {
+                    err = tr_gen_plan_link(plan, n, i + x * ((j + 1) % y + y * k));
+                }
+
+                if (err >= 0 && ndims == 3) {
+                    err = tr_gen_plan_link(plan, n, i + x * (j + y * ((k + 1) % z)));
+                }
+            }
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_torus(tr_network net, const unsigned *dims, unsigned ndims,
+                    const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (!dims) return TR_EPOINTER;
+    if (ndims != 2 && ndims != 3) return TR_EOUTOFRANGE;
+
+    unsigned int size[3] = { 1, 1, 1 };
+    unsigned long long numnodes = 1;
+
+    for (unsigned int d = 0; d < ndims; ++d) {
+        if (dims[d] < 3) return TR_EOUTOFRANGE;
+
+        size[d] = dims[d];
+        numnodes *= dims[d];
+
+        // Keeps the product from overflowing; plan_init rejects it anyway
+        if (numnodes > ~0u) return TR_EOUTOFRANGE;
+    }
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, numnodes, numnodes * ndims);
+
+    if (err >= 0) err = tr_gen_plan_torus(&plan, size, ndims);
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
+
+// Lays out a k-ary fat tree
+//
+static tr_err tr_gen_plan_fat_tree(genplan *plan, unsigned int k)
+{
+    unsigned int h = k / 2;
+
+    unsigned int core = tr_gen_plan_nodes(plan, "core", h * h);
+    unsigned int agg = tr_gen_plan_nodes(plan, "agg", k * h);
+    unsigned int edge = tr_gen_plan_nodes(plan, "edge", k * h);
+    unsigned int host = tr_gen_plan_nodes(plan, "host", k * h * h);
+
+    tr_err err = TR_OK;
+    for (unsigned int p = 0; p < k; ++p) {
+        // Aggregation switch i in every pod goes up to the i'th group of
+        // core switches
+        for (unsigned int i = 0; i < h; ++i) {
+            for (unsigned int j = 0; j < h && err >= 0; ++j) {
+                err = tr_gen_plan_link(plan, agg + p * h + i, core + i * h + j);
+            }
+        }
+
+        // The pod's edge switches each go up to all of its aggregation
+        // switches, and down to their own hosts
+        for (unsigned int i = 0; i < h; ++i) {
+            unsigned int e = edge + p * h + i;
+
+            for (unsigned int j = 0; j < h && err >= 0; ++j) {
+                err = tr_gen_plan_link(plan, e, agg + p * h + j);
+            }
+
+            for (unsigned int j = 0; j < h && err >= 0; ++j) {
+                err = tr_gen_plan_link(plan, e, host + (p * h + i) * h + j);
+            }
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_fat_tree(tr_network net, unsigned k, const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (k < 2 || k % 2) return TR_EOUTOFRANGE;
+
+    // A fat tree has 5k^2/4 switches, k^3/4 hosts and 3k^3/4 links
+    unsigned long long kk = k;
+    unsigned long long numnodes = 5 * kk * kk / 4 + kk * kk * kk / 4;
+    unsigned long long numedges = 3 * kk * kk * kk / 4;
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, numnodes, numedges);
+
+    if (err >= 0) err = tr_gen_plan_fat_tree(&plan, k);
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
+
+// Lays out a star of stars
+//
+static tr_err tr_gen_plan_star_of_stars(genplan *plan, unsigned int arms,
+                                        unsigned int leaves)
+{
+    unsigned int hub = tr_gen_plan_nodes(plan, "hub", 1);
+    unsigned int arm = tr_gen_plan_nodes(plan, "arm", arms);
+    unsigned int leaf = tr_gen_plan_nodes(plan, "leaf", arms * leaves);
+
+    tr_err err = TR_OK;
+    for (unsigned int i = 0; i < arms && err >= 0; ++i) {
+        err = tr_gen_plan_link(plan, hub, arm + i);
+
+        for (unsigned int j = 0; j < leaves && err >= 0; ++j) {
+            err = tr_gen_plan_link(plan, arm + i, leaf + i * leaves + j);
+        }
+    }
+
+    return err;
+}
+
+tr_err tr_gen_star_of_stars(tr_network net, unsigned arms, unsigned leaves,
+                            const tr_genopts *opts)
+{
+    if (!net) return TR_EPOINTER;
+    if (arms < 1 || leaves < 1) return TR_EOUTOFRANGE;
+
+    unsigned long long numedges = arms + (unsigned long long)arms * leaves;
+
+    genplan plan;
+    tr_err err = tr_gen_plan_init(&plan, 1 + numedges, numedges);
+
+    if (err >= 0) err = tr_gen_plan_star_of_stars(&plan, arms, leaves);
+    if (err >= 0) err = tr_gen_build(net, &plan, opts);
+
+    tr_gen_plan_free(&plan);
+    return err;
+}
@@ -0,0 +1,216 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// group.h - Control-byte groups for Swiss tables
+//
+
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdbool.h> // for bool
+#include <stdint.h> // for uint64_t
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // for _mm_movemask_epi8 and friends
+#endif
+
+// Swiss tables (tr_hash and the tables from TR_HASH_DEFINE) keep one control
+// byte per slot alongside their keys and values. A control byte is either
+// EMPTY, DELETED (a tombstone), or FULL: the high bit set plus the low 7
+// bits of the hash of the key in that slot. Lookups scan control bytes a
+// whole group at a time, and only compare keys for slots whose 7 hash bits
+// match.
+//
+// EMPTY is zero so that a freshly zeroed control array is an empty table.
+//
+// The control array is TR_GROUP_WIDTH bytes longer than the table. The
+// trailing bytes mirror the first TR_GROUP_WIDTH control bytes, so a group
+// load starting near the end of the table wraps around without any special
+// casing. Table capacities are powers of two, at least TR_GROUP_WIDTH.
+//
+// Everything here is inline, so that tables specialized for one key type
+// compile down to straight-line code.
+//
+
+#define TR_GROUP_WIDTH 16
+
+#define TR_CTRL_EMPTY   0x00
+#define TR_CTRL_DELETED 0x7F
+#define TR_CTRL_FULL    0x80
+
+//
+// Group matching.
+// Each of these returns a bitmask with bit i set if the i'th control byte in
+// the group satisfies the condition.
+//
+
+#if defined(__SSE2__)
+
+static inline unsigned int tr_group_match(const unsigned char *group, unsigned char h2)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    __m128i match = _mm_set1_epi8((char)h2);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(match, ctrl));
+}
+
+static inline unsigned int tr_group_match_empty(const unsigned char *group)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    __m128i match = _mm_set1_epi8((char)TR_CTRL_EMPTY);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(match, ctrl));
+}
+
+static inline unsigned int tr_group_match_free(const unsigned char *group)
+{
+    // EMPTY and DELETED are the only control bytes without the high bit set
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return ~_mm_movemask_epi8(ctrl) & 0xFFFF;
+}
+
+static inline unsigned int tr_group_match_full(const unsigned char *group)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return _mm_movemask_epi8(ctrl);
+}
+
+#else
+
+static inline unsigned int tr_group_match(const unsigned char *group, unsigned char h2)
+{
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < TR_GROUP_WIDTH; ++i) {
+        mask |= (unsigned int)(group[i] == h2) << i;
+    }
+
+    return mask;
+}
+
+static inline unsigned int tr_group_match_empty(const unsigned char *group)
+{
+    return tr_group_match(group, TR_CTRL_EMPTY);
+}
+
+static inline unsigned int tr_group_match_free(const unsigned char *group)
+{
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < TR_GROUP_WIDTH; ++i) {
+        mask |= (unsigned int)!(group[i] & TR_CTRL_FULL) << i;
+    }
+
+    return mask;
+}
+
+static inline unsigned int tr_group_match_full(const unsigned char *group)
+{
+    return ~tr_group_match_free(group) & 0xFFFF;
+}
+
+#endif
+
+// Gets the index of the lowest set bit in a nonzero group mask
+//
+static inline unsigned int tr_group_first(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    unsigned int i = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        i += 1;
+    }
+    return i;
+#endif
+}
+
+// Gets the index of the highest set bit in a nonzero group mask
+//
+static inline unsigned int tr_group_last(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(mask);
+#else
+    unsigned int i = 0;
+    while (mask >>= 1) {
+        i += 1;
+    }
+    return i;
+#endif
+}
+
+//
+// Control arrays.
+// These work on a bare control array of the given capacity, whatever the
+// slots next to it hold.
+//
+
+// Gets the control byte to store for a key with the given hash
+//
+static inline unsigned char tr_ctrl_h2(uint64_t h)
+{
+    return (unsigned char)(h & 0x7f) | TR_CTRL_FULL;
+}
+
+// Gets the first slot index to probe for a key with the given hash
+//
+static inline unsigned int tr_ctrl_h1(uint64_t h, unsigned int capacity)
+{
+    return (unsigned int)(h >> 7) & (capacity - 1);
+}
+
+// Sets the i'th control byte, keeping the mirrored tail in sync
+//
+static inline void tr_ctrl_set(unsigned char *ctrl, unsigned int capacity,
+                               unsigned int i, unsigned char c)
+{
+    ctrl[i] = c;
+    if (i < TR_GROUP_WIDTH) {
+        ctrl[capacity + i] = c;
+    }
+}
+
+// Finds the first empty or deleted slot in the probe sequence for hash h
+//
+static inline unsigned int tr_ctrl_find_free(const unsigned char *ctrl,
+                                             unsigned int capacity, uint64_t h)
+{
+    unsigned int mask = capacity - 1;
+    unsigned int pos = tr_ctrl_h1(h, capacity);
+
+    for (unsigned int stride = TR_GROUP_WIDTH; ; stride += TR_GROUP_WIDTH) {
+        unsigned int m = tr_group_match_free(ctrl + pos);
+        if (m) {
+            return (pos + tr_group_first(m)) & mask;
+        }
+
+        pos = (pos + stride) & mask;
+    }
+}
+
+// Marks the i'th slot free. Returns true if it had to leave a tombstone.
+//
+static inline bool tr_ctrl_erase(unsigned char *ctrl, unsigned int capacity,
+                                 unsigned int i)
+{
+    // If every group containing this slot has always had an empty slot, no
+    // probe sequence can have passed over it. In that case we can mark it
+    // empty instead of leaving a tombstone behind.
+    unsigned int mask = capacity - 1;
+    unsigned int before = (i - TR_GROUP_WIDTH) & mask;
+    unsigned int emptyafter = tr_group_match_empty(ctrl + i);
+    unsigned int emptybefore = tr_group_match_empty(ctrl + before);
+
+    if (emptyafter && emptybefore &&
+        tr_group_first(emptyafter) +
+        (TR_GROUP_WIDTH - 1 - tr_group_last(emptybefore)) < TR_GROUP_WIDTH) {
+        tr_ctrl_set(ctrl, capacity, i, TR_CTRL_EMPTY);
+        return false;
+    }
+
+    tr_ctrl_set(ctrl, capacity, i, TR_CTRL_DELETED);
+    return true;
+}
+
+#endif
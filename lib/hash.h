@@ -9,6 +9,9 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include <stddef.h> // for size_t
+#include <stdint.h> // for uint64_t
+
 #include <traffic.h>
 #include "vector.h"
 
@@ -22,16 +25,66 @@ unsigned int tr_hashfunc_int(const void *num);
 bool tr_equalfunc_str(const void *str1, const void *str2);
 bool tr_equalfunc_int(const void *num1, const void *num2);
 
+// Seeded 64-bit hashes. Every output bit depends on every input bit, so
+// they need no further mixing, and tables that pick their own random seed
+// can't be flooded with keys chosen to collide (e.g. from replayed
+// traffic).
+typedef uint64_t (*tr_hashfunc64)(const void *data, uint64_t seed);
+
+// Hashes len bytes (wyhash; reads 16 bytes per step)
+uint64_t tr_hash64_bytes(const void *data, size_t len, uint64_t seed);
+
+uint64_t tr_hashfunc64_str(const void *str, uint64_t seed);   // const char *
+uint64_t tr_hashfunc64_int(const void *num, uint64_t seed);   // int
+uint64_t tr_hashfunc64_u64(const void *num, uint64_t seed);   // uint64_t
+uint64_t tr_hashfunc64_mac(const void *mac, uint64_t seed);   // 6 bytes
+uint64_t tr_hashfunc64_ipv4(const void *addr, uint64_t seed); // 4 bytes
+
+bool tr_equalfunc_mac(const void *mac1, const void *mac2);
+bool tr_equalfunc_u64(const void *num1, const void *num2);
+
+// Gets a fresh seed, different on every call and in every process
+uint64_t tr_hash_random_seed();
+
 tr_hash tr_hash_create(unsigned int keysize, 
                        unsigned int valuesize,
                        tr_hashfunc hashfunc,
                        tr_equalfunc equalfunc);
 
+// Creates a table that hashes with a seeded hash function and a random
+// seed of its own
+tr_hash tr_hash_create_seeded(unsigned int keysize,
+                              unsigned int valuesize,
+                              tr_hashfunc64 hashfunc,
+                              tr_equalfunc equalfunc);
+
+uint64_t tr_hash_seed(tr_hash hash);
+
 tr_err tr_hash_delete(tr_hash hash);
 
+// In incremental mode, resizes migrate a bounded number of items per write
+// instead of all at once, so no single insert stalls.
+//
+// Only writes migrate. Lookups never move items, so a pointer from
+// tr_hash_get stays valid until the next write, and a table can be read
+// while a cursor walks it. The catch is that a table that stops being
+// written stays mid-migration: it keeps the old table's memory, and
+// lookups of missing keys probe both tables. Turning incremental mode off
+// finishes the migration at once.
+tr_err tr_hash_set_incremental(tr_hash hash, bool incremental);
+bool tr_hash_is_incremental(tr_hash hash);
+
+// Grows the table so it can hold count items without resizing again
+tr_err tr_hash_reserve(tr_hash hash, unsigned int count);
+
 bool tr_hash_contains(tr_hash hash, const void *key);
 void *tr_hash_get(tr_hash hash, const void *key);
 
+// Starts pulling the part of the table the key would be in into cache, so
+// that a lookup or insert of the key a little later doesn't stall on it.
+// Code handling a batch of keys can prefetch a few keys ahead.
+void tr_hash_prefetch(tr_hash hash, const void *key);
+
 tr_err tr_hash_set(tr_hash hash, const void *key, const void *value);
 tr_err tr_hash_clear(tr_hash, const void *key);
 
@@ -39,6 +92,34 @@ unsigned int tr_hash_num_keys(tr_hash hash);
 tr_vector tr_hash_keys(tr_hash hash);
 tr_vector tr_hash_values(tr_hash hash);
 
+// A cursor over the items in a hashtable. key and value point straight into
+// the table, and walking it never allocates. Items come back in no
+// particular order. The table must not be modified while a cursor is
+// walking it.
+struct _hash_iter
+{
+    void *key;              // The current item's key
+    void *value;            // The current item's value
+
+    tr_hash hash;           // The table being walked (NULL when finished)
+    unsigned int table;     // Which of the table's backing tables we're in
+    unsigned int group;     // First slot of the current group
+    unsigned int next;      // First slot of the next group to scan
+    unsigned int mask;      // Occupied slots left to visit in the group
+};
+
+typedef struct _hash_iter tr_hash_iter;
+
+void tr_hash_iter_init(tr_hash hash, tr_hash_iter *it);
+
+// Moves the cursor to the next item. Returns false once every item has
+// been visited.
+bool tr_hash_iter_next(tr_hash_iter *it);
+
+#define tr_hash_foreach(it, hash)                       \
+    for (tr_hash_iter_init((hash), &(it));              \
+         tr_hash_iter_next(&(it)); )
+
 
 tr_hash tr_strhash_create(unsigned int itemsize);
 tr_err tr_strhash_delete(tr_hash hash);
@@ -0,0 +1,95 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// hashfunc.h - Inline seeded hash primitives
+//
+
+#ifndef HASHFUNC_H
+#define HASHFUNC_H
+
+#include <stdint.h> // for uint64_t, uint32_t
+#include <string.h> // for memcpy
+
+// The multiply-fold rounds behind the tr_hashfunc64_* functions in hash.h.
+// Those take their keys through a void pointer so tables can call them
+// through a tr_hashfunc64; these take keys by value, so that tables made
+// with TR_HASH_DEFINE can inline them.
+//
+
+#define TR_HASH64_SECRET0 0xa0761d6478bd642full
+#define TR_HASH64_SECRET1 0xe7037ed1a0b428dbull
+#define TR_HASH64_SECRET2 0x8ebc6af09c88c6e3ull
+#define TR_HASH64_SECRET3 0x589965cc75374cc3ull
+
+// Multiplies a and b into a 128-bit product, and returns its halves in a
+// and b
+//
+static inline void tr_hash64_mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// Multiplies a and b and folds the 128-bit product down to 64 bits
+//
+static inline uint64_t tr_hash64_mix(uint64_t a, uint64_t b)
+{
+    tr_hash64_mum(&a, &b);
+    return a ^ b;
+}
+
+// Hashes a value of up to 64 bits. Two rounds are enough to spread
+// sequential keys across every output bit.
+//
+static inline uint64_t tr_hash64_value(uint64_t value, uint64_t seed)
+{
+    uint64_t h = tr_hash64_mix(value ^ TR_HASH64_SECRET0, seed ^ TR_HASH64_SECRET1);
+    return tr_hash64_mix(h ^ TR_HASH64_SECRET2, h ^ TR_HASH64_SECRET3);
+}
+
+static inline uint64_t tr_hash64_int(unsigned int num, uint64_t seed)
+{
+    return tr_hash64_value(num, seed);
+}
+
+static inline uint64_t tr_hash64_u64(uint64_t num, uint64_t seed)
+{
+    return tr_hash64_value(num, seed);
+}
+
+// Hashes the 6 bytes of a MAC address
+//
+static inline uint64_t tr_hash64_mac(const unsigned char *mac, uint64_t seed)
+{
+    uint32_t hi;
+    memcpy(&hi, mac, 4);
+
+    return tr_hash64_value(((uint64_t)hi << 16) | ((uint64_t)mac[4] << 8) | mac[5], seed);
+}
+
+// Hashes the 4 bytes of an IPv4 address
+//
+static inline uint64_t tr_hash64_ipv4(const unsigned char *addr, uint64_t seed)
+{
+    uint32_t v;
+    memcpy(&v, addr, 4);
+
+    return tr_hash64_value(v, seed);
+}
+
+#endif
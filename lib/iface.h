@@ -11,10 +11,82 @@
 
 #include <traffic.h>
 
+#include "intern.h"
+
+struct _network;
+struct _node;
+struct _link;
+
 struct _iface
 {
+    const char *name;       // This interface's unique ID
+    tr_atom id;             // Atom for this interface's unique ID
+    struct _node *node;     // The node this interface is attached to
+    unsigned int index;     // Index in the network's snapshot, while bound
+
+    struct _link **links;   // Links attached to this interface
+    unsigned int numlinks;  // Number of links attached to this interface
+    unsigned int maxlinks;  // Number of links there's room for in links
+    tr_atom mac;            // Atom for the MAC address to bind with, or
+                            // TR_NO_ATOM to pick one
+    tr_atom ip;             // Atom for the IP address to bind with, or
+                            // TR_NO_ATOM to pick one
+    int subnet;             // Subnet mask to bind with (TR_ANY_SUBNET_MASK
+                            // to pick one)
 };
 
 typedef struct _iface iface;
 
+// Resolves a public interface handle. Returns NULL if the handle is NULL or
+// stale (its interface, or the interface's network, has been deleted).
+//
+iface *tr_iface_get(tr_iface handle);
+
+// Gets the public handle for an interface
+//
+tr_iface tr_iface_handle(iface *i);
+
+// Does the work of tr_iface_create_many and tr_iface_create_seq, once the
+// new interfaces' IDs have been interned: gives each of the nodes count
+// interfaces, with the IDs (and filling ifaces) node by node, all or
+// nothing. Allocations count as whatever the caller has tagged them as.
+//
+tr_err tr_iface_make_many(struct _network *net, struct _node *const *nodes,
+                          unsigned int numnodes, const tr_atom *ids,
+                          unsigned int count, tr_iface *ifaces);
+
+// Detaches an interface from its node and frees it and its links, without
+// checking whether its network is bound
+//
+tr_err tr_iface_remove(struct _network *net, iface *i);
+
+// Frees the heap resources an interface holds outside its network's arena,
+// without unlinking it. Used when tearing down a whole network at once.
+//
+void tr_iface_release(iface *i);
+
+// Indicates whether the len characters at str are a MAC address: six pairs
+// of hex digits, separated by colons
+//
+bool tr_iface_is_mac(const char *str, unsigned int len);
+
+// Indicates whether the len characters at str are an IPv4 address: four
+// decimal numbers from 0 to 255, separated by dots
+//
+bool tr_iface_is_ip(const char *str, unsigned int len);
+
+// Makes room for count links on the interface in all, so attaching that
+// many doesn't have to grow its links array
+//
+tr_err tr_iface_reserve_links(iface *i, unsigned int count);
+
+// Attaches a link to the interface, as the link's given end (0 or 1)
+//
+tr_err tr_iface_add_link(iface *i, struct _link *l, int end);
+
+// Detaches a link from the interface, where the interface is the given end
+// of the link. Moves the interface's last link into the gap.
+//
+void tr_iface_remove_link(iface *i, struct _link *l, int end);
+
 #endif
@@ -0,0 +1,301 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// iface/create.c -- Network interface creation and cleanup
+//
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for memcpy, strlen
+
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+
+// Does the work of tr_iface_create, whose allocations count as topology
+//
+static iface *tr_iface_make(node *n, const char *name)
+{
+    tr_atom id = tr_net_intern(n->net, name);
+
+    if (tr_net_id_taken(n->net, id)) {
+        return NULL;
+    }
+
+    iface *i = (iface *)tr_slotmap_alloc(n->net->ifaceslots);
+    if (!i) {
+        return NULL;
+    }
+
+    i->id = id;
+    i->name = tr_net_id_str(n->net, id);
+    i->node = n;
+    i->links = NULL;
+    i->numlinks = 0;
+    i->maxlinks = 0;
+    i->mac = TR_NO_ATOM;
+    i->ip = TR_NO_ATOM;
+    i->subnet = TR_ANY_SUBNET_MASK;
+
+    if (tr_node_add_iface(n, i) < 0) {
+        tr_slotmap_free(n->net->ifaceslots, i);
+        return NULL;
+    }
+
+    return i;
+}
+
+tr_iface tr_iface_create(tr_node trn, const char *name)
+{
+    if (!name) return NULL;
+
+    node *n = tr_node_get(trn);
+    if (!n) return NULL;
+    if (n->net->frozen) return NULL;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    iface *i = tr_iface_make(n, name);
+    tr_mem_set_tag(tag);
+
+    return tr_iface_handle(i);
+}
+
+// Undoes the first made interfaces of a tr_iface_make_many batch of count
+// per node, and gives back the IDs the whole batch took
+//
+static void tr_iface_unmake_many(network *net, node *const *nodes,
+                                 const tr_atom *ids, unsigned int made,
+                                 unsigned int count, unsigned int total)
+{
+    for (unsigned int k = 0; k < made; ++k) {
+        node *n = nodes[k / count];
+        iface *i = *(iface **)tr_inthash_get(n->ifaces, ids[k]);
+
+        tr_inthash_clear(n->ifaces, ids[k]);
+        tr_slotmap_free(net->ifaceslots, i);
+    }
+
+    for (unsigned int k = 0; k < total; ++k) {
+        tr_net_release_id(net, ids[k]);
+    }
+}
+
+tr_err tr_iface_make_many(network *net, node *const *nodes,
+                          unsigned int numnodes, const tr_atom *ids,
+                          unsigned int count, tr_iface *ifaces)
+{
+    tr_err err = tr_net_take_ids(net, ids, numnodes * count);
+    if (err < 0) {
+        return err;
+    }
+
+    for (unsigned int j = 0; j < numnodes; ++j) {
+        node *n = nodes[j];
+        tr_hash_reserve(n->ifaces, tr_inthash_num_keys(n->ifaces) + count);
+
+        for (unsigned int k = j * count; k < (j + 1) * count; ++k) {
+            iface *i = (iface *)tr_slotmap_alloc(net->ifaceslots);
+            if (!i) {
+                tr_iface_unmake_many(net, nodes, ids, k, count, numnodes * count);
+                return TR_ENOMEM;
+            }
+
+            i->id = ids[k];
+            i->name = tr_net_id_str(net, ids[k]);
+            i->node = n;
+            i->links = NULL;
+            i->numlinks = 0;
+            i->maxlinks = 0;
+            i->mac = TR_NO_ATOM;
+            i->ip = TR_NO_ATOM;
+            i->subnet = TR_ANY_SUBNET_MASK;
+
+            // The IDs were all taken above, so this skips tr_node_add_iface
+            tr_inthash_set(n->ifaces, i->id, &i);
+
+            if (ifaces) {
+                ifaces[k] = tr_iface_handle(i);
+            }
+        }
+    }
+
+    return TR_OK;
+}
+
+// Interns a batch of interface IDs, from names (for one node) if it isn't
+// NULL and otherwise as a sequence after each node's name, and then creates
+// the interfaces
+//
+static tr_err tr_iface_create_batch(network *net, node *const *nodes,
+                                    unsigned int numnodes,
+                                    const char *const *names,
+                                    const char *suffix, unsigned int first,
+                                    unsigned int count, tr_iface *ifaces)
+{
+    tr_atom *ids = (tr_atom *)tr_malloc(numnodes * count * sizeof(tr_atom));
+    const char **prefixes = names ? NULL
+                          : (const char **)tr_malloc(numnodes * sizeof(const char *));
+
+    tr_err err = TR_ENOMEM;
+    if (ids && (names || prefixes)) {
+        if (names) {
+            err = tr_net_intern_all(net, names, count, ids);
+        }
+        else {
+            for (unsigned int j = 0; j < numnodes; ++j) {
+                prefixes[j] = nodes[j]->name;
+            }
+
+            err = tr_net_intern_seq(net, prefixes, numnodes, suffix, first, count, ids);
+        }
+    }
+
+    if (err >= 0) {
+        err = tr_iface_make_many(net, nodes, numnodes, ids, count, ifaces);
+    }
+
+    tr_free(prefixes);
+    tr_free(ids);
+    return err;
+}
+
+tr_err tr_iface_create_many(tr_node trn, const char *const *names,
+                            unsigned count, tr_iface *ifaces)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!names) return TR_EPOINTER;
+
+    node *n = tr_node_get(trn);
+    if (!n) return TR_ESTALE;
+    if (n->net->frozen) return TR_ENETBOUND;
+    if (!count) return TR_OK;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    tr_err err = tr_iface_create_batch(n->net, &n, 1, names, NULL, 0, count, ifaces);
+    tr_mem_set_tag(tag);
+
+    return err;
+}
+
+tr_err tr_iface_create_seq(const tr_node *trns, unsigned numnodes,
+                           const char *suffix, unsigned first, unsigned count,
+                           tr_iface *ifaces)
+{
+    if (!trns) return TR_EPOINTER;
+    if (!suffix) return TR_EPOINTER;
+    if (!numnodes || !count) return TR_OK;
+    if (count > ~0u / sizeof(tr_atom) / numnodes) return TR_EOUTOFRANGE;
+
+    node **nodes = (node **)tr_malloc(numnodes * sizeof(node *));
+    if (!nodes) return TR_ENOMEM;
+
+    network *net = NULL;
+    tr_err err = TR_OK;
+
+    for (unsigned int j = 0; j < numnodes && err >= 0; ++j) {
+        nodes[j] = tr_node_get(trns[j]);
+
+        if (!trns[j]) err = TR_EPOINTER;
+        else if (!nodes[j]) err = TR_ESTALE;
+        else if (net && nodes[j]->net != net) err = TR_ENOTFOUND;
+        else net = nodes[j]->net;
+    }
+
+    if (err >= 0 && net->frozen) {
+        err = TR_ENETBOUND;
+    }
+
+    if (err >= 0) {
+        tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+        err = tr_iface_create_batch(net, nodes, numnodes, NULL, suffix, first, count, ifaces);
+        tr_mem_set_tag(tag);
+    }
+
+    tr_free(nodes);
+    return err;
+}
+
+tr_err tr_iface_delete(tr_iface tri)
+{
+    if (!tri) return TR_EPOINTER;
+
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ESTALE;
+
+    if (i->node->net->frozen) {
+        return TR_ENETBOUND;
+    }
+
+    return tr_iface_remove(i->node->net, i);
+}
+
+tr_err tr_iface_remove(network *net, iface *i)
+{
+    tr_err err = tr_node_remove_iface(i->node, i);
+    if (err < 0) {
+        return err;
+    }
+
+    while (i->numlinks) {
+        tr_link_remove(net, i->links[i->numlinks - 1]);
+    }
+
+    tr_iface_release(i);
+    tr_slotmap_free(net->ifaceslots, i);
+    return TR_OK;
+}
+
+void tr_iface_release(iface *i)
+{
+    tr_free(i->links);
+    i->links = NULL;
+    i->numlinks = 0;
+    i->maxlinks = 0;
+}
+
+tr_err tr_iface_reserve_links(iface *i, unsigned int count)
+{
+    if (count <= i->maxlinks) {
+        return TR_OK;
+    }
+
+    link **links = (link **)tr_realloc(i->links, count * sizeof(link *));
+    if (!links) {
+        return TR_ENOMEM;
+    }
+
+    i->links = links;
+    i->maxlinks = count;
+    return TR_OK;
+}
+
+tr_err tr_iface_add_link(iface *i, struct _link *l, int end)
+{
+    if (i->numlinks == i->maxlinks) {
+        unsigned int max = i->maxlinks ? 2 * i->maxlinks : 4;
+        link **links = (link **)tr_realloc(i->links, max * sizeof(link *));
+        if (!links) {
+            return TR_ENOMEM;
+        }
+
+        i->links = links;
+        i->maxlinks = max;
+    }
+
+    l->slots[end] = i->numlinks;
+    i->links[i->numlinks++] = l;
+
+    return TR_OK;
+}
+
+void tr_iface_remove_link(iface *i, struct _link *l, int end)
+{
+    unsigned int slot = l->slots[end];
+    link *last = i->links[--i->numlinks];
+
+    i->links[slot] = last;
+    last->slots[last->ends[0] == i ? 0 : 1] = slot;
+}
@@ -0,0 +1,247 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// iface/model.c - Virtual network interface modeling
+//
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for strlen
+
+#include "iface.h"
+#include "link.h"
+#include "network.h"
+#include "node.h"
+
+iface *tr_iface_get(tr_iface tri)
+{
+    network *net = tr_handle_network(tri);
+    if (!net) return NULL;
+
+    return (iface *)tr_slotmap_get(net->ifaceslots, tr_handle_index(tri),
+                                   tr_handle_gen(tri));
+}
+
+tr_iface tr_iface_handle(iface *i)
+{
+    return i ? tr_handle_make(i->node->net->slot, i) : NULL;
+}
+
+tr_node tr_iface_node(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i) return NULL;
+
+    return tr_node_handle(i->node);
+}
+
+const char *tr_iface_name(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i) return NULL;
+
+    return i->name;
+}
+
+bool tr_iface_is_mac(const char *str, unsigned int len)
+{
+    if (len != 17) {
+        return false;
+    }
+
+    for (unsigned int k = 0; k < len; ++k) {
+        char c = str[k];
+        bool hex = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+                   (c >= 'A' && c <= 'F');
+
+        if (k % 3 == 2 ? c != ':' : !hex) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool tr_iface_is_ip(const char *str, unsigned int len)
+{
+    unsigned int k = 0;
+
+    for (int part = 0; part < 4; ++part) {
+        if (part > 0) {
+            if (k == len || str[k++] != '.') {
+                return false;
+            }
+        }
+
+        unsigned int value = 0, digits = 0;
+        while (k < len && str[k] >= '0' && str[k] <= '9' && digits < 3) {
+            value = 10 * value + (str[k++] - '0');
+            ++digits;
+        }
+
+        if (!digits || value > 255) {
+            return false;
+        }
+    }
+
+    return k == len;
+}
+
+const char *tr_iface_mac(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i || i->mac == TR_NO_ATOM) return TR_ANY_MAC_ADDR;
+
+    return tr_net_id_str(i->node->net, i->mac);
+}
+
+tr_err tr_iface_set_mac(tr_iface tri, const char *macaddr)
+{
+    if (!tri) return TR_EPOINTER;
+    if (macaddr && !tr_iface_is_mac(macaddr, strlen(macaddr))) return TR_EOUTOFRANGE;
+
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ESTALE;
+    if (i->node->net->frozen) return TR_ENETBOUND;
+
+    tr_atom mac = TR_NO_ATOM;
+    if (macaddr) {
+        tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+        mac = tr_net_intern(i->node->net, macaddr);
+        tr_mem_set_tag(tag);
+
+        if (mac == TR_NO_ATOM) {
+            return TR_ENOMEM;
+        }
+    }
+
+    i->mac = mac;
+    return TR_OK;
+}
+
+const char *tr_iface_ip(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i || i->ip == TR_NO_ATOM) return TR_ANY_IP_ADDR;
+
+    return tr_net_id_str(i->node->net, i->ip);
+}
+
+tr_err tr_iface_set_ip(tr_iface tri, const char *ip)
+{
+    if (!tri) return TR_EPOINTER;
+    if (ip && !tr_iface_is_ip(ip, strlen(ip))) return TR_EOUTOFRANGE;
+
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ESTALE;
+    if (i->node->net->frozen) return TR_ENETBOUND;
+
+    tr_atom atom = TR_NO_ATOM;
+    if (ip) {
+        tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+        atom = tr_net_intern(i->node->net, ip);
+        tr_mem_set_tag(tag);
+
+        if (atom == TR_NO_ATOM) {
+            return TR_ENOMEM;
+        }
+    }
+
+    i->ip = atom;
+    return TR_OK;
+}
+
+int tr_iface_subnet_mask(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ANY_SUBNET_MASK;
+
+    return i->subnet;
+}
+
+tr_err tr_iface_set_subnet_mask(tr_iface tri, int subnet)
+{
+    if (!tri) return TR_EPOINTER;
+    if (subnet != TR_ANY_SUBNET_MASK && (subnet < 0 || subnet > 32)) return TR_EOUTOFRANGE;
+
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ESTALE;
+    if (i->node->net->frozen) return TR_ENETBOUND;
+
+    i->subnet = subnet;
+    return TR_OK;
+}
+
+bool tr_iface_is_bound(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i) return false;
+
+    return i->node->net->frozen != NULL;
+}
+
+unsigned tr_iface_num_links(tr_iface tri)
+{
+    iface *i = tr_iface_get(tri);
+    if (!i) return 0;
+
+    return i->numlinks;
+}
+
+tr_err tr_iface_links(tr_iface tri, tr_link *links, unsigned len)
+{
+    if (!tri) return TR_EPOINTER;
+    if (!links) return TR_EPOINTER;
+
+    iface *i = tr_iface_get(tri);
+    if (!i) return TR_ESTALE;
+
+    if (len < i->numlinks) {
+        return TR_EARRAYLEN;
+    }
+
+    for (unsigned int k = 0; k < i->numlinks; ++k) {
+        links[k] = tr_link_handle(i->links[k]);
+    }
+
+    return TR_OK;
+}
+
+// Finds the link between two interfaces, or returns NULL. Handles say
+// which network they're in, so this doesn't need to visit either node.
+//
+static link *tr_iface_find_link(tr_iface tri, tr_iface other, network **net)
+{
+    if (tr_handle_net(tri) != tr_handle_net(other)) {
+        return NULL;
+    }
+
+    *net = tr_handle_network(tri);
+    if (!*net) {
+        return NULL;
+    }
+
+    iface *i = tr_slotmap_get((*net)->ifaceslots, tr_handle_index(tri), tr_handle_gen(tri));
+    iface *o = tr_slotmap_get((*net)->ifaceslots, tr_handle_index(other), tr_handle_gen(other));
+    if (!i || !o) {
+        return NULL;
+    }
+
+    link **l = tr_linkindex_get((*net)->links, tr_link_key(i, o));
+    return l ? *l : NULL;
+}
+
+bool tr_iface_has_link(tr_iface tri, tr_iface other)
+{
+    network *net;
+    return tr_iface_find_link(tri, other, &net) != NULL;
+}
+
+tr_link tr_iface_link(tr_iface tri, tr_iface other)
+{
+    network *net;
+    link *l = tr_iface_find_link(tri, other, &net);
+
+    return l ? tr_handle_make(net->slot, l) : NULL;
+}
@@ -0,0 +1,86 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ilist.h - Intrusive doubly-linked list
+//
+
+#ifndef ILIST_H
+#define ILIST_H
+
+#include <stddef.h> // for offsetof
+
+#include <traffic.h>
+
+// Unlike tr_list, an intrusive list never allocates or copies: callers embed
+// a tr_ilink in their own structs and the list threads through those. An
+// item can sit on several lists at once by embedding several links. The
+// list doesn't own its items; removing one just unlinks it.
+//
+// Lists are circular around a sentinel link in the tr_ilist itself, so
+// unlinking from any position is O(1) and needs no pointer to the list.
+//
+
+struct _ilink;
+struct _ilist;
+
+typedef struct _ilink tr_ilink;
+typedef struct _ilist tr_ilist;
+
+struct _ilink
+{
+    tr_ilink *next;         // The next link (or the list's sentinel)
+    tr_ilink *prev;         // The previous link (or the list's sentinel)
+};
+
+struct _ilist
+{
+    tr_ilink head;          // Sentinel; head.next is first, head.prev is last
+};
+
+// Gets a pointer to the struct containing the given link.
+// e.g. tr_ilist_entry(link, packet, queuelink)
+#define tr_ilist_entry(link, type, member)                      \
+    ((type *)((char *)(link) - offsetof(type, member)))
+
+void tr_ilist_init(tr_ilist *list);
+void tr_ilink_init(tr_ilink *link);
+
+bool tr_ilist_empty(const tr_ilist *list);
+
+// Checks whether a link is currently on some list.
+// Only meaningful for links that were initialized with tr_ilink_init.
+bool tr_ilink_linked(const tr_ilink *link);
+
+tr_ilink *tr_ilist_first(tr_ilist *list);
+tr_ilink *tr_ilist_last(tr_ilist *list);
+
+// These return NULL past either end of the list
+tr_ilink *tr_ilist_next(tr_ilist *list, tr_ilink *link);
+tr_ilink *tr_ilist_prev(tr_ilist *list, tr_ilink *link);
+
+// Links must not already be on a list when they're added
+tr_err tr_ilist_add(tr_ilist *list, tr_ilink *link);
+tr_err tr_ilist_add_before(tr_ilink *other, tr_ilink *link);
+tr_err tr_ilist_add_after(tr_ilink *other, tr_ilink *link);
+tr_err tr_ilist_prepend(tr_ilist *list, tr_ilink *link);
+tr_err tr_ilist_append(tr_ilist *list, tr_ilink *link);
+tr_err tr_ilist_remove(tr_ilink *link);
+
+// These return the unlinked link, or NULL if the list was empty
+tr_ilink *tr_ilist_remove_first(tr_ilist *list);
+tr_ilink *tr_ilist_remove_last(tr_ilist *list);
+
+#define tr_ilist_foreach(var, list)                             \
+    for (tr_ilink *var = tr_ilist_first(list);                  \
+         var; var = tr_ilist_next((list), var))
+
+// Like tr_ilist_foreach, but var may be removed from the list in the loop
+#define tr_ilist_foreach_safe(var, tmp, list)                   \
+    for (tr_ilink *var = tr_ilist_first(list),                  \
+                  *tmp = var ? tr_ilist_next((list), var) : NULL; \
+         var;                                                   \
+         var = tmp, tmp = var ? tr_ilist_next((list), var) : NULL)
+
+#endif
@@ -0,0 +1,57 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// intern.h - String interning table
+//
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <traffic.h>
+
+#include "memory.h"
+
+typedef void *tr_intern;        // A string interning table
+typedef unsigned int tr_atom;   // A dense ID for an interned string
+
+static const tr_atom TR_NO_ATOM = (tr_atom)-1;
+
+// Creates an interning table. Returns NULL if memory runs out.
+tr_intern tr_intern_create();
+
+// Creates an interning table whose string storage lives in the given arena.
+// The strings are released along with the arena, rather than by
+// tr_intern_delete, so the arena must outlive the table. Returns NULL if
+// memory runs out.
+tr_intern tr_intern_create_in(tr_arena arena);
+
+tr_err tr_intern_delete(tr_intern intern);
+
+// Gets the atom for the given string, interning it if it's new.
+// Atoms are assigned densely, starting from 0. Returns TR_NO_ATOM if memory
+// runs out, leaving the table as it was.
+tr_atom tr_intern_atom(tr_intern intern, const char *str);
+tr_atom tr_intern_atom_n(tr_intern intern, const char *str, unsigned int len);
+
+// Gets the atom for the given string without interning it.
+// Returns TR_NO_ATOM if the string has never been interned.
+tr_atom tr_intern_find(tr_intern intern, const char *str);
+tr_atom tr_intern_find_n(tr_intern intern, const char *str, unsigned int len);
+
+// Starts pulling the table entry for the given string into cache, ahead of
+// interning or finding it (see tr_hash_prefetch)
+void tr_intern_prefetch_n(tr_intern intern, const char *str, unsigned int len);
+
+// Gets the interned copy of an atom's string.
+// The pointer is valid until the interning table is deleted.
+const char *tr_intern_str(tr_intern intern, tr_atom atom);
+
+unsigned int tr_intern_count(tr_intern intern);
+
+// Makes room for count strings in all, so interning that many doesn't have
+// to grow the table along the way
+tr_err tr_intern_reserve(tr_intern intern, unsigned int count);
+
+#endif
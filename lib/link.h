@@ -11,10 +11,81 @@
 
 #include <traffic.h>
 
+#include <stdint.h> // for uint64_t
+
+#include "typed.h"
+
+struct _iface;
+struct _network;
+
+// The physical characteristics of a link. Kept together (and by value in
+// the link) so the forwarding path gets everything in one cache line.
+//
+struct _linkattrs
+{
+    long latency;           // Mean latency, in milliseconds
+    long variance;          // Latency variance, in milliseconds
+    float droprate;         // Ratio of packets that are dropped
+    bool enabled;           // Whether the link ferries any traffic
+};
+
+typedef struct _linkattrs linkattrs;
+
 struct _link
 {
+    struct _iface *ends[2]; // The interfaces the link connects
+    unsigned int slots[2];  // Where the link is in each end's links array
+    unsigned int index;     // Index in the network's snapshot, while bound
+    linkattrs attrs;        // The link's physical characteristics
+    unsigned int traffic;   // Expected traffic, relative to other links
 };
 
 typedef struct _link link;
 
+// Resolves a public link handle. Returns NULL if the handle is NULL or
+// stale (its link, or the link's network, has been deleted).
+//
+link *tr_link_get(tr_link handle);
+
+// Gets the public handle for a link
+//
+tr_link tr_link_handle(link *l);
+
+// Networks index their links by the pair of interfaces they connect, so a
+// link can be found without touching either interface's adjacency list.
+// Keys are the two interfaces' ID atoms, smaller one first.
+//
+TR_HASH_DEFINE(linkindex, uint64_t, link *, tr_hash64_u64, tr_typed_equal)
+
+// Gets the key a link between the given interfaces is indexed by
+//
+uint64_t tr_link_key(struct _iface *i1, struct _iface *i2);
+
+// Does the work of tr_net_link, once the interfaces have been checked: links
+// them with default characteristics into out. Fails with TR_ELINKED if
+// they're linked already. Allocations count as whatever the caller has
+// tagged them as.
+//
+tr_err tr_link_add(struct _network *net, struct _iface *i1, struct _iface *i2,
+                   link **out);
+
+// Changes a link's characteristics. If its network is bound, they're
+// copied into the snapshot, and if the link was turned on or off, the
+// routes over it are repaired to match.
+//
+void tr_link_update(link *l, const linkattrs *attrs);
+
+// Gives each of count links, all in the same network, the characteristics
+// at the same place in attrs, as tr_link_update does. The links that were
+// turned on or off are changed in the routes all at once, so route lookups
+// see them all as they were or all as they are. Fails with TR_ENOMEM,
+// changing nothing, if memory runs out.
+//
+tr_err tr_link_update_many(link **links, const linkattrs *attrs,
+                           unsigned int count);
+
+// Unlinks and frees a link, without checking whether its network is bound
+//
+void tr_link_remove(struct _network *net, link *l);
+
 #endif
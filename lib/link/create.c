@@ -0,0 +1,193 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// link/create.c -- Link creation and cleanup
+//
+
+#include <stdlib.h> // for NULL
+
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+
+uint64_t tr_link_key(iface *i1, iface *i2)
+{
+    uint64_t a = i1->id, b = i2->id;
+    return a < b ? (a << 32) | b : (b << 32) | a;
+}
+
+tr_err tr_link_add(network *net, iface *i1, iface *i2, link **out)
+{
+    bool added;
+    link **entry = tr_linkindex_put(net->links, tr_link_key(i1, i2), &added);
+    if (!entry) {
+        return TR_ENOMEM;
+    }
+
+    if (!added) {
+        return TR_ELINKED;
+    }
+
+    link *l = (link *)tr_slotmap_alloc(net->linkslots);
+    if (!l) {
+        tr_linkindex_clear(net->links, tr_link_key(i1, i2));
+        return TR_ENOMEM;
+    }
+
+    *entry = l;
+
+    l->ends[0] = i1;
+    l->ends[1] = i2;
+    l->index = 0;
+    l->attrs.latency = 0;
+    l->attrs.variance = 0;
+    l->attrs.droprate = 0;
+    l->attrs.enabled = true;
+    l->traffic = 1;
+
+    tr_err err = tr_iface_add_link(i1, l, 0);
+    if (err >= 0) {
+        err = tr_iface_add_link(i2, l, 1);
+        if (err < 0) {
+            tr_iface_remove_link(i1, l, 0);
+        }
+    }
+
+    if (err < 0) {
+        tr_linkindex_clear(net->links, tr_link_key(i1, i2));
+        tr_slotmap_free(net->linkslots, l);
+        return err;
+    }
+
+    *out = l;
+    return TR_OK;
+}
+
+tr_err tr_net_link(tr_network trn, tr_iface tri1, tr_iface tri2, tr_link *trl)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!tri1) return TR_EPOINTER;
+    if (!tri2) return TR_EPOINTER;
+    if (tri1 == tri2) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    iface *i1 = tr_iface_get(tri1), *i2 = tr_iface_get(tri2);
+
+    if (!i1 || !i2) {
+        return TR_ESTALE;
+    }
+
+    if (i1->node->net != net || i2->node->net != net) {
+        return TR_ENOTFOUND;
+    }
+
+    if (net->frozen) {
+        return TR_ENETBOUND;
+    }
+
+    link *l = NULL;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    tr_err err = tr_link_add(net, i1, i2, &l);
+    tr_mem_set_tag(tag);
+
+    if (err >= 0 && trl) {
+        *trl = tr_link_handle(l);
+    }
+
+    return err;
+}
+
+// Does the work of tr_net_link_many, once the pairs have been checked.
+// Allocations count as topology.
+//
+static tr_err tr_link_add_many(network *net, const tr_iface *ends,
+                               unsigned int count, tr_link *links)
+{
+    tr_linkindex_reserve(net->links, tr_linkindex_num_keys(net->links) + count);
+
+    for (unsigned int k = 0; k < count; ++k) {
+        link *l = NULL;
+        tr_err err = tr_link_add(net, tr_iface_get(ends[2 * k]),
+                                 tr_iface_get(ends[2 * k + 1]), &l);
+
+        if (err < 0) {
+            // Undo the links this batch made, which the index still knows
+            while (k--) {
+                iface *i1 = tr_iface_get(ends[2 * k]), *i2 = tr_iface_get(ends[2 * k + 1]);
+                tr_link_remove(net, *tr_linkindex_get(net->links, tr_link_key(i1, i2)));
+            }
+
+            return err;
+        }
+
+        if (links) {
+            links[k] = tr_link_handle(l);
+        }
+    }
+
+    return TR_OK;
+}
+
+tr_err tr_net_link_many(tr_network trn, const tr_iface *ends, unsigned count,
+                        tr_link *links)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!ends) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+
+    for (unsigned int k = 0; k < 2 * count; k += 2) {
+        if (!ends[k] || !ends[k + 1] || ends[k] == ends[k + 1]) {
+            return TR_EPOINTER;
+        }
+
+        iface *i1 = tr_iface_get(ends[k]), *i2 = tr_iface_get(ends[k + 1]);
+        if (!i1 || !i2) {
+            return TR_ESTALE;
+        }
+
+        if (i1->node->net != net || i2->node->net != net) {
+            return TR_ENOTFOUND;
+        }
+    }
+
+    if (net->frozen) {
+        return TR_ENETBOUND;
+    }
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    tr_err err = tr_link_add_many(net, ends, count, links);
+    tr_mem_set_tag(tag);
+
+    return err;
+}
+
+void tr_link_remove(network *net, link *l)
+{
+    tr_linkindex_clear(net->links, tr_link_key(l->ends[0], l->ends[1]));
+    tr_iface_remove_link(l->ends[0], l, 0);
+    tr_iface_remove_link(l->ends[1], l, 1);
+    tr_slotmap_free(net->linkslots, l);
+}
+
+tr_err tr_link_delete(tr_link trl)
+{
+    if (!trl) return TR_EPOINTER;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    network *net = l->ends[0]->node->net;
+
+    if (net->frozen) {
+        return TR_ENETBOUND;
+    }
+
+    tr_link_remove(net, l);
+    return TR_OK;
+}
@@ -0,0 +1,242 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// link/model.c - Virtual network link modeling
+//
+
+#include <stdlib.h> // for NULL
+
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "route.h"
+#include "snapshot.h"
+
+// Copies the link's attributes into its network's snapshot, if it's bound.
+// Unlike the topology, a bound link's characteristics can change. Route
+// lookups read whether links are enabled, so that's left to the caller,
+// to change through the routes, which repair themselves to match. Returns
+// whether it needs changing.
+//
+static bool tr_link_sync(link *l)
+{
+    snapshot *snap = l->ends[0]->node->net->frozen;
+
+    if (snap) {
+        snap->latency[l->index] = l->attrs.latency;
+        snap->variance[l->index] = l->attrs.variance;
+        snap->droprate[l->index] = l->attrs.droprate;
+
+        return snap->enabled[l->index] != l->attrs.enabled;
+    }
+
+    return false;
+}
+
+void tr_link_update(link *l, const linkattrs *attrs)
+{
+    l->attrs = *attrs;
+
+    if (tr_link_sync(l)) {
+        network *net = l->ends[0]->node->net;
+        tr_routes_link_changed(net->routes, l->index, l->attrs.enabled);
+    }
+}
+
+tr_err tr_link_update_many(link **links, const linkattrs *attrs,
+                           unsigned int count)
+{
+    if (!count) {
+        return TR_OK;
+    }
+
+    network *net = links[0]->ends[0]->node->net;
+    unsigned int *flipped = NULL;
+    bool *enabled = NULL;
+    unsigned int numflipped = 0;
+
+    if (net->frozen) {
+        flipped = (unsigned int *)tr_malloc(count * sizeof(unsigned int));
+        enabled = (bool *)tr_malloc(count * sizeof(bool));
+
+        if (!flipped || !enabled) {
+            tr_free(flipped);
+            tr_free(enabled);
+            return TR_ENOMEM;
+        }
+    }
+
+    for (unsigned int k = 0; k < count; ++k) {
+        links[k]->attrs = attrs[k];
+
+        if (tr_link_sync(links[k])) {
+            flipped[numflipped] = links[k]->index;
+            enabled[numflipped++] = attrs[k].enabled;
+        }
+    }
+
+    if (numflipped) {
+        tr_routes_links_changed(net->routes, flipped, enabled, numflipped);
+    }
+
+    tr_free(flipped);
+    tr_free(enabled);
+    return TR_OK;
+}
+
+// Turns the link on or off
+//
+static void tr_link_set_enabled(link *l, bool enabled)
+{
+    linkattrs attrs = l->attrs;
+    attrs.enabled = enabled;
+    tr_link_update(l, &attrs);
+}
+
+link *tr_link_get(tr_link trl)
+{
+    network *net = tr_handle_network(trl);
+    if (!net) return NULL;
+
+    return (link *)tr_slotmap_get(net->linkslots, tr_handle_index(trl),
+                                  tr_handle_gen(trl));
+}
+
+tr_link tr_link_handle(link *l)
+{
+    return l ? tr_handle_make(l->ends[0]->node->net->slot, l) : NULL;
+}
+
+tr_iface tr_link_endpoint(tr_link trl, int index)
+{
+    if (index < 0 || index > 1) return NULL;
+
+    link *l = tr_link_get(trl);
+    if (!l) return NULL;
+
+    return tr_iface_handle(l->ends[index]);
+}
+
+long tr_link_latency(tr_link trl)
+{
+    link *l = tr_link_get(trl);
+    if (!l) return 0;
+
+    return l->attrs.latency;
+}
+
+tr_err tr_link_set_latency(tr_link trl, long latency)
+{
+    if (!trl) return TR_EPOINTER;
+    if (latency < 0) return TR_EOUTOFRANGE;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    linkattrs attrs = l->attrs;
+    attrs.latency = latency;
+    tr_link_update(l, &attrs);
+
+    return TR_OK;
+}
+
+long tr_link_variance(tr_link trl)
+{
+    link *l = tr_link_get(trl);
+    if (!l) return 0;
+
+    return l->attrs.variance;
+}
+
+tr_err tr_link_set_variance(tr_link trl, long variance)
+{
+    if (!trl) return TR_EPOINTER;
+    if (variance < 0) return TR_EOUTOFRANGE;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    linkattrs attrs = l->attrs;
+    attrs.variance = variance;
+    tr_link_update(l, &attrs);
+
+    return TR_OK;
+}
+
+float tr_link_droprate(tr_link trl)
+{
+    link *l = tr_link_get(trl);
+    if (!l) return 0;
+
+    return l->attrs.droprate;
+}
+
+tr_err tr_link_set_droprate(tr_link trl, float droprate)
+{
+    if (!trl) return TR_EPOINTER;
+    if (!(droprate >= 0 && droprate <= 1)) return TR_EOUTOFRANGE;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    linkattrs attrs = l->attrs;
+    attrs.droprate = droprate;
+    tr_link_update(l, &attrs);
+
+    return TR_OK;
+}
+
+unsigned tr_link_traffic(tr_link trl)
+{
+    link *l = tr_link_get(trl);
+    if (!l) return 0;
+
+    return l->traffic;
+}
+
+tr_err tr_link_set_traffic(tr_link trl, unsigned traffic)
+{
+    if (!trl) return TR_EPOINTER;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    l->traffic = traffic;
+    return TR_OK;
+}
+
+bool tr_link_is_enabled(tr_link trl)
+{
+    link *l = tr_link_get(trl);
+    if (!l) return false;
+
+    return l->attrs.enabled;
+}
+
+tr_err tr_link_enable(tr_link trl)
+{
+    if (!trl) return TR_EPOINTER;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    tr_link_set_enabled(l, true);
+
+    return TR_OK;
+}
+
+tr_err tr_link_disable(tr_link trl)
+{
+    if (!trl) return TR_EPOINTER;
+
+    link *l = tr_link_get(trl);
+    if (!l) return TR_ESTALE;
+
+    tr_link_set_enabled(l, false);
+
+    return TR_OK;
+}
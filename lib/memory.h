@@ -6,12 +6,62 @@
 // memory.h - Memory allocation routines
 //
 
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <traffic.h>
+
 // Returns a pointer to [size] bytes of heap-allocated memory.
 // Returns NULL if the pointer could not be allocated.
 //
 void *tr_malloc(unsigned int size);
 
+// Returns a pointer to [count * size] bytes of zeroed heap-allocated memory.
+// Returns NULL if the pointer could not be allocated.
+//
+void *tr_calloc(unsigned int count, unsigned int size);
+
+// Resizes a heap-allocated pointer created with tr_malloc, preserving its
+// contents up to the smaller of the old and new sizes.
+// Returns NULL (and leaves mem alone) if the pointer could not be resized.
+//
+void *tr_realloc(void *mem, unsigned int size);
+
 // Frees a heap-allocated pointer created with tr_malloc.
 // Don't mix with other memory allocation routines.
 //
 void tr_free(void *);
+
+// Sets the tag that the calling thread's allocations are accounted to from
+// now on (see tr_mem_stats), and returns the tag that was set before.
+// Arenas account their memory to the tag that was set when they were created.
+// Subsystems set their tag on the way in and restore the old one on the way
+// out, so memory allocated on their behalf counts against them.
+//
+tr_memtag tr_mem_set_tag(tr_memtag tag);
+
+
+typedef void *tr_arena; // A region of memory that is freed all at once
+
+// Creates an empty arena. Returns NULL if memory runs out.
+//
+tr_arena tr_arena_create();
+
+// Frees every allocation made from the arena, and the arena itself.
+// Cost is proportional to the number of chunks the arena has grown to,
+// not the number of allocations made from it.
+//
+void tr_arena_delete(tr_arena arena);
+
+// Returns a pointer to [size] bytes of memory owned by the arena.
+// The memory is 16-byte aligned.
+//
+void *tr_arena_alloc(tr_arena arena, unsigned int size);
+
+// Returns memory to the arena so a later allocation of the same size can
+// reuse it. size must match the size the memory was allocated with.
+// Calling this is optional; tr_arena_delete reclaims everything anyway.
+//
+void tr_arena_free(tr_arena arena, void *mem, unsigned int size);
+
+#endif
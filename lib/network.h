@@ -12,34 +12,152 @@
 #include <traffic.h>
 
 #include "hash.h"
+#include "intern.h"
+#include "link.h"
+#include "memory.h"
 #include "set.h"
+#include "slotmap.h"
+#include "snapshot.h"
+
+#include <stdint.h> // for uint64_t, uintptr_t
 
 struct _node;
 
 struct _network
 {
     const char *name;   // The network's friendly name
-    tr_set entityids;   // IDs in use by entities in this network
-    tr_hash nodes;      // Map from node ID string to node ptr
-    tr_hash links;      // Map from link ID string to link ptr
+    unsigned int slot;  // The network's slot in the registry of networks
+    tr_arena arena;     // Backing memory for the network's entities
+    tr_slotmap nodeslots;   // Storage for the network's nodes
+    tr_slotmap ifaceslots;  // Storage for the network's interfaces
+    tr_slotmap linkslots;   // Storage for the network's links
+    tr_intern ids;      // Interned entity ID strings
+    tr_set entityids;   // Atoms of IDs in use by entities in this network
+    tr_hash nodes;      // Map from node ID atom to node ptr
+    tr_linkindex *links; // Map from iface ID atom pair to link ptr
+
+    snapshot *frozen;   // The compiled topology while bound, otherwise NULL
+    struct _routes *routes; // Routes over the frozen topology, while bound
+    unsigned int routecache; // Destinations to cache routes for (0 = auto)
+    struct _placement *placement; // Nodes' forwarding threads, while bound
+    bool simulating;    // Whether the simulation has been started
 };
 
 typedef struct _network network;
 
+// The number of networks that can exist at once
+//
+#define TR_MAX_NETWORKS 1024
+
+// The tr_node, tr_iface and tr_link handles the public API hands out aren't
+// pointers. Each packs, from the top bit down, the generation (24 bits) and
+// index (30 bits) of the entity's slot in one of its network's slot maps,
+// with the network's registry slot (10 bits) in between. Generations are
+// odd, so a handle is never NULL. A network's slot maps start their
+// generations after those of the last network to hold its registry slot,
+// so handles into a deleted network go stale too.
+//
+static inline void *tr_handle_make(unsigned int netslot, const void *item)
+{
+    if (!item) {
+        return NULL;
+    }
+
+    uint64_t h = (uint64_t)tr_slotmap_gen(item) << 40 |
+                 (uint64_t)netslot << 30 |
+                 tr_slotmap_index(item);
+
+    return (void *)(uintptr_t)h;
+}
+
+static inline unsigned int tr_handle_gen(const void *handle)
+{
+    return (unsigned int)((uint64_t)(uintptr_t)handle >> 40);
+}
+
+static inline unsigned int tr_handle_net(const void *handle)
+{
+    return (unsigned int)((uint64_t)(uintptr_t)handle >> 30) & (TR_MAX_NETWORKS - 1);
+}
+
+static inline unsigned int tr_handle_index(const void *handle)
+{
+    return (unsigned int)(uintptr_t)handle & (TR_SLOT_MAX - 1);
+}
+
+// The registry of live networks, by slot (see network/create.c)
+//
+extern network *g_nets[TR_MAX_NETWORKS];
+
+// Gets the network in the given registry slot, or NULL if there isn't one
+//
+static inline network *tr_net_in_slot(unsigned int slot)
+{
+    return __atomic_load_n(&g_nets[slot % TR_MAX_NETWORKS], __ATOMIC_ACQUIRE);
+}
+
+// Gets the network a node, interface or link handle belongs to, or NULL if
+// that network has been deleted
+//
+static inline network *tr_handle_network(const void *handle)
+{
+    return tr_net_in_slot(tr_handle_net(handle));
+}
+
+// Gets the atom for the given network entity ID, interning it if needed.
+// Every entity ID string is hashed here once; everything past this point
+// works in terms of atoms.
+//
+tr_atom tr_net_intern(network *net, const char *id);
+
+// Like tr_net_intern, but for the len characters at id, which needn't be
+// terminated
+//
+tr_atom tr_net_intern_n(network *net, const char *id, unsigned int len);
+
+// Gets the atom for the given network entity ID without interning it.
+// Returns TR_NO_ATOM if no entity has ever used the ID.
+//
+tr_atom tr_net_find_id(network *net, const char *id);
+
+// Gets the (interned) ID string for the given atom
+//
+const char *tr_net_id_str(network *net, tr_atom id);
+
 // Checks if some other entity in the network is already using the given
 // network entity ID.
 //
-bool tr_net_id_taken(network *net, const char *id);
+bool tr_net_id_taken(network *net, tr_atom id);
 
 // Marks the given network entity ID as in use.
 // Won't fail if the ID is already taken; use tr_net_id_taken instead.
 //
-tr_err tr_net_take_id(network *net, const char *id);
+tr_err tr_net_take_id(network *net, tr_atom id);
 
 // Marks the given network entity ID as no longer in use.
 // Won't fail if the ID isn't already taken; use tr_net_id_taken instead.
 //
-tr_err tr_net_release_id(network *net, const char *id);
+tr_err tr_net_release_id(network *net, tr_atom id);
+
+// Interns the IDs for a batch of new entities into ids.
+// Fails with TR_EPOINTER if any of the names is NULL.
+//
+tr_err tr_net_intern_all(network *net, const char *const *names,
+                         unsigned int count, tr_atom *ids);
+
+// Interns count numbered IDs for each of the given prefixes into ids:
+// prefix, then suffix, then first through first + count - 1. IDs with the
+// same prefix are together in ids, in the order of the prefixes.
+//
+tr_err tr_net_intern_seq(network *net, const char *const *prefixes,
+                         unsigned int numprefixes, const char *suffix,
+                         unsigned int first, unsigned int count, tr_atom *ids);
+
+// Marks a batch of network entity IDs as in use, all or nothing. If any of
+// them is already taken, or appears twice, releases the ones it took and
+// fails with TR_ENAMETAKEN.
+//
+tr_err tr_net_take_ids(network *net, const tr_atom *ids, unsigned int count);
 
 // Adds a node to the network
 //
@@ -49,4 +167,39 @@ tr_err tr_net_add_node(network *net, struct _node *node);
 //
 tr_err tr_net_remove_node(network *net, struct _node *node);
 
+// Compiles the network's topology into a snapshot (see snapshot.h) and
+// stores it in net->frozen, replacing any snapshot that was there before,
+// and sets up routing over it in net->routes (see route.h).
+// Run when the network is bound; the topology can't change after that,
+// except by reloading its config.
+//
+tr_err tr_net_freeze(network *net);
+
+// Compiles a bound network's changed topology into a new snapshot and
+// routes, and swaps them in for the old ones. The placement is carried
+// over, so nodes that were there before stay on their threads. gone gives
+// the old snapshot indices of the nodes that were removed, since their
+// slots may have been reused. Everything new is built before anything is
+// swapped, so if memory runs out, the network is left as it was. The old
+// snapshot, routes and placement are retired rather than freed.
+//
+tr_err tr_net_refreeze(network *net, const unsigned int *gone,
+                       unsigned int numgone);
+
+// Discards the network's snapshot, routes and placement, if it has them,
+// waiting until no reader can still be looking at them
+//
+void tr_net_thaw(network *net);
+
+// A bound network can be changed while the forwarding threads read it, by
+// reloading its config. The forwarding path (tr_node_next_hop,
+// tr_node_hops and tr_node_part) only reads net->routes, net->placement
+// and the snapshot they point to, never the entities they were built
+// from, and only between tr_epoch_enter and tr_epoch_leave. Changes swap
+// in new ones with atomic stores and retire the old ones (see epoch.h), so
+// readers see the network as it was or as it is, and what they're reading
+// is never freed out from under them. Nothing else may be called on the
+// network while it's being changed.
+//
+
 #endif
@@ -0,0 +1,277 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// network/bind.c - Binding, starting and stopping network simulations
+//
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset
+
+#include "epoch.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "part.h"
+#include "route.h"
+#include "snapshot.h"
+
+tr_err tr_net_freeze(network *net)
+{
+    if (!net) return TR_EPOINTER;
+
+    snapshot *snap = tr_snapshot_create(net);
+    if (!snap) {
+        return TR_ENOMEM;
+    }
+
+    routes *r = tr_routes_create(snap, net->routecache);
+    if (!r) {
+        tr_snapshot_delete(snap);
+        return TR_ENOMEM;
+    }
+
+    tr_net_thaw(net);
+    __atomic_store_n(&net->frozen, snap, __ATOMIC_RELEASE);
+    __atomic_store_n(&net->routes, r, __ATOMIC_RELEASE);
+
+    return TR_OK;
+}
+
+// Gives each node in the new snapshot the part it had in the old one, or
+// TR_NO_PART if it's new. Building the new snapshot renumbered the nodes
+// that survived, so the old snapshot leads from each old index to the new
+// one, except for removed nodes, whose pointers there are stale.
+//
+static tr_err tr_net_carry_parts(snapshot *old, snapshot *snap,
+                                 const placement *p, const unsigned int *gone,
+                                 unsigned int numgone, unsigned int *prev)
+{
+    unsigned char *removed = (unsigned char *)tr_calloc(old->num_nodes ? old->num_nodes : 1, 1);
+    if (!removed) {
+        return TR_ENOMEM;
+    }
+
+    for (unsigned int k = 0; k < numgone; ++k) {
+        removed[gone[k]] = 1;
+    }
+
+    for (unsigned int n = 0; n < snap->num_nodes; ++n) {
+        prev[n] = TR_NO_PART;
+    }
+
+    for (unsigned int n = 0; n < old->num_nodes; ++n) {
+        if (!removed[n]) {
+            prev[old->nodes[n]->index] = p->part[n];
+        }
+    }
+
+    tr_free(removed);
+    return TR_OK;
+}
+
+// Maps the old snapshot's nodes and links onto the new one's, by their
+// handles, so that routes can be carried over. Handles of entities that
+// are gone are stale by now, so they lead nowhere.
+//
+static tr_err tr_net_map_routes(snapshot *old, snapshot *snap, routemap *map)
+{
+    map->old = old;
+    map->node = (unsigned int *)tr_malloc((old->num_nodes ? old->num_nodes : 1) * sizeof(unsigned int));
+    map->link = (unsigned int *)tr_malloc((old->num_links ? old->num_links : 1) * sizeof(unsigned int));
+    map->added = (unsigned int *)tr_malloc((snap->num_links ? snap->num_links : 1) * sizeof(unsigned int));
+    map->numadded = 0;
+
+    // The new links are the ones nothing maps to, and the ones that were
+    // off before
+    unsigned char *fresh = (unsigned char *)tr_malloc(snap->num_links ? snap->num_links : 1);
+
+    if (!map->node || !map->link || !map->added || !fresh) {
+        tr_free(fresh);
+        return TR_ENOMEM;
+    }
+
+    for (unsigned int n = 0; n < old->num_nodes; ++n) {
+        map->node[n] = tr_snapshot_node(snap, old->node_handles[n]);
+    }
+
+    memset(fresh, 1, snap->num_links);
+    for (unsigned int k = 0; k < old->num_links; ++k) {
+        link *l = tr_link_get(old->link_handles[k]);
+        map->link[k] = l ? l->index : TR_NO_ROUTE;
+
+        if (l && old->enabled[k]) {
+            fresh[l->index] = 0;
+        }
+    }
+
+    for (unsigned int k = 0; k < snap->num_links; ++k) {
+        if (fresh[k] && snap->enabled[k]) {
+            map->added[map->numadded++] = k;
+        }
+    }
+
+    tr_free(fresh);
+    return TR_OK;
+}
+
+tr_err tr_net_refreeze(network *net, const unsigned int *gone,
+                       unsigned int numgone)
+{
+    if (!net) return TR_EPOINTER;
+    if (!net->frozen) return TR_ENETBOUND;
+
+    snapshot *old = net->frozen;
+    snapshot *snap = tr_snapshot_create(net);
+    if (!snap) {
+        return TR_ENOMEM;
+    }
+
+    routes *r = tr_routes_create(snap, net->routecache);
+    placement *p = NULL;
+    tr_err err = r ? TR_OK : TR_ENOMEM;
+
+    if (err >= 0 && net->placement) {
+        unsigned int count = snap->num_nodes;
+        unsigned int *prev = (unsigned int *)tr_malloc((count ? count : 1) * sizeof(unsigned int));
+
+        if (prev && tr_net_carry_parts(old, snap, net->placement, gone,
+                                       numgone, prev) >= 0) {
+            p = tr_part_carry(snap, net->placement, prev);
+        }
+
+        tr_free(prev);
+        err = p ? TR_OK : TR_ENOMEM;
+    }
+
+    if (err < 0) {
+        tr_routes_delete(r);
+        tr_snapshot_delete(snap);
+        return err;
+    }
+
+    // The old routes' trees are carried over if there's the memory to;
+    // otherwise they're rebuilt as they're needed
+    routes *oldroutes = net->routes;
+    routemap map;
+
+    if (tr_net_map_routes(old, snap, &map) >= 0) {
+        tr_routes_carry(r, oldroutes, &map);
+    }
+
+    tr_free(map.added);
+    tr_free(map.link);
+    tr_free(map.node);
+
+    // Readers may still be looking at what's replaced, so it's retired
+    // rather than freed
+    placement *oldplacement = net->placement;
+
+    __atomic_store_n(&net->frozen, snap, __ATOMIC_RELEASE);
+    __atomic_store_n(&net->routes, r, __ATOMIC_RELEASE);
+    __atomic_store_n(&net->placement, p, __ATOMIC_RELEASE);
+
+    tr_part_retire(oldplacement);
+    tr_routes_retire(oldroutes);
+    tr_snapshot_retire(old);
+
+    return TR_OK;
+}
+
+void tr_net_thaw(network *net)
+{
+    if (!net || !net->frozen) {
+        return;
+    }
+
+    placement *p = net->placement;
+    routes *r = net->routes;
+    snapshot *snap = net->frozen;
+
+    __atomic_store_n(&net->placement, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&net->routes, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&net->frozen, NULL, __ATOMIC_RELEASE);
+
+    tr_part_retire(p);
+    tr_routes_retire(r);
+    tr_snapshot_retire(snap);
+
+    // Nothing outlives the binding, so the memory is back once unbound
+    tr_epoch_drain();
+}
+
+tr_err tr_net_bind(tr_network trn)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    if (net->frozen) {
+        return TR_OK;
+    }
+
+    return tr_net_freeze(net);
+}
+
+bool tr_net_is_bound(tr_network trn)
+{
+    if (!trn) return false;
+
+    network *net = (network *)trn;
+    return net->frozen != NULL;
+}
+
+tr_err tr_net_start(tr_network trn)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    tr_err err = tr_net_bind(net);
+    if (err < 0) {
+        return err;
+    }
+
+    // Nodes are spread over a forwarding thread per core, unless they've
+    // been placed already
+    if (!net->placement) {
+        err = tr_part_network(net, 0, TR_PART_IMBALANCE);
+        if (err < 0) {
+            return err;
+        }
+    }
+
+    net->simulating = true;
+    return TR_OK;
+}
+
+bool tr_net_is_simulating(tr_network trn)
+{
+    if (!trn) return false;
+
+    network *net = (network *)trn;
+    return net->simulating;
+}
+
+tr_err tr_net_stop(tr_network trn)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    net->simulating = false;
+
+    return TR_OK;
+}
+
+tr_err tr_net_unbind(tr_network trn)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    if (net->simulating) {
+        return TR_ENETINUSE;
+    }
+
+    tr_net_thaw(net);
+    return TR_OK;
+}
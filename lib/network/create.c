@@ -3,55 +3,195 @@
 // traffic - A Simple Network Simulator
 // Copyright (c) Dave Kilian 2014
 //
-// network/unique.id - tr_network creation and cleanup
+// network/create.c - tr_network creation and cleanup
 //
 
+#include <pthread.h> // for pthread_mutex_t and friends
 #include <stdlib.h> // for NULL
 #include <string.h> // for strlen, strcpy
 
+#include "iface.h"
 #include "link.h"
 #include "memory.h"
 #include "network.h"
 #include "node.h"
 
+// The registry of live networks, which handles name their network by slot
+// in. Lookups read it without the lock. A slot is claimed as soon as a
+// network starts being created, but only filled in once it's ready.
+//
+network *g_nets[TR_MAX_NETWORKS];
+static bool g_netclaimed[TR_MAX_NETWORKS];
+static pthread_mutex_t g_netslock = PTHREAD_MUTEX_INITIALIZER;
+
+// For each registry slot, the generation the next network in it starts its
+// entities at, which is past every generation the last one handed out
+//
+static unsigned int g_netgens[TR_MAX_NETWORKS];
+
+// Where to start looking for a free registry slot. Slots are handed out
+// round-robin, so one isn't reused until the others have been.
+//
+static unsigned int g_nextslot;
+
+// Claims a free registry slot for the network. Returns false if there are
+// already TR_MAX_NETWORKS networks.
+//
+static bool tr_net_register(network *net)
+{
+    pthread_mutex_lock(&g_netslock);
+
+    bool found = false;
+    for (unsigned int k = 0; k < TR_MAX_NETWORKS && !found; ++k) {
+        unsigned int slot = (g_nextslot + k) % TR_MAX_NETWORKS;
+        if (!g_netclaimed[slot]) {
+            g_netclaimed[slot] = true;
+            net->slot = slot;
+            g_nextslot = slot + 1;
+            found = true;
+        }
+    }
+
+    pthread_mutex_unlock(&g_netslock);
+    return found;
+}
+
+// Publishes a registered network, so its handles resolve
+//
+static void tr_net_publish(network *net)
+{
+    __atomic_store_n(&g_nets[net->slot], net, __ATOMIC_RELEASE);
+}
+
+// Gives up the network's registry slot, and makes sure the slot's next
+// network doesn't hand out any of the same handles
+//
+static void tr_net_unregister(network *net)
+{
+    unsigned int gen = g_netgens[net->slot];
+    tr_slotmap maps[] = { net->nodeslots, net->ifaceslots, net->linkslots };
+
+    for (unsigned int k = 0; k < 3; ++k) {
+        unsigned int next = tr_slotmap_next_gen(maps[k]);
+        gen = next > gen ? next : gen;
+    }
+
+    pthread_mutex_lock(&g_netslock);
+    g_netgens[net->slot] = gen;
+    g_netclaimed[net->slot] = false;
+    __atomic_store_n(&g_nets[net->slot], NULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_netslock);
+}
+
 tr_network tr_net_create(const char *name)
 {
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+
     network *net = (network *)tr_malloc(sizeof(network));
+    if (!net || !tr_net_register(net)) {
+        tr_free(net);
+        tr_mem_set_tag(tag);
+        return NULL;
+    }
+
+    unsigned int gen = g_netgens[net->slot];
 
     net->name = NULL;
-    net->entityids = tr_strset_create();
-    net->nodes = tr_strhash_create(sizeof(node));
-    net->links = tr_strhash_create(sizeof(link));
+    net->arena = tr_arena_create();
+    net->nodeslots = tr_slotmap_create_in(net->arena, sizeof(node), gen);
+    net->ifaceslots = tr_slotmap_create_in(net->arena, sizeof(iface), gen);
+    net->linkslots = tr_slotmap_create_in(net->arena, sizeof(link), gen);
+    net->ids = tr_intern_create_in(net->arena);
+    net->entityids = tr_intset_create();
+    net->nodes = tr_inthash_create(sizeof(node *));
+    net->links = tr_linkindex_create();
+    net->frozen = NULL;
+    net->routes = NULL;
+    net->routecache = 0;
+    net->placement = NULL;
+    net->simulating = false;
+
+    if (name && net->arena) {
+        net->name = tr_arena_alloc(net->arena, strlen(name) + 1);
+        if (net->name) {
+            strcpy((char *)net->name, name);
+        }
+    }
 
-    if (name) {
-        net->name = tr_malloc(strlen(name) + 1);
-        strcpy((char *)net->name, name);
+    // Everything the network is made of is checked at once; deleting it
+    // copes with whichever parts are missing
+    if (!net->arena || !net->nodeslots || !net->ifaceslots ||
+        !net->linkslots || !net->ids || !net->entityids || !net->nodes ||
+        !net->links || (name && !net->name)) {
+        tr_net_delete(net);
+        tr_mem_set_tag(tag);
+        return NULL;
     }
 
+    tr_net_publish(net);
+
+    tr_mem_set_tag(tag);
     return net;
 }
 
-tr_err tr_net_delete(tr_network trn)
+tr_err tr_net_reserve(tr_network trn, unsigned nodes, unsigned ifaces,
+                      unsigned links)
 {
     if (!trn) return TR_EPOINTER;
+    if (ifaces > ~0u - nodes) return TR_EOUTOFRANGE;
 
     network *net = (network *)trn;
+    if (net->frozen) {
+        return TR_ENETBOUND;
+    }
 
-    tr_vec_foreach(node *, n, net->nodes) {
-        tr_err err = tr_net_remove_node(net, n);
-        if (err < 0) {
-            return err;
-        }
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+
+    // Every node and interface ID gets interned, on top of any IDs that
+    // were interned before
+    unsigned int ids = nodes + ifaces;
+    tr_err err = tr_intern_reserve(net->ids, tr_intern_count(net->ids) + ids);
+
+    if (err >= 0) {
+        err = tr_hash_reserve(net->nodes, nodes);
     }
 
-    tr_strset_delete(net->entityids);
-    tr_strhash_delete(net->nodes);
-    tr_strhash_delete(net->links);
+    if (err >= 0) {
+        err = tr_linkindex_reserve(net->links, links);
+    }
+
+    tr_mem_set_tag(tag);
+    return err;
+}
+
+tr_err tr_net_delete(tr_network trn)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    if (net->simulating) {
+        return TR_ENETINUSE;
+    }
+
+    tr_net_thaw(net);
+    tr_net_unregister(net);
 
-    if (net->name) {
-        tr_free((void*)net->name);
+    // Entities, their names and the network's name all live in the arena,
+    // so there's no need to delete them (and unlink them from each other)
+    // one at a time. Only what they hold on the heap is freed here.
+    tr_slotmap_foreach(node *, n, net->nodeslots) {
+        tr_node_release(n);
     }
 
+    tr_intset_delete(net->entityids);
+    tr_inthash_delete(net->nodes);
+    tr_linkindex_delete(net->links);
+    tr_intern_delete(net->ids);
+    tr_slotmap_delete(net->nodeslots);
+    tr_slotmap_delete(net->ifaceslots);
+    tr_slotmap_delete(net->linkslots);
+    tr_arena_delete(net->arena);
+
     tr_free(net);
 
     return TR_OK;
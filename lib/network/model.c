@@ -7,7 +7,6 @@
 //
 
 #include <stdlib.h> // for NULL
-#include <string.h> // for memcpy
 
 #include "network.h"
 #include "node.h"
@@ -25,7 +24,7 @@ unsigned int tr_net_num_nodes(tr_network trn)
     if (!trn) return 0;
 
     network *net = (network *)trn;
-    return tr_strhash_num_keys(net->nodes);
+    return tr_inthash_num_keys(net->nodes);
 }
 
 tr_err tr_net_nodes(tr_network trn, tr_node *nodes, unsigned int len)
@@ -34,33 +33,32 @@ tr_err tr_net_nodes(tr_network trn, tr_node *nodes, unsigned int len)
     if (!nodes) return TR_EPOINTER;
 
     network *net = (network *)trn;
-    tr_vector nodevec = tr_hash_values(net->nodes);
-
-    if (len < tr_vec_length(nodevec)) {
+    if (len < tr_inthash_num_keys(net->nodes)) {
         return TR_EARRAYLEN;
     }
-    else if (len > tr_vec_length(nodevec)) {
-        len = tr_vec_length(nodevec);
-    }
 
-    memcpy(nodes, tr_vec_items(nodevec), len * sizeof(node));
+    // The slot map keeps the nodes together, so walk it rather than the
+    // index
+    unsigned int count = 0;
+    tr_slotmap_foreach(node *, n, net->nodeslots) {
+        nodes[count++] = tr_node_handle(n);
+    }
 
-    tr_vec_delete(nodes);
     return TR_OK;
 }
 
-tr_err tr_net_link(tr_network net, tr_iface i1, tr_iface i2, tr_link *link)
-{
-    return TR_EINTERNAL; // TODO NYI link modeling
-}
-
 bool tr_net_has_node(tr_network trn, const char *name)
 {
-    if (!trn) return TR_EPOINTER;
-    if (!name) return TR_EPOINTER;
+    if (!trn) return false;
+    if (!name) return false;
 
     network *net = (network *)trn;
-    return tr_strhash_contains(net->nodes, name);
+    tr_atom id = tr_net_find_id(net, name);
+    if (id == TR_NO_ATOM) {
+        return false;
+    }
+
+    return tr_inthash_contains(net->nodes, id);
 }
 
 tr_node tr_net_node(tr_network trn, const char *name)
@@ -69,7 +67,13 @@ tr_node tr_net_node(tr_network trn, const char *name)
     if (!name) return NULL;
 
     network *net = (network *)trn;
-    return tr_strhash_get(net->nodes, name);
+    tr_atom id = tr_net_find_id(net, name);
+    if (id == TR_NO_ATOM) {
+        return NULL;
+    }
+
+    node **n = (node **)tr_inthash_get(net->nodes, id);
+    return n ? tr_node_handle(*n) : NULL;
 }
 
 tr_err tr_net_add_node(network *net, struct _node *node)
@@ -77,16 +81,16 @@ tr_err tr_net_add_node(network *net, struct _node *node)
     if (!net) return TR_EPOINTER;
     if (!node) return TR_EPOINTER;
 
-    if (tr_net_id_taken(net, node->name)) {
+    if (tr_net_id_taken(net, node->id)) {
         return TR_ENAMETAKEN;
     }
 
-    tr_err err = tr_net_take_id(net, node->name);
+    tr_err err = tr_net_take_id(net, node->id);
     if (err < 0) {
         return err;
     }
 
-    return tr_strhash_set(net->nodes, node->name, node);
+    return tr_inthash_set(net->nodes, node->id, &node);
 }
 
 tr_err tr_net_remove_node(network *net, struct _node *node)
@@ -94,10 +98,10 @@ tr_err tr_net_remove_node(network *net, struct _node *node)
     if (!net) return TR_EPOINTER;
     if (!node) return TR_EPOINTER;
 
-    tr_err err = tr_net_release_id(net, node->name);
+    tr_err err = tr_net_release_id(net, node->id);
     if (err < 0) {
         return err;
     }
 
-    return tr_strhash_clear(net->nodes, node->name);
+    return tr_inthash_clear(net->nodes, node->id);
 }
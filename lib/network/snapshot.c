@@ -0,0 +1,213 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// network/snapshot.c - Compiling a network into a frozen snapshot
+//
+
+#include <stdlib.h> // for NULL, qsort
+#include <string.h> // for memset
+
+#include "epoch.h"
+#include "iface.h"
+#include "link.h"
+#include "network.h"
+#include "node.h"
+#include "snapshot.h"
+
+// Orders entities by ID atom. Atoms are handed out in creation order, so
+// snapshots number entities the same way every time the network is built.
+//
+static int tr_snapshot_cmp_nodes(const void *a, const void *b)
+{
+    tr_atom x = (*(node **)a)->id, y = (*(node **)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+static int tr_snapshot_cmp_ifaces(const void *a, const void *b)
+{
+    tr_atom x = (*(iface **)a)->id, y = (*(iface **)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+// Allocates an array of count items of the given size from the arena
+//
+static void *tr_snapshot_array(tr_arena arena, unsigned int count, unsigned int size)
+{
+    return tr_arena_alloc(arena, count * size);
+}
+
+// Does the work of tr_snapshot_create, whose allocations count as topology
+//
+static snapshot *tr_snapshot_build(network *net)
+{
+    tr_arena arena = tr_arena_create();
+    snapshot *snap = (snapshot *)tr_arena_alloc(arena, sizeof(snapshot));
+    if (!snap) {
+        tr_arena_delete(arena);
+        return NULL;
+    }
+
+    memset(snap, 0, sizeof(snapshot));
+    snap->arena = arena;
+    snap->num_nodes = tr_inthash_num_keys(net->nodes);
+
+    tr_hash_iter it;
+    tr_hash_foreach(it, net->nodes) {
+        snap->num_ifaces += tr_inthash_num_keys((*(node **)it.value)->ifaces);
+    }
+
+    snap->num_links = tr_linkindex_num_keys(net->links);
+
+    unsigned int nn = snap->num_nodes, ni = snap->num_ifaces, nl = snap->num_links;
+
+    snap->nodes = (node **)tr_snapshot_array(arena, nn, sizeof(node *));
+    snap->node_ifaces = (unsigned int *)tr_snapshot_array(arena, nn + 1, sizeof(unsigned int));
+    snap->ifaces = (iface **)tr_snapshot_array(arena, ni, sizeof(iface *));
+    snap->iface_node = (unsigned int *)tr_snapshot_array(arena, ni, sizeof(unsigned int));
+    snap->iface_links = (unsigned int *)tr_snapshot_array(arena, ni + 1, sizeof(unsigned int));
+    snap->adj_link = (unsigned int *)tr_snapshot_array(arena, 2 * nl, sizeof(unsigned int));
+    snap->adj_peer = (unsigned int *)tr_snapshot_array(arena, 2 * nl, sizeof(unsigned int));
+    snap->links = (link **)tr_snapshot_array(arena, nl, sizeof(link *));
+    snap->link_ends = (unsigned int *)tr_snapshot_array(arena, 2 * nl, sizeof(unsigned int));
+    snap->latency = (long *)tr_snapshot_array(arena, nl, sizeof(long));
+    snap->variance = (long *)tr_snapshot_array(arena, nl, sizeof(long));
+    snap->droprate = (float *)tr_snapshot_array(arena, nl, sizeof(float));
+    snap->enabled = (unsigned char *)tr_snapshot_array(arena, nl, sizeof(unsigned char));
+
+    unsigned int ns = ((slotmap *)net->nodeslots)->used;
+    snap->num_node_slots = ns;
+    snap->slot_node = (unsigned int *)tr_snapshot_array(arena, ns, sizeof(unsigned int));
+    snap->node_handles = (tr_node *)tr_snapshot_array(arena, nn, sizeof(tr_node));
+    snap->iface_handles = (tr_iface *)tr_snapshot_array(arena, ni, sizeof(tr_iface));
+    snap->link_handles = (tr_link *)tr_snapshot_array(arena, nl, sizeof(tr_link));
+
+    if (!snap->nodes || !snap->node_ifaces || !snap->ifaces ||
+        !snap->iface_node || !snap->iface_links || !snap->adj_link ||
+        !snap->adj_peer || !snap->links || !snap->link_ends ||
+        !snap->latency || !snap->variance || !snap->droprate || !snap->enabled ||
+        !snap->slot_node || !snap->node_handles || !snap->iface_handles ||
+        !snap->link_handles) {
+        tr_arena_delete(arena);
+        return NULL;
+    }
+
+    // Number the nodes
+    unsigned int count = 0;
+    tr_hash_foreach(it, net->nodes) {
+        snap->nodes[count++] = *(node **)it.value;
+    }
+
+    qsort(snap->nodes, nn, sizeof(node *), tr_snapshot_cmp_nodes);
+
+    memset(snap->slot_node, 0xff, ns * sizeof(unsigned int));
+
+    // Number the interfaces, each node's in a contiguous run
+    unsigned int next = 0;
+    for (unsigned int n = 0; n < nn; ++n) {
+        node *nd = snap->nodes[n];
+        nd->index = n;
+        snap->node_ifaces[n] = next;
+        snap->node_handles[n] = tr_node_handle(nd);
+        snap->slot_node[tr_slotmap_index(nd)] = n;
+
+        unsigned int first = next;
+        tr_hash_foreach(it, nd->ifaces) {
+            snap->ifaces[next++] = *(iface **)it.value;
+        }
+
+        qsort(snap->ifaces + first, next - first, sizeof(iface *),
+              tr_snapshot_cmp_ifaces);
+
+        for (unsigned int i = first; i < next; ++i) {
+            snap->ifaces[i]->index = i;
+            snap->iface_node[i] = n;
+            snap->iface_handles[i] = tr_iface_handle(snap->ifaces[i]);
+        }
+    }
+
+    snap->node_ifaces[nn] = next;
+
+    // Number the links in the order their first ends list them, and lay
+    // out each interface's adjacency
+    unsigned int numbered = 0, adj = 0;
+    for (unsigned int i = 0; i < ni; ++i) {
+        iface *f = snap->ifaces[i];
+        snap->iface_links[i] = adj;
+        adj += f->numlinks;
+
+        for (unsigned int k = 0; k < f->numlinks; ++k) {
+            link *l = f->links[k];
+            if (l->ends[0] != f) {
+                continue;
+            }
+
+            l->index = numbered++;
+            snap->links[l->index] = l;
+            snap->link_handles[l->index] = tr_link_handle(l);
+            snap->latency[l->index] = l->attrs.latency;
+            snap->variance[l->index] = l->attrs.variance;
+            snap->droprate[l->index] = l->attrs.droprate;
+            snap->enabled[l->index] = l->attrs.enabled;
+        }
+    }
+
+    snap->iface_links[ni] = adj;
+
+    for (unsigned int i = 0; i < ni; ++i) {
+        iface *f = snap->ifaces[i];
+        unsigned int first = snap->iface_links[i];
+
+        for (unsigned int k = 0; k < f->numlinks; ++k) {
+            link *l = f->links[k];
+            snap->adj_link[first + k] = l->index;
+            snap->adj_peer[first + k] = l->ends[l->ends[0] == f ? 1 : 0]->index;
+        }
+    }
+
+    for (unsigned int k = 0; k < nl; ++k) {
+        link *l = snap->links[k];
+        snap->link_ends[2 * k] = l->ends[0]->index;
+        snap->link_ends[2 * k + 1] = l->ends[1]->index;
+    }
+
+    return snap;
+}
+
+snapshot *tr_snapshot_create(network *net)
+{
+    if (!net) return NULL;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    snapshot *snap = tr_snapshot_build(net);
+    tr_mem_set_tag(tag);
+
+    return snap;
+}
+
+unsigned int tr_snapshot_node(const snapshot *snap, tr_node handle)
+{
+    // A stale handle's slot may hold some other node by now
+    unsigned int slot = tr_handle_index(handle);
+    unsigned int n = slot < snap->num_node_slots ? snap->slot_node[slot] : TR_NO_NODE;
+
+    return n != TR_NO_NODE && snap->node_handles[n] == handle ? n : TR_NO_NODE;
+}
+
+void tr_snapshot_delete(snapshot *snap)
+{
+    if (snap) {
+        tr_arena_delete(snap->arena);
+    }
+}
+
+static void tr_snapshot_free(void *ptr)
+{
+    tr_snapshot_delete((snapshot *)ptr);
+}
+
+void tr_snapshot_retire(snapshot *snap)
+{
+    tr_epoch_retire(snap, tr_snapshot_free);
+}
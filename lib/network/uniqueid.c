@@ -6,19 +6,167 @@
 // network/unique.id - Unique ID bookkeeping
 //
 
+#include <string.h> // for memcpy, strlen
+
+#include "memory.h"
 #include "network.h"
 
-bool tr_net_id_taken(network *net, const char *id)
+tr_atom tr_net_intern(network *net, const char *id)
+{
+    return tr_intern_atom(net->ids, id);
+}
+
+tr_atom tr_net_intern_n(network *net, const char *id, unsigned int len)
+{
+    return tr_intern_atom_n(net->ids, id, len);
+}
+
+tr_atom tr_net_find_id(network *net, const char *id)
+{
+    return tr_intern_find(net->ids, id);
+}
+
+const char *tr_net_id_str(network *net, tr_atom id)
+{
+    return tr_intern_str(net->ids, id);
+}
+
+bool tr_net_id_taken(network *net, tr_atom id)
+{
+    return tr_intset_contains(net->entityids, id);
+}
+
+tr_err tr_net_take_id(network *net, tr_atom id)
 {
-    return tr_strset_contains(net->entityids, id);
+    return tr_intset_add(net->entityids, id);
 }
 
-tr_err tr_net_take_id(network *net, const char *id)
+tr_err tr_net_release_id(network *net, tr_atom id)
 {
-    return tr_strset_add(net->entityids, id);
+    return tr_intset_remove(net->entityids, id);
 }
 
-tr_err tr_net_release_id(network *net, const char *id)
+// Batches intern their IDs this many ahead of where they prefetch them.
+// Lookups in a big intern table mostly miss the cache, so this keeps a few
+// misses in flight at once instead of waiting on them one at a time.
+//
+static const unsigned int PREFETCH_AHEAD = 8;
+
+tr_err tr_net_intern_all(network *net, const char *const *names,
+                         unsigned int count, tr_atom *ids)
 {
-    return tr_strset_remove(net->entityids, id);
+    for (unsigned int i = 0; i < count; ++i) {
+        if (!names[i]) {
+            return TR_EPOINTER;
+        }
+    }
+
+    for (unsigned int i = 0; i < count && i < PREFETCH_AHEAD; ++i) {
+        tr_intern_prefetch_n(net->ids, names[i], strlen(names[i]));
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int ahead = i + PREFETCH_AHEAD;
+        if (ahead < count) {
+            tr_intern_prefetch_n(net->ids, names[ahead], strlen(names[ahead]));
+        }
+
+        ids[i] = tr_intern_atom(net->ids, names[i]);
+    }
+
+    return TR_OK;
+}
+
+// Writes the name of the i'th entity in a tr_net_intern_seq batch into
+// name, and returns its length
+//
+static unsigned int tr_net_seq_name(char *name, const char *const *prefixes,
+                                    const char *suffix, unsigned int suffixlen,
+                                    unsigned int first, unsigned int count,
+                                    unsigned int i)
+{
+    const char *prefix = prefixes[i / count];
+    unsigned int len = strlen(prefix);
+
+    memcpy(name, prefix, len);
+    memcpy(name + len, suffix, suffixlen);
+    len += suffixlen;
+
+    char digits[10];
+    unsigned int value = first + i % count, numdigits = 0;
+
+    do {
+        digits[numdigits++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    for (unsigned int d = 0; d < numdigits; ++d) {
+        name[len + d] = digits[numdigits - 1 - d];
+    }
+
+    return len + numdigits;
+}
+
+tr_err tr_net_intern_seq(network *net, const char *const *prefixes,
+                         unsigned int numprefixes, const char *suffix,
+                         unsigned int first, unsigned int count, tr_atom *ids)
+{
+    if (count && count - 1 > ~0u - first) {
+        return TR_EOUTOFRANGE;
+    }
+
+    unsigned int longest = 0, suffixlen = strlen(suffix);
+    for (unsigned int p = 0; p < numprefixes; ++p) {
+        unsigned int len = strlen(prefixes[p]);
+        longest = len > longest ? len : longest;
+    }
+
+    // One buffer for the name being interned, one for the name being
+    // prefetched
+    unsigned int size = longest + suffixlen + 10;
+    char *name = (char *)tr_malloc(2 * size);
+    if (!name) {
+        return TR_ENOMEM;
+    }
+
+    char *ahead = name + size;
+    unsigned int total = numprefixes * count;
+
+    for (unsigned int i = 0; i < total && i < PREFETCH_AHEAD; ++i) {
+        unsigned int len = tr_net_seq_name(ahead, prefixes, suffix, suffixlen, first, count, i);
+        tr_intern_prefetch_n(net->ids, ahead, len);
+    }
+
+    for (unsigned int i = 0; i < total; ++i) {
+        if (i + PREFETCH_AHEAD < total) {
+            unsigned int len = tr_net_seq_name(ahead, prefixes, suffix, suffixlen,
+                                               first, count, i + PREFETCH_AHEAD);
+            tr_intern_prefetch_n(net->ids, ahead, len);
+        }
+
+        unsigned int len = tr_net_seq_name(name, prefixes, suffix, suffixlen, first, count, i);
+        ids[i] = tr_intern_atom_n(net->ids, name, len);
+    }
+
+    tr_free(name);
+    return TR_OK;
+}
+
+tr_err tr_net_take_ids(network *net, const tr_atom *ids, unsigned int count)
+{
+    // Taking each ID as it's checked catches repeats within the batch too
+    for (unsigned int i = 0; i < count; ++i) {
+        tr_err err = tr_net_id_taken(net, ids[i])
+                   ? TR_ENAMETAKEN : tr_net_take_id(net, ids[i]);
+
+        if (err < 0) {
+            while (i--) {
+                tr_net_release_id(net, ids[i]);
+            }
+
+            return err;
+        }
+    }
+
+    return TR_OK;
 }
@@ -12,16 +12,56 @@
 #include <traffic.h>
 
 #include "hash.h"
+#include "intern.h"
 
 struct _network;
+struct _iface;
 
 struct _node
 {
     const char *name;       // This node's unique ID
+    tr_atom id;             // Atom for this node's unique ID
     struct _network *net;   // The network that contains this node
-    tr_hash ifaces;         // This node's virtual network interfaces
+    tr_hash ifaces;         // Map from iface ID atom to iface ptr
+    unsigned int index;     // Index in the network's snapshot, while bound
 };
 
 typedef struct _node node;
 
+// Resolves a public node handle. Returns NULL if the handle is NULL or
+// stale (its node, or the node's network, has been deleted).
+//
+node *tr_node_get(tr_node handle);
+
+// Gets the public handle for a node
+//
+tr_node tr_node_handle(node *n);
+
+// Does the work of tr_node_create_many and tr_node_create_seq, once the new
+// nodes' IDs have been interned: creates count nodes with the given IDs,
+// all or nothing, filling nodes if it isn't NULL. Allocations count as
+// whatever the caller has tagged them as.
+//
+tr_err tr_node_make_many(struct _network *net, const tr_atom *ids,
+                         unsigned int count, tr_node *nodes);
+
+// Takes a node out of its network and frees it, with its interfaces and
+// their links, without checking whether the network is bound
+//
+tr_err tr_node_remove(struct _network *net, node *n);
+
+// Frees the heap resources a node holds outside its network's arena,
+// without unlinking it from the network or deleting its interfaces.
+// Used when tearing down a whole network at once.
+//
+void tr_node_release(node *n);
+
+// Adds an interface to the node
+//
+tr_err tr_node_add_iface(node *n, struct _iface *iface);
+
+// Removes an interface from the node
+//
+tr_err tr_node_remove_iface(node *n, struct _iface *iface);
+
 #endif
@@ -7,48 +7,198 @@
 //
 
 #include <stdlib.h> // for NULL
-#include <string.h> // for strlen, strcpy
 
 #include "iface.h"
 #include "memory.h"
 #include "network.h"
 #include "node.h"
 
-tr_node tr_node_create(tr_network net, const char *name)
+// Does the work of tr_node_create, whose allocations count as topology
+//
+static node *tr_node_make(network *net, const char *name)
 {
-    if (!net) return NULL;
-    if (!name) return NULL;
+    tr_atom id = tr_net_intern(net, name);
 
-    if (tr_net_id_taken(net, name)) {
+    if (tr_net_id_taken(net, id)) {
         return NULL;
     }
 
-    node *n = (node *)tr_malloc(sizeof(node));
-    n->net = net;
-    n->ifaces = tr_strhash_create(sizeof(iface));
+    node *n = (node *)tr_slotmap_alloc(net->nodeslots);
+    if (!n) {
+        return NULL;
+    }
 
-    n->name = tr_malloc(strlen(name) + 1);
-    strcpy((char*)n->name, name);
+    n->id = id;
+    n->name = tr_net_id_str(net, id);
+    n->net = net;
+    n->ifaces = tr_inthash_create(sizeof(iface *));
 
     if (tr_net_add_node(net, n) < 0) {
+        tr_inthash_delete(n->ifaces);
+        tr_slotmap_free(net->nodeslots, n);
         return NULL;
     }
 
     return n;
 }
 
+tr_node tr_node_create(tr_network trn, const char *name)
+{
+    if (!trn) return NULL;
+    if (!name) return NULL;
+    if (((network *)trn)->frozen) return NULL;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    node *n = tr_node_make((network *)trn, name);
+    tr_mem_set_tag(tag);
+
+    return tr_node_handle(n);
+}
+
+tr_err tr_node_make_many(network *net, const tr_atom *ids,
+                                unsigned int count, tr_node *nodes)
+{
+    tr_err err = tr_net_take_ids(net, ids, count);
+    if (err < 0) {
+        return err;
+    }
+
+    tr_hash_reserve(net->nodes, tr_inthash_num_keys(net->nodes) + count);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        node *n = (node *)tr_slotmap_alloc(net->nodeslots);
+        if (!n) {
+            // Undo the nodes this batch made, and release the rest's IDs
+            while (i--) {
+                node **made = (node **)tr_inthash_get(net->nodes, ids[i]);
+                tr_net_remove_node(net, *made);
+                tr_node_release(*made);
+                tr_slotmap_free(net->nodeslots, *made);
+            }
+
+            for (unsigned int k = 0; k < count; ++k) {
+                tr_net_release_id(net, ids[k]);
+            }
+
+            return TR_ENOMEM;
+        }
+
+        n->id = ids[i];
+        n->name = tr_net_id_str(net, ids[i]);
+        n->net = net;
+        n->ifaces = tr_inthash_create(sizeof(iface *));
+
+        // The IDs were all taken above, so this skips tr_net_add_node
+        tr_inthash_set(net->nodes, n->id, &n);
+
+        if (nodes) {
+            nodes[i] = tr_node_handle(n);
+        }
+    }
+
+    return TR_OK;
+}
+
+// Interns a batch of node IDs, from names if it isn't NULL and otherwise
+// as a sequence, and then creates the nodes
+//
+static tr_err tr_node_create_batch(network *net, const char *const *names,
+                                   const char *prefix, unsigned int first,
+                                   unsigned int count, tr_node *nodes)
+{
+    tr_atom *ids = (tr_atom *)tr_malloc(count * sizeof(tr_atom));
+    if (!ids) {
+        return TR_ENOMEM;
+    }
+
+    tr_err err = names ? tr_net_intern_all(net, names, count, ids)
+                       : tr_net_intern_seq(net, &prefix, 1, "", first, count, ids);
+
+    if (err >= 0) {
+        err = tr_node_make_many(net, ids, count, nodes);
+    }
+
+    tr_free(ids);
+    return err;
+}
+
+tr_err tr_node_create_many(tr_network trn, const char *const *names,
+                           unsigned count, tr_node *nodes)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!names) return TR_EPOINTER;
+    if (((network *)trn)->frozen) return TR_ENETBOUND;
+    if (!count) return TR_OK;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    tr_err err = tr_node_create_batch((network *)trn, names, NULL, 0, count, nodes);
+    tr_mem_set_tag(tag);
+
+    return err;
+}
+
+tr_err tr_node_create_seq(tr_network trn, const char *prefix, unsigned first,
+                          unsigned count, tr_node *nodes)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!prefix) return TR_EPOINTER;
+    if (((network *)trn)->frozen) return TR_ENETBOUND;
+    if (!count) return TR_OK;
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    tr_err err = tr_node_create_batch((network *)trn, NULL, prefix, first, count, nodes);
+    tr_mem_set_tag(tag);
+
+    return err;
+}
+
 tr_err tr_node_delete(tr_node trn)
 {
     if (!trn) return TR_EPOINTER;
 
-    node *n = (node *)trn;
+    node *n = tr_node_get(trn);
+    if (!n) return TR_ESTALE;
+
+    if (n->net->frozen) {
+        return TR_ENETBOUND;
+    }
+
+    return tr_node_remove(n->net, n);
+}
+
+tr_err tr_node_remove(network *net, node *n)
+{
+    // Removing an interface modifies the map under the cursor, so each
+    // removal starts a fresh walk
+    tr_hash_iter it;
+    tr_hash_iter_init(n->ifaces, &it);
+
+    while (tr_hash_iter_next(&it)) {
+        tr_err err = tr_iface_remove(net, *(iface **)it.value);
+        if (err < 0) {
+            return err;
+        }
 
-    tr_err err = tr_net_remove_node(n->net, n);
+        tr_hash_iter_init(n->ifaces, &it);
+    }
+
+    tr_err err = tr_net_remove_node(net, n);
     if (err < 0) {
         return err;
     }
 
-    tr_free((void*)n->name);
-    tr_strhash_delete(n->ifaces);
+    tr_node_release(n);
+    tr_slotmap_free(net->nodeslots, n);
     return TR_OK;
 }
+
+void tr_node_release(node *n)
+{
+    tr_hash_iter it;
+    tr_hash_foreach(it, n->ifaces) {
+        tr_iface_release(*(iface **)it.value);
+    }
+
+    tr_inthash_delete(n->ifaces);
+    n->ifaces = NULL;
+}
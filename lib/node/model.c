@@ -7,33 +7,47 @@
 //
 
 #include <stdlib.h> // for NULL
-#include <string.h> // for memcpy
 
 #include "iface.h"
+#include "network.h"
 #include "node.h"
 
+node *tr_node_get(tr_node trn)
+{
+    network *net = tr_handle_network(trn);
+    if (!net) return NULL;
+
+    return (node *)tr_slotmap_get(net->nodeslots, tr_handle_index(trn),
+                                  tr_handle_gen(trn));
+}
+
+tr_node tr_node_handle(node *n)
+{
+    return n ? tr_handle_make(n->net->slot, n) : NULL;
+}
+
 const char *tr_node_name(tr_node trn)
 {
-    if (!trn) return NULL;
+    node *n = tr_node_get(trn);
+    if (!n) return NULL;
 
-    node *n = (node *)trn;
     return n->name;
 }
 
 tr_network tr_node_network(tr_node trn)
 {
-    if (!trn) return NULL;
+    node *n = tr_node_get(trn);
+    if (!n) return NULL;
 
-    node *n = (node *)trn;
     return n->net;
 }
 
 unsigned tr_node_num_ifaces(tr_node trn)
 {
-    if (!trn) return 0;
+    node *n = tr_node_get(trn);
+    if (!n) return 0;
 
-    node *n = (node *)trn;
-    return tr_strhash_num_keys(n->ifaces);
+    return tr_inthash_num_keys(n->ifaces);
 }
 
 tr_err tr_node_ifaces(tr_node trn, tr_iface *ifaces, unsigned len)
@@ -41,36 +55,78 @@ tr_err tr_node_ifaces(tr_node trn, tr_iface *ifaces, unsigned len)
     if (!trn) return TR_EPOINTER;
     if (!ifaces) return TR_EPOINTER;
 
-    node *n = (node *)trn;
-    tr_vector vec = tr_strhash_values(n->ifaces);
+    node *n = tr_node_get(trn);
+    if (!n) return TR_ESTALE;
 
-    if (len < tr_vec_count(vec)) {
+    if (len < tr_inthash_num_keys(n->ifaces)) {
         return TR_EARRAYLEN;
     }
-    else if (len > tr_vec_count(vec)) {
-        len = tr_vec_count(vec);
-    }
 
-    memcpy(ifaces, tr_vec_items(vec), len * sizeof(iface));
+    unsigned int count = 0;
+    tr_hash_iter it;
+
+    tr_hash_foreach(it, n->ifaces) {
+        ifaces[count++] = tr_iface_handle(*(iface **)it.value);
+    }
 
-    tr_vec_delete(vec);
     return TR_OK;
 }
 
 bool tr_node_has_iface(tr_node trn, const char *name)
 {
-    if (!trn) return false;
-    if (!name) return false;
-
-    node *n = (node *)trn;
-    return tr_strhash_contains(n->ifaces, name);
+    return tr_node_iface(trn, name) != NULL;
 }
 
 tr_iface tr_node_iface(tr_node trn, const char *name)
 {
-    if (!trn) return false;
-    if (!name) return false;
+    if (!name) return NULL;
+
+    node *n = tr_node_get(trn);
+    if (!n) return NULL;
+
+    tr_atom id = tr_net_find_id(n->net, name);
+    if (id == TR_NO_ATOM) {
+        return NULL;
+    }
+
+    iface **i = (iface **)tr_inthash_get(n->ifaces, id);
+    return i ? tr_iface_handle(*i) : NULL;
+}
+
+tr_err tr_node_add_iface(node *n, struct _iface *iface)
+{
+    if (!n) return TR_EPOINTER;
+    if (!iface) return TR_EPOINTER;
+
+    if (tr_net_id_taken(n->net, iface->id)) {
+        return TR_ENAMETAKEN;
+    }
+
+    tr_err err = tr_net_take_id(n->net, iface->id);
+    if (err < 0) {
+        return err;
+    }
+
+    return tr_inthash_set(n->ifaces, iface->id, &iface);
+}
+
+tr_err tr_node_remove_iface(node *n, struct _iface *iface)
+{
+    if (!n) return TR_EPOINTER;
+    if (!iface) return TR_EPOINTER;
+
+    tr_err err = tr_net_release_id(n->net, iface->id);
+    if (err < 0) {
+        return err;
+    }
+
+    return tr_inthash_clear(n->ifaces, iface->id);
+}
+
+bool tr_node_is_bound(tr_node trn)
+{
+    node *n = tr_node_get(trn);
+    if (!n) return false;
 
-    node *n = (node *)trn;
-    return tr_strhash_get(n->ifaces, name);
+    return n->net->frozen != NULL;
 }
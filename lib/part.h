@@ -0,0 +1,137 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part.h - Declarations for partitioning networks across threads
+//
+
+#ifndef PART_H
+#define PART_H
+
+#include <traffic.h>
+
+#include "snapshot.h"
+
+// Networks are split into parts, one per forwarding thread, by multilevel
+// partitioning. The node graph is coarsened by repeatedly merging pairs of
+// nodes joined by heavy links, until it's small. The small graph is split
+// in half, and the halves in half again, each time by growing one half out
+// from the edge of the graph. Then the split is carried back up through
+// the levels, refined at each one by moving nodes on part boundaries to
+// whichever neighboring part cuts the least traffic, within the balance
+// allowed.
+//
+// Nodes all weigh the same, so balanced parts have the same number of
+// nodes. Links weigh their expected traffic (see tr_link_set_traffic).
+//
+
+// A weighted graph at one level of coarsening, in CSR form
+//
+struct _partgraph
+{
+    unsigned int numnodes;
+    unsigned int *adj;              // CSR offsets of each node's edges (+1 end)
+    unsigned int *nbr;              // Node at the far end of each edge
+    unsigned long long *ewt;        // Weight of each edge
+    unsigned int *nwt;              // Weight of each node
+    unsigned int *cmap;             // Node each one merges into at the next
+                                    // level, or NULL at the coarsest
+    struct _partgraph *coarser;     // The next level, or NULL
+};
+
+typedef struct _partgraph partgraph;
+
+// Builds the finest graph from a snapshot: a node per node, and an edge
+// each way per link, weighted by traffic. Links between a node and itself
+// are left out. Returns NULL if memory runs out.
+//
+partgraph *tr_part_graph_create(snapshot *snap);
+
+// Frees a graph, and all coarser levels
+//
+void tr_part_graph_delete(partgraph *g);
+
+// Builds coarser levels under g until there are about minnodes nodes, or
+// coarsening stops making progress. Returns the coarsest level (g itself if
+// it's small enough already), or NULL if memory runs out.
+//
+partgraph *tr_part_coarsen(partgraph *g, unsigned int minnodes,
+                           unsigned long long seed);
+
+// Splits a graph into parts of about the same weight, giving each node's
+// part in part. Every part gets at least one node.
+//
+tr_err tr_part_initial(partgraph *g, unsigned int parts, unsigned int *part);
+
+// Improves the split of a graph into parts, keeping parts no heavier than
+// maxwt where it can
+//
+tr_err tr_part_refine(partgraph *g, unsigned int parts, unsigned int maxwt,
+                      unsigned int *part);
+
+// Carries a split of a graph's coarser level back to the graph
+//
+void tr_part_project(partgraph *g, const unsigned int *coarse,
+                     unsigned int *part);
+
+// The placement of a bound network's nodes into parts
+//
+struct _placement
+{
+    const snapshot *snap;       // The snapshot the nodes were placed from
+    unsigned int parts;         // Number of parts
+    unsigned int *part;         // Part of each node, by snapshot index
+    float imbalance;            // How much bigger than average parts may be
+    tr_partinfo info;           // How good the split is
+};
+
+typedef struct _placement placement;
+
+// Splits the snapshot's nodes into the given number of parts, each no more
+// than (1 + imbalance) times the average size where possible. Returns NULL
+// if memory runs out.
+//
+placement *tr_part_place(snapshot *snap, unsigned int parts, float imbalance);
+
+// Marks a node that hasn't been placed, for tr_part_carry
+//
+#define TR_NO_PART 0xffffffffu
+
+// Carries a placement over to a new snapshot of the same network, taken
+// after its topology changed, so nodes stay on the threads they were on.
+// prev gives the part of each node in snap, or TR_NO_PART for nodes that
+// are new. New nodes join the part they share the most traffic with that
+// has room under the placement's imbalance allowance, or the smallest part
+// if none does. Returns NULL if memory runs out.
+//
+placement *tr_part_carry(snapshot *snap, const placement *old,
+                         const unsigned int *prev);
+
+// Frees a placement
+//
+void tr_part_delete(placement *p);
+
+// Frees a placement once no reader can still be looking at it (see epoch.h)
+//
+void tr_part_retire(placement *p);
+
+// Gets the number of cores online, which is the number of parts networks
+// are placed in by default
+//
+unsigned int tr_part_cores();
+
+// How much heavier than average parts may be when the network is placed
+// on threads by tr_net_start
+//
+#define TR_PART_IMBALANCE 0.03f
+
+// Binds the network if it isn't already, and places its nodes into the
+// given number of parts (0 for one per core) in net->placement
+//
+struct _network;
+
+tr_err tr_part_network(struct _network *net, unsigned int parts,
+                       float imbalance);
+
+#endif
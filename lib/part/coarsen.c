@@ -0,0 +1,316 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part/coarsen.c - Partitioning graphs, and coarsening them
+//
+
+#include <stdlib.h> // for NULL
+
+#include "link.h"
+#include "memory.h"
+#include "part.h"
+
+// Marks a node that hasn't been matched yet
+//
+#define UNMATCHED 0xffffffffu
+
+// Coarsening stops when a level has more than this fraction of the nodes
+// of the one before it (in 1024ths)
+//
+#define MIN_SHRINK 922
+
+// Allocates a graph with room for the given numbers of nodes and edges
+//
+static partgraph *tr_part_graph_alloc(unsigned int numnodes,
+                                      unsigned int numedges)
+{
+    partgraph *g = (partgraph *)tr_calloc(1, sizeof(partgraph));
+    if (!g) {
+        return NULL;
+    }
+
+    g->numnodes = numnodes;
+    g->adj = (unsigned int *)tr_malloc((numnodes + 1) * sizeof(unsigned int));
+    g->nbr = (unsigned int *)tr_malloc((numedges ? numedges : 1) * sizeof(unsigned int));
+    g->ewt = (unsigned long long *)tr_malloc((numedges ? numedges : 1) * sizeof(unsigned long long));
+    g->nwt = (unsigned int *)tr_malloc((numnodes ? numnodes : 1) * sizeof(unsigned int));
+
+    if (!g->adj || !g->nbr || !g->ewt || !g->nwt) {
+        tr_part_graph_delete(g);
+        return NULL;
+    }
+
+    return g;
+}
+
+void tr_part_graph_delete(partgraph *g)
+{
+    while (g) {
+        partgraph *coarser = g->coarser;
+
+        tr_free(g->adj);
+        tr_free(g->nbr);
+        tr_free(g->ewt);
+        tr_free(g->nwt);
+        tr_free(g->cmap);
+        tr_free(g);
+
+        g = coarser;
+    }
+}
+
+partgraph *tr_part_graph_create(snapshot *snap)
+{
+    unsigned int nn = snap->num_nodes;
+    unsigned int numedges = 0;
+
+    // Links from a node to itself have no bearing on where it goes
+    for (unsigned int k = 0; k < snap->num_links; ++k) {
+        if (snap->iface_node[snap->link_ends[2 * k]] !=
+            snap->iface_node[snap->link_ends[2 * k + 1]]) {
+            numedges += 2;
+        }
+    }
+
+    partgraph *g = tr_part_graph_alloc(nn, numedges);
+    if (!g) {
+        return NULL;
+    }
+
+    unsigned int e = 0;
+    for (unsigned int n = 0; n < nn; ++n) {
+        g->adj[n] = e;
+        g->nwt[n] = 1;
+
+        unsigned int first = snap->iface_links[snap->node_ifaces[n]];
+        unsigned int last = snap->iface_links[snap->node_ifaces[n + 1]];
+
+        for (unsigned int k = first; k < last; ++k) {
+            unsigned int u = snap->iface_node[snap->adj_peer[k]];
+
+            if (u != n) {
+                g->nbr[e] = u;
+                g->ewt[e++] = snap->links[snap->adj_link[k]]->traffic;
+            }
+        }
+    }
+
+    g->adj[nn] = e;
+    return g;
+}
+
+// Gets a pseudo-random number from a xorshift generator
+//
+static unsigned long long tr_part_random(unsigned long long *state)
+{
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Pairs up nodes to merge into the next level, into match. Nodes are
+// visited in random order, each paired with the neighbor it has the
+// heaviest link to, so those links are hidden inside merged nodes and can
+// never be cut. Merged nodes can be no heavier than maxwt.
+//
+// Nodes left over are mostly the leaves of hubs whose other neighbors got
+// to them first, so leftover neighbors of the same node are paired with
+// each other too.
+//
+static void tr_part_match(partgraph *g, unsigned int maxwt,
+                          unsigned long long *seed, unsigned int *order,
+                          unsigned int *match)
+{
+    unsigned int nn = g->numnodes;
+
+    for (unsigned int v = 0; v < nn; ++v) {
+        order[v] = v;
+        match[v] = UNMATCHED;
+    }
+
+    for (unsigned int v = nn; v > 1; --v) {
+        unsigned int j = tr_part_random(seed) % v;
+        unsigned int t = order[v - 1];
+        order[v - 1] = order[j];
+        order[j] = t;
+    }
+
+    for (unsigned int i = 0; i < nn; ++i) {
+        unsigned int v = order[i];
+        if (match[v] != UNMATCHED) {
+            continue;
+        }
+
+        unsigned int best = UNMATCHED;
+        unsigned long long bestwt = 0;
+
+        for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+            unsigned int u = g->nbr[e];
+
+            if (match[u] == UNMATCHED && g->nwt[v] + g->nwt[u] <= maxwt &&
+                (best == UNMATCHED || g->ewt[e] > bestwt)) {
+                best = u;
+                bestwt = g->ewt[e];
+            }
+        }
+
+        if (best != UNMATCHED) {
+            match[v] = best;
+            match[best] = v;
+        }
+    }
+
+    for (unsigned int h = 0; h < nn; ++h) {
+        unsigned int pending = UNMATCHED;
+
+        for (unsigned int e = g->adj[h]; e < g->adj[h + 1]; ++e) {
+            unsigned int u = g->nbr[e];
+            if (match[u] != UNMATCHED) {
+                continue;
+            }
+
+            if (pending == UNMATCHED) {
+                pending = u;
+            }
+            else if (pending != u && g->nwt[pending] + g->nwt[u] <= maxwt) {
+                match[pending] = u;
+                match[u] = pending;
+                pending = UNMATCHED;
+            }
+        }
+    }
+
+    for (unsigned int v = 0; v < nn; ++v) {
+        if (match[v] == UNMATCHED) {
+            match[v] = v;
+        }
+    }
+}
+
+// Merges the matched pairs of g's nodes into a new, coarser level.
+// Parallel edges that merging makes are combined into one.
+//
+static partgraph *tr_part_contract(partgraph *g, const unsigned int *match,
+                                   unsigned int *where)
+{
+    unsigned int nn = g->numnodes, numcoarse = 0;
+
+    g->cmap = (unsigned int *)tr_malloc((nn ? nn : 1) * sizeof(unsigned int));
+    if (!g->cmap) {
+        return NULL;
+    }
+
+    for (unsigned int v = 0; v < nn; ++v) {
+        if (match[v] >= v) {
+            g->cmap[v] = numcoarse++;
+        }
+        else {
+            g->cmap[v] = g->cmap[match[v]];
+        }
+    }
+
+    // Merging never adds edges, so the finer level's count is enough room
+    partgraph *c = tr_part_graph_alloc(numcoarse, g->adj[nn]);
+    if (!c) {
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < numcoarse; ++i) {
+        where[i] = UNMATCHED;
+    }
+
+    unsigned int e = 0, next = 0;
+    for (unsigned int v = 0; v < nn; ++v) {
+        if (match[v] < v) {
+            continue;
+        }
+
+        unsigned int cv = next++;
+        unsigned int first = e;
+        unsigned int members[2] = { v, match[v] };
+        unsigned int count = match[v] == v ? 1 : 2;
+
+        c->adj[cv] = e;
+        c->nwt[cv] = 0;
+
+        for (unsigned int m = 0; m < count; ++m) {
+            unsigned int x = members[m];
+            c->nwt[cv] += g->nwt[x];
+
+            for (unsigned int f = g->adj[x]; f < g->adj[x + 1]; ++f) {
+                unsigned int cu = g->cmap[g->nbr[f]];
+                if (cu == cv) {
+                    continue;
+                }
+
+                if (where[cu] == UNMATCHED || where[cu] < first) {
+                    where[cu] = e;
+                    c->nbr[e] = cu;
+                    c->ewt[e++] = g->ewt[f];
+                }
+                else {
+                    c->ewt[where[cu]] += g->ewt[f];
+                }
+            }
+        }
+    }
+
+    c->adj[numcoarse] = e;
+    g->coarser = c;
+    return c;
+}
+
+partgraph *tr_part_coarsen(partgraph *g, unsigned int minnodes,
+                           unsigned long long seed)
+{
+    unsigned int nn = g->numnodes;
+    unsigned int *order = (unsigned int *)tr_malloc((nn ? nn : 1) * sizeof(unsigned int));
+    unsigned int *match = (unsigned int *)tr_malloc((nn ? nn : 1) * sizeof(unsigned int));
+    unsigned int *where = (unsigned int *)tr_malloc((nn ? nn : 1) * sizeof(unsigned int));
+
+    if (!order || !match || !where) {
+        g = NULL;
+    }
+
+    // Merged nodes are kept small enough that the coarsest level can still
+    // be split evenly
+    unsigned long long total = nn;
+    unsigned int maxwt = (unsigned int)(total * 3 / (2 * (minnodes ? minnodes : 1)));
+    if (maxwt < 2) {
+        maxwt = 2;
+    }
+
+    if (!seed) {
+        seed = 0x9e3779b97f4a7c15ull;
+    }
+
+    while (g && g->numnodes > minnodes) {
+        tr_part_match(g, maxwt, &seed, order, match);
+
+        partgraph *c = tr_part_contract(g, match, where);
+        bool stalled = c && (unsigned long long)c->numnodes * 1024 >
+                            (unsigned long long)g->numnodes * MIN_SHRINK;
+
+        g = c;
+        if (stalled) {
+            break;
+        }
+    }
+
+    tr_free(where);
+    tr_free(match);
+    tr_free(order);
+    return g;
+}
+
+void tr_part_project(partgraph *g, const unsigned int *coarse,
+                     unsigned int *part)
+{
+    for (unsigned int v = 0; v < g->numnodes; ++v) {
+        part[v] = coarse[g->cmap[v]];
+    }
+}
@@ -0,0 +1,103 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part/model.c - Thread placement of networks and their nodes
+//
+
+#include <stdlib.h> // for NULL
+
+#include "epoch.h"
+#include "memory.h"
+#include "network.h"
+#include "part.h"
+
+tr_err tr_part_network(network *net, unsigned int parts, float imbalance)
+{
+    tr_err err = tr_net_bind(net);
+    if (err < 0) {
+        return err;
+    }
+
+    unsigned int nn = net->frozen->num_nodes;
+
+    // By default, there's a part for each core
+    if (!parts) {
+        parts = tr_part_cores();
+    }
+
+    if (parts > nn) {
+        parts = nn ? nn : 1;
+    }
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_TOPOLOGY);
+    placement *p = tr_part_place(net->frozen, parts, imbalance);
+    tr_mem_set_tag(tag);
+
+    if (!p) {
+        return TR_ENOMEM;
+    }
+
+    placement *old = net->placement;
+    __atomic_store_n(&net->placement, p, __ATOMIC_RELEASE);
+    tr_part_retire(old);
+
+    return TR_OK;
+}
+
+tr_err tr_net_partition(tr_network trn, unsigned parts, float imbalance,
+                        tr_partinfo *info)
+{
+    if (!trn) return TR_EPOINTER;
+    if (parts < 1) return TR_EOUTOFRANGE;
+    if (!(imbalance >= 0)) return TR_EOUTOFRANGE;
+
+    network *net = (network *)trn;
+    if (net->frozen && parts > net->frozen->num_nodes) {
+        return TR_EOUTOFRANGE;
+    }
+
+    if (!net->frozen && parts > tr_net_num_nodes(trn)) {
+        return TR_EOUTOFRANGE;
+    }
+
+    tr_err err = tr_part_network(net, parts, imbalance);
+    if (err >= 0 && info) {
+        *info = net->placement->info;
+    }
+
+    return err;
+}
+
+tr_err tr_net_placement(tr_network trn, tr_partinfo *info)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!info) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    if (!net->placement) {
+        return TR_ENOTFOUND;
+    }
+
+    *info = net->placement->info;
+    return TR_OK;
+}
+
+int tr_node_part(tr_node trn)
+{
+    network *net = trn ? tr_handle_network(trn) : NULL;
+    if (!net) {
+        return -1;
+    }
+
+    // Forwarding threads ask while the network may be re-placed, so this
+    // reads nothing but the placement and its snapshot (see epoch.h)
+    tr_epoch epoch = tr_epoch_enter();
+    placement *p = __atomic_load_n(&net->placement, __ATOMIC_ACQUIRE);
+    unsigned int n = p ? tr_snapshot_node(p->snap, trn) : TR_NO_NODE;
+    int part = n != TR_NO_NODE ? (int)p->part[n] : -1;
+    tr_epoch_leave(epoch);
+
+    return part;
+}
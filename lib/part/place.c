@@ -0,0 +1,250 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part/place.c - Placing a network's nodes on forwarding threads
+//
+
+#define _POSIX_C_SOURCE 200112L // for sysconf
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset
+#include <unistd.h> // for sysconf
+
+#include "epoch.h"
+#include "memory.h"
+#include "part.h"
+
+// Coarsening stops at about this many nodes per part
+//
+#define COARSEST_PER_PART 16
+
+// Splits g into parts, from its coarsest level up
+//
+static tr_err tr_part_level(partgraph *g, unsigned int parts,
+                            unsigned int maxwt, unsigned int *part)
+{
+    if (!g->coarser) {
+        tr_err err = tr_part_initial(g, parts, part);
+        return err < 0 ? err : tr_part_refine(g, parts, maxwt, part);
+    }
+
+    unsigned int nc = g->coarser->numnodes;
+    unsigned int *coarse = (unsigned int *)tr_malloc((nc ? nc : 1) * sizeof(unsigned int));
+    if (!coarse) {
+        return TR_ENOMEM;
+    }
+
+    tr_err err = tr_part_level(g->coarser, parts, maxwt, coarse);
+    if (err >= 0) {
+        tr_part_project(g, coarse, part);
+        err = tr_part_refine(g, parts, maxwt, part);
+    }
+
+    tr_free(coarse);
+    return err;
+}
+
+// Works out how good a placement is, from the finest level of the graph
+// it was made from (which has every link twice, once from each end)
+//
+static void tr_part_measure(partgraph *g, placement *p)
+{
+    tr_partinfo *info = &p->info;
+    info->parts = p->parts;
+
+    for (unsigned int v = 0; v < g->numnodes; ++v) {
+        for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+            unsigned int u = g->nbr[e];
+            if (u < v) {
+                continue;
+            }
+
+            info->traffic += g->ewt[e];
+            if (p->part[u] != p->part[v]) {
+                info->cut += g->ewt[e];
+                ++info->cutlinks;
+            }
+        }
+    }
+
+    unsigned int *sizes = (unsigned int *)tr_calloc(p->parts, sizeof(unsigned int));
+    if (!sizes) {
+        return;
+    }
+
+    for (unsigned int v = 0; v < g->numnodes; ++v) {
+        ++sizes[p->part[v]];
+    }
+
+    info->largest = 0;
+    info->smallest = sizes[0];
+    for (unsigned int i = 0; i < p->parts; ++i) {
+        if (sizes[i] > info->largest) info->largest = sizes[i];
+        if (sizes[i] < info->smallest) info->smallest = sizes[i];
+    }
+
+    double average = (double)g->numnodes / p->parts;
+    info->imbalance = average > 0 ? info->largest / average - 1 : 0;
+
+    tr_free(sizes);
+}
+
+placement *tr_part_place(snapshot *snap, unsigned int parts, float imbalance)
+{
+    unsigned int nn = snap->num_nodes;
+    placement *p = (placement *)tr_calloc(1, sizeof(placement));
+    if (!p) {
+        return NULL;
+    }
+
+    p->snap = snap;
+    p->parts = parts;
+    p->imbalance = imbalance;
+    p->part = (unsigned int *)tr_calloc(nn ? nn : 1, sizeof(unsigned int));
+
+    partgraph *g = p->part ? tr_part_graph_create(snap) : NULL;
+    partgraph *coarsest = g ? tr_part_coarsen(g, parts * COARSEST_PER_PART, 1) : NULL;
+
+    // Parts may be a node heavier than the allowance, so there's always
+    // some way to split the nodes evenly enough
+    unsigned int average = (nn + parts - 1) / parts;
+    unsigned int maxwt = (unsigned int)(average * (1 + imbalance));
+    if (maxwt < average + 1) {
+        maxwt = average + 1;
+    }
+
+    tr_err err = TR_ENOMEM;
+    if (coarsest) {
+        err = parts > 1 ? tr_part_level(g, parts, maxwt, p->part) : TR_OK;
+    }
+
+    if (err >= 0) {
+        for (partgraph *level = g; level; level = level->coarser) {
+            ++p->info.levels;
+        }
+
+        tr_part_measure(g, p);
+    }
+
+    tr_part_graph_delete(g);
+
+    if (err < 0) {
+        tr_part_delete(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+placement *tr_part_carry(snapshot *snap, const placement *old,
+                         const unsigned int *prev)
+{
+    unsigned int nn = snap->num_nodes, parts = old->parts;
+    placement *p = (placement *)tr_calloc(1, sizeof(placement));
+    if (!p) {
+        return NULL;
+    }
+
+    p->snap = snap;
+    p->parts = parts;
+    p->imbalance = old->imbalance;
+    p->part = (unsigned int *)tr_malloc((nn ? nn : 1) * sizeof(unsigned int));
+    unsigned int *sizes = (unsigned int *)tr_calloc(parts, sizeof(unsigned int));
+    unsigned long long *conn = (unsigned long long *)tr_calloc(parts, sizeof(unsigned long long));
+    partgraph *g = p->part && sizes && conn ? tr_part_graph_create(snap) : NULL;
+
+    if (!g) {
+        tr_free(conn);
+        tr_free(sizes);
+        tr_part_delete(p);
+        return NULL;
+    }
+
+    for (unsigned int v = 0; v < nn; ++v) {
+        p->part[v] = prev[v];
+        if (prev[v] != TR_NO_PART) {
+            ++sizes[prev[v]];
+        }
+    }
+
+    // The same allowance the placement was made with, for the new size
+    unsigned int average = (nn + parts - 1) / parts;
+    unsigned int maxwt = (unsigned int)(average * (1 + p->imbalance));
+    if (maxwt < average + 1) {
+        maxwt = average + 1;
+    }
+
+    // New nodes go where most of their traffic goes, as far as that's
+    // known yet, so as little of it as possible crosses between threads;
+    // but not into a part that's already full
+    for (unsigned int v = 0; v < nn; ++v) {
+        if (p->part[v] != TR_NO_PART) {
+            continue;
+        }
+
+        for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+            unsigned int u = g->nbr[e];
+            if (p->part[u] != TR_NO_PART) {
+                conn[p->part[u]] += g->ewt[e];
+            }
+        }
+
+        unsigned int lightest = 0, best = TR_NO_PART;
+        for (unsigned int i = 0; i < parts; ++i) {
+            if (sizes[i] < sizes[lightest]) {
+                lightest = i;
+            }
+
+            if (!conn[i] || sizes[i] + 1 > maxwt) {
+                continue;
+            }
+
+            if (best == TR_NO_PART || conn[i] > conn[best] ||
+                (conn[i] == conn[best] && sizes[i] < sizes[best])) {
+                best = i;
+            }
+        }
+
+        if (best == TR_NO_PART) {
+            best = lightest;
+        }
+
+        p->part[v] = best;
+        ++sizes[best];
+        memset(conn, 0, parts * sizeof(unsigned long long));
+    }
+
+    p->info.levels = old->info.levels;
+    tr_part_measure(g, p);
+
+    tr_part_graph_delete(g);
+    tr_free(conn);
+    tr_free(sizes);
+    return p;
+}
+
+void tr_part_delete(placement *p)
+{
+    if (p) {
+        tr_free(p->part);
+        tr_free(p);
+    }
+}
+
+static void tr_part_free(void *ptr)
+{
+    tr_part_delete((placement *)ptr);
+}
+
+void tr_part_retire(placement *p)
+{
+    tr_epoch_retire(p, tr_part_free);
+}
+
+unsigned int tr_part_cores()
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (unsigned int)cpus;
+}
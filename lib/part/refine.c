@@ -0,0 +1,351 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part/refine.c - Splitting coarse graphs, and refining splits
+//
+
+#include <stdlib.h> // for NULL
+
+#include "memory.h"
+#include "part.h"
+
+// The most passes refinement makes over a level
+//
+#define MAX_PASSES 8
+
+// Scratch space for splitting a graph by recursive bisection
+//
+struct _partsplit
+{
+    partgraph *g;
+    unsigned int *part;
+    unsigned int *set;          // Stamp of the set each node is being split in
+    unsigned int *queue;        // Breadth-first search queue
+    unsigned int *frontier;     // Nodes next to the growing side
+    unsigned int *slot;         // Each node's place in frontier, or NOWHERE
+    long long *gain;            // How much less traffic is cut if each
+                                // frontier node joins the growing side
+    bool *grown;                // Whether each node is on the growing side
+    unsigned int stamp;
+};
+
+typedef struct _partsplit partsplit;
+
+// Marks a node that isn't in the frontier
+//
+#define NOWHERE 0xffffffffu
+
+// Finds a node near the edge of the set of nodes stamped like start, by
+// searching breadth-first from start and taking the last node it reaches
+//
+static unsigned int tr_part_peripheral(partsplit *s, unsigned int start)
+{
+    partgraph *g = s->g;
+    unsigned int stamp = s->set[start];
+    unsigned int head = 0, count = 0;
+
+    s->queue[count++] = start;
+    s->grown[start] = true;
+
+    while (head < count) {
+        unsigned int v = s->queue[head++];
+
+        for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+            unsigned int u = g->nbr[e];
+
+            if (s->set[u] == stamp && !s->grown[u]) {
+                s->grown[u] = true;
+                s->queue[count++] = u;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        s->grown[s->queue[i]] = false;
+    }
+
+    return s->queue[count - 1];
+}
+
+// Moves node v to the growing side, and updates the frontier to match
+//
+static void tr_part_grow(partsplit *s, unsigned int v, unsigned int *numfrontier)
+{
+    partgraph *g = s->g;
+    unsigned int stamp = s->set[v];
+
+    s->grown[v] = true;
+    if (s->slot[v] != NOWHERE) {
+        unsigned int last = s->frontier[--*numfrontier];
+        s->frontier[s->slot[v]] = last;
+        s->slot[last] = s->slot[v];
+        s->slot[v] = NOWHERE;
+    }
+
+    for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+        unsigned int u = g->nbr[e];
+        if (s->set[u] != stamp || s->grown[u]) {
+            continue;
+        }
+
+        if (s->slot[u] == NOWHERE) {
+            // Joining would cut all of u's links in the set but this one
+            long long gain = 0;
+            for (unsigned int f = g->adj[u]; f < g->adj[u + 1]; ++f) {
+                if (s->set[g->nbr[f]] == stamp) {
+                    gain -= (long long)g->ewt[f];
+                }
+            }
+
+            s->gain[u] = gain;
+            s->slot[u] = (*numfrontier)++;
+            s->frontier[s->slot[u]] = u;
+        }
+
+        s->gain[u] += 2 * (long long)g->ewt[e];
+    }
+}
+
+// Splits the count nodes in nodes into parts parts, numbered from first.
+// The nodes are halved by growing one side out from a node near their
+// edge, a neighbor at a time, always taking the neighbor that cuts the
+// least traffic, until it's heavy enough. Then each side is split again.
+//
+static void tr_part_bisect(partsplit *s, unsigned int *nodes,
+                           unsigned int count, unsigned int parts,
+                           unsigned int first)
+{
+    partgraph *g = s->g;
+
+    if (parts == 1) {
+        for (unsigned int i = 0; i < count; ++i) {
+            s->part[nodes[i]] = first;
+        }
+        return;
+    }
+
+    unsigned int stamp = ++s->stamp;
+    unsigned long long total = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        s->set[nodes[i]] = stamp;
+        total += g->nwt[nodes[i]];
+    }
+
+    // Grow the first half, making sure both halves have at least a node
+    // for each of their parts
+    unsigned int lower = parts / 2;
+    unsigned long long target = total * lower / parts;
+    unsigned long long weight = 0;
+    unsigned int numgrown = 0, numfrontier = 0, next = 0;
+
+    while (numgrown < count - (parts - lower) &&
+           (weight < target || numgrown < lower)) {
+        unsigned int v = NOWHERE;
+
+        if (numfrontier) {
+            v = s->frontier[0];
+            for (unsigned int i = 1; i < numfrontier; ++i) {
+                if (s->gain[s->frontier[i]] > s->gain[v]) {
+                    v = s->frontier[i];
+                }
+            }
+        }
+        else {
+            // Start on the next piece of the set that isn't connected to
+            // what's grown so far
+            while (s->grown[nodes[next]]) {
+                ++next;
+            }
+            v = tr_part_peripheral(s, nodes[next]);
+        }
+
+        tr_part_grow(s, v, &numfrontier);
+        weight += g->nwt[v];
+        ++numgrown;
+    }
+
+    while (numfrontier) {
+        s->slot[s->frontier[--numfrontier]] = NOWHERE;
+    }
+
+    // Sort the grown nodes to the front, and split each half
+    unsigned int a = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int v = nodes[i];
+        if (s->grown[v]) {
+            nodes[i] = nodes[a];
+            nodes[a++] = v;
+            s->grown[v] = false;
+        }
+    }
+
+    tr_part_bisect(s, nodes, a, lower, first);
+    tr_part_bisect(s, nodes + a, count - a, parts - lower, first + lower);
+}
+
+tr_err tr_part_initial(partgraph *g, unsigned int parts, unsigned int *part)
+{
+    unsigned int nn = g->numnodes, room = nn ? nn : 1;
+    partsplit s;
+
+    s.g = g;
+    s.part = part;
+    s.stamp = 0;
+    s.set = (unsigned int *)tr_calloc(room, sizeof(unsigned int));
+    s.queue = (unsigned int *)tr_malloc(room * sizeof(unsigned int));
+    s.frontier = (unsigned int *)tr_malloc(room * sizeof(unsigned int));
+    s.slot = (unsigned int *)tr_malloc(room * sizeof(unsigned int));
+    s.gain = (long long *)tr_malloc(room * sizeof(long long));
+    s.grown = (bool *)tr_calloc(room, sizeof(bool));
+    unsigned int *nodes = (unsigned int *)tr_malloc(room * sizeof(unsigned int));
+
+    tr_err err = TR_OK;
+    if (!s.set || !s.queue || !s.frontier || !s.slot || !s.gain ||
+        !s.grown || !nodes) {
+        err = TR_ENOMEM;
+    }
+
+    if (err >= 0) {
+        for (unsigned int v = 0; v < nn; ++v) {
+            nodes[v] = v;
+            s.slot[v] = NOWHERE;
+        }
+
+        tr_part_bisect(&s, nodes, nn, parts, 0);
+    }
+
+    tr_free(nodes);
+    tr_free(s.grown);
+    tr_free(s.gain);
+    tr_free(s.slot);
+    tr_free(s.frontier);
+    tr_free(s.queue);
+    tr_free(s.set);
+    return err;
+}
+
+// Picks where node v should move, or returns its own part if it should
+// stay, given its connection to each part in conn (of which the ones in
+// touched are nonzero).
+//
+// A node moves to cut less traffic, as long as its new part doesn't get
+// too heavy; or to even out part weights without cutting more; or out of
+// a part that's too heavy, into the one it cuts least for.
+//
+static unsigned int tr_part_target(partgraph *g, unsigned int v,
+                                   const unsigned int *part,
+                                   const unsigned long long *pwt,
+                                   unsigned int maxwt,
+                                   const unsigned long long *conn,
+                                   const unsigned int *touched,
+                                   unsigned int numtouched)
+{
+    unsigned int from = part[v], w = g->nwt[v];
+    unsigned long long own = conn[from];
+
+    // Never leave a part empty
+    if (pwt[from] <= w) {
+        return from;
+    }
+
+    bool overloaded = pwt[from] > maxwt;
+    unsigned int best = from;
+    long long bestgain = 0;
+
+    for (unsigned int t = 0; t < numtouched; ++t) {
+        unsigned int p = touched[t];
+        if (p == from || pwt[p] + w > maxwt) {
+            continue;
+        }
+
+        long long gain = (long long)conn[p] - (long long)own;
+        bool evener = pwt[p] + w < pwt[from];
+
+        if (best == from) {
+            if (gain > 0 || (gain == 0 && evener) || overloaded) {
+                best = p;
+                bestgain = gain;
+            }
+        }
+        else if (gain > bestgain || (gain == bestgain && pwt[p] < pwt[best])) {
+            best = p;
+            bestgain = gain;
+        }
+    }
+
+    return best;
+}
+
+tr_err tr_part_refine(partgraph *g, unsigned int parts, unsigned int maxwt,
+                      unsigned int *part)
+{
+    unsigned int nn = g->numnodes;
+    unsigned long long *pwt = (unsigned long long *)tr_calloc(parts, sizeof(unsigned long long));
+    unsigned long long *conn = (unsigned long long *)tr_calloc(parts, sizeof(unsigned long long));
+    unsigned int *touched = (unsigned int *)tr_malloc(parts * sizeof(unsigned int));
+
+    if (!pwt || !conn || !touched) {
+        tr_free(touched);
+        tr_free(conn);
+        tr_free(pwt);
+        return TR_ENOMEM;
+    }
+
+    for (unsigned int v = 0; v < nn; ++v) {
+        pwt[part[v]] += g->nwt[v];
+    }
+
+    bool moved = true;
+    for (unsigned int pass = 0; pass < MAX_PASSES && moved; ++pass) {
+        moved = false;
+
+        for (unsigned int v = 0; v < nn; ++v) {
+            unsigned int from = part[v], numtouched = 0;
+            bool boundary = false;
+
+            // Tally how much traffic v has with each part it touches
+            conn[from] = 0;
+            touched[numtouched++] = from;
+
+            for (unsigned int e = g->adj[v]; e < g->adj[v + 1]; ++e) {
+                unsigned int p = part[g->nbr[e]];
+
+                if (p != from && !conn[p]) {
+                    bool fresh = true;
+                    for (unsigned int t = 1; t < numtouched && fresh; ++t) {
+                        fresh = touched[t] != p;
+                    }
+
+                    if (fresh) {
+                        touched[numtouched++] = p;
+                    }
+                }
+
+                conn[p] += g->ewt[e];
+                boundary = boundary || p != from;
+            }
+
+            if (boundary) {
+                unsigned int to = tr_part_target(g, v, part, pwt, maxwt, conn,
+                                                 touched, numtouched);
+                if (to != from) {
+                    pwt[from] -= g->nwt[v];
+                    pwt[to] += g->nwt[v];
+                    part[v] = to;
+                    moved = true;
+                }
+            }
+
+            for (unsigned int t = 0; t < numtouched; ++t) {
+                conn[touched[t]] = 0;
+            }
+        }
+    }
+
+    tr_free(touched);
+    tr_free(conn);
+    tr_free(pwt);
+    return TR_OK;
+}
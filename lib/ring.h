@@ -0,0 +1,65 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ring.h - Bounded lock-free ring buffers
+//
+
+#ifndef RING_H
+#define RING_H
+
+#include <traffic.h>
+
+// A tr_ring is a bounded FIFO queue of fixed-size items for handing work
+// between threads without locks. Single-producer rings may be pushed to by
+// one thread at a time; multi-producer rings by any number at once. Either
+// way, only one thread at a time may pop.
+//
+// Consumers that run out of work can sleep in tr_ring_wait, or poll
+// tr_ring_fd alongside other descriptors. Producers only pay for a wakeup
+// (a write to an eventfd, or a pipe where there's no eventfd) when the
+// consumer is actually asleep.
+//
+typedef void *tr_ring;
+
+// Capacity is rounded up to a power of two
+tr_ring tr_ring_create_spsc(unsigned int itemsize, unsigned int capacity);
+tr_ring tr_ring_create_mpsc(unsigned int itemsize, unsigned int capacity);
+
+// No other thread may be using the ring when it's deleted
+tr_err tr_ring_delete(tr_ring ring);
+
+unsigned int tr_ring_capacity(tr_ring ring);
+
+// Only a snapshot while other threads are pushing or popping
+unsigned int tr_ring_size(tr_ring ring);
+
+// Fails with TR_EFULL if the ring is full
+tr_err tr_ring_push(tr_ring ring, const void *item);
+
+// Fails with TR_EEMPTY if the ring is empty
+tr_err tr_ring_pop(tr_ring ring, void *item);
+
+// Pushes as many of the given items as fit, in order.
+// Returns the number pushed.
+unsigned int tr_ring_push_n(tr_ring ring, const void *items, unsigned int count);
+
+// Pops up to count items into the given array.
+// Returns the number popped.
+unsigned int tr_ring_pop_n(tr_ring ring, void *items, unsigned int count);
+
+// Blocks the consumer until the ring is nonempty, or until timeout
+// milliseconds pass (forever if timeout < 0). Fails with TR_EEMPTY on
+// timeout.
+tr_err tr_ring_wait(tr_ring ring, int timeout);
+
+// For consumers driven by an event loop: tr_ring_fd becomes readable when
+// a producer pushes while the consumer is armed. Arm before polling, and
+// disarm after waking (which also clears the descriptor). If tr_ring_arm
+// returns false, the ring already has items, and isn't left armed.
+int tr_ring_fd(tr_ring ring);
+bool tr_ring_arm(tr_ring ring);
+void tr_ring_disarm(tr_ring ring);
+
+#endif
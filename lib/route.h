@@ -0,0 +1,193 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route.h - Declarations for psychic switch routing
+//
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <traffic.h>
+
+#include <pthread.h> // for pthread_mutex_t
+
+#include "snapshot.h"
+
+// Psychic switches route along shortest paths, counting hops over enabled
+// links. A full next-hop table (every switch, every destination) is
+// quadratic in the size of the network, so it isn't built up front.
+// Instead, routes are kept as shortest-path trees, one per destination:
+// a single breadth-first search out from the destination gives every node's
+// next hop toward it, so one search does the work for all sources at once.
+//
+// Trees are built the first time a destination is asked about, or ahead of
+// time in parallel with tr_routes_prepare, and are cached up to a limit,
+// past which the least recently used ones are dropped.
+//
+// Looking a route up can build a tree and evict another, so lookups, like
+// everything else that touches the cache, take the routes' lock. Lookups
+// copy what they need out before letting go of it.
+//
+// When a link is enabled or disabled, cached trees are repaired in place
+// rather than rebuilt. Disabling a link only affects the trees that route
+// over it, and then only the nodes downstream of it, which are reattached
+// to the rest of the tree. Enabling a link only affects trees in which it's
+// a shortcut, and then only the nodes it brings closer.
+//
+// When the topology changes, the routes over the new snapshot start with
+// the old routes' trees, carried over and repaired the same way: the nodes
+// that routed over links that are gone are reattached, and links that are
+// new are spread through as shortcuts.
+//
+
+// Distance of a node with no route to a tree's destination, and the link
+// the destination itself forwards over
+//
+#define TR_NO_ROUTE 0xffffffffu
+
+// The number of destinations to cache trees for, when not set, is as many
+// as fit in this many bytes (but at least TR_ROUTE_MIN_CACHE)
+//
+#define TR_ROUTE_CACHE_BYTES (256u << 20)
+#define TR_ROUTE_MIN_CACHE 64
+
+// The shortest paths from every node to one destination
+//
+struct _routetree
+{
+    unsigned int dest;      // Node index of the destination
+    unsigned int slot;      // Where the tree is in its routes' cache
+    unsigned int *dist;     // Hops from each node to dest, or TR_NO_ROUTE
+    unsigned int *via;      // Link index each node forwards over toward dest
+};
+
+typedef struct _routetree routetree;
+
+// Scratch space for one thread working on trees
+//
+struct _routeworker
+{
+    unsigned int *queue;        // Nodes waiting to be visited
+    unsigned int *mark;         // Stamp of the repair each node is in, if any
+    unsigned long long *seeds;  // Tentative distances and nodes, to sort
+    unsigned int stamp;         // Stamp of the current repair
+};
+
+typedef struct _routeworker routeworker;
+
+// The routes over a snapshot's topology, and the trees cached for them
+//
+struct _routes
+{
+    snapshot *snap;             // The topology being routed over
+    unsigned int *node_adj;     // CSR offsets of each node's adjacency (+1 end)
+    unsigned int *adj_node;     // Node index at the far end of each adjacency
+
+    routetree **trees;          // Tree for each destination node, or NULL
+    routetree **cache;          // Cached trees, in no particular order
+    unsigned char *recent;      // Whether each cached tree was used lately
+    unsigned int numcached;     // Number of trees in the cache
+    unsigned int maxcached;     // Most trees the cache holds
+    unsigned int hand;          // Where eviction looks next in cache
+
+    routeworker *workers;       // Scratch space for each thread, or NULL
+    unsigned int numworkers;    // Number of threads to spread work over
+
+    pthread_mutex_t lock;       // Held while the cache is used or changed
+};
+
+typedef struct _routes routes;
+
+// How an older snapshot's indices map onto a newer one's, for carrying
+// trees over from one to the other
+//
+struct _routemap
+{
+    snapshot *old;              // The snapshot being carried over from
+    unsigned int *node;         // New index of each old node, or TR_NO_NODE
+    unsigned int *link;         // New index of each old link, or TR_NO_ROUTE
+    unsigned int *added;        // New links that are enabled but weren't
+    unsigned int numadded;      // Number of links in added
+};
+
+typedef struct _routemap routemap;
+
+// Creates the routes over a snapshot's topology, caching trees for up to
+// maxcached destinations (0 picks a limit by TR_ROUTE_CACHE_BYTES). No
+// trees are built yet. Returns NULL if memory runs out.
+//
+routes *tr_routes_create(snapshot *snap, unsigned int maxcached);
+
+// Frees the routes and all their trees
+//
+void tr_routes_delete(routes *r);
+
+// Frees the routes once no reader can still be looking at them (see
+// epoch.h). Doesn't free the snapshot they're over.
+//
+void tr_routes_retire(routes *r);
+
+// Changes how many destinations trees are cached for (0 picks a limit by
+// TR_ROUTE_CACHE_BYTES), dropping trees if there are more than that
+//
+void tr_routes_set_cache(routes *r, unsigned int maxcached);
+
+// Looks up the route from one node index to another, building the tree of
+// routes to dest if it isn't cached: the number of hops (into dist) and the
+// link index the route leaves from over (into via). Returns false if
+// there's no route or memory runs out. Can be called from many threads at
+// once.
+//
+bool tr_routes_lookup(routes *r, unsigned int from, unsigned int dest,
+                      unsigned int *dist, unsigned int *via);
+
+// Builds trees for the given node indices, in parallel. Fails with
+// TR_EFULL if there are more of them than the cache holds.
+//
+tr_err tr_routes_prepare(routes *r, const unsigned int *dests,
+                         unsigned int count);
+
+// Enables or disables the given link in the snapshot, and repairs every
+// cached tree to match
+//
+void tr_routes_link_changed(routes *r, unsigned int link, bool enabled);
+
+// Like tr_routes_link_changed, for count links at once. The routes stay
+// locked throughout, so lookups see all of the links as they were or all
+// of them as they are.
+//
+void tr_routes_links_changed(routes *r, const unsigned int *links,
+                             const bool *enabled, unsigned int count);
+
+// Fills the cache of new routes, over a newer snapshot, with the trees
+// cached in old, mapped across by map and repaired for what changed, as
+// many as fit. Trees that can't be carried over (because their
+// destination is gone, or memory runs out) are left to be built when
+// they're needed. Lookups of old can go on meanwhile.
+//
+void tr_routes_carry(routes *r, routes *old, const routemap *map);
+
+// Builds a tree from scratch, by breadth-first search from its destination
+//
+void tr_routes_build(routes *r, routeworker *w, routetree *tree);
+
+// Checks if a tree needs repairs after the given link was enabled or
+// disabled
+//
+bool tr_routes_affected(routes *r, routetree *tree, unsigned int link);
+
+// Repairs a tree after the given link was enabled or disabled
+//
+void tr_routes_repair(routes *r, routeworker *w, routetree *tree,
+                      unsigned int link);
+
+// Fills a tree with a tree for the same destination over an older
+// snapshot, mapped across by map, and repairs it for the links that are
+// gone, off or new
+//
+void tr_routes_remap(routes *r, routeworker *w, routetree *tree,
+                     const routetree *from, const routemap *map);
+
+#endif
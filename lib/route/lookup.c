@@ -0,0 +1,127 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route/lookup.c - Looking up psychic switch routes
+//
+
+#include <stdlib.h> // for NULL
+
+#include "epoch.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "route.h"
+
+// Looks up the route from one node to another: the number of hops, and
+// the interface it leaves by. Forwarding threads ask while the routes may
+// be replaced, so this reads nothing but the routes and the snapshot
+// they're over, and only from inside an epoch (see epoch.h). Returns false
+// if there's no route (as for tr_node_next_hop).
+//
+static bool tr_route_find(tr_node trn, tr_node trdest, unsigned int *hops,
+                          tr_iface *next)
+{
+    if (!trn || !trdest) {
+        return false;
+    }
+
+    network *net = tr_handle_network(trn);
+    if (!net || net != tr_handle_network(trdest)) {
+        return false;
+    }
+
+    tr_epoch epoch = tr_epoch_enter();
+    routes *r = __atomic_load_n(&net->routes, __ATOMIC_ACQUIRE);
+    bool found = false;
+
+    if (r) {
+        snapshot *snap = r->snap;
+        unsigned int from = tr_snapshot_node(snap, trn);
+        unsigned int dest = tr_snapshot_node(snap, trdest);
+        unsigned int link;
+
+        found = from != TR_NO_NODE && dest != TR_NO_NODE && from != dest &&
+                tr_routes_lookup(r, from, dest, hops, &link);
+
+        if (found) {
+            // Leave by whichever end of the link is on this node
+            unsigned int end = snap->link_ends[2 * link];
+            if (snap->iface_node[end] != from) {
+                end = snap->link_ends[2 * link + 1];
+            }
+
+            *next = snap->iface_handles[end];
+        }
+    }
+
+    tr_epoch_leave(epoch);
+    return found;
+}
+
+tr_iface tr_node_next_hop(tr_node trn, tr_node trdest)
+{
+    unsigned int hops;
+    tr_iface next;
+
+    return tr_route_find(trn, trdest, &hops, &next) ? next : NULL;
+}
+
+int tr_node_hops(tr_node trn, tr_node trdest)
+{
+    unsigned int hops;
+    tr_iface next;
+
+    return tr_route_find(trn, trdest, &hops, &next) ? (int)hops : -1;
+}
+
+tr_err tr_net_prepare_routes(tr_network trn, const tr_node *dests,
+                             unsigned count)
+{
+    if (!trn) return TR_EPOINTER;
+    if (!dests && count) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    for (unsigned int k = 0; k < count; ++k) {
+        if (!dests[k]) return TR_EPOINTER;
+
+        node *n = tr_node_get(dests[k]);
+        if (!n) return TR_ESTALE;
+        if (n->net != net) return TR_ENOTFOUND;
+    }
+
+    tr_err err = tr_net_bind(trn);
+    if (err < 0) {
+        return err;
+    }
+
+    unsigned int *indices = (unsigned int *)tr_malloc((count ? count : 1) * sizeof(unsigned int));
+    if (!indices) {
+        return TR_ENOMEM;
+    }
+
+    // Nodes only have their indices once the network is bound
+    for (unsigned int k = 0; k < count; ++k) {
+        indices[k] = tr_node_get(dests[k])->index;
+    }
+
+    err = tr_routes_prepare(net->routes, indices, count);
+    tr_free(indices);
+
+    return err;
+}
+
+tr_err tr_net_set_route_cache(tr_network trn, unsigned dests)
+{
+    if (!trn) return TR_EPOINTER;
+
+    network *net = (network *)trn;
+    net->routecache = dests;
+
+    if (net->routes) {
+        tr_routes_set_cache(net->routes, dests);
+    }
+
+    return TR_OK;
+}
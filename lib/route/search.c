@@ -0,0 +1,277 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route/search.c - Building and repairing shortest-path trees
+//
+
+#include <stdlib.h> // for qsort
+#include <string.h> // for memset
+
+#include "route.h"
+
+void tr_routes_build(routes *r, routeworker *w, routetree *tree)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via, *queue = w->queue;
+    unsigned int head = 0, tail = 0;
+
+    memset(dist, 0xff, snap->num_nodes * sizeof(unsigned int));
+    dist[tree->dest] = 0;
+    via[tree->dest] = TR_NO_ROUTE;
+    queue[tail++] = tree->dest;
+
+    while (head < tail) {
+        unsigned int v = queue[head++];
+        unsigned int d = dist[v] + 1;
+
+        for (unsigned int k = r->node_adj[v]; k < r->node_adj[v + 1]; ++k) {
+            unsigned int u = r->adj_node[k];
+
+            if (dist[u] == TR_NO_ROUTE && snap->enabled[snap->adj_link[k]]) {
+                dist[u] = d;
+                via[u] = snap->adj_link[k];
+                queue[tail++] = u;
+            }
+        }
+    }
+}
+
+// Spreads a shorter distance to node from, found through a newly enabled
+// link, to everything it brings closer to the destination. Nodes are
+// visited in order of distance, so each one is improved at most once.
+//
+static void tr_routes_spread(routes *r, routeworker *w, routetree *tree,
+                             unsigned int from)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via, *queue = w->queue;
+    unsigned int head = 0, tail = 0;
+
+    queue[tail++] = from;
+
+    while (head < tail) {
+        unsigned int v = queue[head++];
+        unsigned int d = dist[v] + 1;
+
+        for (unsigned int k = r->node_adj[v]; k < r->node_adj[v + 1]; ++k) {
+            unsigned int u = r->adj_node[k];
+
+            if (d < dist[u] && snap->enabled[snap->adj_link[k]]) {
+                dist[u] = d;
+                via[u] = snap->adj_link[k];
+                queue[tail++] = u;
+            }
+        }
+    }
+}
+
+// Starts a new repair, giving it two stamps of its own: one for the nodes
+// being repaired, and one for those whose routes are settled again
+//
+static unsigned int tr_routes_stamp(routes *r, routeworker *w)
+{
+    if (w->stamp >= TR_NO_ROUTE - 2) {
+        memset(w->mark, 0, r->snap->num_nodes * sizeof(unsigned int));
+        w->stamp = 0;
+    }
+
+    w->stamp += 2;
+    return w->stamp;
+}
+
+static int tr_routes_cmp_seeds(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Reattaches the part of the tree that routed through the first count
+// nodes in the worker's queue, whose links toward the destination were
+// disabled or removed.
+//
+// The nodes downstream of the breaks are cut loose first. Each gets a
+// tentative route through whichever of its neighbors outside the cut is
+// closest, and then the cut is settled in order of distance, like
+// Dijkstra's algorithm but with two queues: the tentative routes, sorted,
+// and the nodes reached from settled ones, which come out in order anyway.
+//
+static void tr_routes_reattach(routes *r, routeworker *w, routetree *tree,
+                               unsigned int count)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via;
+    unsigned int *queue = w->queue, *mark = w->mark;
+    unsigned int loose = tr_routes_stamp(r, w), settled = loose + 1;
+    unsigned int numseeds = 0;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        mark[queue[i]] = loose;
+    }
+
+    // Find everything downstream: the nodes that forward to a node that's
+    // already in the cut
+    for (unsigned int head = 0; head < count; ++head) {
+        unsigned int v = queue[head];
+
+        for (unsigned int k = r->node_adj[v]; k < r->node_adj[v + 1]; ++k) {
+            unsigned int u = r->adj_node[k];
+
+            if (mark[u] != loose && dist[u] != TR_NO_ROUTE &&
+                via[u] == snap->adj_link[k]) {
+                mark[u] = loose;
+                queue[count++] = u;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        dist[queue[i]] = TR_NO_ROUTE;
+    }
+
+    // Route each one through its closest neighbor outside the cut
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int v = queue[i];
+
+        for (unsigned int k = r->node_adj[v]; k < r->node_adj[v + 1]; ++k) {
+            unsigned int u = r->adj_node[k];
+
+            if (mark[u] != loose && dist[u] < dist[v] - 1 &&
+                snap->enabled[snap->adj_link[k]]) {
+                dist[v] = dist[u] + 1;
+                via[v] = snap->adj_link[k];
+            }
+        }
+
+        if (dist[v] != TR_NO_ROUTE) {
+            w->seeds[numseeds++] = (unsigned long long)dist[v] << 32 | v;
+        }
+    }
+
+    qsort(w->seeds, numseeds, sizeof(unsigned long long), tr_routes_cmp_seeds);
+
+    // Settle the cut, closest first
+    unsigned int seed = 0, head = 0, tail = 0;
+    while (seed < numseeds || head < tail) {
+        unsigned int v;
+
+        if (head < tail &&
+            (seed == numseeds || dist[queue[head]] <= w->seeds[seed] >> 32)) {
+            v = queue[head++];
+        }
+        else {
+            v = (unsigned int)w->seeds[seed];
+            if (dist[v] != w->seeds[seed++] >> 32) {
+                continue;
+            }
+        }
+
+        if (mark[v] == settled) {
+            continue;
+        }
+
+        mark[v] = settled;
+        unsigned int d = dist[v] + 1;
+
+        for (unsigned int k = r->node_adj[v]; k < r->node_adj[v + 1]; ++k) {
+            unsigned int u = r->adj_node[k];
+
+            if (mark[u] == loose && d < dist[u] &&
+                snap->enabled[snap->adj_link[k]]) {
+                dist[u] = d;
+                via[u] = snap->adj_link[k];
+                queue[tail++] = u;
+            }
+        }
+    }
+}
+
+bool tr_routes_affected(routes *r, routetree *tree, unsigned int link)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via;
+    unsigned int x = snap->iface_node[snap->link_ends[2 * link]];
+    unsigned int y = snap->iface_node[snap->link_ends[2 * link + 1]];
+
+    if (snap->enabled[link]) {
+        // The link is a shortcut if it brings one end closer through the
+        // other
+        return (dist[x] != TR_NO_ROUTE && dist[x] + 1 < dist[y]) ||
+               (dist[y] != TR_NO_ROUTE && dist[y] + 1 < dist[x]);
+    }
+
+    // Only matters if one end forwards over the link
+    return (dist[x] != TR_NO_ROUTE && via[x] == link) ||
+           (dist[y] != TR_NO_ROUTE && via[y] == link);
+}
+
+void tr_routes_repair(routes *r, routeworker *w, routetree *tree,
+                      unsigned int link)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via;
+    unsigned int x = snap->iface_node[snap->link_ends[2 * link]];
+    unsigned int y = snap->iface_node[snap->link_ends[2 * link + 1]];
+
+    // Whichever end is further from the destination is the one affected;
+    // a link can't bring both ends closer, or carry routes both ways
+    if (dist[y] < dist[x]) {
+        unsigned int t = x;
+        x = y;
+        y = t;
+    }
+
+    if (snap->enabled[link]) {
+        if (dist[x] != TR_NO_ROUTE && dist[x] + 1 < dist[y]) {
+            dist[y] = dist[x] + 1;
+            via[y] = link;
+            tr_routes_spread(r, w, tree, y);
+        }
+    }
+    else if (dist[y] != TR_NO_ROUTE && via[y] == link) {
+        w->queue[0] = y;
+        tr_routes_reattach(r, w, tree, 1);
+    }
+}
+
+void tr_routes_remap(routes *r, routeworker *w, routetree *tree,
+                     const routetree *from, const routemap *map)
+{
+    snapshot *snap = r->snap;
+    unsigned int *dist = tree->dist, *via = tree->via;
+    unsigned int numcut = 0;
+
+    // Nodes that are new have no routes yet; those that stayed keep theirs,
+    // though some are over links that are gone
+    memset(dist, 0xff, snap->num_nodes * sizeof(unsigned int));
+
+    for (unsigned int n = 0; n < map->old->num_nodes; ++n) {
+        unsigned int v = map->node[n];
+        if (v != TR_NO_NODE && from->dist[n] != TR_NO_ROUTE) {
+            dist[v] = from->dist[n];
+            via[v] = v == tree->dest ? TR_NO_ROUTE : map->link[from->via[n]];
+        }
+    }
+
+    // Every link that's still on still leads no more than a hop closer, so
+    // turning the new ones on brings nodes closer as it would have in the
+    // old tree, new nodes included
+    for (unsigned int k = 0; k < map->numadded; ++k) {
+        tr_routes_repair(r, w, tree, map->added[k]);
+    }
+
+    // Then whatever doesn't lead to a link that's gone or off is on a
+    // shortest route, and what does is cut loose and reattached to it
+    for (unsigned int v = 0; v < snap->num_nodes; ++v) {
+        if (v != tree->dest && dist[v] != TR_NO_ROUTE &&
+            (via[v] == TR_NO_ROUTE || !snap->enabled[via[v]])) {
+            w->queue[numcut++] = v;
+        }
+    }
+
+    if (numcut) {
+        tr_routes_reattach(r, w, tree, numcut);
+    }
+}
@@ -0,0 +1,582 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route/table.c - Caching shortest-path trees and spreading work on them
+//
+
+#define _POSIX_C_SOURCE 200112L // for sysconf
+
+#include <pthread.h> // for pthread_create, pthread_join, pthread_mutex_lock
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset
+#include <unistd.h> // for sysconf
+
+#include "epoch.h"
+#include "memory.h"
+#include "route.h"
+
+// The most threads work is spread over
+//
+#define MAX_WORKERS 16
+
+// Work is only spread over threads when there's at least this much of it,
+// in nodes visited, since starting threads has a cost of its own
+//
+#define MIN_PARALLEL_WORK (1u << 16)
+
+// Picks how many trees to cache for a network of the given size
+//
+static unsigned int tr_routes_cache_size(unsigned int numnodes,
+                                         unsigned int maxcached)
+{
+    if (!maxcached) {
+        unsigned long long bytes = 2ull * sizeof(unsigned int) * (numnodes ? numnodes : 1);
+        maxcached = TR_ROUTE_CACHE_BYTES / bytes;
+
+        if (maxcached < TR_ROUTE_MIN_CACHE) {
+            maxcached = TR_ROUTE_MIN_CACHE;
+        }
+    }
+
+    return maxcached < numnodes ? maxcached : numnodes;
+}
+
+// Lays out each node's adjacency, across all of its interfaces, and the
+// node at the far end of each
+//
+static routes *tr_routes_build_adjacency(routes *r)
+{
+    snapshot *snap = r->snap;
+    unsigned int nn = snap->num_nodes;
+    unsigned int na = snap->iface_links[snap->num_ifaces];
+
+    r->node_adj = (unsigned int *)tr_malloc((nn + 1) * sizeof(unsigned int));
+    r->adj_node = (unsigned int *)tr_malloc((na ? na : 1) * sizeof(unsigned int));
+    r->trees = (routetree **)tr_calloc(nn ? nn : 1, sizeof(routetree *));
+
+    if (!r->node_adj || !r->adj_node || !r->trees) {
+        return NULL;
+    }
+
+    // A node's interfaces are contiguous, and so are their adjacencies
+    for (unsigned int n = 0; n <= nn; ++n) {
+        r->node_adj[n] = snap->iface_links[snap->node_ifaces[n]];
+    }
+
+    for (unsigned int k = 0; k < na; ++k) {
+        r->adj_node[k] = snap->iface_node[snap->adj_peer[k]];
+    }
+
+    return r;
+}
+
+routes *tr_routes_create(snapshot *snap, unsigned int maxcached)
+{
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+    routes *r = (routes *)tr_calloc(1, sizeof(routes));
+
+    if (r) {
+        r->snap = snap;
+        pthread_mutex_init(&r->lock, NULL);
+        r->maxcached = tr_routes_cache_size(snap->num_nodes, maxcached);
+        r->cache = (routetree **)tr_calloc(r->maxcached + 1, sizeof(routetree *));
+        r->recent = (unsigned char *)tr_calloc(r->maxcached + 1, 1);
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        r->numworkers = cpus < 1 ? 1 : cpus > MAX_WORKERS ? MAX_WORKERS : cpus;
+
+        if (!r->cache || !r->recent || !tr_routes_build_adjacency(r)) {
+            tr_routes_delete(r);
+            r = NULL;
+        }
+    }
+
+    tr_mem_set_tag(tag);
+    return r;
+}
+
+static void tr_routes_free_tree(routetree *tree)
+{
+    tr_free(tree->dist);
+    tr_free(tree->via);
+    tr_free(tree);
+}
+
+// Drops the cached tree in the given slot, moving the last one into it
+//
+static void tr_routes_evict(routes *r, unsigned int slot)
+{
+    routetree *tree = r->cache[slot];
+    routetree *last = r->cache[--r->numcached];
+
+    r->cache[slot] = last;
+    r->recent[slot] = r->recent[r->numcached];
+    last->slot = slot;
+
+    r->trees[tree->dest] = NULL;
+    tr_routes_free_tree(tree);
+}
+
+void tr_routes_delete(routes *r)
+{
+    if (!r) {
+        return;
+    }
+
+    while (r->numcached) {
+        tr_routes_evict(r, 0);
+    }
+
+    if (r->workers) {
+        for (unsigned int t = 0; t < r->numworkers; ++t) {
+            tr_free(r->workers[t].queue);
+            tr_free(r->workers[t].mark);
+            tr_free(r->workers[t].seeds);
+        }
+
+        tr_free(r->workers);
+    }
+
+    tr_free(r->trees);
+    tr_free(r->adj_node);
+    tr_free(r->node_adj);
+    tr_free(r->recent);
+    tr_free(r->cache);
+    pthread_mutex_destroy(&r->lock);
+    tr_free(r);
+}
+
+static void tr_routes_free(void *ptr)
+{
+    tr_routes_delete((routes *)ptr);
+}
+
+void tr_routes_retire(routes *r)
+{
+    tr_epoch_retire(r, tr_routes_free);
+}
+
+void tr_routes_set_cache(routes *r, unsigned int maxcached)
+{
+    maxcached = tr_routes_cache_size(r->snap->num_nodes, maxcached);
+
+    pthread_mutex_lock(&r->lock);
+    if (maxcached == r->maxcached) {
+        pthread_mutex_unlock(&r->lock);
+        return;
+    }
+
+    while (r->numcached > maxcached) {
+        tr_routes_evict(r, r->numcached - 1);
+    }
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+    routetree **cache = (routetree **)tr_realloc(r->cache, (maxcached + 1) * sizeof(routetree *));
+    unsigned char *recent = (unsigned char *)tr_realloc(r->recent, maxcached + 1);
+    tr_mem_set_tag(tag);
+
+    // If the arrays can't be resized, the cache keeps its old size
+    if (cache) r->cache = cache;
+    if (recent) r->recent = recent;
+
+    if (cache && recent) {
+        r->maxcached = maxcached;
+        r->hand = 0;
+    }
+
+    pthread_mutex_unlock(&r->lock);
+}
+
+// Gets the scratch space for the first count threads, allocating it the
+// first time. Returns NULL if memory runs out.
+//
+static routeworker *tr_routes_workers(routes *r, unsigned int count)
+{
+    unsigned int nn = r->snap->num_nodes ? r->snap->num_nodes : 1;
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+
+    if (!r->workers) {
+        r->workers = (routeworker *)tr_calloc(r->numworkers, sizeof(routeworker));
+    }
+
+    bool ok = r->workers != NULL;
+    for (unsigned int t = 0; ok && t < count; ++t) {
+        routeworker *w = &r->workers[t];
+
+        if (!w->queue) {
+            w->queue = (unsigned int *)tr_malloc(nn * sizeof(unsigned int));
+            w->mark = (unsigned int *)tr_calloc(nn, sizeof(unsigned int));
+            w->seeds = (unsigned long long *)tr_malloc(nn * sizeof(unsigned long long));
+        }
+
+        ok = w->queue && w->mark && w->seeds;
+    }
+
+    tr_mem_set_tag(tag);
+    return ok ? r->workers : NULL;
+}
+
+// Gets a cached tree for the given destination, which is left unbuilt if it
+// wasn't cached. If the cache is full, the least recently used tree that
+// isn't pinned (recent == 2) makes way. Returns NULL if memory runs out.
+//
+static routetree *tr_routes_acquire(routes *r, unsigned int dest, bool *fresh)
+{
+    routetree *tree = r->trees[dest];
+    *fresh = !tree;
+
+    if (tree) {
+        if (!r->recent[tree->slot]) {
+            r->recent[tree->slot] = 1;
+        }
+
+        return tree;
+    }
+
+    if (r->numcached == r->maxcached) {
+        if (r->hand >= r->numcached) {
+            r->hand = 0;
+        }
+
+        // Sweep the clock hand past the trees used since it last went by
+        while (r->recent[r->hand]) {
+            if (r->recent[r->hand] == 1) {
+                r->recent[r->hand] = 0;
+            }
+
+            r->hand = (r->hand + 1) % r->numcached;
+        }
+
+        tr_routes_evict(r, r->hand);
+    }
+
+    unsigned int nn = r->snap->num_nodes;
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+    tree = (routetree *)tr_malloc(sizeof(routetree));
+
+    if (tree) {
+        tree->dist = (unsigned int *)tr_malloc(nn * sizeof(unsigned int));
+        tree->via = (unsigned int *)tr_malloc(nn * sizeof(unsigned int));
+
+        if (!tree->dist || !tree->via) {
+            tr_routes_free_tree(tree);
+            tree = NULL;
+        }
+    }
+
+    tr_mem_set_tag(tag);
+
+    if (tree) {
+        tree->dest = dest;
+        tree->slot = r->numcached++;
+        r->cache[tree->slot] = tree;
+        r->recent[tree->slot] = 1;
+        r->trees[dest] = tree;
+    }
+
+    return tree;
+}
+
+// Gets the tree of routes to the given node index, building it if it isn't
+// cached. Returns NULL if memory runs out. The routes must be locked, and
+// the tree is only good until they're unlocked.
+//
+static routetree *tr_routes_tree(routes *r, unsigned int dest)
+{
+    bool fresh;
+    routetree *tree = tr_routes_acquire(r, dest, &fresh);
+
+    if (tree && fresh) {
+        routeworker *w = tr_routes_workers(r, 1);
+        if (!w) {
+            tr_routes_evict(r, tree->slot);
+            return NULL;
+        }
+
+        tr_routes_build(r, w, tree);
+    }
+
+    return tree;
+}
+
+bool tr_routes_lookup(routes *r, unsigned int from, unsigned int dest,
+                      unsigned int *dist, unsigned int *via)
+{
+    pthread_mutex_lock(&r->lock);
+
+    routetree *tree = tr_routes_tree(r, dest);
+    bool found = tree && tree->dist[from] != TR_NO_ROUTE;
+
+    if (found) {
+        *dist = tree->dist[from];
+        *via = tree->via[from];
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+struct _routejob;
+typedef struct _routejob routejob;
+
+// Works on one of a job's trees
+//
+typedef void (*routejobfunc)(const routejob *job, routeworker *w,
+                             routetree *tree);
+
+// A batch of trees to work on, shared by the threads working on it
+//
+struct _routejob
+{
+    routes *r;
+    routejobfunc func;
+    routetree **items;
+    unsigned int count;
+    unsigned int link;      // The link being changed, for repairs
+    const routemap *map;    // How trees map across, for carrying them
+    unsigned int next;      // The next item for a thread to take
+};
+
+static void tr_routes_job_build(const routejob *job, routeworker *w,
+                                routetree *tree)
+{
+    tr_routes_build(job->r, w, tree);
+}
+
+static void tr_routes_job_repair(const routejob *job, routeworker *w,
+                                 routetree *tree)
+{
+    tr_routes_repair(job->r, w, tree, job->link);
+}
+
+// Items are the old trees, since the new ones can be found from them
+//
+static void tr_routes_job_carry(const routejob *job, routeworker *w,
+                                routetree *from)
+{
+    routetree *tree = job->r->trees[job->map->node[from->dest]];
+    tr_routes_remap(job->r, w, tree, from, job->map);
+}
+
+// One thread's share of a job
+//
+struct _routethread
+{
+    routejob *job;
+    routeworker *worker;
+    pthread_t thread;
+};
+
+typedef struct _routethread routethread;
+
+static void *tr_routes_thread(void *arg)
+{
+    routethread *t = (routethread *)arg;
+    routejob *job = t->job;
+
+    // Threads take items one at a time, so none sits idle while another
+    // has a long queue
+    unsigned int k;
+    while ((k = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count) {
+        job->func(job, t->worker, job->items[k]);
+    }
+
+    return NULL;
+}
+
+// Runs func on each of the trees, spread across as many threads as are
+// worth starting for them. The calling thread works too.
+//
+static tr_err tr_routes_parallel(routes *r, routejob *job)
+{
+    unsigned long long work = (unsigned long long)job->count * r->snap->num_nodes;
+    unsigned int numthreads = r->numworkers;
+
+    if (numthreads > job->count) {
+        numthreads = job->count;
+    }
+
+    if (work < MIN_PARALLEL_WORK || numthreads < 1) {
+        numthreads = 1;
+    }
+
+    routeworker *workers = tr_routes_workers(r, numthreads);
+    if (!workers) {
+        return TR_ENOMEM;
+    }
+
+    routethread threads[MAX_WORKERS];
+    unsigned int started = 1;
+
+    for (unsigned int t = 0; t < numthreads; ++t) {
+        threads[t].job = job;
+        threads[t].worker = &workers[t];
+    }
+
+    // If a thread can't be started, the others take up its share
+    while (started < numthreads &&
+           pthread_create(&threads[started].thread, NULL, tr_routes_thread,
+                          &threads[started]) == 0) {
+        ++started;
+    }
+
+    tr_routes_thread(&threads[0]);
+
+    for (unsigned int t = 1; t < started; ++t) {
+        pthread_join(threads[t].thread, NULL);
+    }
+
+    return TR_OK;
+}
+
+tr_err tr_routes_prepare(routes *r, const unsigned int *dests,
+                         unsigned int count)
+{
+    routetree **fresh = (routetree **)tr_malloc((count ? count : 1) * sizeof(routetree *));
+    if (!fresh) {
+        return TR_ENOMEM;
+    }
+
+    pthread_mutex_lock(&r->lock);
+
+    // Pin the batch's trees as they're found or made, so that making room
+    // for one of them never drops another
+    unsigned int numfresh = 0;
+    tr_err err = count > r->maxcached ? TR_EFULL : TR_OK;
+
+    for (unsigned int k = 0; k < count && err >= 0; ++k) {
+        bool isfresh;
+        routetree *tree = tr_routes_acquire(r, dests[k], &isfresh);
+
+        if (!tree) {
+            err = TR_ENOMEM;
+        }
+        else {
+            r->recent[tree->slot] = 2;
+            if (isfresh) {
+                fresh[numfresh++] = tree;
+            }
+        }
+    }
+
+    if (err >= 0) {
+        routejob job = { r, tr_routes_job_build, fresh, numfresh, 0, NULL, 0 };
+        err = tr_routes_parallel(r, &job);
+    }
+
+    // Trees that didn't get built can't be kept
+    if (err < 0) {
+        for (unsigned int k = 0; k < numfresh; ++k) {
+            tr_routes_evict(r, fresh[k]->slot);
+        }
+    }
+
+    for (unsigned int s = 0; s < r->numcached; ++s) {
+        if (r->recent[s] == 2) {
+            r->recent[s] = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&r->lock);
+
+    tr_free(fresh);
+    return err;
+}
+
+// Enables or disables a link and repairs the cached trees to match. The
+// routes must be locked.
+//
+static void tr_routes_relink(routes *r, unsigned int link, bool enabled)
+{
+    r->snap->enabled[link] = enabled;
+    if (!r->numcached) {
+        return;
+    }
+
+    // Most trees don't route over any given link, or have any use for it,
+    // so only the ones that do are worth spreading across threads
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+    routetree **affected = (routetree **)tr_malloc(r->numcached * sizeof(routetree *));
+    tr_mem_set_tag(tag);
+
+    tr_err err = TR_ENOMEM;
+    if (affected) {
+        unsigned int count = 0;
+        for (unsigned int s = 0; s < r->numcached; ++s) {
+            if (tr_routes_affected(r, r->cache[s], link)) {
+                affected[count++] = r->cache[s];
+            }
+        }
+
+        routejob job = { r, tr_routes_job_repair, affected, count, link, NULL, 0 };
+        err = count ? tr_routes_parallel(r, &job) : TR_OK;
+        tr_free(affected);
+    }
+
+    // A tree that can't be repaired can't be trusted either, so without
+    // the memory to repair them, the trees are dropped, to be rebuilt as
+    // they're needed
+    if (err < 0) {
+        while (r->numcached) {
+            tr_routes_evict(r, 0);
+        }
+    }
+}
+
+void tr_routes_link_changed(routes *r, unsigned int link, bool enabled)
+{
+    pthread_mutex_lock(&r->lock);
+    tr_routes_relink(r, link, enabled);
+    pthread_mutex_unlock(&r->lock);
+}
+
+void tr_routes_links_changed(routes *r, const unsigned int *links,
+                             const bool *enabled, unsigned int count)
+{
+    pthread_mutex_lock(&r->lock);
+
+    for (unsigned int k = 0; k < count; ++k) {
+        tr_routes_relink(r, links[k], enabled[k]);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+}
+
+void tr_routes_carry(routes *r, routes *old, const routemap *map)
+{
+    // Readers of the old routes can still build and evict trees, so they
+    // wait while the old trees are read
+    pthread_mutex_lock(&old->lock);
+    pthread_mutex_lock(&r->lock);
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_ROUTING);
+    routetree **from = (routetree **)tr_malloc((old->numcached ? old->numcached : 1) * sizeof(routetree *));
+    tr_mem_set_tag(tag);
+
+    unsigned int count = 0;
+    for (unsigned int s = 0; from && s < old->numcached && count < r->maxcached; ++s) {
+        routetree *tree = old->cache[s];
+        unsigned int dest = map->node[tree->dest];
+
+        // Making a tree can't evict another while there's room for it
+        bool fresh;
+        if (dest != TR_NO_NODE && tr_routes_acquire(r, dest, &fresh)) {
+            r->recent[r->trees[dest]->slot] = old->recent[s];
+            from[count++] = tree;
+        }
+    }
+
+    routejob job = { r, tr_routes_job_carry, from, count, 0, map, 0 };
+    if (count && tr_routes_parallel(r, &job) < 0) {
+        while (r->numcached) {
+            tr_routes_evict(r, 0);
+        }
+    }
+
+    tr_free(from);
+
+    pthread_mutex_unlock(&r->lock);
+    pthread_mutex_unlock(&old->lock);
+}
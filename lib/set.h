@@ -9,6 +9,8 @@
 #ifndef SET_H
 #define SET_H
 
+#include <stdint.h> // for uint64_t
+
 #include <traffic.h>
 #include "hash.h" // tr_hashfunc and tr_equalfunc
 
@@ -24,8 +26,34 @@ bool tr_set_contains(tr_set set, const void *key);
 tr_err tr_set_add(tr_set set, const void *key);
 tr_err tr_set_remove(tr_set, const void *key);
 
+unsigned int tr_set_size(tr_set set);
 tr_vector tr_set_items(tr_set set);
 
+// A cursor over the items in a set; see tr_hash_iter. The current item is
+// it.key. The set must not be modified while a cursor is walking it.
+struct _set_iter
+{
+    void *key;              // The current item
+
+    tr_hash_iter hashit;    // Cursor into the set's hashtable, if it has one
+
+    const uint64_t *words;  // Bitmap being walked, for dense intsets
+    unsigned int numwords;  // Number of words in the bitmap
+    unsigned int word;      // Next word to load
+    uint64_t bits;          // Items left to visit in the current word
+    long long base;         // Value of the bitmap's first bit
+    int value;              // The current item, when key can't point into the set
+};
+
+typedef struct _set_iter tr_set_iter;
+
+void tr_set_iter_init(tr_set set, tr_set_iter *it);
+bool tr_set_iter_next(tr_set_iter *it);
+
+#define tr_set_foreach(it, set)                         \
+    for (tr_set_iter_init((set), &(it));                \
+         tr_set_iter_next(&(it)); )
+
 
 tr_set tr_strset_create();
 tr_err tr_strset_delete(tr_set set);
@@ -37,6 +65,10 @@ tr_err tr_strset_remove(tr_set, const char *key);
 tr_vector tr_strset_items(tr_set set);
 
 
+// Intsets switch by themselves to a bitmap (one bit per possible value
+// between the smallest and largest items) once their items are dense
+// enough that it's smaller than a hashtable, e.g. for sequential IDs.
+// They switch back if the items thin out again.
 tr_set tr_intset_create();
 tr_err tr_intset_delete(tr_set set);
 
@@ -46,4 +78,7 @@ tr_err tr_intset_remove(tr_set, int key);
 
 tr_vector tr_intset_items(tr_set set);
 
+// Whether the intset is currently a bitmap, for tests and diagnostics
+bool tr_intset_dense(tr_set set);
+
 #endif
@@ -0,0 +1,131 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// slotmap.h - Generational slot map of fixed-size items
+//
+
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <traffic.h>
+
+#include <stdint.h> // for uint32_t
+#include <stdlib.h> // for NULL
+
+#include "memory.h"
+
+typedef void *tr_slotmap; // A slot map
+
+// Items are named by (index, generation) pairs. A slot's generation is odd
+// while an item lives in it and moves on every time the item is freed, so
+// the pair for a freed item never finds whatever reuses its slot. Items
+// stay where they're allocated until they're freed.
+//
+static const unsigned int TR_SLOT_GEN_BITS = 24;
+static const unsigned int TR_SLOT_GEN_MASK = (1u << 24) - 1;
+static const unsigned int TR_SLOT_MAX = 1u << 30;
+
+// Slots are carved out of pages of this many, allocated from the arena as
+// they're needed. Pages never move, so neither do items.
+//
+static const unsigned int TR_SLOTS_PER_PAGE = 256;
+
+// Each item is preceded by its slot's header
+//
+struct _slothdr
+{
+    uint32_t gen;           // Odd while the slot holds an item
+    uint32_t index;         // The slot's index while it holds an item,
+                            // otherwise the next free slot
+};
+
+typedef struct _slothdr slothdr;
+
+// The map itself is only public so that lookups, which every handle goes
+// through, can be inlined
+//
+struct _slotmap
+{
+    tr_arena arena;         // Where the pages come from
+    unsigned int stride;    // Bytes per slot, header included
+    char **pages;           // Page directory
+    unsigned int numpages;  // Number of pages allocated
+    unsigned int maxpages;  // Number of pages there's room for in pages
+    unsigned int used;      // Number of slots ever handed out
+    unsigned int count;     // Number of live items
+    unsigned int freelist;  // The most recently freed slot, or TR_NO_SLOT
+    unsigned int firstgen;  // Generation new slots start at (odd)
+    unsigned int nextgen;   // Later than every generation handed out
+};
+
+typedef struct _slotmap slotmap;
+
+// Marks the end of the free list
+//
+static const unsigned int TR_NO_SLOT = (unsigned int)-1;
+
+static inline slothdr *tr_slot_hdr(slotmap *m, unsigned int index)
+{
+    return (slothdr *)(m->pages[index / TR_SLOTS_PER_PAGE] +
+                       (index % TR_SLOTS_PER_PAGE) * m->stride);
+}
+
+// Creates a slot map whose item storage lives in the given arena, which
+// must outlive it. Slots the map hasn't used before start at the generation
+// after firstgen, or at firstgen itself if that's odd.
+tr_slotmap tr_slotmap_create_in(tr_arena arena, unsigned int itemsize,
+                                unsigned int firstgen);
+
+tr_err tr_slotmap_delete(tr_slotmap map);
+
+// Allocates an (uninitialized) item. Freed slots are reused first, most
+// recently freed first. Returns NULL when out of memory or slots.
+void *tr_slotmap_alloc(tr_slotmap map);
+
+// Frees an item that came from the map, which makes its pair stale
+void tr_slotmap_free(tr_slotmap map, void *item);
+
+// Gets the item with the given index and generation, or NULL if it has
+// been freed (or never existed)
+static inline void *tr_slotmap_get(tr_slotmap map, unsigned int index,
+                                   unsigned int gen)
+{
+    slotmap *m = (slotmap *)map;
+    if (!m || index >= m->used || !(gen & 1)) {
+        return NULL;
+    }
+
+    slothdr *h = tr_slot_hdr(m, index);
+    return h->gen == gen ? h + 1 : NULL;
+}
+
+// Gets the index and generation that name an item
+static inline unsigned int tr_slotmap_index(const void *item)
+{
+    return ((const slothdr *)item - 1)->index;
+}
+
+static inline unsigned int tr_slotmap_gen(const void *item)
+{
+    return ((const slothdr *)item - 1)->gen;
+}
+
+// Gets the number of items
+unsigned int tr_slotmap_count(tr_slotmap map);
+
+// Gets a generation later than every generation the map has handed out,
+// to start a later map's slots at so the two can't be confused
+unsigned int tr_slotmap_next_gen(tr_slotmap map);
+
+// Gets the live item after the given one in slot order, or the first live
+// item if item is NULL. Returns NULL at the end. Items can be freed during
+// a walk, but not the one the walk is on.
+void *tr_slotmap_next(tr_slotmap map, void *item);
+
+#define tr_slotmap_foreach(type, var, map)                  \
+    for (type var = (type)tr_slotmap_next((map), NULL);     \
+         var; var = (type)tr_slotmap_next((map), var))
+
+#endif
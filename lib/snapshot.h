@@ -0,0 +1,101 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// snapshot.h - Frozen, read-only view of a network topology
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <traffic.h>
+
+#include "memory.h"
+
+// The editable model (networks holding hashes of nodes, nodes holding hashes
+// of interfaces) is built for lookups by name, not for walking the graph.
+// When a network is bound, it's compiled into a snapshot: every node,
+// interface and link gets a dense index, and the graph is laid out in
+// compressed sparse row (CSR) form, so everything the forwarding engine and
+// route computation need is in a handful of flat arrays.
+//
+// Node n's interfaces are ifaces[node_ifaces[n] .. node_ifaces[n + 1]).
+// Interface i's links are adj_*[iface_links[i] .. iface_links[i + 1]), each
+// entry naming the link and the interface at its far end. Link attributes
+// are stored as a struct of arrays indexed by link.
+//
+// Apart from links' characteristics, snapshots never change once built.
+// Changing the topology, by reloading the network's config, means building
+// a new one. Readers that only use the snapshot, and never the entities it
+// was built from, can keep going while that happens (see network.h).
+//
+
+// Marks a node slot with no node in it
+//
+#define TR_NO_NODE 0xffffffffu
+
+struct _node;
+struct _iface;
+struct _link;
+struct _network;
+
+struct _snapshot
+{
+    tr_arena arena;             // Backing memory for the arrays below
+
+    unsigned int num_nodes;
+    unsigned int num_ifaces;
+    unsigned int num_links;
+
+    // Nodes, by node index
+    struct _node **nodes;       // The node with each index
+    unsigned int *node_ifaces;  // CSR offsets of each node's ifaces (+1 end)
+
+    // Interfaces, by iface index (grouped by node)
+    struct _iface **ifaces;     // The interface with each index
+    unsigned int *iface_node;   // Node index of each interface
+    unsigned int *iface_links;  // CSR offsets of each iface's links (+1 end)
+
+    // Adjacency, in CSR order
+    unsigned int *adj_link;     // Link index of each adjacency
+    unsigned int *adj_peer;     // Iface index at the far end of each adjacency
+
+    // Links, by link index
+    struct _link **links;       // The link with each index
+    unsigned int *link_ends;    // Iface indexes of each link's endpoints (x2)
+    long *latency;              // Mean latency of each link, in ms
+    long *variance;             // Latency variance of each link, in ms
+    float *droprate;            // Ratio of packets each link drops
+    unsigned char *enabled;     // Whether each link ferries traffic
+
+    // Handles, so that they can be looked up without the network
+    unsigned int num_node_slots; // Node slots the network had used
+    unsigned int *slot_node;    // Node index in each node slot, or TR_NO_NODE
+    tr_node *node_handles;      // Handle of the node with each index
+    tr_iface *iface_handles;    // Handle of the interface with each index
+    tr_link *link_handles;      // Handle of the link with each index
+};
+
+typedef struct _snapshot snapshot;
+
+// Compiles the network's current topology into a new snapshot.
+// Also records each entity's index in the entity itself.
+// Returns NULL if memory runs out.
+//
+snapshot *tr_snapshot_create(struct _network *net);
+
+// Gets the index of the node with the given handle, or TR_NO_NODE if it
+// isn't in the snapshot. Looks at nothing but the snapshot.
+//
+unsigned int tr_snapshot_node(const snapshot *snap, tr_node handle);
+
+// Frees a snapshot. Does not affect the network it was built from.
+//
+void tr_snapshot_delete(snapshot *snap);
+
+// Frees a snapshot once no reader can still be looking at it (see epoch.h)
+//
+void tr_snapshot_retire(snapshot *snap);
+
+#endif
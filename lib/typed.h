@@ -0,0 +1,508 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// typed.h - Generators for statically typed containers
+//
+
+#ifndef TYPED_H
+#define TYPED_H
+
+#include <stdbool.h> // for bool
+#include <stdint.h> // for uint64_t
+#include <stdlib.h> // for NULL
+#include <string.h> // for memset
+
+#include <traffic.h>
+
+#include "group.h"
+#include "hash.h"
+#include "hashfunc.h"
+#include "memory.h"
+
+// tr_hash and tr_vector are sized at runtime: every hash goes through a
+// function pointer, and every key, value and item is copied with a memcpy of
+// a size the compiler can't see. That's what lets one implementation serve
+// every type, but per-packet paths pay for it on every operation.
+//
+// The macros here stamp out a container specialized for one type, in the
+// spirit of khash. Everything is static inline, so the compiler inlines the
+// hash and compare functions and copies keys and items with plain
+// assignments. Define a container once, in a header or at the top of a .c
+// file:
+//
+//     struct _mac { unsigned char bytes[6]; };
+//     typedef struct _mac mac;
+//
+//     #define mac_hash(m, seed) tr_hash64_mac((m).bytes, (seed))
+//     #define mac_equal(m1, m2) (memcmp((m1).bytes, (m2).bytes, 6) == 0)
+//
+//     TR_HASH_DEFINE(machash, mac, int, mac_hash, mac_equal)
+//     TR_VEC_DEFINE(pktvec, packet)
+//
+// The generic void * containers stay as they are; these are for the hot
+// paths that have earned them.
+//
+
+// Compares keys that support ==
+//
+#define tr_typed_equal(a, b) ((a) == (b))
+
+// Walks pointers to each entry in a typed container: tr_<name>_entry is the
+// item type of a vector, and the {key, value} slot type of a hashtable.
+// The container must not be modified during the loop.
+//
+#define tr_typed_foreach(name, var, container)                              \
+    for (tr_##name##_entry *var = tr_##name##_first(container);             \
+         var; var = tr_##name##_next((container), var))
+
+// TR_HASH_DEFINE(name, keytype, valuetype, hashfn, eqfn) defines tr_<name>,
+// a Swiss table from keytype to valuetype laid out like tr_hash (see
+// group.h), with a random seed of its own. Keys and values are held by
+// value. hashfn(key, seed) must return a well-mixed uint64_t (the
+// tr_hash64_* functions in hashfunc.h are), and eqfn(a, b) must return
+// whether two keys are equal; either may be a macro.
+//
+// Unlike tr_hash, the table resizes all at once rather than incrementally.
+//
+//     tr_<name> *tr_<name>_create();
+//     tr_err tr_<name>_delete(tr_<name> *hash);
+//     unsigned int tr_<name>_num_keys(tr_<name> *hash);
+//
+//     // Grows the table so it can hold count items without resizing again
+//     tr_err tr_<name>_reserve(tr_<name> *hash, unsigned int count);
+//
+//     bool tr_<name>_contains(tr_<name> *hash, keytype key);
+//
+//     // Gets a pointer to the key's value, or NULL if it isn't there
+//     valuetype *tr_<name>_get(tr_<name> *hash, keytype key);
+//
+//     // Gets a pointer to the key's value, adding the key (with its value
+//     // uninitialized) if it isn't there. added says which happened.
+//     // Returns NULL if the table couldn't grow.
+//     valuetype *tr_<name>_put(tr_<name> *hash, keytype key, bool *added);
+//
+//     tr_err tr_<name>_set(tr_<name> *hash, keytype key, valuetype value);
+//     tr_err tr_<name>_clear(tr_<name> *hash, keytype key);
+//
+//     tr_<name>_entry *tr_<name>_first(tr_<name> *hash);
+//     tr_<name>_entry *tr_<name>_next(tr_<name> *hash, tr_<name>_entry *item);
+//
+#define TR_HASH_DEFINE(name, keytype, valuetype, hashfn, eqfn)              \
+                                                                            \
+struct _##name##_entry                                                      \
+{                                                                           \
+    keytype key;                                                            \
+    valuetype value;                                                        \
+};                                                                          \
+                                                                            \
+struct _##name                                                              \
+{                                                                           \
+    unsigned int capacity;                                                  \
+    unsigned int numused;                                                   \
+    unsigned int numdeleted;                                                \
+    uint64_t seed;                                                          \
+    unsigned char *ctrl;                                                    \
+    struct _##name##_entry *slots;                                          \
+};                                                                          \
+                                                                            \
+typedef struct _##name##_entry tr_##name##_entry;                           \
+typedef struct _##name tr_##name;                                           \
+                                                                            \
+static inline tr_err tr_##name##_alloc(tr_##name *hash,                     \
+                                       unsigned int capacity)               \
+{                                                                           \
+    unsigned char *ctrl =                                                   \
+        (unsigned char *)tr_calloc(capacity + TR_GROUP_WIDTH, 1);           \
+    tr_##name##_entry *slots = (tr_##name##_entry *)                        \
+        tr_malloc(capacity * sizeof(tr_##name##_entry));                    \
+                                                                            \
+    if (!ctrl || !slots) {                                                  \
+        tr_free(ctrl);                                                      \
+        tr_free(slots);                                                     \
+        return TR_ENOMEM;                                                   \
+    }                                                                       \
+                                                                            \
+    hash->capacity = capacity;                                              \
+    hash->numused = 0;                                                      \
+    hash->numdeleted = 0;                                                   \
+    hash->ctrl = ctrl;                                                      \
+    hash->slots = slots;                                                    \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_##name *tr_##name##_create()                               \
+{                                                                           \
+    tr_##name *hash = (tr_##name *)tr_malloc(sizeof(tr_##name));            \
+    if (!hash) {                                                            \
+        return NULL;                                                        \
+    }                                                                       \
+                                                                            \
+    if (tr_##name##_alloc(hash, TR_GROUP_WIDTH) < 0) {                      \
+        tr_free(hash);                                                      \
+        return NULL;                                                        \
+    }                                                                       \
+                                                                            \
+    hash->seed = tr_hash_random_seed();                                     \
+    return hash;                                                            \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_delete(tr_##name *hash)                    \
+{                                                                           \
+    if (!hash) return TR_EPOINTER;                                          \
+                                                                            \
+    tr_free(hash->ctrl);                                                    \
+    tr_free(hash->slots);                                                   \
+    tr_free(hash);                                                          \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline unsigned int tr_##name##_num_keys(tr_##name *hash)            \
+{                                                                           \
+    return hash ? hash->numused : 0;                                        \
+}                                                                           \
+                                                                            \
+/* Moves every item into a fresh table of the given capacity */             \
+static inline tr_err tr_##name##_rehash(tr_##name *hash,                    \
+                                        unsigned int capacity)              \
+{                                                                           \
+    tr_##name old = *hash;                                                  \
+    if (tr_##name##_alloc(hash, capacity) < 0) {                            \
+        return TR_ENOMEM;                                                   \
+    }                                                                       \
+                                                                            \
+    for (unsigned int i = 0; i < old.capacity; ++i) {                       \
+        if (!(old.ctrl[i] & TR_CTRL_FULL)) {                                \
+            continue;                                                       \
+        }                                                                   \
+                                                                            \
+        uint64_t h = hashfn(old.slots[i].key, hash->seed);                  \
+        unsigned int j = tr_ctrl_find_free(hash->ctrl, capacity, h);        \
+        tr_ctrl_set(hash->ctrl, capacity, j, tr_ctrl_h2(h));                \
+        hash->slots[j] = old.slots[i];                                      \
+    }                                                                       \
+                                                                            \
+    hash->numused = old.numused;                                            \
+    tr_free(old.ctrl);                                                      \
+    tr_free(old.slots);                                                     \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_reserve(tr_##name *hash,                   \
+                                         unsigned int count)                \
+{                                                                           \
+    if (!hash) return TR_EPOINTER;                                          \
+                                                                            \
+    unsigned int capacity = hash->capacity;                                 \
+    while (capacity - capacity / 8 < count) {                               \
+        if (capacity > ~0u / 2) {                                           \
+            return TR_ENOMEM;                                               \
+        }                                                                   \
+                                                                            \
+        capacity *= 2;                                                      \
+    }                                                                       \
+                                                                            \
+    return capacity > hash->capacity                                        \
+         ? tr_##name##_rehash(hash, capacity) : TR_OK;                      \
+}                                                                           \
+                                                                            \
+/* Finds the slot holding key, or returns -1 */                             \
+static inline long tr_##name##_find(tr_##name *hash, keytype key,           \
+                                    uint64_t h)                             \
+{                                                                           \
+    unsigned int mask = hash->capacity - 1;                                 \
+    unsigned int pos = tr_ctrl_h1(h, hash->capacity);                       \
+    unsigned char h2 = tr_ctrl_h2(h);                                       \
+                                                                            \
+    for (unsigned int stride = TR_GROUP_WIDTH; ; stride += TR_GROUP_WIDTH) { \
+        const unsigned char *group = hash->ctrl + pos;                      \
+                                                                            \
+        for (unsigned int m = tr_group_match(group, h2); m; m &= m - 1) {   \
+            unsigned int i = (pos + tr_group_first(m)) & mask;              \
+            if (eqfn(hash->slots[i].key, key)) {                            \
+                return i;                                                   \
+            }                                                               \
+        }                                                                   \
+                                                                            \
+        if (tr_group_match_empty(group)) {                                  \
+            return -1;                                                      \
+        }                                                                   \
+                                                                            \
+        pos = (pos + stride) & mask;                                        \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static inline valuetype *tr_##name##_get(tr_##name *hash, keytype key)      \
+{                                                                           \
+    if (!hash || !hash->numused) return NULL;                               \
+                                                                            \
+    long i = tr_##name##_find(hash, key, hashfn(key, hash->seed));          \
+    return i < 0 ? NULL : &hash->slots[i].value;                            \
+}                                                                           \
+                                                                            \
+static inline bool tr_##name##_contains(tr_##name *hash, keytype key)       \
+{                                                                           \
+    return tr_##name##_get(hash, key) != NULL;                              \
+}                                                                           \
+                                                                            \
+static inline valuetype *tr_##name##_put(tr_##name *hash, keytype key,      \
+                                         bool *added)                       \
+{                                                                           \
+    if (!hash) return NULL;                                                 \
+                                                                            \
+    uint64_t h = hashfn(key, hash->seed);                                   \
+    long i = tr_##name##_find(hash, key, h);                                \
+    if (added) *added = i < 0;                                              \
+    if (i >= 0) {                                                           \
+        return &hash->slots[i].value;                                       \
+    }                                                                       \
+                                                                            \
+    /* Grow at 7/8 full, or just clear out tombstones if they're most */    \
+    /* of the load */                                                       \
+    unsigned int limit = hash->capacity - hash->capacity / 8;               \
+    if (hash->numused + hash->numdeleted + 1 > limit) {                     \
+        unsigned int capacity = hash->numused + 1 <= limit / 2              \
+                              ? hash->capacity : 2 * hash->capacity;        \
+        if (tr_##name##_rehash(hash, capacity) < 0) {                       \
+            return NULL;                                                    \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    unsigned int j = tr_ctrl_find_free(hash->ctrl, hash->capacity, h);      \
+    if (hash->ctrl[j] == TR_CTRL_DELETED) {                                 \
+        hash->numdeleted -= 1;                                              \
+    }                                                                       \
+                                                                            \
+    tr_ctrl_set(hash->ctrl, hash->capacity, j, tr_ctrl_h2(h));              \
+    hash->numused += 1;                                                     \
+    hash->slots[j].key = key;                                               \
+    return &hash->slots[j].value;                                           \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_set(tr_##name *hash, keytype key,          \
+                                     valuetype value)                       \
+{                                                                           \
+    if (!hash) return TR_EPOINTER;                                          \
+                                                                            \
+    valuetype *slot = tr_##name##_put(hash, key, NULL);                     \
+    if (!slot) {                                                            \
+        return TR_ENOMEM;                                                   \
+    }                                                                       \
+                                                                            \
+    *slot = value;                                                          \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_clear(tr_##name *hash, keytype key)        \
+{                                                                           \
+    if (!hash) return TR_EPOINTER;                                          \
+                                                                            \
+    long i = hash->numused                                                  \
+           ? tr_##name##_find(hash, key, hashfn(key, hash->seed)) : -1;     \
+    if (i < 0) {                                                            \
+        return TR_ENOTFOUND;                                                \
+    }                                                                       \
+                                                                            \
+    if (tr_ctrl_erase(hash->ctrl, hash->capacity, i)) {                     \
+        hash->numdeleted += 1;                                              \
+    }                                                                       \
+    hash->numused -= 1;                                                     \
+                                                                            \
+    /* Shrink at 1/8 full, as tr_hash does; failing to is harmless */       \
+    if (hash->capacity > TR_GROUP_WIDTH &&                                  \
+        hash->numused <= hash->capacity / 8) {                              \
+        tr_##name##_rehash(hash, hash->capacity / 2);                       \
+    }                                                                       \
+                                                                            \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_##name##_entry *tr_##name##_next(tr_##name *hash,          \
+                                                 tr_##name##_entry *item)   \
+{                                                                           \
+    if (!hash) return NULL;                                                 \
+                                                                            \
+    unsigned int i = item ? (unsigned int)(item - hash->slots) + 1 : 0;     \
+    while (i < hash->capacity) {                                            \
+        /* Mask off the mirrored bytes past the end of the table */         \
+        unsigned int m = tr_group_match_full(hash->ctrl + i);               \
+        if (hash->capacity - i < TR_GROUP_WIDTH) {                          \
+            m &= (1u << (hash->capacity - i)) - 1;                          \
+        }                                                                   \
+                                                                            \
+        if (m) {                                                            \
+            return &hash->slots[i + tr_group_first(m)];                     \
+        }                                                                   \
+                                                                            \
+        i += TR_GROUP_WIDTH;                                                \
+    }                                                                       \
+                                                                            \
+    return NULL;                                                            \
+}                                                                           \
+                                                                            \
+static inline tr_##name##_entry *tr_##name##_first(tr_##name *hash)         \
+{                                                                           \
+    return tr_##name##_next(hash, NULL);                                    \
+}
+
+// TR_VEC_DEFINE(name, type) defines tr_<name>, a growable array of type.
+// Items are copied in and out by assignment. Unlike tr_vector, it never
+// gives memory back by itself, since per-packet queues that fill and drain
+// constantly would otherwise keep reallocating.
+//
+//     tr_<name> *tr_<name>_create(unsigned int capacity);
+//     tr_err tr_<name>_delete(tr_<name> *vec);
+//
+//     unsigned int tr_<name>_size(tr_<name> *vec);
+//     unsigned int tr_<name>_capacity(tr_<name> *vec);
+//     tr_err tr_<name>_reserve(tr_<name> *vec, unsigned int capacity);
+//
+//     type *tr_<name>_item(tr_<name> *vec, unsigned int index);
+//     type *tr_<name>_items(tr_<name> *vec);
+//
+//     tr_err tr_<name>_append(tr_<name> *vec, type item);
+//     tr_err tr_<name>_remove_at(tr_<name> *vec, unsigned int index);
+//     type *tr_<name>_peek(tr_<name> *vec);
+//     tr_err tr_<name>_pop(tr_<name> *vec);
+//     void tr_<name>_clear(tr_<name> *vec);
+//
+//     type *tr_<name>_first(tr_<name> *vec);
+//     type *tr_<name>_next(tr_<name> *vec, type *item);
+//
+#define TR_VEC_DEFINE(name, type)                                           \
+                                                                            \
+struct _##name                                                              \
+{                                                                           \
+    unsigned int size;                                                      \
+    unsigned int capacity;                                                  \
+    type *items;                                                            \
+};                                                                          \
+                                                                            \
+typedef type tr_##name##_entry;                                             \
+typedef struct _##name tr_##name;                                           \
+                                                                            \
+static inline tr_err tr_##name##_reserve(tr_##name *vec,                    \
+                                         unsigned int capacity)             \
+{                                                                           \
+    if (!vec) return TR_EPOINTER;                                           \
+    if (capacity <= vec->capacity) return TR_OK;                            \
+                                                                            \
+    type *items = (type *)tr_realloc(vec->items, capacity * sizeof(type));  \
+    if (!items) {                                                           \
+        return TR_ENOMEM;                                                   \
+    }                                                                       \
+                                                                            \
+    vec->items = items;                                                     \
+    vec->capacity = capacity;                                               \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_##name *tr_##name##_create(unsigned int capacity)          \
+{                                                                           \
+    tr_##name *vec = (tr_##name *)tr_malloc(sizeof(tr_##name));             \
+    if (!vec) {                                                             \
+        return NULL;                                                        \
+    }                                                                       \
+                                                                            \
+    memset(vec, 0, sizeof(tr_##name));                                      \
+    if (tr_##name##_reserve(vec, capacity) < 0) {                           \
+        tr_free(vec);                                                       \
+        return NULL;                                                        \
+    }                                                                       \
+                                                                            \
+    return vec;                                                             \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_delete(tr_##name *vec)                     \
+{                                                                           \
+    if (!vec) return TR_EPOINTER;                                           \
+                                                                            \
+    tr_free(vec->items);                                                    \
+    tr_free(vec);                                                           \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline unsigned int tr_##name##_size(tr_##name *vec)                 \
+{                                                                           \
+    return vec ? vec->size : 0;                                             \
+}                                                                           \
+                                                                            \
+static inline unsigned int tr_##name##_capacity(tr_##name *vec)             \
+{                                                                           \
+    return vec ? vec->capacity : 0;                                         \
+}                                                                           \
+                                                                            \
+static inline type *tr_##name##_item(tr_##name *vec, unsigned int index)    \
+{                                                                           \
+    return vec ? &vec->items[index] : NULL;                                 \
+}                                                                           \
+                                                                            \
+static inline type *tr_##name##_items(tr_##name *vec)                       \
+{                                                                           \
+    return vec ? vec->items : NULL;                                         \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_append(tr_##name *vec, type item)          \
+{                                                                           \
+    if (!vec) return TR_EPOINTER;                                           \
+                                                                            \
+    if (vec->size == vec->capacity) {                                       \
+        unsigned int capacity = vec->capacity ? 2 * vec->capacity : 4;      \
+        if (capacity <= vec->capacity) {                                    \
+            return TR_ENOMEM;                                               \
+        }                                                                   \
+                                                                            \
+        tr_err err = tr_##name##_reserve(vec, capacity);                    \
+        if (err < 0) {                                                      \
+            return err;                                                     \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    vec->items[vec->size++] = item;                                         \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_remove_at(tr_##name *vec,                  \
+                                           unsigned int index)              \
+{                                                                           \
+    if (!vec) return TR_EPOINTER;                                           \
+    if (index >= vec->size) return TR_EOUTOFRANGE;                          \
+                                                                            \
+    memmove(&vec->items[index], &vec->items[index + 1],                     \
+            (vec->size - index - 1) * sizeof(type));                        \
+    vec->size -= 1;                                                         \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline type *tr_##name##_peek(tr_##name *vec)                        \
+{                                                                           \
+    return vec && vec->size ? &vec->items[vec->size - 1] : NULL;            \
+}                                                                           \
+                                                                            \
+static inline tr_err tr_##name##_pop(tr_##name *vec)                        \
+{                                                                           \
+    if (!vec) return TR_EPOINTER;                                           \
+    if (!vec->size) return TR_ESTACKEMPTY;                                  \
+                                                                            \
+    vec->size -= 1;                                                         \
+    return TR_OK;                                                           \
+}                                                                           \
+                                                                            \
+static inline void tr_##name##_clear(tr_##name *vec)                        \
+{                                                                           \
+    if (vec) vec->size = 0;                                                 \
+}                                                                           \
+                                                                            \
+static inline type *tr_##name##_first(tr_##name *vec)                       \
+{                                                                           \
+    return vec && vec->size ? vec->items : NULL;                            \
+}                                                                           \
+                                                                            \
+static inline type *tr_##name##_next(tr_##name *vec, type *item)            \
+{                                                                           \
+    if (!vec || !item) return NULL;                                         \
+    return item + 1 < vec->items + vec->size ? item + 1 : NULL;             \
+}
+
+#endif
@@ -0,0 +1,557 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// chash.c - Concurrent sharded hashtable
+//
+
+#include <pthread.h> // for pthread_mutex_t and friends
+#include <stdint.h> // for uint32_t, uint64_t
+#include <stdlib.h> // for NULL
+#include <string.h> // for memcpy, memset
+
+#include "chash.h"
+#include "epoch.h"
+#include "memory.h"
+
+// The table is split into NUM_SHARDS independent open-addressed tables,
+// chosen by the top bits of each key's hash. Each shard has its own writer
+// lock and sequence counter, padded out to its own cache lines so threads
+// working in different shards don't contend.
+//
+// Readers never lock. A shard's sequence counter is odd while a writer is
+// modifying the shard in place; readers snapshot the counter, probe the
+// table, and retry if the counter changed underneath them (a seqlock).
+// Candidate slots are copied out and rechecked against the counter before
+// equalfunc ever sees them, so it's never called on a half-written key.
+//
+// Growing a shard builds a whole new table off to the side and publishes it
+// with a single pointer store. Readers may still be probing the old table,
+// so it's retired rather than freed, and reclaimed once no reader can
+// still see it (see epoch.h).
+//
+
+#define NUM_SHARDS 64
+#define SHARD_BITS 6
+#define CACHE_LINE 64
+
+// Smallest per-shard table. Must be a power of two.
+//
+static const unsigned int MIN_CAPACITY = 16;
+
+// Slot tags. Every slot starts with a 32-bit tag that's either one of these
+// or bits of the hash of the key in that slot (remapped to avoid these).
+//
+static const uint32_t TAG_EMPTY = 0;
+static const uint32_t TAG_DELETED = 1;
+
+struct _ctable;
+struct _shard;
+struct _chash;
+
+typedef struct _ctable ctable;
+typedef struct _shard shard;
+typedef struct _chash chash;
+
+struct _ctable
+{
+    unsigned int capacity;  // Number of slots in the table (a power of two)
+    unsigned int used;      // Number of occupied slots
+    unsigned int deleted;   // Number of tombstones
+    unsigned int reserved;  // Keeps the slots 16-byte aligned
+    // capacity slots follow
+};
+
+struct _shard
+{
+    unsigned int seq;       // Odd while a writer is modifying the table
+    unsigned int count;     // Number of keys in the shard
+    ctable *table;          // The shard's current table
+    pthread_mutex_t lock;   // Held by writers
+};
+
+struct _chash
+{
+    unsigned int keysize;   // Size of each key, in bytes
+    unsigned int valuesize; // Size of each value, in bytes
+    unsigned int keyoff;    // Offset of the key within a slot, in bytes
+    unsigned int valueoff;  // Offset of the value within a slot, in bytes
+    unsigned int slotsize;  // Size of each slot, in bytes
+    unsigned int stride;    // Distance between shards, in bytes
+
+    tr_hashfunc hashfunc;   // Uniformly hashes input keys
+    tr_equalfunc equalfunc; // Determines whether two keys are equivalent
+
+    void *shardmem;         // The allocation the shards live in
+    char *shards;           // NUM_SHARDS shards, each on its own cache lines
+};
+
+
+//
+// Tables.
+// Except for tr_chash_read, everything here runs with the shard locked.
+//
+
+static void tr_chash_pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static unsigned int tr_chash_roundup(unsigned int size, unsigned int align)
+{
+    return (size + align - 1) & ~(align - 1);
+}
+
+static uint64_t tr_chash_hash(chash *hash, const void *key)
+{
+    // The MurmurHash3 finalizer, so every bit of the user's hash feeds the
+    // shard, slot and tag bits alike
+    uint64_t h = hash->hashfunc(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static uint32_t tr_chash_tag(uint64_t h)
+{
+    uint32_t tag = (uint32_t)(h >> 32);
+    return tag > TAG_DELETED ? tag : tag + 2;
+}
+
+static shard *tr_chash_shard(chash *hash, uint64_t h)
+{
+    unsigned int i = (unsigned int)(h >> (64 - SHARD_BITS));
+    return (shard *)(hash->shards + i * hash->stride);
+}
+
+static char *tr_ctable_slot(chash *hash, ctable *t, unsigned int i)
+{
+    return (char *)(t + 1) + i * hash->slotsize;
+}
+
+static uint32_t *tr_ctable_tag(char *slot)
+{
+    return (uint32_t *)slot;
+}
+
+static ctable *tr_ctable_create(chash *hash, unsigned int capacity)
+{
+    ctable *t = (ctable *)tr_calloc(1, sizeof(ctable) + capacity * hash->slotsize);
+    if (t) {
+        t->capacity = capacity;
+    }
+
+    return t;
+}
+
+// Finds the slot holding the given key, or -1
+//
+static long tr_ctable_find(chash *hash, ctable *t, const void *key, uint64_t h)
+{
+    uint32_t tag = tr_chash_tag(h);
+    unsigned int mask = t->capacity - 1;
+    unsigned int i = (unsigned int)h & mask;
+
+    for (unsigned int n = 0; n < t->capacity; ++n, i = (i + 1) & mask) {
+        char *slot = tr_ctable_slot(hash, t, i);
+        uint32_t stag = *tr_ctable_tag(slot);
+
+        if (stag == TAG_EMPTY) {
+            break;
+        }
+
+        if (stag == tag && hash->equalfunc(slot + hash->keyoff, key)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Finds the first empty or deleted slot on the key's probe path.
+// The table must not be full.
+//
+static unsigned int tr_ctable_find_free(ctable *t, chash *hash, uint64_t h)
+{
+    unsigned int mask = t->capacity - 1;
+    unsigned int i = (unsigned int)h & mask;
+
+    while (*tr_ctable_tag(tr_ctable_slot(hash, t, i)) > TAG_DELETED) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static void tr_chash_write_begin(shard *s)
+{
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void tr_chash_write_end(shard *s)
+{
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Makes sure the shard's table has room for one more key, replacing it with
+// a bigger (or just tombstone-free) one if not
+//
+static tr_err tr_chash_reserve_one(chash *hash, shard *s)
+{
+    ctable *old = s->table;
+    if ((old->used + old->deleted + 1) * 4 <= old->capacity * 3) {
+        return TR_OK;
+    }
+
+    unsigned int capacity = old->capacity;
+    while ((old->used + 1) * 2 > capacity) {
+        capacity *= 2;
+    }
+
+    ctable *t = tr_ctable_create(hash, capacity);
+    if (!t) {
+        return TR_ENOMEM;
+    }
+
+    for (unsigned int i = 0; i < old->capacity; ++i) {
+        char *slot = tr_ctable_slot(hash, old, i);
+        if (*tr_ctable_tag(slot) > TAG_DELETED) {
+            uint64_t h = tr_chash_hash(hash, slot + hash->keyoff);
+            unsigned int j = tr_ctable_find_free(t, hash, h);
+
+            memcpy(tr_ctable_slot(hash, t, j), slot, hash->slotsize);
+            t->used += 1;
+        }
+    }
+
+    // The new table is complete before anyone can see it, and the old one
+    // is never written again, so readers of either see a consistent table
+    __atomic_store_n(&s->table, t, __ATOMIC_RELEASE);
+    tr_epoch_retire(old, tr_free);
+
+    return TR_OK;
+}
+
+// Looks a key up without locking, copying its value out if found
+//
+static bool tr_chash_read(chash *hash, const void *key, void *value)
+{
+    uint64_t h = tr_chash_hash(hash, key);
+    uint32_t tag = tr_chash_tag(h);
+    shard *s = tr_chash_shard(hash, h);
+
+    char buf[hash->slotsize];
+    bool found = false;
+
+    tr_epoch epoch = tr_epoch_enter();
+
+    for (;;) {
+        unsigned int seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            tr_chash_pause();
+            continue;
+        }
+
+        ctable *t = __atomic_load_n(&s->table, __ATOMIC_ACQUIRE);
+        unsigned int mask = t->capacity - 1;
+        unsigned int i = (unsigned int)h & mask;
+        bool torn = false;
+
+        found = false;
+
+        for (unsigned int n = 0; n < t->capacity; ++n, i = (i + 1) & mask) {
+            char *slot = tr_ctable_slot(hash, t, i);
+            uint32_t stag = __atomic_load_n(tr_ctable_tag(slot), __ATOMIC_RELAXED);
+
+            if (stag == TAG_EMPTY) {
+                break;
+            }
+
+            if (stag != tag) {
+                continue;
+            }
+
+            // Only compare keys we know weren't being written as we copied
+            memcpy(buf, slot, hash->slotsize);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq) {
+                torn = true;
+                break;
+            }
+
+            if (hash->equalfunc(buf + hash->keyoff, key)) {
+                found = true;
+                break;
+            }
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!torn && __atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+
+    tr_epoch_leave(epoch);
+
+    if (found && value) {
+        memcpy(value, buf + hash->valueoff, hash->valuesize);
+    }
+
+    return found;
+}
+
+
+//
+// Public interface
+//
+
+tr_chash tr_chash_create(unsigned int keysize,
+                         unsigned int valuesize,
+                         tr_hashfunc hashfunc,
+                         tr_equalfunc equalfunc)
+{
+    if (!hashfunc || !equalfunc) return NULL;
+
+    chash *hash = (chash *)tr_malloc(sizeof(chash));
+    if (!hash) {
+        return NULL;
+    }
+
+    hash->keysize = keysize;
+    hash->valuesize = valuesize;
+
+    // Slots are as small as the key and value allow: eight-byte-multiple
+    // keys and values are 8-byte aligned, anything else 4-byte aligned
+    unsigned int keyalign = keysize % 8 ? 4 : 8;
+    unsigned int valuealign = valuesize % 8 ? 4 : 8;
+    unsigned int slotalign = keyalign > valuealign ? keyalign : valuealign;
+
+    hash->keyoff = tr_chash_roundup(sizeof(uint32_t), keyalign);
+    hash->valueoff = tr_chash_roundup(hash->keyoff + keysize, valuealign);
+    hash->slotsize = tr_chash_roundup(hash->valueoff + valuesize, slotalign);
+    hash->stride = tr_chash_roundup(sizeof(shard), CACHE_LINE);
+    hash->hashfunc = hashfunc;
+    hash->equalfunc = equalfunc;
+
+    hash->shardmem = tr_calloc(1, NUM_SHARDS * hash->stride + CACHE_LINE);
+    if (!hash->shardmem) {
+        tr_free(hash);
+        return NULL;
+    }
+
+    uintptr_t base = (uintptr_t)hash->shardmem;
+    hash->shards = (char *)((base + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+
+    for (unsigned int i = 0; i < NUM_SHARDS; ++i) {
+        shard *s = (shard *)(hash->shards + i * hash->stride);
+        pthread_mutex_init(&s->lock, NULL);
+        s->table = tr_ctable_create(hash, MIN_CAPACITY);
+
+        if (!s->table) {
+            // Unwind the shards made so far, this one included
+            for (unsigned int k = 0; k <= i; ++k) {
+                shard *made = (shard *)(hash->shards + k * hash->stride);
+                pthread_mutex_destroy(&made->lock);
+                tr_free(made->table);
+            }
+
+            tr_free(hash->shardmem);
+            tr_free(hash);
+            return NULL;
+        }
+    }
+
+    return hash;
+}
+
+tr_err tr_chash_delete(tr_chash trh)
+{
+    if (!trh) return TR_EPOINTER;
+
+    chash *hash = (chash *)trh;
+
+    for (unsigned int i = 0; i < NUM_SHARDS; ++i) {
+        shard *s = (shard *)(hash->shards + i * hash->stride);
+        pthread_mutex_destroy(&s->lock);
+        tr_free(s->table);
+    }
+
+    tr_free(hash->shardmem);
+    tr_free(hash);
+
+    // The tables the hash outgrew may still be in limbo
+    tr_epoch_drain();
+
+    return TR_OK;
+}
+
+bool tr_chash_contains(tr_chash trh, const void *key)
+{
+    if (!trh) return false;
+    return tr_chash_read((chash *)trh, key, NULL);
+}
+
+tr_err tr_chash_get(tr_chash trh, const void *key, void *value)
+{
+    if (!trh) return TR_EPOINTER;
+    return tr_chash_read((chash *)trh, key, value) ? TR_OK : TR_ENOTFOUND;
+}
+
+// Runs func on the key's value (or a zeroed one, if the key is new), or
+// just stores value if there's no func
+//
+static tr_err tr_chash_write(chash *hash, const void *key, const void *value,
+                             tr_chash_updatefunc func, void *ctx)
+{
+    uint64_t h = tr_chash_hash(hash, key);
+    shard *s = tr_chash_shard(hash, h);
+    tr_err err = TR_OK;
+
+    pthread_mutex_lock(&s->lock);
+
+    long i = tr_ctable_find(hash, s->table, key, h);
+    if (i >= 0) {
+        char *slot = tr_ctable_slot(hash, s->table, i);
+
+        tr_chash_write_begin(s);
+        if (func) {
+            func(slot + hash->valueoff, false, ctx);
+        }
+        else {
+            memcpy(slot + hash->valueoff, value, hash->valuesize);
+        }
+        tr_chash_write_end(s);
+    }
+    else if ((err = tr_chash_reserve_one(hash, s)) == TR_OK) {
+        ctable *t = s->table;
+        unsigned int j = tr_ctable_find_free(t, hash, h);
+        char *slot = tr_ctable_slot(hash, t, j);
+
+        tr_chash_write_begin(s);
+        if (*tr_ctable_tag(slot) == TAG_DELETED) {
+            t->deleted -= 1;
+        }
+
+        memcpy(slot + hash->keyoff, key, hash->keysize);
+        if (func) {
+            memset(slot + hash->valueoff, 0, hash->valuesize);
+            func(slot + hash->valueoff, true, ctx);
+        }
+        else {
+            memcpy(slot + hash->valueoff, value, hash->valuesize);
+        }
+
+        *tr_ctable_tag(slot) = tr_chash_tag(h);
+        t->used += 1;
+        tr_chash_write_end(s);
+
+        __atomic_store_n(&s->count, s->count + 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&s->lock);
+    return err;
+}
+
+tr_err tr_chash_set(tr_chash trh, const void *key, const void *value)
+{
+    if (!trh) return TR_EPOINTER;
+    if (!value && ((chash *)trh)->valuesize) return TR_EPOINTER;
+
+    return tr_chash_write((chash *)trh, key, value, NULL, NULL);
+}
+
+tr_err tr_chash_update(tr_chash trh, const void *key,
+                       tr_chash_updatefunc func, void *ctx)
+{
+    if (!trh) return TR_EPOINTER;
+    if (!func) return TR_EPOINTER;
+
+    return tr_chash_write((chash *)trh, key, NULL, func, ctx);
+}
+
+tr_err tr_chash_clear(tr_chash trh, const void *key)
+{
+    if (!trh) return TR_EPOINTER;
+
+    chash *hash = (chash *)trh;
+    uint64_t h = tr_chash_hash(hash, key);
+    shard *s = tr_chash_shard(hash, h);
+
+    pthread_mutex_lock(&s->lock);
+
+    ctable *t = s->table;
+    long i = tr_ctable_find(hash, t, key, h);
+    if (i < 0) {
+        pthread_mutex_unlock(&s->lock);
+        return TR_ENOTFOUND;
+    }
+
+    tr_chash_write_begin(s);
+    *tr_ctable_tag(tr_ctable_slot(hash, t, i)) = TAG_DELETED;
+    t->used -= 1;
+    t->deleted += 1;
+    tr_chash_write_end(s);
+
+    __atomic_store_n(&s->count, s->count - 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&s->lock);
+    return TR_OK;
+}
+
+unsigned int tr_chash_num_keys(tr_chash trh)
+{
+    if (!trh) return 0;
+
+    chash *hash = (chash *)trh;
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < NUM_SHARDS; ++i) {
+        shard *s = (shard *)(hash->shards + i * hash->stride);
+        count += __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    }
+
+    return count;
+}
+
+tr_chash tr_intchash_create(unsigned int itemsize)
+{
+    return tr_chash_create(sizeof(int),
+                           itemsize,
+                           tr_hashfunc_int,
+                           tr_equalfunc_int);
+}
+
+bool tr_intchash_contains(tr_chash hash, int key)
+{
+    return tr_chash_contains(hash, &key);
+}
+
+tr_err tr_intchash_get(tr_chash hash, int key, void *value)
+{
+    return tr_chash_get(hash, &key, value);
+}
+
+tr_err tr_intchash_set(tr_chash hash, int key, const void *value)
+{
+    return tr_chash_set(hash, &key, value);
+}
+
+tr_err tr_intchash_clear(tr_chash hash, int key)
+{
+    return tr_chash_clear(hash, &key);
+}
+
+tr_err tr_intchash_update(tr_chash hash, int key,
+                          tr_chash_updatefunc func, void *ctx)
+{
+    return tr_chash_update(hash, &key, func, ctx);
+}
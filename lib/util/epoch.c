@@ -0,0 +1,229 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// epoch.c - Epoch-based reclamation of memory shared between threads
+//
+
+#include <pthread.h> // for pthread_mutex_t, pthread_once, pthread_key_t
+#include <sched.h>  // for sched_yield
+#include <stdlib.h> // for NULL
+
+#include "epoch.h"
+#include "memory.h"
+
+struct _epochrec;
+struct _limbo;
+
+typedef struct _epochrec epochrec;
+typedef struct _limbo limbo;
+
+struct _epochrec
+{
+    unsigned long epoch;    // Global epoch seen when the thread went active
+    unsigned int active;    // Whether the thread is reading
+    unsigned int inuse;     // Whether a live thread owns this record
+    unsigned int depth;     // How deeply the thread's reads are nested
+    epochrec *next;         // The next record in the global list
+};
+
+// Something waiting to be freed
+//
+struct _limbo
+{
+    void *ptr;
+    tr_retirefunc func;
+    limbo *next;            // The next item retired in the same epoch
+};
+
+// Shared by everything in the process that reclaims memory this way
+//
+static unsigned long g_epoch = 0;                   // The global epoch
+static epochrec *g_records = NULL;                  // Every thread's record
+static unsigned int g_strays = 0;                   // Readers with no record
+static limbo *g_limbo[3] = { NULL, NULL, NULL };    // Retired, by epoch % 3
+static pthread_mutex_t g_limbolock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t g_epochonce = PTHREAD_ONCE_INIT;
+static pthread_key_t g_epochkey;
+static __thread epochrec *t_record = NULL;
+
+// Hands a record back for reuse when its thread exits
+//
+static void tr_epoch_release(void *ptr)
+{
+    epochrec *rec = (epochrec *)ptr;
+    rec->depth = 0;
+    __atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&rec->inuse, 0, __ATOMIC_RELEASE);
+}
+
+static void tr_epoch_init()
+{
+    pthread_key_create(&g_epochkey, tr_epoch_release);
+}
+
+// Finds (or makes) an epoch record for the calling thread. Returns NULL if
+// memory runs out.
+//
+static epochrec *tr_epoch_register()
+{
+    pthread_once(&g_epochonce, tr_epoch_init);
+
+    epochrec *rec = __atomic_load_n(&g_records, __ATOMIC_ACQUIRE);
+    for (; rec; rec = rec->next) {
+        unsigned int expected = 0;
+        if (__atomic_compare_exchange_n(&rec->inuse, &expected, 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!rec) {
+        // Records are never freed, so pushing is the only list operation
+        rec = (epochrec *)tr_calloc(1, sizeof(epochrec));
+        if (!rec) {
+            return NULL;
+        }
+
+        rec->inuse = 1;
+        rec->next = __atomic_load_n(&g_records, __ATOMIC_RELAXED);
+
+        while (!__atomic_compare_exchange_n(&g_records, &rec->next, rec, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    pthread_setspecific(g_epochkey, rec);
+    t_record = rec;
+
+    return rec;
+}
+
+tr_epoch tr_epoch_enter()
+{
+    epochrec *rec = t_record ? t_record : tr_epoch_register();
+
+    if (!rec) {
+        __atomic_add_fetch(&g_strays, 1, __ATOMIC_SEQ_CST);
+        return NULL;
+    }
+
+    if (rec->depth++ == 0) {
+        __atomic_store_n(&rec->active, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&rec->epoch, __atomic_load_n(&g_epoch, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+
+        // Our announcement must be visible before we read anything shared
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    return rec;
+}
+
+void tr_epoch_leave(tr_epoch rec)
+{
+    if (!rec) {
+        __atomic_sub_fetch(&g_strays, 1, __ATOMIC_RELEASE);
+    }
+    else if (--rec->depth == 0) {
+        __atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// Advances the global epoch if every active reader has seen the current
+// one, and frees whatever that makes unreachable.
+// Must be called with g_limbolock held.
+//
+static void tr_epoch_collect()
+{
+    unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&g_strays, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    epochrec *rec = __atomic_load_n(&g_records, __ATOMIC_ACQUIRE);
+    for (; rec; rec = rec->next) {
+        if (__atomic_load_n(&rec->inuse, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&rec->active, __ATOMIC_SEQ_CST) &&
+            __atomic_load_n(&rec->epoch, __ATOMIC_SEQ_CST) != epoch) {
+            return;
+        }
+    }
+
+    __atomic_store_n(&g_epoch, epoch + 1, __ATOMIC_SEQ_CST);
+
+    // Everything in this list was retired two epochs before the one we just
+    // left, and every active reader has since seen a later epoch
+    limbo *item = g_limbo[(epoch + 1) % 3];
+    g_limbo[(epoch + 1) % 3] = NULL;
+
+    while (item) {
+        limbo *next = item->next;
+        item->func(item->ptr);
+        tr_free(item);
+        item = next;
+    }
+}
+
+// Waits for the epoch to reach the given one, collecting as it goes.
+// Must be called with g_limbolock held.
+//
+static void tr_epoch_wait(unsigned long target)
+{
+    // Reads are short, so the epoch can't be held up for long
+    while ((long)(__atomic_load_n(&g_epoch, __ATOMIC_RELAXED) - target) < 0) {
+        unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_RELAXED);
+        tr_epoch_collect();
+
+        if (__atomic_load_n(&g_epoch, __ATOMIC_RELAXED) == epoch) {
+            pthread_mutex_unlock(&g_limbolock);
+            sched_yield();
+            pthread_mutex_lock(&g_limbolock);
+        }
+    }
+}
+
+void tr_epoch_retire(void *ptr, tr_retirefunc func)
+{
+    if (!ptr || !func) {
+        return;
+    }
+
+    limbo *item = (limbo *)tr_malloc(sizeof(limbo));
+    pthread_mutex_lock(&g_limbolock);
+
+    unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_RELAXED);
+
+    if (item) {
+        item->ptr = ptr;
+        item->func = func;
+        item->next = g_limbo[epoch % 3];
+        g_limbo[epoch % 3] = item;
+
+        tr_epoch_collect();
+    }
+    else {
+        // Two advances see off every reader that was in when it was retired
+        tr_epoch_wait(epoch + 2);
+    }
+
+    pthread_mutex_unlock(&g_limbolock);
+
+    if (!item) {
+        func(ptr);
+    }
+}
+
+void tr_epoch_drain()
+{
+    pthread_mutex_lock(&g_limbolock);
+
+    // What was retired in this epoch is freed on the way out of the one
+    // two after it
+    tr_epoch_wait(__atomic_load_n(&g_epoch, __ATOMIC_RELAXED) + 3);
+
+    pthread_mutex_unlock(&g_limbolock);
+}
@@ -7,298 +7,531 @@
 //
 
 #include <assert.h> // for assert()
+#include <stdint.h> // for uint64_t
 #include <stdlib.h> // for NULL
 #include <string.h> // for memset
 
+#include "group.h"
 #include "hash.h"
 #include "memory.h"
 #include "vector.h"
 
-struct _hashitem;
+// The table is an open-addressed 'Swiss table' (see group.h for the layout
+// of its control bytes).
+//
+// Since EMPTY is zero, new tables get their control bytes from calloc, whose
+// pages the OS hands out lazily, instead of paying to initialize a huge
+// array in one go.
+//
+
+// The smallest table we'll allocate. Must be a power of two >= TR_GROUP_WIDTH.
+//
+static const unsigned int MIN_CAPACITY = TR_GROUP_WIDTH;
+
+struct _table;
 struct _hashtable;
 
-typedef struct _hashitem hashitem;
+typedef struct _table table;
 typedef struct _hashtable hashtable;
 
-struct _hashitem
+struct _table
 {
-    unsigned int occupied;  // Boolean indicating whether slot is in use
-    hashitem *next;         // Next item that shares the same hash value
-    // Next hashtable->keysize bytes contain the key
-    // Then hashtable->valuesize bytes containing the value
+    unsigned int capacity;  // Number of slots in the table (a power of two)
+    unsigned int numused;   // Number of occupied slots in the table
+    unsigned int numdeleted;// Number of tombstones in the table
+
+    unsigned char *ctrl;    // capacity + TR_GROUP_WIDTH control bytes
+    void *slots;            // Table of key/value slots
 };
 
 struct _hashtable
 {
     unsigned int keysize;   // Size of each key, in bytes
     unsigned int valuesize; // Size of each value, in bytes
+    unsigned int valueoff;  // Offset of the value within a slot, in bytes
+    unsigned int slotsize;  // Size of each slot, in bytes
 
-    tr_hashfunc hashfunc;   // Uniformly hashes input keys
+    tr_hashfunc hashfunc;   // Uniformly hashes input keys...
+    tr_hashfunc64 hashfunc64; // ...or does so with a seed
+    uint64_t seed;          // The table's seed for hashfunc64
     tr_equalfunc equalfunc; // Determines whether two keys are equivalent
 
-    unsigned int capacity;  // Number of items in the table
-    unsigned int numused;   // Number of occupied items in the table
-    unsigned int cellar;    // Start of the cellar region (see below)
-
-    void *items;            // Table of hashitems
+    table cur;              // The table new items are inserted into
+    table old;              // The table being migrated away from, if any
+    unsigned int migrated;  // Slots of old that have been migrated so far
+    bool incremental;       // Whether resizes are spread across operations
 };
 
-// The portion of the hashtable that is reserved for the 'cellar.'
+// In incremental mode, the number of old-table slots each write migrates.
+// Growing doubles the capacity, so the new table has room for at least
+// (capacity * 7/8) more inserts before it fills; migrating a couple of slots
+// per write would be enough to drain the old table in time. We do more so
+// that the old table (and the double lookups it costs) goes away quickly.
 //
-// In coalesced hashing, the cellar is a portion of the table reserved for
-// items whose hashes conflict with another item already in the table.
-// By separating out this part of the table, we guarantee that chains of
-// values with different hash addresses don't coalesce until the cellar 
-// is full.
+static const unsigned int MIGRATE_STEP = 64;
+
+// Gets the alignment we'll give a field of the given size in a slot
 //
-static const double CELLAR = .14;
+static unsigned int tr_hash_align(unsigned int size)
+{
+    unsigned int align = size & -size;
+    return (align == 0 || align > 8) ? 8 : align;
+}
 
-// Gets the index in the hashtable's item table for the given key
+// Rounds size up to the next multiple of align (a power of two)
 //
-static unsigned int tr_hash_addr(hashtable *hash, const void *key)
+static unsigned int tr_hash_roundup(unsigned int size, unsigned int align)
 {
-    // % hash->cellar: hash to any bucket before the cellar starts
-    return hash->hashfunc(key) % hash->cellar;
+    return (size + align - 1) & ~(align - 1);
 }
 
-// Gets the i'th item from the hashtable's item table
+// Hashes a key, scrambling the bits of the user's hash so that both the
+// low bits (the control byte) and the high bits (the slot index) are usable.
+// Seeded hashes are already well mixed, and used as they are.
 //
-static hashitem *tr_hash_item(hashtable *hash, unsigned int i)
+static uint64_t tr_hash_hash(hashtable *hash, const void *key)
 {
-    unsigned int size = sizeof(hashitem) + hash->keysize + hash->valuesize;
-    return (hashitem*)((char*)hash->items + i * size);
+    if (hash->hashfunc64) {
+        return hash->hashfunc64(key, hash->seed);
+    }
+
+    // This is the 64-bit finalizer from MurmurHash3
+    uint64_t h = hash->hashfunc(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
 }
 
-// Gets the key for a hash table item
+// Gets the i'th slot from a table
 //
-static void *tr_hashitem_key(hashtable *hash, hashitem *item)
+static void *tr_hash_slot(hashtable *hash, table *t, unsigned int i)
 {
-    return (char*)item + sizeof(hashitem);
+    return (char*)t->slots + (size_t)i * hash->slotsize;
 }
 
-// Gets the value for a hash table item
+// Gets the key stored in a slot
 //
-static void *tr_hashitem_value(hashtable *hash, hashitem *item)
+static void *tr_hashslot_key(hashtable *hash, void *slot)
 {
-    return (char*)item + sizeof(hashitem) + hash->keysize;
+    return slot;
 }
 
-// Sets an item in the hash, without resizing it
+// Gets the value stored in a slot
 //
-static tr_err tr_hash_set_without_resizing(hashtable *hash, 
-                                           const void *key, 
-                                           const void *value);
+static void *tr_hashslot_value(hashtable *hash, void *slot)
+{
+    return (char*)slot + hash->valueoff;
+}
 
-// Resizes an existing hash, migrating over any existing data
+// Gets the number of slots that may be occupied or tombstoned before a
+// table needs to be rehashed (7/8 of capacity).
 //
-static void tr_hash_resize(hashtable *hash, unsigned int capacity)
+static unsigned int tr_hash_growth_limit(table *t)
 {
-    assert(hash->numused < capacity);
+    return t->capacity - t->capacity / 8;
+}
 
-    // Store the old item table
-    unsigned int prevcap = hash->capacity;
-    void *previtems = hash->items;
+// Allocates a table's storage, with every slot empty
+//
+static void tr_table_init(hashtable *hash, table *t, unsigned int capacity)
+{
+    assert((capacity & (capacity - 1)) == 0);
 
-    // Allocate the new item table
-    unsigned int itemsize = sizeof(hashitem) + hash->keysize + hash->valuesize;
-    hash->items = tr_malloc(capacity * itemsize);
-    memset(hash->items, 0, capacity * itemsize);
+    t->capacity = capacity;
+    t->numused = 0;
+    t->numdeleted = 0;
+    t->ctrl = (unsigned char*)tr_calloc(capacity + TR_GROUP_WIDTH, 1);
+    t->slots = tr_malloc(capacity * hash->slotsize);
+}
 
-    hash->numused = 0;
-    hash->capacity = capacity;
-    hash->cellar = capacity - CELLAR * capacity;
+// Frees a table's storage
+//
+static void tr_table_free(table *t)
+{
+    tr_free(t->ctrl);
+    tr_free(t->slots);
 
-    if (previtems) {
+    t->capacity = 0;
+    t->numused = 0;
+    t->numdeleted = 0;
+    t->ctrl = NULL;
+    t->slots = NULL;
+}
 
-        // Migrate the existing items to the new table
-        for (unsigned int i = 0; i < prevcap; ++i) {
+// Finds the slot holding the given key.
+// Returns the slot index, or -1 if the key isn't in the table.
+//
+static long tr_table_find(hashtable *hash, table *t, const void *key, uint64_t h)
+{
+    if (!t->numused) {
+        return -1;
+    }
 
-            hashitem *item = (hashitem*)((char*)previtems + i * itemsize);
-            if (item->occupied) {
+    unsigned int mask = t->capacity - 1;
+    unsigned int pos = tr_ctrl_h1(h, t->capacity);
+    unsigned char h2 = tr_ctrl_h2(h);
 
-                void *key = ((char*)item + sizeof(hashitem));
-                void *value = ((char*)key + hash->keysize);
+    // The key is almost always in the first group, so start pulling in its
+    // slot while we're still scanning control bytes.
+#if defined(__GNUC__)
+    __builtin_prefetch(tr_hash_slot(hash, t, pos));
+#endif
 
-                tr_hash_set_without_resizing(hash, key, value);
+    for (unsigned int stride = TR_GROUP_WIDTH; ; stride += TR_GROUP_WIDTH) {
+        const unsigned char *group = t->ctrl + pos;
+
+        for (unsigned int m = tr_group_match(group, h2); m; m &= m - 1) {
+            unsigned int i = (pos + tr_group_first(m)) & mask;
+            void *slot = tr_hash_slot(hash, t, i);
+
+            if (hash->equalfunc(key, tr_hashslot_key(hash, slot))) {
+                return i;
             }
         }
 
-        // Clean up the old item table
-        tr_free(previtems);
+        if (tr_group_match_empty(group)) {
+            return -1;
+        }
+
+        pos = (pos + stride) & mask;
     }
 }
 
-// Resizes the hashtable's intenral item table if needed.
-// Follows the same resize rules as tr_vector.
+// Claims a free slot for a key that isn't already in the table.
+// Returns the slot; the caller fills in the key and value.
 //
-static void tr_hash_resize_if_needed(hashtable *hash)
+static void *tr_table_claim(hashtable *hash, table *t, uint64_t h)
 {
-    if (hash->numused >= hash->capacity / 2) {
-        tr_hash_resize(hash, 2 * hash->capacity);
+    unsigned int i = tr_ctrl_find_free(t->ctrl, t->capacity, h);
+    if (t->ctrl[i] == TR_CTRL_DELETED) {
+        t->numdeleted -= 1;
     }
-    else if (hash->numused <= hash->capacity / 4) {
-        tr_hash_resize(hash, hash->capacity / 2);
+
+    tr_ctrl_set(t->ctrl, t->capacity, i, tr_ctrl_h2(h));
+    t->numused += 1;
+
+    return tr_hash_slot(hash, t, i);
+}
+
+// Removes the item in the i'th slot of a table
+//
+static void tr_table_erase(table *t, unsigned int i)
+{
+    if (tr_ctrl_erase(t->ctrl, t->capacity, i)) {
+        t->numdeleted += 1;
     }
+
+    t->numused -= 1;
 }
 
-// Gets the next free hashitem in the cellar.
-// If the cellar is full, returns NULL.
+// Moves the item in the i'th slot of the old table into the current table
 //
-static hashitem *tr_hash_next_cellar(hashtable *hash)
+static void tr_hash_migrate_slot(hashtable *hash, unsigned int i)
 {
-    for (unsigned int i = hash->cellar; i < hash->capacity; ++i) {
+    table *old = &hash->old;
+    if (!(old->ctrl[i] & TR_CTRL_FULL)) {
+        return;
+    }
 
-        hashitem *item = tr_hash_item(hash, i);
-        if (!item->occupied) {
-            return item;
-        }
+    // Keys are unique across both tables, so we can skip the lookup
+    void *slot = tr_hash_slot(hash, old, i);
+    uint64_t h = tr_hash_hash(hash, tr_hashslot_key(hash, slot));
+    memcpy(tr_table_claim(hash, &hash->cur, h), slot, hash->slotsize);
+
+    // Tombstone the old slot so lookups in the old table skip it, without
+    // breaking the probe sequences of keys that haven't moved yet.
+    tr_ctrl_set(old->ctrl, old->capacity, i, TR_CTRL_DELETED);
+    old->numused -= 1;
+    old->numdeleted += 1;
+}
+
+// Migrates up to count slots from the old table to the current one,
+// freeing the old table once it has been drained.
+//
+static void tr_hash_migrate(hashtable *hash, unsigned int count)
+{
+    table *old = &hash->old;
+    if (!old->ctrl) {
+        return;
     }
 
-    return NULL;
+    unsigned int end = count > old->capacity - hash->migrated
+                     ? old->capacity
+                     : hash->migrated + count;
+
+    for (unsigned int i = hash->migrated; i < end && old->numused; ++i) {
+        tr_hash_migrate_slot(hash, i);
+    }
+
+    hash->migrated = end;
+    if (hash->migrated == old->capacity || old->numused == 0) {
+        tr_table_free(old);
+        hash->migrated = 0;
+    }
+}
+
+// Resizes an existing hash, migrating over any existing data.
+// Also clears out any tombstones.
+//
+// In incremental mode, this only allocates the new table; existing items are
+// moved over a few at a time by later writes (see tr_hash_migrate).
+//
+static void tr_hash_resize(hashtable *hash, unsigned int capacity)
+{
+    // Only one migration can be in flight at a time
+    tr_hash_migrate(hash, ~0u);
+
+    assert(hash->cur.numused < capacity);
+
+    hash->old = hash->cur;
+    hash->migrated = 0;
+    tr_table_init(hash, &hash->cur, capacity);
+
+    if (!hash->old.ctrl || !hash->incremental) {
+        tr_hash_migrate(hash, ~0u);
+    }
 }
 
-// Stores the given key and value in the given hash item.
+// Gets the total number of items in the hashtable
 //
-static void tr_hashitem_claim(hashtable *hash, hashitem *item, 
-                              const void *key, const void *value)
+static unsigned int tr_hash_count(hashtable *hash)
 {
-    assert(!item->occupied);
-    item->occupied = true;
+    return hash->cur.numused + hash->old.numused;
+}
 
-    memcpy(tr_hashitem_key(hash, item), key, hash->keysize);
-    memcpy(tr_hashitem_value(hash, item), value, hash->valuesize);
+// Makes room for one more item in the current table, if needed
+//
+static void tr_hash_reserve_one(hashtable *hash)
+{
+    table *cur = &hash->cur;
+    if (cur->numused + cur->numdeleted + 1 <= tr_hash_growth_limit(cur)) {
+        return;
+    }
+
+    // Writes drain the old table long before the current one can fill up
+    assert(!hash->old.ctrl);
 
-    hash->numused += 1;
+    // If most of the dead weight is tombstones, rehashing in place is enough
+    unsigned int count = tr_hash_count(hash);
+    if (count + 1 <= tr_hash_growth_limit(cur) / 2) {
+        tr_hash_resize(hash, cur->capacity);
+    }
+    else {
+        tr_hash_resize(hash, 2 * cur->capacity);
+    }
 }
 
-tr_hash tr_hash_create(unsigned int keysize, 
+// Shrinks the hashtable's internal tables if they're mostly empty.
+//
+// Growing happens at 7/8 load and leaves the table under half full, so we
+// wait until the table is 1/8 full before halving it. That way a table that
+// hovers around a resize boundary doesn't thrash between sizes.
+//
+static void tr_hash_shrink_if_needed(hashtable *hash)
+{
+    table *cur = &hash->cur;
+    if (hash->old.ctrl || cur->capacity <= MIN_CAPACITY) {
+        return;
+    }
+
+    if (tr_hash_count(hash) <= cur->capacity / 8) {
+        tr_hash_resize(hash, cur->capacity / 2);
+    }
+}
+
+tr_hash tr_hash_create(unsigned int keysize,
                        unsigned int valuesize,
                        tr_hashfunc hashfunc,
                        tr_equalfunc equalfunc)
 {
     hashtable *hash = (hashtable*)tr_malloc(sizeof(hashtable));
+    memset(hash, 0, sizeof(hashtable));
+
     hash->keysize = keysize;
     hash->valuesize = valuesize;
     hash->hashfunc = hashfunc;
     hash->equalfunc = equalfunc;
-    hash->capacity = 0;
-    hash->numused = 0;
-    hash->cellar = 0;
-    hash->items = NULL;
+    hash->incremental = false;
+
+    unsigned int keyalign = tr_hash_align(keysize);
+    unsigned int valuealign = tr_hash_align(valuesize);
+    unsigned int slotalign = keyalign > valuealign ? keyalign : valuealign;
 
-    tr_hash_resize(hash, 2);
+    hash->valueoff = tr_hash_roundup(keysize, valuealign);
+    hash->slotsize = tr_hash_roundup(hash->valueoff + valuesize, slotalign);
+
+    tr_table_init(hash, &hash->cur, MIN_CAPACITY);
     return hash;
 }
 
+tr_hash tr_hash_create_seeded(unsigned int keysize,
+                              unsigned int valuesize,
+                              tr_hashfunc64 hashfunc,
+                              tr_equalfunc equalfunc)
+{
+    hashtable *hash = (hashtable *)tr_hash_create(keysize, valuesize, NULL, equalfunc);
+    if (!hash) {
+        return NULL;
+    }
+
+    hash->hashfunc64 = hashfunc;
+    hash->seed = tr_hash_random_seed();
+
+    return hash;
+}
+
+uint64_t tr_hash_seed(tr_hash trh)
+{
+    if (!trh) return 0;
+
+    return ((hashtable *)trh)->seed;
+}
+
 tr_err tr_hash_delete(tr_hash trh)
 {
     if (!trh) return TR_EPOINTER;
 
     hashtable *hash = (hashtable *)trh;
-    tr_free(hash->items);
+    tr_table_free(&hash->cur);
+    if (hash->old.ctrl) {
+        tr_table_free(&hash->old);
+    }
 
+    tr_free(hash);
     return TR_OK;
 }
 
-bool tr_hash_contains(tr_hash trh, const void *key)
+tr_err tr_hash_set_incremental(tr_hash trh, bool incremental)
 {
-    if (!trh) return false;
-
-    hashtable *hash = (hashtable*)trh;
-    unsigned int i = tr_hash_addr(hash, key);
-    hashitem *bucket = tr_hash_item(hash, i);
-
-    for (hashitem *item = bucket; item; item = item->next) {
+    if (!trh) return TR_EPOINTER;
 
-        if (!item->occupied) {
-            return false;
-        }
+    hashtable *hash = (hashtable *)trh;
+    hash->incremental = incremental;
 
-        if (hash->equalfunc(key, tr_hashitem_key(hash, item))) {
-            return true;
-        }
+    if (!incremental) {
+        tr_hash_migrate(hash, ~0u);
     }
 
-    return false;
+    return TR_OK;
 }
 
-void *tr_hash_get(tr_hash trh, const void *key)
+bool tr_hash_is_incremental(tr_hash trh)
 {
-    if (!trh) return NULL;
+    if (!trh) return false;
+    return ((hashtable *)trh)->incremental;
+}
 
-    hashtable *hash = (hashtable*)trh;
-    unsigned int i = tr_hash_addr(hash, key);
-    hashitem *bucket = tr_hash_item(hash, i);
+tr_err tr_hash_reserve(tr_hash trh, unsigned int count)
+{
+    if (!trh) return TR_EPOINTER;
 
-    for (hashitem *item = bucket; item; item = item->next) {
-        void *itemkey = tr_hashitem_key(hash, item);
+    hashtable *hash = (hashtable *)trh;
+    unsigned int capacity = hash->cur.capacity;
 
-        if (hash->equalfunc(key, itemkey)) {
-            return tr_hashitem_value(hash, item);
+    while (capacity - capacity / 8 < count) {
+        if (capacity > ~0u / 2) {
+            return TR_ENOMEM;
         }
+
+        capacity *= 2;
+    }
+
+    if (capacity > hash->cur.capacity) {
+        // There's nothing to spread out: the caller is about to fill the
+        // table anyway, so move everything over now
+        tr_hash_resize(hash, capacity);
+        tr_hash_migrate(hash, ~0u);
     }
 
-    return NULL;
+    return TR_OK;
 }
 
-tr_err tr_hash_set(tr_hash trh, const void *key, const void *value)
+// Finds the slot holding the given key in either table.
+// Returns NULL if the key isn't in the hash.
+//
+static void *tr_hash_find(hashtable *hash, const void *key, uint64_t h,
+                          table **where, long *index)
 {
-    if (!trh) return TR_EPOINTER;
-    hashtable *hash = (hashtable*)trh;
+    table *t = &hash->cur;
+    long i = tr_table_find(hash, t, key, h);
 
-    tr_err err = tr_hash_set_without_resizing(hash, key, value);
-    if (err < 0) {
-        return err;
+    if (i < 0 && hash->old.ctrl) {
+        t = &hash->old;
+        i = tr_table_find(hash, t, key, h);
     }
 
-    tr_hash_resize_if_needed(hash);
-    return err;
+    if (i < 0) {
+        return NULL;
+    }
+
+    if (where) *where = t;
+    if (index) *index = i;
+    return tr_hash_slot(hash, t, i);
 }
 
-static tr_err tr_hash_set_without_resizing(hashtable *hash, 
-                                           const void *key, 
-                                           const void *value)
+bool tr_hash_contains(tr_hash trh, const void *key)
 {
-    // Insert the item into its bucket if the bucket is free
-    unsigned int i = tr_hash_addr(hash, key);
-    hashitem *bucket = tr_hash_item(hash, i);
+    if (!trh) return false;
 
-    if (!bucket->occupied) {
-        tr_hashitem_claim(hash, bucket, key, value);
-        return TR_OK;
-    }
+    hashtable *hash = (hashtable*)trh;
+    uint64_t h = tr_hash_hash(hash, key);
+    return tr_hash_find(hash, key, h, NULL, NULL) != NULL;
+}
 
-    // The bucket is occupied; try adding to the cellar
-    hashitem *cellar = tr_hash_next_cellar(hash);
-    if (cellar) {
+void *tr_hash_get(tr_hash trh, const void *key)
+{
+    if (!trh) return NULL;
 
-        assert(!cellar->occupied);
-        tr_hashitem_claim(hash, cellar, key, value);
+    hashtable *hash = (hashtable*)trh;
+    uint64_t h = tr_hash_hash(hash, key);
 
-        cellar->next = bucket->next;
-        bucket->next = cellar;
+    void *slot = tr_hash_find(hash, key, h, NULL, NULL);
+    return slot ? tr_hashslot_value(hash, slot) : NULL;
+}
 
-        return TR_OK;
-    }
+void tr_hash_prefetch(tr_hash trh, const void *key)
+{
+#if defined(__GNUC__)
+    if (!trh) return;
 
-    // The cellar is full; use open addressing
-    for (unsigned int i = 0; i < hash->capacity; ++i) {
+    hashtable *hash = (hashtable*)trh;
+    table *t = &hash->cur;
+    unsigned int pos = tr_ctrl_h1(tr_hash_hash(hash, key), t->capacity);
 
-        hashitem *item = tr_hash_item(hash, i);
-        if (!item->occupied) {
+    __builtin_prefetch(t->ctrl + pos);
+    __builtin_prefetch(tr_hash_slot(hash, t, pos));
+#else
+    (void)trh;
+    (void)key;
+#endif
+}
 
-            tr_hashitem_claim(hash, item, key, value);
+tr_err tr_hash_set(tr_hash trh, const void *key, const void *value)
+{
+    if (!trh) return TR_EPOINTER;
+    hashtable *hash = (hashtable*)trh;
 
-            item->next = bucket->next;
-            bucket->next = item;
+    tr_hash_migrate(hash, MIGRATE_STEP);
 
-            return TR_OK;
-        }
+    uint64_t h = tr_hash_hash(hash, key);
+
+    // Overwrite the value if the key is already in the table
+    void *slot = tr_hash_find(hash, key, h, NULL, NULL);
+    if (!slot) {
+        tr_hash_reserve_one(hash);
+
+        slot = tr_table_claim(hash, &hash->cur, h);
+        memcpy(tr_hashslot_key(hash, slot), key, hash->keysize);
+    }
+
+    if (value) {
+        memcpy(tr_hashslot_value(hash, slot), value, hash->valuesize);
     }
 
-    // The hash itself is full (this should never happen)
-    assert(0 && "Hash is full. Possible bug with tr_hash_resize_if_needed()");
-    return TR_EINTERNAL;
+    return TR_OK;
 }
 
 tr_err tr_hash_clear(tr_hash trh, const void *key)
@@ -306,50 +539,81 @@ tr_err tr_hash_clear(tr_hash trh, const void *key)
     if (!trh) return TR_EPOINTER;
 
     hashtable *hash = (hashtable*)trh;
-    unsigned int i = tr_hash_addr(hash, key);
-    hashitem *bucket = tr_hash_item(hash, i);
+    tr_hash_migrate(hash, MIGRATE_STEP);
 
-    hashitem *item = bucket;
-    hashitem *prev = NULL;
-    while (item) {
+    table *t = NULL;
+    long i = -1;
+    if (!tr_hash_find(hash, key, tr_hash_hash(hash, key), &t, &i)) {
+        return TR_ENOTFOUND;
+    }
 
-        void *itemkey = tr_hashitem_key(hash, item);
-        if (hash->equalfunc(key, itemkey)) {
+    tr_table_erase(t, i);
+    tr_hash_shrink_if_needed(hash);
 
-            item->occupied = false;
-            if (prev) {
-                prev->next = item->next;
-            }
+    return TR_OK;
+}
 
-            hash->numused -= 1;
-            tr_hash_resize_if_needed(hash);
+unsigned int tr_hash_num_keys(tr_hash trh)
+{
+    if (!trh) return 0;
 
-            return TR_OK;
-        }
+    hashtable *hash = (hashtable *)trh;
+    return tr_hash_count(hash);
+}
 
-        prev = item;
-        item = item->next;
-    }
+void tr_hash_iter_init(tr_hash trh, tr_hash_iter *it)
+{
+    if (!it) return;
 
-    return TR_ENOTFOUND;
+    it->key = NULL;
+    it->value = NULL;
+    it->hash = trh;
+    it->table = 0;
+    it->group = 0;
+    it->next = 0;
+    it->mask = 0;
 }
 
-unsigned int tr_hash_num_keys(tr_hash trh)
+bool tr_hash_iter_next(tr_hash_iter *it)
 {
-    if (!trh) return 0;
+    if (!it || !it->hash) return false;
 
-    hashtable *hash = (hashtable *)trh;
-    unsigned int count = 0;
+    hashtable *hash = (hashtable *)it->hash;
 
-    for (unsigned int i = 0; i < hash->capacity; ++i) {
-        hashitem *item = tr_hash_item(hash, i);
+    // Walk the current table, then whatever's left to migrate in the old
+    // one. Migrated slots are tombstoned, so nothing is visited twice.
+    for (;;) {
+        table *t = it->table == 0 ? &hash->cur : &hash->old;
 
-        if (item->occupied) {
-            count += 1;
+        if (it->mask) {
+            unsigned int i = it->group + tr_group_first(it->mask);
+            it->mask &= it->mask - 1;
+
+            void *slot = tr_hash_slot(hash, t, i);
+            it->key = tr_hashslot_key(hash, slot);
+            it->value = tr_hashslot_value(hash, slot);
+            return true;
+        }
+
+        // Tables are a whole number of groups, so we never scan into the
+        // mirrored control bytes
+        if (t->ctrl && it->next < t->capacity) {
+            it->group = it->next;
+            it->next += TR_GROUP_WIDTH;
+            it->mask = tr_group_match_full(t->ctrl + it->group);
+            continue;
         }
-    }
 
-    return count;
+        if (it->table == 1) {
+            it->key = NULL;
+            it->value = NULL;
+            it->hash = NULL;
+            return false;
+        }
+
+        it->table = 1;
+        it->next = 0;
+    }
 }
 
 tr_vector tr_hash_keys(tr_hash trh)
@@ -357,15 +621,11 @@ tr_vector tr_hash_keys(tr_hash trh)
     if (!trh) return NULL;
 
     hashtable *hash = (hashtable *)trh;
-    tr_vector keys = tr_vec_create(hash->keysize, hash->capacity);
-
-    for (unsigned int i = 0; i < hash->capacity; ++i) {
-        hashitem *item = tr_hash_item(hash, i);
+    tr_vector keys = tr_vec_create(hash->keysize, tr_hash_count(hash) + 1);
 
-        if (item->occupied) {
-            void *key = (char*)item + sizeof(hashitem);
-            tr_vec_append(keys, key);
-        }
+    tr_hash_iter it;
+    tr_hash_foreach(it, trh) {
+        tr_vec_append(keys, it.key);
     }
 
     return keys;
@@ -376,15 +636,11 @@ tr_vector tr_hash_values(tr_hash trh)
     if (!trh) return NULL;
 
     hashtable *hash = (hashtable *)trh;
-    tr_vector values = tr_vec_create(hash->valuesize, hash->capacity);
-
-    for (unsigned int i = 0; i < hash->capacity; ++i) {
-        hashitem *item = tr_hash_item(hash, i);
+    tr_vector values = tr_vec_create(hash->valuesize, tr_hash_count(hash) + 1);
 
-        if (item->occupied) {
-            void *value = (char*)item + sizeof(hashitem) + hash->keysize;
-            tr_vec_append(values, value);
-        }
+    tr_hash_iter it;
+    tr_hash_foreach(it, trh) {
+        tr_vec_append(values, it.value);
     }
 
     return values;
@@ -414,19 +670,15 @@ bool tr_equalfunc_str(const void *val1, const void *val2)
 
 tr_hash tr_strhash_create(unsigned int itemsize)
 {
-    return tr_hash_create(sizeof(const char *), 
-                          itemsize, 
-                          tr_hashfunc_str,
-                          tr_equalfunc_str);
+    return tr_hash_create_seeded(sizeof(const char *),
+                                 itemsize,
+                                 tr_hashfunc64_str,
+                                 tr_equalfunc_str);
 }
 
 tr_err tr_strhash_delete(tr_hash hash)
 {
-    tr_vector values = tr_hash_values(hash);
-    tr_vec_foreach(char **, value, values) {
-        tr_free(*value);
-    }
-
+    // Keys and values are owned by the caller
     return tr_hash_delete(hash);
 }
 
@@ -480,10 +732,10 @@ bool tr_equalfunc_int(const void *val1, const void *val2)
 
 tr_hash tr_inthash_create(unsigned int itemsize)
 {
-    return tr_hash_create(sizeof(int), 
-                          itemsize, 
-                          tr_hashfunc_int,
-                          tr_equalfunc_int);
+    return tr_hash_create_seeded(sizeof(int),
+                                 itemsize,
+                                 tr_hashfunc64_int,
+                                 tr_equalfunc_int);
 }
 
 tr_err tr_inthash_delete(tr_hash hash)
@@ -0,0 +1,164 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// hashfunc.c - Seeded 64-bit hash functions
+//
+
+#include <stdint.h> // for uint64_t, uint32_t, uintptr_t
+#include <string.h> // for memcpy, strlen
+#include <time.h> // for time, clock
+
+#include "hash.h"
+#include "hashfunc.h"
+
+// The byte hash is wyhash (https://github.com/wangyi-fudan/wyhash, public
+// domain): it consumes 16 bytes per step (48 for long inputs, in three
+// independent lanes), and folds each step with a 64x64->128-bit multiply.
+// Short keys take a couple of overlapping loads and no loop at all.
+//
+// The fixed-size hashes (ints, MACs, IPv4 addresses) skip straight to two
+// rounds of the same multiply-fold; they're inline in hashfunc.h.
+//
+
+#define SECRET0 TR_HASH64_SECRET0
+#define SECRET1 TR_HASH64_SECRET1
+#define SECRET2 TR_HASH64_SECRET2
+#define SECRET3 TR_HASH64_SECRET3
+
+static uint64_t tr_hash64_r8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t tr_hash64_r4(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Reads 1-3 bytes
+//
+static uint64_t tr_hash64_r3(const unsigned char *p, size_t len)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+uint64_t tr_hash64_bytes(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t a, b;
+
+    seed ^= tr_hash64_mix(seed ^ SECRET0, SECRET1);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two overlapping pairs of 4-byte loads cover 4-16 bytes
+            size_t mid = (len >> 3) << 2;
+            a = (tr_hash64_r4(p) << 32) | tr_hash64_r4(p + mid);
+            b = (tr_hash64_r4(p + len - 4) << 32) | tr_hash64_r4(p + len - 4 - mid);
+        }
+        else if (len > 0) {
+            a = tr_hash64_r3(p, len);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+
+            do {
+                seed = tr_hash64_mix(tr_hash64_r8(p) ^ SECRET1, tr_hash64_r8(p + 8) ^ seed);
+                see1 = tr_hash64_mix(tr_hash64_r8(p + 16) ^ SECRET2, tr_hash64_r8(p + 24) ^ see1);
+                see2 = tr_hash64_mix(tr_hash64_r8(p + 32) ^ SECRET3, tr_hash64_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = tr_hash64_mix(tr_hash64_r8(p) ^ SECRET1, tr_hash64_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        // The last 16 bytes, overlapping what came before if need be
+        a = tr_hash64_r8(p + i - 16);
+        b = tr_hash64_r8(p + i - 8);
+    }
+
+    a ^= SECRET1;
+    b ^= seed;
+    tr_hash64_mum(&a, &b);
+
+    return tr_hash64_mix(a ^ SECRET0 ^ len, b ^ SECRET1);
+}
+
+uint64_t tr_hashfunc64_str(const void *str, uint64_t seed)
+{
+    const char *s = *(const char **)str;
+    return tr_hash64_bytes(s, strlen(s), seed);
+}
+
+uint64_t tr_hashfunc64_int(const void *num, uint64_t seed)
+{
+    return tr_hash64_int(*(const unsigned int *)num, seed);
+}
+
+uint64_t tr_hashfunc64_u64(const void *num, uint64_t seed)
+{
+    return tr_hash64_u64(*(const uint64_t *)num, seed);
+}
+
+uint64_t tr_hashfunc64_mac(const void *mac, uint64_t seed)
+{
+    return tr_hash64_mac((const unsigned char *)mac, seed);
+}
+
+uint64_t tr_hashfunc64_ipv4(const void *addr, uint64_t seed)
+{
+    return tr_hash64_ipv4((const unsigned char *)addr, seed);
+}
+
+bool tr_equalfunc_mac(const void *mac1, const void *mac2)
+{
+    return memcmp(mac1, mac2, 6) == 0;
+}
+
+bool tr_equalfunc_u64(const void *num1, const void *num2)
+{
+    return *(const uint64_t *)num1 == *(const uint64_t *)num2;
+}
+
+uint64_t tr_hash_random_seed()
+{
+    // Not cryptographic, but differs between processes (thanks to address
+    // space randomization and the clock) and between calls
+    static uint64_t state = 0;
+
+    uint64_t base = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    if (base == 0) {
+        uint64_t local = 0;
+        base = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^
+               (uint64_t)(uintptr_t)&state ^ ((uint64_t)(uintptr_t)&local << 16);
+        base = tr_hash64_value(base, SECRET2) | 1;
+
+        uint64_t expected = 0;
+        __atomic_compare_exchange_n(&state, &expected, base, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+
+    uint64_t n = __atomic_add_fetch(&state, 0x9e3779b97f4a7c15ull, __ATOMIC_RELAXED);
+    return tr_hash64_value(n, SECRET3);
+}
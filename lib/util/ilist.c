@@ -0,0 +1,146 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ilist.c - Intrusive doubly-linked list
+//
+
+#include <stdlib.h> // for NULL
+
+#include "ilist.h"
+
+void tr_ilist_init(tr_ilist *list)
+{
+    if (!list) return;
+
+    list->head.next = &list->head;
+    list->head.prev = &list->head;
+}
+
+void tr_ilink_init(tr_ilink *link)
+{
+    if (!link) return;
+
+    link->next = NULL;
+    link->prev = NULL;
+}
+
+bool tr_ilist_empty(const tr_ilist *list)
+{
+    if (!list) return true;
+    return list->head.next == &list->head;
+}
+
+bool tr_ilink_linked(const tr_ilink *link)
+{
+    if (!link) return false;
+    return link->next != NULL;
+}
+
+tr_ilink *tr_ilist_first(tr_ilist *list)
+{
+    if (!list) return NULL;
+    return tr_ilist_next(list, &list->head);
+}
+
+tr_ilink *tr_ilist_last(tr_ilist *list)
+{
+    if (!list) return NULL;
+    return tr_ilist_prev(list, &list->head);
+}
+
+tr_ilink *tr_ilist_next(tr_ilist *list, tr_ilink *link)
+{
+    if (!list || !link) return NULL;
+    return link->next != &list->head ? link->next : NULL;
+}
+
+tr_ilink *tr_ilist_prev(tr_ilist *list, tr_ilink *link)
+{
+    if (!list || !link) return NULL;
+    return link->prev != &list->head ? link->prev : NULL;
+}
+
+// Links the given link in between two adjacent links
+//
+static void tr_ilist_splice(tr_ilink *prev, tr_ilink *next, tr_ilink *link)
+{
+    link->prev = prev;
+    link->next = next;
+    prev->next = link;
+    next->prev = link;
+}
+
+tr_err tr_ilist_add(tr_ilist *list, tr_ilink *link)
+{
+    return tr_ilist_append(list, link);
+}
+
+tr_err tr_ilist_add_before(tr_ilink *other, tr_ilink *link)
+{
+    if (!other || !link) return TR_EPOINTER;
+    if (!other->prev) return TR_ENOTFOUND;
+
+    tr_ilist_splice(other->prev, other, link);
+    return TR_OK;
+}
+
+tr_err tr_ilist_add_after(tr_ilink *other, tr_ilink *link)
+{
+    if (!other || !link) return TR_EPOINTER;
+    if (!other->next) return TR_ENOTFOUND;
+
+    tr_ilist_splice(other, other->next, link);
+    return TR_OK;
+}
+
+tr_err tr_ilist_prepend(tr_ilist *list, tr_ilink *link)
+{
+    if (!list || !link) return TR_EPOINTER;
+
+    tr_ilist_splice(&list->head, list->head.next, link);
+    return TR_OK;
+}
+
+tr_err tr_ilist_append(tr_ilist *list, tr_ilink *link)
+{
+    if (!list || !link) return TR_EPOINTER;
+
+    tr_ilist_splice(list->head.prev, &list->head, link);
+    return TR_OK;
+}
+
+tr_err tr_ilist_remove(tr_ilink *link)
+{
+    if (!link) return TR_EPOINTER;
+    if (!link->next) return TR_ENOTFOUND;
+
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+
+    link->next = NULL;
+    link->prev = NULL;
+
+    return TR_OK;
+}
+
+tr_ilink *tr_ilist_remove_first(tr_ilist *list)
+{
+    tr_ilink *link = tr_ilist_first(list);
+    if (link) {
+        tr_ilist_remove(link);
+    }
+
+    return link;
+}
+
+tr_ilink *tr_ilist_remove_last(tr_ilist *list)
+{
+    tr_ilink *link = tr_ilist_last(list);
+    if (link) {
+        tr_ilist_remove(link);
+    }
+
+    return link;
+}
@@ -0,0 +1,246 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// intern.c - String interning table
+//
+
+#include <stdlib.h> // for NULL
+#include <string.h> // for memcpy, strlen
+
+#include "hash.h"
+#include "intern.h"
+#include "memory.h"
+#include "vector.h"
+
+// Interned strings are packed into blocks of this size. Strings never move
+// once interned, so pointers to them stay valid as the table grows.
+//
+static const unsigned int BLOCK_SIZE = 16384;
+
+struct _strblock;
+struct _strref;
+struct _intern;
+
+typedef struct _strblock strblock;
+typedef struct _strref strref;
+typedef struct _intern intern;
+
+struct _strblock
+{
+    strblock *next;         // The previously filled block
+    unsigned int size;      // Number of bytes of storage in this block
+    unsigned int used;      // Number of bytes in use
+    char data[];            // String storage
+};
+
+struct _strref
+{
+    const char *str;        // The string's characters (not NUL-terminated)
+    unsigned int len;       // Length of the string, in bytes
+};
+
+struct _intern
+{
+    tr_hash atoms;          // Map from strref to atom
+    tr_vector strs;         // Map from atom to interned string
+    strblock *blocks;       // String storage, most recent block first
+    tr_arena arena;         // Arena the blocks come from, or NULL for heap
+};
+
+static uint64_t tr_hashfunc_strref(const void *val, uint64_t seed)
+{
+    const strref *ref = (const strref *)val;
+    return tr_hash64_bytes(ref->str, ref->len, seed);
+}
+
+static bool tr_equalfunc_strref(const void *val1, const void *val2)
+{
+    const strref *ref1 = (const strref *)val1;
+    const strref *ref2 = (const strref *)val2;
+
+    return ref1->len == ref2->len && memcmp(ref1->str, ref2->str, ref1->len) == 0;
+}
+
+// Copies a string into the table's block storage and NUL-terminates it.
+// Returns NULL if memory runs out.
+//
+static const char *tr_intern_store(intern *in, const char *str, unsigned int len)
+{
+    strblock *block = in->blocks;
+
+    if (!block || block->size - block->used < len + 1) {
+        unsigned int size = len + 1 > BLOCK_SIZE ? len + 1 : BLOCK_SIZE;
+
+        block = in->arena
+              ? (strblock *)tr_arena_alloc(in->arena, sizeof(strblock) + size)
+              : (strblock *)tr_malloc(sizeof(strblock) + size);
+        if (!block) {
+            return NULL;
+        }
+
+        block->next = in->blocks;
+        block->size = size;
+        block->used = 0;
+        in->blocks = block;
+    }
+
+    char *copy = block->data + block->used;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    block->used += len + 1;
+    return copy;
+}
+
+tr_intern tr_intern_create()
+{
+    return tr_intern_create_in(NULL);
+}
+
+tr_intern tr_intern_create_in(tr_arena arena)
+{
+    intern *in = (intern *)tr_malloc(sizeof(intern));
+    if (!in) {
+        return NULL;
+    }
+
+    in->atoms = tr_hash_create_seeded(sizeof(strref),
+                                      sizeof(tr_atom),
+                                      tr_hashfunc_strref,
+                                      tr_equalfunc_strref);
+    in->strs = tr_vec_create(sizeof(const char *), 16);
+    in->blocks = NULL;
+    in->arena = arena;
+
+    if (!in->atoms || !in->strs) {
+        tr_intern_delete(in);
+        return NULL;
+    }
+
+    return in;
+}
+
+tr_err tr_intern_delete(tr_intern tri)
+{
+    if (!tri) return TR_EPOINTER;
+
+    intern *in = (intern *)tri;
+
+    strblock *block = in->arena ? NULL : in->blocks;
+    while (block) {
+        strblock *next = block->next;
+        tr_free(block);
+        block = next;
+    }
+
+    tr_hash_delete(in->atoms);
+    tr_vec_delete(in->strs);
+    tr_free(in);
+
+    return TR_OK;
+}
+
+tr_atom tr_intern_atom(tr_intern tri, const char *str)
+{
+    if (!tri || !str) return TR_NO_ATOM;
+    return tr_intern_atom_n(tri, str, strlen(str));
+}
+
+tr_atom tr_intern_atom_n(tr_intern tri, const char *str, unsigned int len)
+{
+    if (!tri || !str) return TR_NO_ATOM;
+
+    intern *in = (intern *)tri;
+    strref ref = { str, len };
+
+    tr_atom *existing = (tr_atom *)tr_hash_get(in->atoms, &ref);
+    if (existing) {
+        return *existing;
+    }
+
+    tr_atom atom = tr_vec_size(in->strs);
+    ref.str = tr_intern_store(in, str, len);
+    if (!ref.str) {
+        return TR_NO_ATOM;
+    }
+
+    // If the string can't be recorded, its copy is given back, so a failed
+    // call leaves the table as it was
+    tr_err err = tr_vec_append(in->strs, &ref.str);
+    if (err >= 0) {
+        err = tr_hash_set(in->atoms, &ref, &atom);
+        if (err < 0) {
+            tr_vec_pop(in->strs);
+        }
+    }
+
+    if (err < 0) {
+        in->blocks->used -= len + 1;
+        return TR_NO_ATOM;
+    }
+
+    return atom;
+}
+
+tr_atom tr_intern_find(tr_intern tri, const char *str)
+{
+    if (!tri || !str) return TR_NO_ATOM;
+    return tr_intern_find_n(tri, str, strlen(str));
+}
+
+tr_atom tr_intern_find_n(tr_intern tri, const char *str, unsigned int len)
+{
+    if (!tri || !str) return TR_NO_ATOM;
+
+    intern *in = (intern *)tri;
+    strref ref = { str, len };
+
+    tr_atom *atom = (tr_atom *)tr_hash_get(in->atoms, &ref);
+    return atom ? *atom : TR_NO_ATOM;
+}
+
+void tr_intern_prefetch_n(tr_intern tri, const char *str, unsigned int len)
+{
+    if (!tri || !str) return;
+
+    intern *in = (intern *)tri;
+    strref ref = { str, len };
+
+    tr_hash_prefetch(in->atoms, &ref);
+}
+
+const char *tr_intern_str(tr_intern tri, tr_atom atom)
+{
+    if (!tri) return NULL;
+
+    intern *in = (intern *)tri;
+    if (atom >= tr_vec_size(in->strs)) {
+        return NULL;
+    }
+
+    return *(const char **)tr_vec_item(in->strs, atom);
+}
+
+unsigned int tr_intern_count(tr_intern tri)
+{
+    if (!tri) return 0;
+
+    intern *in = (intern *)tri;
+    return tr_vec_size(in->strs);
+}
+
+tr_err tr_intern_reserve(tr_intern tri, unsigned int count)
+{
+    if (!tri) return TR_EPOINTER;
+
+    intern *in = (intern *)tri;
+
+    tr_err err = tr_hash_reserve(in->atoms, count);
+    if (err < 0) {
+        return err;
+    }
+
+    return tr_vec_reserve(in->strs, count);
+}
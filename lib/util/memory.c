@@ -7,9 +7,897 @@
 //
 
 // libtraffic uses tr_malloc/tr_free for all heap-allocation needs.
-// For now malloc/free suit our needs, but it would be easy to switch
-// to a custom allocator should the need arise.
 //
-#include <stdlib.h>
-void *tr_malloc(unsigned int size) { return malloc(size); }
+// Small allocations (the bulk of what the library makes: list nodes, entity
+// structs, small vectors and hash tables) come from per-thread pools, one per
+// size class. Each pool carves blocks out of large chunks and recycles freed
+// blocks through a free list, so the common case is a handful of
+// instructions with no locking. Anything bigger than the largest size class
+// goes straight to the system allocator.
+//
+// Every block is preceded by a small header recording its size class, which
+// is how tr_free knows where to return it. A block freed on a different
+// thread than the one that allocated it simply joins the freeing thread's
+// pool. Pooled memory is recycled, but never returned to the system. When a
+// thread exits, whatever is left in its pools goes to a shared depot, and
+// other threads take it up before carving new chunks.
+//
+// Build with -DTR_SYSTEM_MALLOC to bypass the pools and use malloc/free
+// directly (e.g. when hunting memory bugs with valgrind or ASan).
+//
+// Allocations are also accounted to the subsystem that made them (see
+// tr_mem_stats). Pooled blocks record their tag in their header, so the
+// bytes are credited back to the right subsystem when they're freed. Under
+// TR_SYSTEM_MALLOC blocks have no header, so only arenas are accounted.
+// Build with -DTR_NO_MEM_STATS to compile accounting out altogether.
+//
+
+#include <assert.h> // for assert
+#include <pthread.h> // for pthread_mutex_t and friends
+#include <stdint.h> // for uint32_t
+#include <stdlib.h> // for malloc, free
+#include <string.h> // for memcpy, memset
+
+#include "memory.h"
+
+
+//
+// Size classes
+//
+
+#if !defined(TR_SYSTEM_MALLOC)
+
+// All blocks are aligned to (and headers padded to) this many bytes
+//
+#define ALIGNMENT 16
+
+// Number of pooled size classes. Sizes are spaced 16 bytes apart up to 128,
+// then 32 apart up to 256, then 64 apart up to 512.
+//
+#define NUM_CLASSES 16
+#define MAX_POOLED 512
+
+// Size class recorded in the header of blocks from the system allocator
+//
+#define CLASS_LARGE 0xFFFFFFFFu
+
+// Gets the size class for an allocation of the given size.
+// size must be at most MAX_POOLED.
+//
+static unsigned int tr_mem_sizeclass(unsigned int size)
+{
+    if (size <= 128) {
+        return size ? (size - 1) / 16 : 0;
+    }
+    else if (size <= 256) {
+        return 8 + (size - 129) / 32;
+    }
+    else {
+        return 12 + (size - 257) / 64;
+    }
+}
+
+// Gets the number of bytes blocks of the given size class hold
+//
+static unsigned int tr_mem_classsize(unsigned int sizeclass)
+{
+    if (sizeclass < 8) {
+        return 16 * (sizeclass + 1);
+    }
+    else if (sizeclass < 12) {
+        return 128 + 32 * (sizeclass - 7);
+    }
+    else {
+        return 256 + 64 * (sizeclass - 11);
+    }
+}
+
+#else
+
+// Without the pools, nothing comes in size classes
+//
+#define NUM_CLASSES 0
+
+#endif
+
+
+//
+// Accounting
+//
+
+// Each thread counts its allocations and frees in counters that only it
+// writes to, so the pools' fast paths pay a single increment and no locking.
+// Pooled blocks are counted by size class; their bytes are worked out from
+// the counts when needed. tr_mem_stats sums the counters of every thread
+// that has ever allocated. Counters are never freed, so allocations made by
+// a thread that has since exited still count.
+//
+// A block freed on a different thread than it was allocated on leaves one
+// thread's counts high and the other's low, but the sums are exact. Peaks
+// need a running process-wide total, which a thread only settles up with
+// when it grows: when its pools take a new chunk, or it makes a large
+// allocation.
+//
+
+// Index of the running totals for all tags combined
+//
+#define TAG_ALL TR_MEM_NUM_TAGS
+
+struct _tagcounters;
+struct _memcounters;
+
+typedef struct _tagcounters tagcounters;
+typedef struct _memcounters memcounters;
+
+struct _tagcounters
+{
+    unsigned long long allocs[NUM_CLASSES + 1]; // By size class, then large
+    unsigned long long frees[NUM_CLASSES + 1];  // By size class, then large
+    unsigned long long large[TR_MEM_HIST_BUCKETS]; // Large allocs by size
+    long long largebytes;   // Bytes in large blocks allocated less freed
+    long long settled;      // Bytes as last settled with g_bytes
+};
+
+struct _memcounters
+{
+    tagcounters tags[TR_MEM_NUM_TAGS];  // Counters for each tag
+    memcounters *next;                  // Counters for another thread
+};
+
+static __thread tr_memtag g_tag;        // Tag for the thread's allocations
+
+tr_memtag tr_mem_set_tag(tr_memtag tag)
+{
+    assert(tag >= 0 && tag < TR_MEM_NUM_TAGS);
+
+    tr_memtag prev = g_tag;
+    g_tag = tag;
+    return prev;
+}
+
+#if defined(TR_NO_MEM_STATS)
+
+static inline void tr_mem_count_alloc(uint32_t tag, unsigned int sizeclass) { }
+static inline void tr_mem_count_free(uint32_t tag, unsigned int sizeclass) { }
+static inline void tr_mem_count_large_alloc(uint32_t tag, unsigned int size) { }
+static inline void tr_mem_count_large_free(uint32_t tag, unsigned int size) { }
+static inline void tr_mem_count_large_resize(uint32_t tag, unsigned int from, unsigned int to) { }
+static inline void tr_mem_settle_all() { }
+
+#else
+
+static __thread memcounters *g_counters;
+
+static pthread_mutex_t g_counterslock = PTHREAD_MUTEX_INITIALIZER;
+static memcounters *g_allcounters;      // Every thread's counters
+
+static long long g_bytes[TR_MEM_NUM_TAGS + 1];  // Settled byte totals
+static long long g_peak[TR_MEM_NUM_TAGS + 1];   // Highest settled totals
+
+// Counters are only written by the thread that owns them, but are read by
+// whichever thread calls tr_mem_stats, so writes are (relaxed) atomic.
+//
+#define tr_mem_add(field, delta) \
+    __atomic_store_n(&(field), (field) + (delta), __ATOMIC_RELAXED)
+
+#define tr_mem_load(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// Allocates and registers counters for the calling thread.
+// Uses the system allocator, so it can't recurse into tr_malloc.
+//
+static __attribute__((noinline)) memcounters *tr_mem_register()
+{
+    memcounters *c = (memcounters *)calloc(1, sizeof(memcounters));
+    if (!c) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_counterslock);
+    c->next = g_allcounters;
+    g_allcounters = c;
+    pthread_mutex_unlock(&g_counterslock);
+
+    g_counters = c;
+    return c;
+}
+
+// Gets the calling thread's counters for the given tag
+//
+static inline tagcounters *tr_mem_counters(uint32_t tag)
+{
+    memcounters *c = g_counters;
+    if (__builtin_expect(!c, 0) && !(c = tr_mem_register())) {
+        return NULL;
+    }
+
+    assert(tag < TR_MEM_NUM_TAGS);
+    return &c->tags[tag];
+}
+
+// Gets the histogram bucket for an allocation of the given size
+//
+static unsigned int tr_mem_bucket(unsigned int size)
+{
+    if (size <= 16) {
+        return 0;
+    }
+
+    unsigned int bucket = 32 - __builtin_clz(size - 1) - 4;
+    return bucket < TR_MEM_HIST_BUCKETS ? bucket : TR_MEM_HIST_BUCKETS - 1;
+}
+
+// Works out how many bytes a thread's counters for a tag add up to.
+// Safe to call on another thread's counters.
+//
+static long long tr_mem_bytes(tagcounters *t)
+{
+    long long bytes = tr_mem_load(t->largebytes);
+
+#if !defined(TR_SYSTEM_MALLOC)
+    for (unsigned int c = 0; c < NUM_CLASSES; ++c) {
+        long long live = (long long)(tr_mem_load(t->allocs[c]) - tr_mem_load(t->frees[c]));
+        bytes += live * tr_mem_classsize(c);
+    }
+#endif
+
+    return bytes;
+}
+
+// Raises *peak to value, if value is higher
+//
+static void tr_mem_raise(long long *peak, long long value)
+{
+    long long old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(peak, &old, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Adds whatever the calling thread has allocated or freed for the given tag
+// since it last settled to the process-wide totals, raising their peaks
+//
+static void tr_mem_settle(tagcounters *t, uint32_t tag)
+{
+    long long bytes = tr_mem_bytes(t);
+    long long delta = bytes - t->settled;
+    t->settled = bytes;
+
+    tr_mem_raise(&g_peak[tag],
+                 __atomic_add_fetch(&g_bytes[tag], delta, __ATOMIC_RELAXED));
+    tr_mem_raise(&g_peak[TAG_ALL],
+                 __atomic_add_fetch(&g_bytes[TAG_ALL], delta, __ATOMIC_RELAXED));
+}
+
+static inline void tr_mem_settle_all()
+{
+    for (uint32_t tag = 0; tag < TR_MEM_NUM_TAGS; ++tag) {
+        tagcounters *t = tr_mem_counters(tag);
+        if (t) {
+            tr_mem_settle(t, tag);
+        }
+    }
+}
+
+static inline void tr_mem_count_alloc(uint32_t tag, unsigned int sizeclass)
+{
+    tagcounters *t = tr_mem_counters(tag);
+    if (t) {
+        tr_mem_add(t->allocs[sizeclass], 1);
+    }
+}
+
+static inline void tr_mem_count_free(uint32_t tag, unsigned int sizeclass)
+{
+    tagcounters *t = tr_mem_counters(tag);
+    if (t) {
+        tr_mem_add(t->frees[sizeclass], 1);
+    }
+}
+
+static void tr_mem_count_large_alloc(uint32_t tag, unsigned int size)
+{
+    tagcounters *t = tr_mem_counters(tag);
+    if (t) {
+        tr_mem_add(t->allocs[NUM_CLASSES], 1);
+        tr_mem_add(t->large[tr_mem_bucket(size)], 1);
+        tr_mem_add(t->largebytes, size);
+        tr_mem_settle(t, tag);
+    }
+}
+
+static void tr_mem_count_large_free(uint32_t tag, unsigned int size)
+{
+    tagcounters *t = tr_mem_counters(tag);
+    if (t) {
+        tr_mem_add(t->frees[NUM_CLASSES], 1);
+        tr_mem_add(t->largebytes, -(long long)size);
+    }
+}
+
+static inline void tr_mem_count_large_resize(uint32_t tag, unsigned int from, unsigned int to)
+{
+    tagcounters *t = tr_mem_counters(tag);
+    if (t) {
+        tr_mem_add(t->largebytes, (long long)to - (long long)from);
+        if (to > from) {
+            tr_mem_settle(t, tag);
+        }
+    }
+}
+
+#endif
+
+tr_err tr_mem_stats(tr_memtag tag, tr_memstats *stats)
+{
+    if (!stats) return TR_EPOINTER;
+    if (tag != TR_MEM_ALL && (tag < 0 || tag >= TR_MEM_NUM_TAGS)) {
+        return TR_EOUTOFRANGE;
+    }
+
+    memset(stats, 0, sizeof(tr_memstats));
+
+#if !defined(TR_NO_MEM_STATS)
+    unsigned int first = tag == TR_MEM_ALL ? 0 : tag;
+    unsigned int last = tag == TR_MEM_ALL ? TR_MEM_NUM_TAGS : tag + 1;
+
+    pthread_mutex_lock(&g_counterslock);
+
+    for (memcounters *c = g_allcounters; c; c = c->next) {
+        for (unsigned int i = first; i < last; ++i) {
+            tagcounters *t = &c->tags[i];
+
+            stats->bytes += tr_mem_bytes(t);
+
+            for (unsigned int s = 0; s <= NUM_CLASSES; ++s) {
+                stats->allocs += tr_mem_load(t->allocs[s]);
+                stats->frees += tr_mem_load(t->frees[s]);
+            }
+
+#if !defined(TR_SYSTEM_MALLOC)
+            // Size classes never straddle histogram buckets
+            for (unsigned int s = 0; s < NUM_CLASSES; ++s) {
+                stats->histogram[tr_mem_bucket(tr_mem_classsize(s))] +=
+                    tr_mem_load(t->allocs[s]);
+            }
+#endif
+
+            for (unsigned int b = 0; b < TR_MEM_HIST_BUCKETS; ++b) {
+                stats->histogram[b] += tr_mem_load(t->large[b]);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&g_counterslock);
+
+    long long peak = tr_mem_load(g_peak[tag == TR_MEM_ALL ? TAG_ALL : tag]);
+    stats->peak = peak > stats->bytes ? peak : stats->bytes;
+#endif
+
+    return TR_OK;
+}
+
+const char *tr_mem_tag_name(tr_memtag tag)
+{
+    static const char *names[] = { "containers", "topology", "packets", "capture",
+                                   "routing" };
+
+    if (tag == TR_MEM_ALL) {
+        return "all";
+    }
+
+    return tag >= 0 && tag < TR_MEM_NUM_TAGS ? names[tag] : NULL;
+}
+
+
+//
+// Pools
+//
+
+#if defined(TR_SYSTEM_MALLOC)
+
+// Zero-byte requests are bumped to one byte so they never come back NULL
+//
+void *tr_malloc(unsigned int size) { return malloc(size ? size : 1); }
+void *tr_calloc(unsigned int count, unsigned int size) { return calloc(count ? count : 1, size ? size : 1); }
+void *tr_realloc(void *mem, unsigned int size) { return realloc(mem, size ? size : 1); }
 void tr_free(void *mem) { free(mem); }
+
+#else
+
+// Size of the chunks each thread's pools carve blocks out of
+//
+static const unsigned int CHUNK_SIZE = 64 * 1024;
+
+struct _blockheader;
+struct _freeblock;
+struct _pool;
+struct _span;
+
+typedef struct _blockheader blockheader;
+typedef struct _freeblock freeblock;
+typedef struct _pool pool;
+typedef struct _span span;
+
+struct _blockheader
+{
+    uint32_t sizeclass;     // Index of the block's size class or CLASS_LARGE
+    uint32_t size;          // Size the block was requested with, in bytes
+    uint32_t tag;           // The tr_memtag the block is accounted to
+    uint32_t reserved;      // Pads the header out to ALIGNMENT
+};
+
+struct _freeblock
+{
+    freeblock *next;        // The next free block of the same size class
+};
+
+struct _pool
+{
+    freeblock *free[NUM_CLASSES];   // Free lists, one per size class
+    char *chunk;                    // Unused space in the current chunk
+    unsigned int chunkleft;         // Bytes left in the current chunk
+    bool owned;                     // Whether the thread's exit empties it
+};
+
+struct _span
+{
+    span *next;             // The next span in the depot
+    unsigned int size;      // Bytes in the span, this header included
+};
+
+static __thread pool g_pool;
+
+// What exited threads left in their pools, for other threads to take up
+//
+static pthread_mutex_t g_depotlock = PTHREAD_MUTEX_INITIALIZER;
+static freeblock *g_depot[NUM_CLASSES]; // Free blocks, by size class
+static span *g_spans;                   // Unused space at the ends of chunks
+
+static pthread_once_t g_poolonce = PTHREAD_ONCE_INIT;
+static pthread_key_t g_poolkey;
+
+// Hands a pool's free blocks and unused chunk space to the depot, when its
+// thread exits
+//
+static void tr_mem_release(void *ptr)
+{
+    pool *p = (pool *)ptr;
+
+    pthread_mutex_lock(&g_depotlock);
+
+    for (unsigned int c = 0; c < NUM_CLASSES; ++c) {
+        freeblock *head = p->free[c];
+        if (head) {
+            freeblock *tail = head;
+            while (tail->next) {
+                tail = tail->next;
+            }
+
+            tail->next = g_depot[c];
+            __atomic_store_n(&g_depot[c], head, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (p->chunkleft >= sizeof(blockheader) + tr_mem_classsize(0)) {
+        span *s = (span *)p->chunk;
+        s->size = p->chunkleft;
+        s->next = g_spans;
+        g_spans = s;
+    }
+
+    pthread_mutex_unlock(&g_depotlock);
+
+    memset(p, 0, sizeof(pool));
+}
+
+static void tr_mem_init_pools()
+{
+    pthread_key_create(&g_poolkey, tr_mem_release);
+}
+
+// Arranges for the thread's pool to go to the depot when the thread exits
+//
+static __attribute__((noinline)) void tr_mem_own(pool *p)
+{
+    pthread_once(&g_poolonce, tr_mem_init_pools);
+    pthread_setspecific(g_poolkey, p);
+    p->owned = true;
+}
+
+// Takes the depot's free blocks of the given size class, or NULL if it
+// has none
+//
+static freeblock *tr_mem_reclaim(unsigned int sizeclass)
+{
+    // Checked without the lock first, since the depot is usually empty
+    if (!__atomic_load_n(&g_depot[sizeclass], __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_depotlock);
+    freeblock *head = g_depot[sizeclass];
+    __atomic_store_n(&g_depot[sizeclass], NULL, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_depotlock);
+
+    return head;
+}
+
+// Takes a span of at least size bytes from the depot, or NULL if there
+// isn't one
+//
+static span *tr_mem_reclaim_span(unsigned int size)
+{
+    if (!__atomic_load_n(&g_spans, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_depotlock);
+
+    span **link = &g_spans;
+    while (*link && (*link)->size < size) {
+        link = &(*link)->next;
+    }
+
+    span *s = *link;
+    if (s) {
+        *link = s->next;
+    }
+
+    pthread_mutex_unlock(&g_depotlock);
+    return s;
+}
+
+// Takes a block of the given size class for a thread whose free list for
+// it is empty: from the depot if it has any, or else carved from the
+// thread's chunk
+//
+static blockheader *tr_mem_carve(pool *p, unsigned int sizeclass)
+{
+    unsigned int blocksize = sizeof(blockheader) + tr_mem_classsize(sizeclass);
+
+    if (!p->owned) {
+        tr_mem_own(p);
+    }
+
+    freeblock *head = tr_mem_reclaim(sizeclass);
+    if (head) {
+        p->free[sizeclass] = head->next;
+        return (blockheader *)head - 1;
+    }
+
+    if (p->chunkleft < blocksize) {
+        span *s = tr_mem_reclaim_span(blocksize);
+
+        if (s) {
+            p->chunk = (char *)s;
+            p->chunkleft = s->size;
+        }
+        else {
+            p->chunk = (char *)malloc(CHUNK_SIZE);
+            if (!p->chunk) {
+                p->chunkleft = 0;
+                return NULL;
+            }
+
+            p->chunkleft = CHUNK_SIZE;
+            tr_mem_settle_all();
+        }
+    }
+
+    blockheader *block = (blockheader *)p->chunk;
+    p->chunk += blocksize;
+    p->chunkleft -= blocksize;
+
+    return block;
+}
+
+void *tr_malloc(unsigned int size)
+{
+    blockheader *block;
+
+    if (size <= MAX_POOLED) {
+        pool *p = &g_pool;
+        unsigned int sizeclass = tr_mem_sizeclass(size);
+
+        freeblock *head = p->free[sizeclass];
+        if (head) {
+            p->free[sizeclass] = head->next;
+            block = (blockheader *)head - 1;
+        }
+        else {
+            block = tr_mem_carve(p, sizeclass);
+            if (!block) {
+                return NULL;
+            }
+        }
+
+        block->sizeclass = sizeclass;
+        tr_mem_count_alloc(g_tag, sizeclass);
+    }
+    else {
+        block = (blockheader *)malloc(sizeof(blockheader) + size);
+        if (!block) {
+            return NULL;
+        }
+
+        block->sizeclass = CLASS_LARGE;
+        tr_mem_count_large_alloc(g_tag, size);
+    }
+
+    block->size = size;
+    block->tag = g_tag;
+    return block + 1;
+}
+
+void *tr_calloc(unsigned int count, unsigned int size)
+{
+    unsigned int total = count * size;
+    if (size && total / size != count) {
+        return NULL;
+    }
+
+    // Large blocks come from calloc, which can hand back untouched
+    // (already zeroed) pages without writing to them.
+    if (total > MAX_POOLED) {
+        blockheader *block = (blockheader *)calloc(1, sizeof(blockheader) + total);
+        if (!block) {
+            return NULL;
+        }
+
+        block->sizeclass = CLASS_LARGE;
+        block->size = total;
+        block->tag = g_tag;
+        tr_mem_count_large_alloc(block->tag, total);
+
+        return block + 1;
+    }
+
+    void *mem = tr_malloc(total);
+    if (mem) {
+        memset(mem, 0, total);
+    }
+
+    return mem;
+}
+
+void *tr_realloc(void *mem, unsigned int size)
+{
+    if (!mem) {
+        return tr_malloc(size);
+    }
+
+    blockheader *block = (blockheader *)mem - 1;
+
+    if (block->sizeclass == CLASS_LARGE && size > MAX_POOLED) {
+        block = (blockheader *)realloc(block, sizeof(blockheader) + size);
+        if (!block) {
+            return NULL;
+        }
+
+        tr_mem_count_large_resize(block->tag, block->size, size);
+        block->size = size;
+        return block + 1;
+    }
+
+    if (block->sizeclass != CLASS_LARGE &&
+        size <= tr_mem_classsize(block->sizeclass) &&
+        tr_mem_sizeclass(size) == block->sizeclass) {
+        block->size = size;
+        return mem;
+    }
+
+    // The moved block stays with the subsystem that allocated it
+    tr_memtag tag = tr_mem_set_tag(block->tag);
+    void *newmem = tr_malloc(size);
+    tr_mem_set_tag(tag);
+
+    if (!newmem) {
+        return NULL;
+    }
+
+    memcpy(newmem, mem, block->size < size ? block->size : size);
+    tr_free(mem);
+
+    return newmem;
+}
+
+void tr_free(void *mem)
+{
+    if (!mem) {
+        return;
+    }
+
+    blockheader *block = (blockheader *)mem - 1;
+
+    if (block->sizeclass == CLASS_LARGE) {
+        tr_mem_count_large_free(block->tag, block->size);
+        free(block);
+        return;
+    }
+
+    tr_mem_count_free(block->tag, block->sizeclass);
+
+    assert(block->sizeclass < NUM_CLASSES);
+
+    pool *p = &g_pool;
+    if (__builtin_expect(!p->owned, 0)) {
+        tr_mem_own(p);
+    }
+
+    freeblock *freed = (freeblock *)mem;
+    freed->next = p->free[block->sizeclass];
+    p->free[block->sizeclass] = freed;
+}
+
+#endif
+
+
+//
+// Arenas
+//
+
+// Arena allocations are rounded up to this many bytes
+//
+#define ARENA_ALIGNMENT 16
+
+// Default size of the chunks an arena allocates from. Allocations bigger than
+// a quarter of this get a chunk of their own.
+//
+static const unsigned int ARENA_CHUNK_SIZE = 64 * 1024;
+
+// Arena free lists are kept for sizes up to this many bytes (one list per
+// multiple of ARENA_ALIGNMENT). Bigger frees are ignored until the arena is
+// deleted.
+//
+#define ARENA_MAX_RECYCLED 512
+#define ARENA_NUM_LISTS (ARENA_MAX_RECYCLED / ARENA_ALIGNMENT)
+
+struct _arenachunk;
+struct _arena;
+
+typedef struct _arenachunk arenachunk;
+typedef struct _arena arena;
+
+struct _arenachunk
+{
+    arenachunk *next;       // The previously allocated chunk
+    uint32_t size;          // Size of the chunk, header included
+    uint32_t reserved;      // Keeps the chunk's data 16-byte aligned
+};
+
+struct _arena
+{
+    arenachunk *chunks;     // Every chunk owned by the arena, newest first
+    char *next;             // Unused space in the newest chunk
+    unsigned int left;      // Bytes left in the newest chunk
+
+    void *free[ARENA_NUM_LISTS]; // Recycled allocations, by size
+
+    tr_memtag tag;          // Tag the arena's chunks are accounted to
+};
+
+// Rounds size up to a multiple of ARENA_ALIGNMENT (and at least one)
+//
+static unsigned int tr_arena_roundup(unsigned int size)
+{
+    if (size == 0) {
+        size = 1;
+    }
+
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+// Allocates a new chunk with room for at least size bytes and links it into
+// the arena's chunk list. Returns the chunk's data.
+//
+// Arenas are accounted a chunk at a time, to the tag that was current when
+// the arena was created, rather than per allocation.
+//
+static char *tr_arena_newchunk(arena *a, unsigned int size)
+{
+    arenachunk *chunk = (arenachunk *)malloc(sizeof(arenachunk) + size);
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->size = sizeof(arenachunk) + size;
+    tr_mem_count_large_alloc(a->tag, chunk->size);
+
+    chunk->next = a->chunks;
+    a->chunks = chunk;
+
+    return (char *)(chunk + 1);
+}
+
+tr_arena tr_arena_create()
+{
+    arena *a = (arena *)malloc(sizeof(arena));
+    if (!a) {
+        return NULL;
+    }
+
+    memset(a, 0, sizeof(arena));
+
+    a->tag = g_tag;
+    tr_mem_count_large_alloc(a->tag, sizeof(arena));
+
+    return a;
+}
+
+void tr_arena_delete(tr_arena tra)
+{
+    if (!tra) {
+        return;
+    }
+
+    arena *a = (arena *)tra;
+
+    arenachunk *chunk = a->chunks;
+    while (chunk) {
+        arenachunk *next = chunk->next;
+        tr_mem_count_large_free(a->tag, chunk->size);
+        free(chunk);
+        chunk = next;
+    }
+
+    tr_mem_count_large_free(a->tag, sizeof(arena));
+    free(a);
+}
+
+void *tr_arena_alloc(tr_arena tra, unsigned int size)
+{
+    if (!tra) {
+        return NULL;
+    }
+
+    arena *a = (arena *)tra;
+    size = tr_arena_roundup(size);
+
+    if (size <= ARENA_MAX_RECYCLED) {
+        unsigned int list = size / ARENA_ALIGNMENT - 1;
+        void *mem = a->free[list];
+
+        if (mem) {
+            a->free[list] = *(void **)mem;
+            return mem;
+        }
+    }
+
+    // Oversized allocations get their own chunk, leaving the current one be
+    if (size > ARENA_CHUNK_SIZE / 4) {
+        return tr_arena_newchunk(a, size);
+    }
+
+    if (a->left < size) {
+        a->next = tr_arena_newchunk(a, ARENA_CHUNK_SIZE);
+        a->left = a->next ? ARENA_CHUNK_SIZE : 0;
+
+        if (!a->next) {
+            return NULL;
+        }
+    }
+
+    void *mem = a->next;
+    a->next += size;
+    a->left -= size;
+
+    return mem;
+}
+
+void tr_arena_free(tr_arena tra, void *mem, unsigned int size)
+{
+    if (!tra || !mem) {
+        return;
+    }
+
+    arena *a = (arena *)tra;
+    size = tr_arena_roundup(size);
+
+    if (size <= ARENA_MAX_RECYCLED) {
+        unsigned int list = size / ARENA_ALIGNMENT - 1;
+
+        *(void **)mem = a->free[list];
+        a->free[list] = mem;
+    }
+}
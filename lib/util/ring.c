@@ -0,0 +1,494 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ring.c - Bounded lock-free ring buffers
+//
+
+#define _POSIX_C_SOURCE 200112L // for clock_gettime, poll, pipe, fcntl
+
+#include <errno.h> // for errno, EINTR
+#include <fcntl.h> // for fcntl, O_NONBLOCK
+#include <poll.h> // for poll
+#include <stdint.h> // for uint32_t, uint64_t, uintptr_t
+#include <string.h> // for memcpy, memset
+#include <time.h> // for clock_gettime
+#include <unistd.h> // for read, write, close, pipe
+
+#if defined(__linux__)
+#include <sys/eventfd.h> // for eventfd
+#endif
+
+#include "memory.h"
+#include "ring.h"
+
+// Items live in a power-of-two array indexed by free-running 32-bit
+// counters: head counts items ever popped, tail counts slots ever claimed by
+// producers, and tail - head is the number in flight. The producer and
+// consumer ends each sit on their own cache line so neither thread's writes
+// invalidate the other's.
+//
+// Single-producer rings publish items with a release store of tail, and
+// each end keeps a private copy of the other's counter, only re-reading the
+// shared one when its copy says the ring is full (or empty).
+//
+// Multi-producer rings have producers claim runs of slots by compare-and-swap
+// on tail, then fill them in whatever order the producers get to them. Each
+// slot has a sequence number that's set to its position + 1 once its item
+// has been written, so the consumer knows how far it can safely read.
+//
+// To sleep, the consumer arms the ring and then rechecks it for items. A
+// producer that pushes and then sees the ring armed disarms it and writes to
+// the wakeup descriptor. Full fences on both sides make sure that either the
+// consumer's recheck sees the item or the producer sees the ring armed.
+//
+
+#define CACHE_LINE 64
+
+// Largest allowed capacity. Keeps tail - head unambiguous.
+//
+static const unsigned int MAX_CAPACITY = 1u << 31;
+
+struct _ring;
+typedef struct _ring ring;
+
+struct _ring
+{
+    // Fixed after creation
+    unsigned int itemsize;  // Size of each item, in bytes
+    unsigned int mask;      // Capacity - 1
+    bool multi;             // Whether many threads may push at once
+    char *items;            // The item array
+    uint32_t *seqs;         // Per-slot sequence numbers (multi only)
+    int readfd;             // Wakeup descriptor the consumer polls
+    int writefd;            // Wakeup descriptor producers write to
+    void *mem;              // The allocation the ring lives in
+
+    // Producer end
+    unsigned int tail __attribute__((aligned(CACHE_LINE)));
+    unsigned int headcache; // Producer's copy of head (single-producer only)
+
+    // Consumer end
+    unsigned int head __attribute__((aligned(CACHE_LINE)));
+    unsigned int tailcache; // Consumer's copy of tail (single-producer only)
+
+    // Set while the consumer is (about to be) asleep
+    unsigned int armed __attribute__((aligned(CACHE_LINE)));
+};
+
+// Copies count items into the ring starting at position pos, wrapping
+// around the end of the item array as needed
+//
+static void tr_ring_copyin(ring *r, unsigned int pos, const char *src,
+                           unsigned int count)
+{
+    unsigned int start = pos & r->mask;
+    unsigned int first = r->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+
+    memcpy(r->items + (size_t)start * r->itemsize, src, (size_t)first * r->itemsize);
+    memcpy(r->items, src + (size_t)first * r->itemsize,
+           (size_t)(count - first) * r->itemsize);
+}
+
+// The reverse of tr_ring_copyin
+//
+static void tr_ring_copyout(ring *r, unsigned int pos, char *dst,
+                            unsigned int count)
+{
+    unsigned int start = pos & r->mask;
+    unsigned int first = r->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+
+    memcpy(dst, r->items + (size_t)start * r->itemsize, (size_t)first * r->itemsize);
+    memcpy(dst + (size_t)first * r->itemsize, r->items,
+           (size_t)(count - first) * r->itemsize);
+}
+
+// Whether the consumer has an item it can pop right now
+//
+static bool tr_ring_ready(ring *r)
+{
+    unsigned int head = r->head;
+
+    if (r->multi) {
+        return __atomic_load_n(&r->seqs[head & r->mask], __ATOMIC_ACQUIRE) == head + 1;
+    }
+
+    return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) != head;
+}
+
+// Wakes the consumer if it's asleep. Called by producers after publishing.
+//
+static void tr_ring_notify(ring *r)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (!__atomic_load_n(&r->armed, __ATOMIC_RELAXED) ||
+        !__atomic_exchange_n(&r->armed, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    // eventfds take exactly 8 bytes; pipes take anything. A full pipe (or
+    // eventfd counter) already means the consumer will wake.
+    uint64_t one = 1;
+    ssize_t written = write(r->writefd, &one, sizeof(one));
+    (void)written;
+}
+
+// Clears any pending wakeups from the wakeup descriptor
+//
+static void tr_ring_drain(ring *r)
+{
+    char buf[64];
+    while (read(r->readfd, buf, sizeof(buf)) > 0) {
+        // Keep reading
+    }
+}
+
+// Opens the ring's wakeup descriptors. Returns false on failure.
+//
+static bool tr_ring_openfds(ring *r)
+{
+#if defined(__linux__)
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    r->readfd = fd;
+    r->writefd = fd;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+    r->readfd = fds[0];
+    r->writefd = fds[1];
+#endif
+
+    return true;
+}
+
+static tr_ring tr_ring_create(unsigned int itemsize, unsigned int capacity,
+                              bool multi)
+{
+    if (itemsize == 0 || capacity == 0 || capacity > MAX_CAPACITY) {
+        return NULL;
+    }
+
+    unsigned int cap = 1;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    void *mem = tr_malloc(sizeof(ring) + CACHE_LINE);
+    if (!mem) {
+        return NULL;
+    }
+
+    uintptr_t base = (uintptr_t)mem;
+    ring *r = (ring *)((base + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+    memset(r, 0, sizeof(ring));
+
+    r->mem = mem;
+    r->itemsize = itemsize;
+    r->mask = cap - 1;
+    r->multi = multi;
+
+    if ((size_t)cap * itemsize > 0xFFFFFFFFu) {
+        tr_free(mem);
+        return NULL;
+    }
+
+    r->items = (char *)tr_malloc(cap * itemsize);
+    if (multi) {
+        r->seqs = (uint32_t *)tr_calloc(cap, sizeof(uint32_t));
+    }
+
+    if (!r->items || (multi && !r->seqs) || !tr_ring_openfds(r)) {
+        tr_free(r->items);
+        tr_free(r->seqs);
+        tr_free(mem);
+        return NULL;
+    }
+
+    return r;
+}
+
+tr_ring tr_ring_create_spsc(unsigned int itemsize, unsigned int capacity)
+{
+    return tr_ring_create(itemsize, capacity, false);
+}
+
+tr_ring tr_ring_create_mpsc(unsigned int itemsize, unsigned int capacity)
+{
+    return tr_ring_create(itemsize, capacity, true);
+}
+
+tr_err tr_ring_delete(tr_ring trr)
+{
+    if (!trr) {
+        return TR_EPOINTER;
+    }
+
+    ring *r = (ring *)trr;
+
+    close(r->readfd);
+    if (r->writefd != r->readfd) {
+        close(r->writefd);
+    }
+
+    tr_free(r->items);
+    tr_free(r->seqs);
+    tr_free(r->mem);
+
+    return TR_OK;
+}
+
+unsigned int tr_ring_capacity(tr_ring trr)
+{
+    if (!trr) {
+        return 0;
+    }
+
+    return ((ring *)trr)->mask + 1;
+}
+
+unsigned int tr_ring_size(tr_ring trr)
+{
+    if (!trr) {
+        return 0;
+    }
+
+    ring *r = (ring *)trr;
+
+    unsigned int head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    // tail may have moved on since head was read; clamp the difference
+    unsigned int size = tail - head;
+    if (size > r->mask + 1) {
+        size = r->mask + 1;
+    }
+
+    return size;
+}
+
+tr_err tr_ring_push(tr_ring trr, const void *item)
+{
+    if (!trr || !item) {
+        return TR_EPOINTER;
+    }
+
+    return tr_ring_push_n(trr, item, 1) ? TR_OK : TR_EFULL;
+}
+
+tr_err tr_ring_pop(tr_ring trr, void *item)
+{
+    if (!trr || !item) {
+        return TR_EPOINTER;
+    }
+
+    return tr_ring_pop_n(trr, item, 1) ? TR_OK : TR_EEMPTY;
+}
+
+unsigned int tr_ring_push_n(tr_ring trr, const void *items, unsigned int count)
+{
+    if (!trr || !items || count == 0) {
+        return 0;
+    }
+
+    ring *r = (ring *)trr;
+    unsigned int cap = r->mask + 1;
+    unsigned int tail, n;
+
+    if (!r->multi) {
+        tail = r->tail;
+
+        if (cap - (tail - r->headcache) < count) {
+            r->headcache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        }
+
+        n = cap - (tail - r->headcache);
+        if (n > count) {
+            n = count;
+        }
+
+        if (n == 0) {
+            return 0;
+        }
+
+        tr_ring_copyin(r, tail, (const char *)items, n);
+        __atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+    }
+    else {
+        tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+
+        // Claim a run of slots. head is read after tail, and only grows,
+        // so the free space we compute is never an overestimate.
+        do {
+            unsigned int head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+            n = cap - (tail - head);
+            if (n > count) {
+                n = count;
+            }
+
+            if (n == 0) {
+                return 0;
+            }
+        } while (!__atomic_compare_exchange_n(&r->tail, &tail, tail + n, true,
+                                              __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+        tr_ring_copyin(r, tail, (const char *)items, n);
+
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int pos = tail + i;
+            __atomic_store_n(&r->seqs[pos & r->mask], pos + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    tr_ring_notify(r);
+
+    return n;
+}
+
+unsigned int tr_ring_pop_n(tr_ring trr, void *items, unsigned int count)
+{
+    if (!trr || !items || count == 0) {
+        return 0;
+    }
+
+    ring *r = (ring *)trr;
+    unsigned int head = r->head;
+    unsigned int n;
+
+    if (!r->multi) {
+        if (r->tailcache - head < count) {
+            r->tailcache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        }
+
+        n = r->tailcache - head;
+        if (n > count) {
+            n = count;
+        }
+    }
+    else {
+        // Claimed slots may be filled out of order; stop at the first one
+        // that hasn't been published yet
+        n = 0;
+        while (n < count && __atomic_load_n(&r->seqs[(head + n) & r->mask],
+                                            __ATOMIC_ACQUIRE) == head + n + 1) {
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    tr_ring_copyout(r, head, (char *)items, n);
+    __atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+// Milliseconds on the monotonic clock
+//
+static long long tr_ring_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+tr_err tr_ring_wait(tr_ring trr, int timeout)
+{
+    if (!trr) {
+        return TR_EPOINTER;
+    }
+
+    ring *r = (ring *)trr;
+    long long deadline = timeout >= 0 ? tr_ring_now() + timeout : 0;
+
+    // Wakeups can be stale (left over from an earlier arming), so keep
+    // sleeping until there's really an item or time's up
+    while (!tr_ring_ready(r)) {
+        int left = -1;
+        if (timeout >= 0) {
+            long long now = tr_ring_now();
+            if (now >= deadline) {
+                return TR_EEMPTY;
+            }
+
+            left = (int)(deadline - now);
+        }
+
+        if (tr_ring_arm(r)) {
+            struct pollfd pfd;
+            pfd.fd = r->readfd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            if (poll(&pfd, 1, left) < 0 && errno != EINTR) {
+                tr_ring_disarm(r);
+                return TR_EINTERNAL;
+            }
+
+            tr_ring_disarm(r);
+        }
+    }
+
+    return TR_OK;
+}
+
+int tr_ring_fd(tr_ring trr)
+{
+    if (!trr) {
+        return -1;
+    }
+
+    return ((ring *)trr)->readfd;
+}
+
+bool tr_ring_arm(tr_ring trr)
+{
+    if (!trr) {
+        return false;
+    }
+
+    ring *r = (ring *)trr;
+
+    __atomic_store_n(&r->armed, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (tr_ring_ready(r)) {
+        __atomic_store_n(&r->armed, 0, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    return true;
+}
+
+void tr_ring_disarm(tr_ring trr)
+{
+    if (!trr) {
+        return;
+    }
+
+    ring *r = (ring *)trr;
+
+    __atomic_store_n(&r->armed, 0, __ATOMIC_RELAXED);
+    tr_ring_drain(r);
+}
@@ -6,98 +6,554 @@
 // set.h - Basic hashset implementation
 //
 
+#include <stdint.h> // for uint64_t, int64_t
 #include <stdlib.h> // for NULL
+#include <string.h> // for memcpy
 
+#if defined(__SSE2__)
+#include <emmintrin.h> // for _mm_movemask_epi8 and friends
+#endif
+
+#include "memory.h"
 #include "set.h"
 
-tr_set tr_set_create(unsigned int keysize, 
+// Sets are hashtables with no values. Intsets can also be bitmaps: an array
+// of 64-bit words covering a range of values starting at a multiple of 64,
+// one bit per value. Membership, adding and removing are then a single bit
+// test or update, and iteration skips empty words and finds set bits with
+// count-trailing-zeros.
+//
+// An intset becomes a bitmap once it has at least BITMAP_MIN_COUNT items
+// spread over no more than DENSE_SPAN values per item, and goes back to
+// being a hashtable once its range grows past SPARSE_SPAN values per item.
+// The gap between the two keeps sets near the threshold from flip-flopping.
+//
+// While an intset is a hashtable, it tracks bounds on its items to decide
+// when to switch. Removing the smallest or largest item leaves the bounds
+// loose; they're recomputed exactly when the set tries to switch, or (to
+// keep the cost amortized constant) once the set has seen a further
+// eighth of its size in adds.
+//
+
+#define BITMAP_MIN_COUNT 64
+#define DENSE_SPAN 32
+#define SPARSE_SPAN 128
+
+// Bitmaps of up to this many words are never considered too sparse
+//
+#define BITMAP_MIN_WORDS 4
+
+struct _set;
+typedef struct _set set;
+
+struct _set
+{
+    tr_hash hash;           // The set's items, unless it's a bitmap
+    bool isint;             // Whether the set is an intset
+
+    // While an intset is a hashtable
+    int min;                // No greater than the smallest item
+    int max;                // No less than the largest item
+    bool loose;             // Whether min and max may not be exact
+    unsigned int adds;      // Adds since min and max went loose
+
+    // While an intset is a bitmap
+    uint64_t *words;        // The bitmap
+    unsigned int numwords;  // Number of words in the bitmap
+    unsigned int count;     // Number of bits set
+    int64_t base;           // Value of the first word's lowest bit
+};
+
+// Rounds a value down to a multiple of 64
+//
+static int64_t tr_set_floor64(int64_t value)
+{
+    return value & ~(int64_t)63;
+}
+
+static bool tr_bitmap_contains(set *s, int key)
+{
+    int64_t off = (int64_t)key - s->base;
+    if (off < 0 || off >= (int64_t)s->numwords * 64) {
+        return false;
+    }
+
+    return (s->words[off >> 6] >> (off & 63)) & 1;
+}
+
+// Widens the bitmap to cover [base, base + numwords * 64)
+//
+static tr_err tr_bitmap_resize(set *s, int64_t base, unsigned int numwords)
+{
+    uint64_t *words = (uint64_t *)tr_calloc(numwords, sizeof(uint64_t));
+    if (!words) {
+        return TR_ENOMEM;
+    }
+
+    if (s->words) {
+        memcpy(words + (s->base - base) / 64, s->words, s->numwords * sizeof(uint64_t));
+        tr_free(s->words);
+    }
+
+    s->words = words;
+    s->numwords = numwords;
+    s->base = base;
+
+    return TR_OK;
+}
+
+// Turns a hashtable intset into a bitmap if it's dense enough.
+// Tightens the set's bounds either way.
+//
+static tr_err tr_set_tobitmap(set *s)
+{
+    unsigned int count = tr_hash_num_keys(s->hash);
+    if (count == 0) {
+        return TR_OK;
+    }
+
+    tr_hash_iter it;
+    bool first = true;
+
+    tr_hash_foreach(it, s->hash) {
+        int key = *(int *)it.key;
+        if (first || key < s->min) s->min = key;
+        if (first || key > s->max) s->max = key;
+        first = false;
+    }
+
+    s->loose = false;
+
+    if ((int64_t)s->max - s->min + 1 > (int64_t)count * DENSE_SPAN) {
+        return TR_OK;
+    }
+
+    int64_t base = tr_set_floor64(s->min);
+    unsigned int numwords = (unsigned int)((tr_set_floor64(s->max) - base) / 64 + 1);
+
+    tr_err err = tr_bitmap_resize(s, base, numwords);
+    if (err < 0) {
+        return err;
+    }
+
+    tr_hash_foreach(it, s->hash) {
+        int64_t off = (int64_t)*(int *)it.key - base;
+        s->words[off >> 6] |= 1ull << (off & 63);
+    }
+
+    s->count = count;
+
+    tr_inthash_delete(s->hash);
+    s->hash = NULL;
+
+    return TR_OK;
+}
+
+// Turns a bitmap intset back into a hashtable
+//
+static tr_err tr_set_tohash(set *s)
+{
+    tr_hash hash = tr_inthash_create(0);
+    if (!hash) {
+        return TR_ENOMEM;
+    }
+
+    tr_set_iter it;
+    bool first = true;
+
+    tr_set_foreach(it, s) {
+        int key = it.value;
+
+        tr_err err = tr_inthash_set(hash, key, NULL);
+        if (err < 0) {
+            tr_inthash_delete(hash);
+            return err;
+        }
+
+        if (first || key < s->min) s->min = key;
+        if (first || key > s->max) s->max = key;
+        first = false;
+    }
+
+    tr_free(s->words);
+    s->words = NULL;
+    s->numwords = 0;
+    s->count = 0;
+    s->hash = hash;
+    s->loose = false;
+
+    return TR_OK;
+}
+
+static tr_err tr_bitmap_add(set *s, int key)
+{
+    int64_t off = (int64_t)key - s->base;
+
+    if (off < 0 || off >= (int64_t)s->numwords * 64) {
+        int64_t keybase = tr_set_floor64(key);
+        int64_t base = keybase < s->base ? keybase : s->base;
+        int64_t end = s->base + (int64_t)s->numwords * 64;
+        if (keybase + 64 > end) {
+            end = keybase + 64;
+        }
+
+        // Too sparse to stay a bitmap
+        int64_t numwords = (end - base) / 64;
+        if (numwords > BITMAP_MIN_WORDS &&
+            end - base > ((int64_t)s->count + 1) * SPARSE_SPAN) {
+            tr_err err = tr_set_tohash(s);
+            if (err < 0) {
+                return err;
+            }
+
+            if (key < s->min) s->min = key;
+            if (key > s->max) s->max = key;
+            return tr_inthash_set(s->hash, key, NULL);
+        }
+
+        // Grow geometrically in whichever direction the key is, so runs of
+        // sequential adds don't copy the bitmap every 64 items
+        if (numwords < 2 * (int64_t)s->numwords) {
+            int64_t extra = 2 * (int64_t)s->numwords - numwords;
+            if (base < s->base) {
+                base -= extra * 64;
+            }
+
+            numwords += extra;
+        }
+
+        tr_err err = tr_bitmap_resize(s, base, (unsigned int)numwords);
+        if (err < 0) {
+            return err;
+        }
+
+        off = (int64_t)key - s->base;
+    }
+
+    uint64_t bit = 1ull << (off & 63);
+    if (!(s->words[off >> 6] & bit)) {
+        s->words[off >> 6] |= bit;
+        s->count++;
+    }
+
+    return TR_OK;
+}
+
+static tr_err tr_bitmap_remove(set *s, int key)
+{
+    if (!tr_bitmap_contains(s, key)) {
+        return TR_ENOTFOUND;
+    }
+
+    int64_t off = (int64_t)key - s->base;
+    s->words[off >> 6] &= ~(1ull << (off & 63));
+    s->count--;
+
+    if (s->numwords > BITMAP_MIN_WORDS &&
+        (int64_t)s->numwords * 64 > (int64_t)s->count * SPARSE_SPAN) {
+        // Failing to switch just leaves the set a (valid) bitmap
+        tr_set_tohash(s);
+    }
+
+    return TR_OK;
+}
+
+// Creates a set wrapping the given hashtable
+//
+static tr_set tr_set_wrap(tr_hash hash, bool isint)
+{
+    if (!hash) {
+        return NULL;
+    }
+
+    set *s = (set *)tr_calloc(1, sizeof(set));
+    if (!s) {
+        tr_hash_delete(hash);
+        return NULL;
+    }
+
+    s->hash = hash;
+    s->isint = isint;
+
+    return s;
+}
+
+tr_set tr_set_create(unsigned int keysize,
                      tr_hashfunc hashfunc,
                      tr_equalfunc equalfunc)
 {
-    return tr_hash_create(keysize, 0, hashfunc, equalfunc);
+    return tr_set_wrap(tr_hash_create(keysize, 0, hashfunc, equalfunc), false);
 }
 
-tr_err tr_set_delete(tr_set set)
+tr_err tr_set_delete(tr_set trs)
 {
-    return tr_hash_delete(set);
+    if (!trs) return TR_EPOINTER;
+
+    set *s = (set *)trs;
+
+    if (s->hash) {
+        tr_hash_delete(s->hash);
+    }
+
+    tr_free(s->words);
+    tr_free(s);
+
+    return TR_OK;
 }
 
-bool tr_set_contains(tr_set set, const void *key)
+bool tr_set_contains(tr_set trs, const void *key)
 {
-    return tr_hash_contains(set, key);
+    if (!trs) return false;
+
+    set *s = (set *)trs;
+    if (s->isint) {
+        return key && tr_intset_contains(trs, *(const int *)key);
+    }
+
+    return tr_hash_contains(s->hash, key);
+}
+
+tr_err tr_set_add(tr_set trs, const void *key)
+{
+    if (!trs) return TR_EPOINTER;
+
+    set *s = (set *)trs;
+    if (s->isint) {
+        return key ? tr_intset_add(trs, *(const int *)key) : TR_EPOINTER;
+    }
+
+    return tr_hash_set(s->hash, key, NULL);
 }
 
-tr_err tr_set_add(tr_set set, const void *key)
+tr_err tr_set_remove(tr_set trs, const void *key)
 {
-    return tr_hash_set(set, key, NULL);
+    if (!trs) return TR_EPOINTER;
+
+    set *s = (set *)trs;
+    if (s->isint) {
+        return key ? tr_intset_remove(trs, *(const int *)key) : TR_EPOINTER;
+    }
+
+    return tr_hash_clear(s->hash, key);
 }
 
-tr_err tr_set_remove(tr_set set, const void *key)
+unsigned int tr_set_size(tr_set trs)
 {
-    return tr_hash_clear(set, key);
+    if (!trs) return 0;
+
+    set *s = (set *)trs;
+    return s->hash ? tr_hash_num_keys(s->hash) : s->count;
 }
 
-tr_vector tr_set_items(tr_set set)
+tr_vector tr_set_items(tr_set trs)
 {
-    return tr_hash_keys(set);
+    if (!trs) return NULL;
+
+    set *s = (set *)trs;
+    if (s->hash) {
+        return tr_hash_keys(s->hash);
+    }
+
+    tr_vector items = tr_vec_create(sizeof(int), s->count);
+    if (!items) {
+        return NULL;
+    }
+
+    tr_set_iter it;
+    tr_set_foreach(it, trs) {
+        tr_vec_append(items, &it.value);
+    }
+
+    return items;
+}
+
+void tr_set_iter_init(tr_set trs, tr_set_iter *it)
+{
+    if (!it) return;
+
+    set *s = (set *)trs;
+
+    it->key = NULL;
+    it->words = NULL;
+    it->numwords = 0;
+    it->word = 0;
+    it->bits = 0;
+    it->base = 0;
+    it->value = 0;
+
+    if (s && !s->hash) {
+        it->words = s->words;
+        it->numwords = s->numwords;
+        it->base = s->base;
+    }
+
+    tr_hash_iter_init(s ? s->hash : NULL, &it->hashit);
+}
+
+bool tr_set_iter_next(tr_set_iter *it)
+{
+    if (!it) return false;
+
+    if (!it->words) {
+        if (!tr_hash_iter_next(&it->hashit)) {
+            it->key = NULL;
+            return false;
+        }
+
+        it->key = it->hashit.key;
+        return true;
+    }
+
+    if (!it->bits) {
+        const uint64_t *words = it->words;
+        unsigned int w = it->word;
+        unsigned int n = it->numwords;
+
+#if defined(__SSE2__)
+        // Skip empty words two at a time
+        __m128i zero = _mm_setzero_si128();
+        while (w + 2 <= n) {
+            __m128i pair = _mm_loadu_si128((const __m128i *)(words + w));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(pair, zero)) != 0xFFFF) {
+                break;
+            }
+
+            w += 2;
+        }
+#endif
+
+        while (w < n && !words[w]) {
+            w++;
+        }
+
+        if (w >= n) {
+            it->word = n;
+            it->key = NULL;
+            return false;
+        }
+
+        it->bits = words[w];
+        it->word = w + 1;
+    }
+
+    unsigned int bit = __builtin_ctzll(it->bits);
+    it->bits &= it->bits - 1;
+
+    it->value = (int)(it->base + (int64_t)(it->word - 1) * 64 + bit);
+    it->key = &it->value;
+
+    return true;
 }
 
 tr_set tr_strset_create()
 {
-    return tr_strhash_create(0);
+    return tr_set_wrap(tr_strhash_create(0), false);
 }
 
 tr_err tr_strset_delete(tr_set set)
 {
-    return tr_strhash_delete(set);
+    return tr_set_delete(set);
 }
 
 bool tr_strset_contains(tr_set set, const char *key)
 {
-    return tr_strhash_contains(set, key);
+    return tr_set_contains(set, &key);
 }
 
 tr_err tr_strset_add(tr_set set, const char *key)
 {
-    return tr_strhash_set(set, key, NULL);
+    return tr_set_add(set, &key);
 }
 
 tr_err tr_strset_remove(tr_set set, const char *key)
 {
-    return tr_strhash_clear(set, key);
+    return tr_set_remove(set, &key);
 }
 
 tr_vector tr_strset_items(tr_set set)
 {
-    return tr_strhash_keys(set);
+    return tr_set_items(set);
 }
 
 tr_set tr_intset_create()
 {
-    return tr_inthash_create(0);
+    return tr_set_wrap(tr_inthash_create(0), true);
 }
 
 tr_err tr_intset_delete(tr_set set)
 {
-    return tr_inthash_delete(set);
+    return tr_set_delete(set);
 }
 
-bool tr_intset_contains(tr_set set, int key)
+bool tr_intset_contains(tr_set trs, int key)
 {
-    return tr_inthash_contains(set, key);
+    if (!trs) return false;
+
+    set *s = (set *)trs;
+    return s->hash ? tr_inthash_contains(s->hash, key) : tr_bitmap_contains(s, key);
 }
 
-tr_err tr_intset_add(tr_set set, int key)
+tr_err tr_intset_add(tr_set trs, int key)
 {
-    return tr_inthash_set(set, key, NULL);
+    if (!trs) return TR_EPOINTER;
+
+    set *s = (set *)trs;
+    if (!s->hash) {
+        return tr_bitmap_add(s, key);
+    }
+
+    unsigned int count = tr_hash_num_keys(s->hash);
+    if (count == 0 || key < s->min) s->min = key;
+    if (count == 0 || key > s->max) s->max = key;
+
+    tr_err err = tr_inthash_set(s->hash, key, NULL);
+    if (err < 0) {
+        return err;
+    }
+
+    count = tr_hash_num_keys(s->hash);
+    if (count < BITMAP_MIN_COUNT) {
+        return TR_OK;
+    }
+
+    bool dense = (int64_t)s->max - s->min + 1 <= (int64_t)count * DENSE_SPAN;
+    if (s->loose && ++s->adds >= count / 8) {
+        s->adds = 0;
+        dense = true;
+    }
+
+    if (dense) {
+        // Failing to switch just leaves the set a (valid) hashtable
+        tr_set_tobitmap(s);
+    }
+
+    return TR_OK;
 }
 
-tr_err tr_intset_remove(tr_set set, int key)
+tr_err tr_intset_remove(tr_set trs, int key)
 {
-    return tr_inthash_clear(set, key);
+    if (!trs) return TR_EPOINTER;
+
+    set *s = (set *)trs;
+    if (!s->hash) {
+        return tr_bitmap_remove(s, key);
+    }
+
+    tr_err err = tr_inthash_clear(s->hash, key);
+    if (err == TR_OK && (key == s->min || key == s->max) && !s->loose) {
+        s->loose = true;
+        s->adds = 0;
+    }
+
+    return err;
 }
 
 tr_vector tr_intset_items(tr_set set)
 {
-    return tr_inthash_keys(set);
+    return tr_set_items(set);
+}
+
+bool tr_intset_dense(tr_set trs)
+{
+    return trs && !((set *)trs)->hash;
 }
@@ -0,0 +1,167 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// slotmap.c - Generational slot map of fixed-size items
+//
+
+#include <stdlib.h> // for NULL
+
+#include "memory.h"
+#include "slotmap.h"
+
+// Gets the generation after gen, with the same parity
+//
+static unsigned int tr_slot_gen_after(unsigned int gen)
+{
+    return (gen + 2) & TR_SLOT_GEN_MASK;
+}
+
+tr_slotmap tr_slotmap_create_in(tr_arena arena, unsigned int itemsize,
+                                unsigned int firstgen)
+{
+    if (!arena) return NULL;
+
+    slotmap *m = (slotmap *)tr_malloc(sizeof(slotmap));
+    if (!m) {
+        return NULL;
+    }
+
+    m->arena = arena;
+    m->stride = (sizeof(slothdr) + itemsize + 7) & ~7u;
+    m->pages = NULL;
+    m->numpages = 0;
+    m->maxpages = 0;
+    m->used = 0;
+    m->count = 0;
+    m->freelist = TR_NO_SLOT;
+    m->firstgen = (firstgen | 1) & TR_SLOT_GEN_MASK;
+    m->nextgen = m->firstgen;
+
+    return m;
+}
+
+tr_err tr_slotmap_delete(tr_slotmap map)
+{
+    if (!map) return TR_EPOINTER;
+
+    // The pages belong to the arena
+    slotmap *m = (slotmap *)map;
+    tr_free(m->pages);
+    tr_free(m);
+
+    return TR_OK;
+}
+
+// Gets a slot that has never been used, adding a page if needed
+//
+static slothdr *tr_slotmap_fresh(slotmap *m)
+{
+    if (m->used == TR_SLOT_MAX) {
+        return NULL;
+    }
+
+    if (m->used == m->numpages * TR_SLOTS_PER_PAGE) {
+        if (m->numpages == m->maxpages) {
+            unsigned int max = m->maxpages ? 2 * m->maxpages : 4;
+            char **pages = (char **)tr_realloc(m->pages, max * sizeof(char *));
+            if (!pages) {
+                return NULL;
+            }
+
+            m->pages = pages;
+            m->maxpages = max;
+        }
+
+        char *page = (char *)tr_arena_alloc(m->arena, TR_SLOTS_PER_PAGE * m->stride);
+        if (!page) {
+            return NULL;
+        }
+
+        m->pages[m->numpages++] = page;
+    }
+
+    slothdr *h = tr_slot_hdr(m, m->used);
+    h->gen = m->firstgen;
+    h->index = m->used++;
+    return h;
+}
+
+void *tr_slotmap_alloc(tr_slotmap map)
+{
+    if (!map) return NULL;
+
+    slotmap *m = (slotmap *)map;
+    slothdr *h;
+
+    if (m->freelist != TR_NO_SLOT) {
+        unsigned int index = m->freelist;
+        h = tr_slot_hdr(m, index);
+        m->freelist = h->index;
+
+        h->gen = (h->gen + 1) & TR_SLOT_GEN_MASK;
+        h->index = index;
+    }
+    else {
+        h = tr_slotmap_fresh(m);
+        if (!h) {
+            return NULL;
+        }
+    }
+
+    // Generations wrap around, so this only has to be right until then
+    if (h->gen >= m->nextgen) {
+        m->nextgen = tr_slot_gen_after(h->gen);
+    }
+
+    ++m->count;
+    return h + 1;
+}
+
+void tr_slotmap_free(tr_slotmap map, void *item)
+{
+    if (!map || !item) return;
+
+    slotmap *m = (slotmap *)map;
+    slothdr *h = (slothdr *)item - 1;
+    unsigned int index = h->index;
+
+    h->gen = (h->gen + 1) & TR_SLOT_GEN_MASK;
+    h->index = m->freelist;
+    m->freelist = index;
+    --m->count;
+}
+
+unsigned int tr_slotmap_count(tr_slotmap map)
+{
+    if (!map) return 0;
+
+    slotmap *m = (slotmap *)map;
+    return m->count;
+}
+
+unsigned int tr_slotmap_next_gen(tr_slotmap map)
+{
+    if (!map) return 0;
+
+    slotmap *m = (slotmap *)map;
+    return m->nextgen;
+}
+
+void *tr_slotmap_next(tr_slotmap map, void *item)
+{
+    if (!map) return NULL;
+
+    slotmap *m = (slotmap *)map;
+    unsigned int index = item ? tr_slotmap_index(item) + 1 : 0;
+
+    for (; index < m->used; ++index) {
+        slothdr *h = tr_slot_hdr(m, index);
+        if (h->gen & 1) {
+            return h + 1;
+        }
+    }
+
+    return NULL;
+}
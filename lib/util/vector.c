@@ -6,32 +6,55 @@
 // vector.c - Basic array-list implementation
 //
 
-#include <assert.h> // for assert
 #include <stdlib.h> // for NULL
 #include <string.h> // for memcpy
 
 #include "memory.h"
 #include "vector.h"
 
+// Vectors whose initial capacity fits in this many bytes keep their items
+// inline, in the same allocation as the vector itself, for as long as they
+// stay that small. Short vectors (a node's handful of interfaces, say) then
+// cost one allocation instead of two.
+//
+static const unsigned int INLINE_BYTES = 64;
+
 struct _vector
 {
     unsigned int itemsize;  // Size of a list item, in bytes
     unsigned int capacity;  // Number of slots available in the vector
     unsigned int size;      // Number of slots occupied
+    unsigned int reserved;  // Capacity the vector won't shrink below by itself
+    unsigned int inlinecap; // Number of slots in the inline buffer
     void *data;             // Current data buffer
+    // The inline buffer (inlinecap * itemsize bytes) follows
 };
 
 typedef struct _vector vector;
 
+#define tr_vec_inline(v)    (void*)((char*)(v) + sizeof(vector))
+
 tr_vector tr_vec_create(unsigned int itemsize, unsigned int capacity)
 {
-    vector *v = (vector*)tr_malloc(sizeof(vector));
+    unsigned int inlinecap = itemsize * capacity <= INLINE_BYTES ? capacity : 0;
+
+    vector *v = (vector*)tr_malloc(sizeof(vector) + inlinecap * itemsize);
+    if (!v) {
+        return NULL;
+    }
+
     v->itemsize = itemsize;
-    v->capacity = 0;
+    v->capacity = inlinecap;
     v->size = 0;
-    v->data = NULL;
+    v->reserved = capacity;
+    v->inlinecap = inlinecap;
+    v->data = tr_vec_inline(v);
+
+    if (capacity > inlinecap && tr_vec_resize(v, capacity) < 0) {
+        tr_free(v);
+        return NULL;
+    }
 
-    tr_vec_resize(v, capacity);
     return v;
 }
 
@@ -40,7 +63,7 @@ tr_err tr_vec_delete(tr_vector trv)
     if (!trv) return TR_EPOINTER;
 
     vector *v = (vector*)trv;
-    if (v->data) {
+    if (v->data != tr_vec_inline(v)) {
         tr_free(v->data);
     }
 
@@ -75,27 +98,110 @@ tr_err tr_vec_resize(tr_vector trv, unsigned int capacity)
     if (!trv) return TR_EPOINTER;
 
     vector *v = (vector*)trv;
-    void *newbuf = malloc(v->itemsize * capacity);
+    void *inl = tr_vec_inline(v);
+    unsigned int keep = v->size < capacity ? v->size : capacity;
+
+    if (capacity <= v->inlinecap) {
+        // Move back into the inline buffer
+        if (v->data != inl) {
+            memcpy(inl, v->data, keep * v->itemsize);
+            tr_free(v->data);
+            v->data = inl;
+        }
+    }
+    else if (v->data == inl) {
+        // Move out of the inline buffer
+        void *newbuf = tr_malloc(v->itemsize * capacity);
+        if (!newbuf) {
+            return TR_ENOMEM;
+        }
+
+        memcpy(newbuf, inl, keep * v->itemsize);
+        v->data = newbuf;
+    }
+    else {
+        void *newbuf = tr_realloc(v->data, v->itemsize * capacity);
+        if (!newbuf) {
+            return TR_ENOMEM;
+        }
 
-    if (v->data) {
-        unsigned int ncopy = v->size < capacity 
-                           ? v->size
-                           : capacity;
+        v->data = newbuf;
+    }
 
-        memcpy(newbuf, v->data, ncopy * v->itemsize);
-        tr_free(v->data);
+    v->capacity = v->data == inl ? v->inlinecap : capacity;
+    v->size = keep;
+
+    return TR_OK;
+}
+
+// Makes room for at least count more items, growing geometrically
+//
+static tr_err tr_vec_grow(vector *v, unsigned int count)
+{
+    unsigned int needed = v->size + count;
+    if (needed < v->size) {
+        return TR_ENOMEM;
+    }
+
+    if (needed <= v->capacity) {
+        return TR_OK;
     }
 
-    v->capacity = capacity;
-    v->data = newbuf;
+    unsigned int capacity = v->capacity ? v->capacity : 1;
+    while (capacity < needed) {
+        capacity = capacity * 2 > capacity ? capacity * 2 : needed;
+    }
+
+    return tr_vec_resize(v, capacity);
+}
+
+// Gives memory back once the vector is down to a quarter full, but never
+// below its reserved capacity
+//
+static void tr_vec_shrink(vector *v)
+{
+    unsigned int capacity = v->capacity;
+    while (capacity > 1 && v->size <= capacity / 4 && capacity / 2 >= v->reserved) {
+        capacity /= 2;
+    }
 
-    if (v->size > capacity) {
-        v->size = capacity;
+    if (capacity < v->inlinecap) {
+        capacity = v->inlinecap;
+    }
+
+    if (capacity != v->capacity) {
+        tr_vec_resize(v, capacity);
+    }
+}
+
+tr_err tr_vec_reserve(tr_vector trv, unsigned int capacity)
+{
+    if (!trv) return TR_EPOINTER;
+
+    vector *v = (vector*)trv;
+    v->reserved = capacity;
+
+    if (capacity > v->capacity) {
+        return tr_vec_resize(v, capacity);
     }
 
     return TR_OK;
 }
 
+tr_err tr_vec_shrink_to_fit(tr_vector trv)
+{
+    if (!trv) return TR_EPOINTER;
+
+    vector *v = (vector*)trv;
+    v->reserved = 0;
+
+    if (v->capacity == v->size) {
+        return TR_OK;
+    }
+
+    return tr_vec_resize(v, v->size);
+}
+
 void *tr_vec_item(tr_vector trv, unsigned int index)
 {
     if (!trv) return NULL;
@@ -125,25 +231,43 @@ tr_err tr_vec_prepend(tr_vector trv, void *item)
 }
 
 tr_err tr_vec_insert(tr_vector trv, unsigned int index, void *item)
+{
+    return tr_vec_insert_n(trv, index, item, 1);
+}
+
+tr_err tr_vec_append_n(tr_vector trv, const void *items, unsigned int count)
 {
     if (!trv) return TR_EPOINTER;
+    return tr_vec_insert_n(trv, tr_vec_size(trv), items, count);
+}
+
+tr_err tr_vec_insert_n(tr_vector trv, unsigned int index,
+                       const void *items, unsigned int count)
+{
+    if (!trv) return TR_EPOINTER;
+    if (!items && count) return TR_EPOINTER;
 
     vector *v = (vector*)trv;
     if (index > v->size) {
         return TR_EOUTOFRANGE;
     }
 
-    assert(v->size < v->capacity);
+    tr_err err = tr_vec_grow(v, count);
+    if (err < 0) {
+        return err;
+    }
 
     unsigned int after = (v->size - index) * v->itemsize;
-    memmove(tr_vec_item(v, index + 1), tr_vec_item(v, index), after);
-    memcpy(tr_vec_item(v, index), item, v->itemsize);
+    if (after > 0) {
+        memmove(tr_vec_item(v, index + count), tr_vec_item(v, index), after);
+    }
 
-    v->size += 1;
-    if (v->size == v->capacity) {
-        tr_vec_resize(trv, 2 * v->capacity);
+    if (count > 0) {
+        memcpy(tr_vec_item(v, index), items, count * v->itemsize);
     }
 
+    v->size += count;
+
     return TR_OK;
 }
 
@@ -164,23 +288,26 @@ tr_err tr_vec_remove(tr_vector trv, void *item)
 }
 
 tr_err tr_vec_remove_at(tr_vector trv, unsigned int index)
+{
+    return tr_vec_remove_range(trv, index, 1);
+}
+
+tr_err tr_vec_remove_range(tr_vector trv, unsigned int index, unsigned int count)
 {
     if (!trv) return TR_EPOINTER;
 
     vector *v = (vector*)trv;
-    if (index >= v->size) {
+    if (index >= v->size || count > v->size - index) {
         return TR_EOUTOFRANGE;
     }
 
-    unsigned int after = (v->size - (index + 1)) * v->itemsize;
+    unsigned int after = (v->size - (index + count)) * v->itemsize;
     if (after > 0) {
-        memmove(tr_vec_item(v, index), tr_vec_item(v, index + 1), after);
+        memmove(tr_vec_item(v, index), tr_vec_item(v, index + count), after);
     }
 
-    v->size -= 1;
-    if (v->size <= v->capacity / 4) {
-        tr_vec_resize(trv, v->capacity / 2);
-    }
+    v->size -= count;
+    tr_vec_shrink(v);
 
     return TR_OK;
 }
@@ -216,58 +343,22 @@ tr_err tr_vec_pop(tr_vector trv)
 }
 
 
-struct _foreach_item
-{
-    vector *parent;
-    int index;
-};
-
-typedef struct _foreach_item foreach_item;
-
-void *tr_vec_foreach_first(tr_vector trv)
+void *tr_vec_first(tr_vector trv)
 {
     if (!trv) return NULL;
-    vector *v = (vector*)trv;
-
-    if (v->size == 0) {
-        return NULL;
-    }
-
-    foreach_item *item = tr_malloc(sizeof(foreach_item) + v->itemsize);
-    item->parent = v;
-    item->index = 0;
-
-    void *buf = (char*)item + sizeof(foreach_item);
-    memcpy(buf, tr_vec_item(v, item->index++), v->itemsize);
-
-    return buf;
-}
-
-bool tr_vec_foreach_finished(void *buf)
-{
-    if (!buf) {
-        return 1;
-    }
 
-    foreach_item *item = (foreach_item*)((char*)buf - sizeof(foreach_item));
-    return item->index > item->parent->size;
+    vector *v = (vector*)trv;
+    return v->size ? v->data : NULL;
 }
 
-void *tr_vec_foreach_next(void *buf)
+void *tr_vec_next(tr_vector trv, void *item)
 {
-    if (!buf) {
-        return NULL;
-    }
-
-    if (tr_vec_foreach_finished(buf)) {
-        tr_free(buf);
-        return NULL;
-    }
+    if (!trv) return NULL;
+    if (!item) return NULL;
 
-    foreach_item *item = (foreach_item*)((char*)buf - sizeof(foreach_item));
-    vector *v = item->parent;
+    vector *v = (vector*)trv;
+    char *next = (char*)item + v->itemsize;
+    char *end = (char*)v->data + v->size * v->itemsize;
 
-    memcpy(buf, tr_vec_item(v, item->index++), v->itemsize);
-    return buf;
+    return next < end ? next : NULL;
 }
-
@@ -0,0 +1,394 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// wheel.c - Hierarchical timing wheel
+//
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime
+
+#include <stdint.h> // for uint64_t, UINT64_MAX
+#include <string.h> // for memset
+#include <time.h> // for clock_gettime
+
+#include "memory.h"
+#include "wheel.h"
+
+// The wheel has NUM_LEVELS levels of SLOTS slots each. Slots on level 0 are
+// one tick wide, slots on level 1 are SLOTS ticks wide, and so on, so the
+// levels between them cover every 64-bit tick.
+//
+// A timer goes on the level of the highest bit in which its due tick
+// differs from the current tick, in the slot given by its due tick's bits
+// for that level. Everything on level 0 is due within the current run of
+// SLOTS ticks; everything on level L is due within the current run of
+// SLOTS^(L+1) ticks, but not the current run of SLOTS^L.
+//
+// When the clock reaches the start of a higher-level slot, that slot's
+// timers are cascaded: re-placed relative to the new tick, which moves each
+// one down at least a level. A timer is cascaded at most once per level, so
+// the amortized cost per timer is constant.
+//
+// Each level keeps a bitmap of its nonempty slots, which lets the clock jump
+// straight over runs of empty ticks instead of visiting each one.
+//
+
+#define LEVEL_BITS 6
+#define SLOTS (1 << LEVEL_BITS)
+#define NUM_LEVELS ((64 + LEVEL_BITS - 1) / LEVEL_BITS)
+
+// Slot of a timer that isn't scheduled
+//
+static const unsigned int NO_SLOT = 0xFFFFFFFFu;
+
+struct _wheel;
+typedef struct _wheel wheel;
+
+struct _wheel
+{
+    uint64_t granularity;   // Length of a tick, in nanoseconds
+    uint64_t now;           // Current time, in nanoseconds
+    uint64_t tick;          // Current tick; every timer is due after it
+    uint64_t start;         // Wall-clock time the wheel was created at
+    unsigned int count;     // Number of scheduled timers
+
+    uint64_t occupied[NUM_LEVELS];          // Nonempty slots, by level
+    tr_ilist slots[NUM_LEVELS * SLOTS];     // Timers, by level then slot
+};
+
+// Nanoseconds on the monotonic clock
+//
+static uint64_t tr_wheel_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Puts a timer in the slot its due tick belongs in, relative to tick ref.
+// The timer must be due on or after ref.
+//
+static void tr_wheel_place(wheel *w, tr_timer *timer, uint64_t ref)
+{
+    uint64_t diff = timer->due ^ ref;
+    unsigned int level = diff ? (63 - __builtin_clzll(diff)) / LEVEL_BITS : 0;
+    unsigned int index = (timer->due >> (level * LEVEL_BITS)) & (SLOTS - 1);
+
+    timer->slot = level * SLOTS + index;
+    tr_ilist_append(&w->slots[timer->slot], &timer->link);
+    w->occupied[level] |= 1ull << index;
+}
+
+// Takes a timer out of its slot
+//
+static void tr_wheel_unplace(wheel *w, tr_timer *timer)
+{
+    unsigned int slot = timer->slot;
+
+    tr_ilist_remove(&timer->link);
+    if (tr_ilist_empty(&w->slots[slot])) {
+        w->occupied[slot / SLOTS] &= ~(1ull << (slot % SLOTS));
+    }
+
+    timer->slot = NO_SLOT;
+}
+
+// Finds the next tick after the current one at which a timer is due or a
+// slot needs cascading. Returns false if nothing is scheduled; every tick,
+// UINT64_MAX included, is a valid answer, so it can't double as "none".
+//
+static bool tr_wheel_nexttick(wheel *w, uint64_t *next)
+{
+    for (unsigned int level = 0; level < NUM_LEVELS; level++) {
+        unsigned int shift = level * LEVEL_BITS;
+        unsigned int index = (w->tick >> shift) & (SLOTS - 1);
+
+        // Only slots after the current one can be occupied
+        uint64_t later = index == SLOTS - 1 ? 0 : w->occupied[level] & (~0ull << (index + 1));
+        if (!later) {
+            continue;
+        }
+
+        // Lower levels are always due sooner, so the first hit is the answer
+        uint64_t base = shift + LEVEL_BITS >= 64 ? 0 : w->tick & ~((1ull << (shift + LEVEL_BITS)) - 1);
+        *next = base | ((uint64_t)__builtin_ctzll(later) << shift);
+        return true;
+    }
+
+    return false;
+}
+
+// Cascades every higher-level slot that starts at the current tick, so
+// everything due on it ends up on level 0
+//
+static void tr_wheel_cascade(wheel *w)
+{
+    for (unsigned int level = NUM_LEVELS - 1; level > 0; level--) {
+        unsigned int shift = level * LEVEL_BITS;
+        if (w->tick & ((1ull << shift) - 1)) {
+            continue;
+        }
+
+        unsigned int index = (w->tick >> shift) & (SLOTS - 1);
+        if (!(w->occupied[level] & (1ull << index))) {
+            continue;
+        }
+
+        tr_ilist *slot = &w->slots[level * SLOTS + index];
+        tr_ilink *link;
+
+        while ((link = tr_ilist_remove_first(slot))) {
+            tr_wheel_place(w, tr_ilist_entry(link, tr_timer, link), w->tick);
+        }
+
+        w->occupied[level] &= ~(1ull << index);
+    }
+}
+
+// Unschedules and returns the next timer due on the current tick, or NULL
+//
+static tr_timer *tr_wheel_popdue(wheel *w)
+{
+    tr_ilink *link = tr_ilist_first(&w->slots[w->tick & (SLOTS - 1)]);
+    if (!link) {
+        return NULL;
+    }
+
+    tr_timer *timer = tr_ilist_entry(link, tr_timer, link);
+    tr_wheel_unplace(w, timer);
+    w->count--;
+
+    return timer;
+}
+
+tr_wheel tr_wheel_create(uint64_t granularity)
+{
+    if (granularity == 0) {
+        return NULL;
+    }
+
+    wheel *w = (wheel *)tr_malloc(sizeof(wheel));
+    if (!w) {
+        return NULL;
+    }
+
+    memset(w, 0, sizeof(wheel));
+    w->granularity = granularity;
+    w->start = tr_wheel_clock();
+
+    for (unsigned int i = 0; i < NUM_LEVELS * SLOTS; i++) {
+        tr_ilist_init(&w->slots[i]);
+    }
+
+    return w;
+}
+
+tr_err tr_wheel_delete(tr_wheel trw)
+{
+    if (!trw) {
+        return TR_EPOINTER;
+    }
+
+    wheel *w = (wheel *)trw;
+
+    // Leave any pending timers unscheduled rather than dangling
+    for (unsigned int i = 0; i < NUM_LEVELS * SLOTS; i++) {
+        tr_ilink *link;
+        while ((link = tr_ilist_remove_first(&w->slots[i]))) {
+            tr_ilist_entry(link, tr_timer, link)->slot = NO_SLOT;
+        }
+    }
+
+    tr_free(w);
+    return TR_OK;
+}
+
+void tr_timer_init(tr_timer *timer, tr_timerfunc func, void *ctx)
+{
+    if (!timer) {
+        return;
+    }
+
+    tr_ilink_init(&timer->link);
+    timer->due = 0;
+    timer->slot = NO_SLOT;
+    timer->func = func;
+    timer->ctx = ctx;
+}
+
+bool tr_timer_scheduled(const tr_timer *timer)
+{
+    return timer && timer->slot != NO_SLOT;
+}
+
+uint64_t tr_wheel_now(tr_wheel trw)
+{
+    return trw ? ((wheel *)trw)->now : 0;
+}
+
+uint64_t tr_wheel_granularity(tr_wheel trw)
+{
+    return trw ? ((wheel *)trw)->granularity : 0;
+}
+
+unsigned int tr_wheel_num_timers(tr_wheel trw)
+{
+    return trw ? ((wheel *)trw)->count : 0;
+}
+
+tr_err tr_wheel_schedule(tr_wheel trw, tr_timer *timer, uint64_t delay)
+{
+    if (!trw) {
+        return TR_EPOINTER;
+    }
+
+    uint64_t now = ((wheel *)trw)->now;
+    uint64_t when = now + delay < now ? UINT64_MAX : now + delay;
+
+    return tr_wheel_schedule_at(trw, timer, when);
+}
+
+tr_err tr_wheel_schedule_at(tr_wheel trw, tr_timer *timer, uint64_t when)
+{
+    if (!trw || !timer) {
+        return TR_EPOINTER;
+    }
+
+    wheel *w = (wheel *)trw;
+
+    if (timer->slot != NO_SLOT) {
+        tr_wheel_unplace(w, timer);
+        w->count--;
+    }
+
+    // Round up, so timers never fire early
+    uint64_t due = when / w->granularity;
+    if (when % w->granularity && due < UINT64_MAX) {
+        due++;
+    }
+
+    // At the very last tick there's no later one; the timer waits forever
+    if (due <= w->tick) {
+        due = w->tick < UINT64_MAX ? w->tick + 1 : UINT64_MAX;
+    }
+
+    timer->due = due;
+    tr_wheel_place(w, timer, w->tick);
+    w->count++;
+
+    return TR_OK;
+}
+
+tr_err tr_wheel_cancel(tr_wheel trw, tr_timer *timer)
+{
+    if (!trw || !timer) {
+        return TR_EPOINTER;
+    }
+
+    if (timer->slot == NO_SLOT) {
+        return TR_ENOTFOUND;
+    }
+
+    wheel *w = (wheel *)trw;
+    tr_wheel_unplace(w, timer);
+    w->count--;
+
+    return TR_OK;
+}
+
+unsigned int tr_wheel_advance(tr_wheel trw, uint64_t now)
+{
+    if (!trw) {
+        return 0;
+    }
+
+    wheel *w = (wheel *)trw;
+    if (now <= w->now) {
+        return 0;
+    }
+
+    uint64_t target = now / w->granularity;
+    unsigned int fired = 0;
+
+    uint64_t next;
+    while (tr_wheel_nexttick(w, &next) && next <= target) {
+        w->tick = next;
+        w->now = next * w->granularity;
+        tr_wheel_cascade(w);
+
+        // Timers scheduled by these callbacks are due after this tick, so
+        // they never land in the slot being drained
+        tr_timer *timer;
+        while ((timer = tr_wheel_popdue(w))) {
+            fired++;
+
+            if (timer->func) {
+                timer->func(timer, timer->ctx);
+            }
+        }
+    }
+
+    w->tick = target;
+    w->now = now;
+
+    return fired;
+}
+
+unsigned int tr_wheel_poll(tr_wheel trw)
+{
+    if (!trw) {
+        return 0;
+    }
+
+    return tr_wheel_advance(trw, tr_wheel_clock() - ((wheel *)trw)->start);
+}
+
+unsigned int tr_wheel_expire(tr_wheel trw, uint64_t now, tr_ilist *expired)
+{
+    if (!trw || !expired) {
+        return 0;
+    }
+
+    wheel *w = (wheel *)trw;
+    if (now <= w->now) {
+        return 0;
+    }
+
+    uint64_t target = now / w->granularity;
+    unsigned int count = 0;
+
+    uint64_t next;
+    while (tr_wheel_nexttick(w, &next) && next <= target) {
+        w->tick = next;
+        tr_wheel_cascade(w);
+
+        tr_timer *timer;
+        while ((timer = tr_wheel_popdue(w))) {
+            tr_ilist_append(expired, &timer->link);
+            count++;
+        }
+    }
+
+    w->tick = target;
+    w->now = now;
+
+    return count;
+}
+
+uint64_t tr_wheel_next(tr_wheel trw)
+{
+    if (!trw) {
+        return UINT64_MAX;
+    }
+
+    wheel *w = (wheel *)trw;
+
+    uint64_t next;
+    if (!tr_wheel_nexttick(w, &next) || next > UINT64_MAX / w->granularity) {
+        return UINT64_MAX;
+    }
+
+    return next * w->granularity;
+}
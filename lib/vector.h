@@ -22,8 +22,17 @@ unsigned int tr_vec_size(tr_vector vec);
 unsigned int tr_vec_count(tr_vector vec);
 unsigned int tr_vec_length(tr_vector vec);
 
+// Sets the vector's capacity, truncating it if it holds more items
 tr_err tr_vec_resize(tr_vector vec, unsigned int capacity);
 
+// Makes sure the vector has room for at least capacity items, and keeps
+// it from shrinking below that as items are removed. Vectors start out
+// reserving the capacity they were created with.
+tr_err tr_vec_reserve(tr_vector vec, unsigned int capacity);
+
+// Drops any reserved capacity and shrinks the vector to fit its items
+tr_err tr_vec_shrink_to_fit(tr_vector vec);
+
 void *tr_vec_item(tr_vector vec, unsigned int index);
 void *tr_vec_items(tr_vector vec);
 
@@ -33,17 +42,26 @@ tr_err tr_vec_insert(tr_vector vec, unsigned int index, void *item);
 tr_err tr_vec_remove(tr_vector vec, void *item);
 tr_err tr_vec_remove_at(tr_vector vec, unsigned int index);
 
+// Bulk operations; each moves the existing items at most once
+tr_err tr_vec_append_n(tr_vector vec, const void *items, unsigned int count);
+tr_err tr_vec_insert_n(tr_vector vec, unsigned int index,
+                       const void *items, unsigned int count);
+tr_err tr_vec_remove_range(tr_vector vec, unsigned int index, unsigned int count);
+
 tr_err tr_vec_push(tr_vector vec, void *item);
 void *tr_vec_peek(tr_vector vec);
 tr_err tr_vec_pop(tr_vector vec);
 
-#define tr_vec_foreach(type, var, vec)                  \
-    for (type var = (type)tr_vec_foreach_first(vec);    \
-         !tr_vec_foreach_finished(var);                 \
-         var = tr_vec_foreach_next(var))
+// Gets a pointer to the first item, or NULL if the vector is empty
+void *tr_vec_first(tr_vector vec);
+
+// Gets a pointer to the item after the given one, or NULL at the end
+void *tr_vec_next(tr_vector vec, void *item);
 
-void *tr_vec_foreach_first(tr_vector vec);
-bool  tr_vec_foreach_finished(void *item);
-void *tr_vec_foreach_next(void *item);
+// Walks pointers to each item in the vector, in place. The vector must not
+// be resized, or have items inserted or removed, during the loop.
+#define tr_vec_foreach(type, var, vec)                  \
+    for (type var = (type)tr_vec_first(vec);            \
+         var; var = (type)tr_vec_next((vec), var))
 
 #endif
@@ -0,0 +1,101 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// wheel.h - Hierarchical timing wheel
+//
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <stdint.h> // for uint64_t
+
+#include <traffic.h>
+
+#include "ilist.h"
+
+// A tr_wheel schedules timers (e.g. packets in flight on a delayed link) and
+// fires them when their time comes. Scheduling and cancelling are O(1) no
+// matter how many timers are pending, and everything due in the same tick
+// expires together.
+//
+// Time is measured in nanoseconds since the wheel was created, and rounded
+// to ticks of the wheel's granularity; timers fire on the first tick at or
+// after their due time, never early. The wheel's clock only moves when told
+// to: either to a virtual time of the caller's choosing (tr_wheel_advance),
+// or to the wall-clock time since the wheel was created (tr_wheel_poll).
+// Use one or the other for a given wheel.
+//
+// Timers are intrusive, like tr_ilist items: callers embed a tr_timer in
+// their own structs, and the wheel never allocates per timer. A timer must
+// stay put in memory while it's scheduled.
+//
+typedef void *tr_wheel;
+
+struct _timer;
+typedef struct _timer tr_timer;
+
+// Called when a timer fires. The timer is no longer scheduled, and may be
+// rescheduled (or freed) from inside the callback.
+typedef void (*tr_timerfunc)(tr_timer *timer, void *ctx);
+
+struct _timer
+{
+    tr_ilink link;          // Links the timer into its wheel slot
+    uint64_t due;           // The tick the timer is due on
+    unsigned int slot;      // The wheel slot it's in, if it's scheduled
+    tr_timerfunc func;      // Called when the timer fires
+    void *ctx;              // Passed to func
+};
+
+// granularity is the length of a tick in nanoseconds
+tr_wheel tr_wheel_create(uint64_t granularity);
+
+// Pending timers are forgotten, not fired
+tr_err tr_wheel_delete(tr_wheel wheel);
+
+// Prepares a timer for use. func may be NULL for timers that are only ever
+// collected with tr_wheel_expire.
+void tr_timer_init(tr_timer *timer, tr_timerfunc func, void *ctx);
+
+bool tr_timer_scheduled(const tr_timer *timer);
+
+// The wheel's current time, in nanoseconds
+uint64_t tr_wheel_now(tr_wheel wheel);
+
+uint64_t tr_wheel_granularity(tr_wheel wheel);
+
+unsigned int tr_wheel_num_timers(tr_wheel wheel);
+
+// Schedules a timer to fire delay nanoseconds from now, or at the given
+// time. Times that have already passed fire on the next tick. A timer
+// that's already scheduled is moved to the new time. Delays that would
+// overflow are taken as UINT64_MAX.
+tr_err tr_wheel_schedule(tr_wheel wheel, tr_timer *timer, uint64_t delay);
+tr_err tr_wheel_schedule_at(tr_wheel wheel, tr_timer *timer, uint64_t when);
+
+// Fails with TR_ENOTFOUND if the timer isn't scheduled
+tr_err tr_wheel_cancel(tr_wheel wheel, tr_timer *timer);
+
+// Moves the wheel's clock forward to the given time, firing every timer
+// due by then in order of due tick. While a timer's callback runs, the
+// wheel's time is that of the tick it fired on, so timers scheduled from
+// callbacks are relative to it. Returns the number of timers fired.
+unsigned int tr_wheel_advance(tr_wheel wheel, uint64_t now);
+
+// tr_wheel_advance to the wall-clock time since the wheel was created
+unsigned int tr_wheel_poll(tr_wheel wheel);
+
+// Like tr_wheel_advance, but appends the expired timers to the given list
+// (in order of due tick) instead of calling their callbacks, so they can be
+// handled as a batch. Returns the number of timers expired.
+unsigned int tr_wheel_expire(tr_wheel wheel, uint64_t now, tr_ilist *expired);
+
+// Gets the earliest tick boundary (in nanoseconds) at which a timer could
+// be due, e.g. for sleeping or skipping a virtual clock ahead. The answer is
+// never later than the real next due time, but may be earlier when the next
+// timer is far off. Returns UINT64_MAX if nothing is scheduled.
+uint64_t tr_wheel_next(tr_wheel wheel);
+
+#endif
@@ -0,0 +1,248 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// chash.c - Concurrent hashtable unit tests
+//
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "chash.h"
+#include "test.h"
+
+#define NUM_THREADS 4
+
+bool test_chash_basics()
+{
+    tr_memstats before, after;
+    (void)before;
+    (void)after;
+
+    tr_chash hash = tr_intchash_create(sizeof(int));
+    ASSERT(hash != NULL, "tr_intchash_create failed!");
+    EQUAL(tr_chash_num_keys(hash), 0);
+
+    int value = 0;
+    EQUAL(tr_intchash_get(hash, 1, &value), TR_ENOTFOUND);
+    EQUAL(tr_intchash_clear(hash, 1), TR_ENOTFOUND);
+
+    // After the lookup, which gives the thread its (permanent) epoch record
+    SUCCEED(tr_mem_stats(TR_MEM_CONTAINERS, &before));
+
+    // Enough keys to grow every shard several times
+    for (int i = 0; i < 100000; ++i) {
+        int v = i * 3;
+        SUCCEED(tr_intchash_set(hash, i, &v));
+    }
+
+    EQUAL(tr_chash_num_keys(hash), 100000);
+
+    for (int i = 0; i < 100000; ++i) {
+        SUCCEED(tr_intchash_get(hash, i, &value));
+        EQUAL(value, i * 3);
+    }
+
+    // Overwrites don't add keys
+    for (int i = 0; i < 100000; i += 2) {
+        int v = -i;
+        SUCCEED(tr_intchash_set(hash, i, &v));
+    }
+
+    EQUAL(tr_chash_num_keys(hash), 100000);
+
+    for (int i = 0; i < 100000; i += 3) {
+        SUCCEED(tr_intchash_clear(hash, i));
+    }
+
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 3 == 0) {
+            EQUAL(tr_intchash_contains(hash, i), false);
+        }
+        else {
+            SUCCEED(tr_intchash_get(hash, i, &value));
+            EQUAL(value, i % 2 ? i * 3 : -i);
+        }
+    }
+
+    EQUAL(tr_chash_num_keys(hash), 100000 - 33334);
+
+    SUCCEED(tr_chash_delete(hash));
+
+    // The tables the hash outgrew went with it (and so may any that earlier
+    // tests left waiting)
+#if !defined(TR_SYSTEM_MALLOC) && !defined(TR_NO_MEM_STATS)
+    SUCCEED(tr_mem_stats(TR_MEM_CONTAINERS, &after));
+    ASSERT(after.bytes <= before.bytes, "outgrown tables leaked");
+#endif
+
+    return true;
+}
+
+// A value that can be checked for consistency on its own
+//
+struct _pairvalue
+{
+    int key;
+    int round;
+    int check;              // ~(key ^ round)
+};
+
+typedef struct _pairvalue pairvalue;
+
+struct _chashctx
+{
+    tr_chash hash;
+    int thread;
+    int keys;
+    int rounds;
+    bool failed;
+};
+
+typedef struct _chashctx chashctx;
+
+// Writer thread: repeatedly rewrites and removes its own keys
+//
+static void *chash_writer(void *arg)
+{
+    chashctx *ctx = (chashctx *)arg;
+
+    for (int round = 0; round < ctx->rounds; ++round) {
+        for (int i = 0; i < ctx->keys; ++i) {
+            int key = ctx->thread * ctx->keys + i;
+            pairvalue v = { key, round, ~(key ^ round) };
+
+            if (tr_chash_set(ctx->hash, &key, &v) != TR_OK) {
+                ctx->failed = true;
+            }
+        }
+
+        for (int i = round % 2; i < ctx->keys; i += 2) {
+            int key = ctx->thread * ctx->keys + i;
+            if (tr_chash_clear(ctx->hash, &key) != TR_OK) {
+                ctx->failed = true;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Reader thread: checks that every value it sees was written whole
+//
+static void *chash_reader(void *arg)
+{
+    chashctx *ctx = (chashctx *)arg;
+    int total = NUM_THREADS * ctx->keys;
+    unsigned int seed = ctx->thread;
+
+    for (int i = 0; i < ctx->rounds * ctx->keys; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 8) % (unsigned int)total);
+
+        pairvalue v;
+        if (tr_chash_get(ctx->hash, &key, &v) == TR_OK) {
+            if (v.key != key || v.check != ~(v.key ^ v.round)) {
+                ctx->failed = true;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+bool test_chash_concurrent()
+{
+    tr_chash hash = tr_intchash_create(sizeof(pairvalue));
+
+    pthread_t writers[NUM_THREADS], readers[NUM_THREADS];
+    chashctx wctx[NUM_THREADS], rctx[NUM_THREADS];
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        chashctx ctx = { hash, t, 5000, 20, false };
+        wctx[t] = ctx;
+        rctx[t] = ctx;
+
+        pthread_create(&writers[t], NULL, chash_writer, &wctx[t]);
+        pthread_create(&readers[t], NULL, chash_reader, &rctx[t]);
+    }
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        pthread_join(writers[t], NULL);
+        pthread_join(readers[t], NULL);
+
+        ASSERT(!wctx[t].failed, "Writer %d failed", t);
+        ASSERT(!rctx[t].failed, "Reader %d saw a torn value", t);
+    }
+
+    // The last round (19) cleared the odd keys
+    EQUAL(tr_chash_num_keys(hash), NUM_THREADS * 5000 / 2);
+
+    for (int key = 0; key < NUM_THREADS * 5000; ++key) {
+        pairvalue v;
+        if (key % 2) {
+            EQUAL(tr_chash_get(hash, &key, &v), TR_ENOTFOUND);
+        }
+        else {
+            SUCCEED(tr_chash_get(hash, &key, &v));
+            EQUAL(v.key, key);
+            EQUAL(v.round, 19);
+        }
+    }
+
+    SUCCEED(tr_chash_delete(hash));
+    return true;
+}
+
+static void chash_increment(void *value, bool isnew, void *ctx)
+{
+    *(int *)value += 1;
+}
+
+static void *chash_counter(void *arg)
+{
+    chashctx *ctx = (chashctx *)arg;
+
+    for (int i = 0; i < ctx->rounds; ++i) {
+        if (tr_intchash_update(ctx->hash, i % ctx->keys, chash_increment, NULL) != TR_OK) {
+            ctx->failed = true;
+        }
+    }
+
+    return NULL;
+}
+
+bool test_chash_update()
+{
+    tr_chash hash = tr_intchash_create(sizeof(int));
+
+    pthread_t threads[NUM_THREADS];
+    chashctx ctx[NUM_THREADS];
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        chashctx c = { hash, t, 16, 16000, false };
+        ctx[t] = c;
+        pthread_create(&threads[t], NULL, chash_counter, &ctx[t]);
+    }
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        pthread_join(threads[t], NULL);
+        ASSERT(!ctx[t].failed, "Counter %d failed", t);
+    }
+
+    // No increments were lost
+    EQUAL(tr_chash_num_keys(hash), 16);
+
+    for (int key = 0; key < 16; ++key) {
+        int count = 0;
+        SUCCEED(tr_intchash_get(hash, key, &count));
+        EQUAL(count, NUM_THREADS * 1000);
+    }
+
+    SUCCEED(tr_chash_delete(hash));
+    return true;
+}
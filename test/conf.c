@@ -0,0 +1,696 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// conf.c - Config file parsing unit tests
+//
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "network.h"
+#include "test.h"
+
+// Parses text into a new network, into net
+//
+static tr_err test_conf_text(const char *text, tr_network *net,
+                             tr_conferror *error)
+{
+    *net = tr_net_create("conf");
+    return tr_conf_parse_text((network *)*net, text, strlen(text), error);
+}
+
+bool test_conf_parse()
+{
+    static const char *text =
+        "# The README's sample, and then some\n"
+        "node 'A' { \n"
+        "    interface 'AB' { mac 'auto' ip 'auto' subnet 'auto' }\n"
+        "}\n"
+        "\n"
+        "node 'B' {\n"
+        "    interface 'BA'\n"
+        "    interface 'BC' { mac '02:00:00:00:00:01' ip '10.0.0.1' subnet '24' }\n"
+        "    switch { strategy 'psychic' noroute 'drop' }\n"
+        "}\n"
+        "\n"
+        "node `C` {\n"
+        "    interface 'CB'\n"
+        "    app { command '/usr/bin/my-echo --bindto=$('CB'.ip)' }\n"
+        "}\n"
+        "\n"
+        "link { from 'AB' to 'BA' }\n"
+        "link 'bc' { from 'BC' to 'CB' latency '150 ms' variance '75ms' }\n"
+        "link { from 'CB' to 'D0' droprate '5%' traffic '7' }  # D comes later\n"
+        "node { interface interface { ip '10.0.0.2' } hub }\n"
+        "node 'D' { interface 'D0' hub {} }\n";
+
+    tr_network net;
+    tr_conferror error;
+    SUCCEED(test_conf_text(text, &net, &error));
+    EQUAL(tr_net_num_nodes(net), 5);
+
+    tr_node a = tr_net_node(net, "A"), b = tr_net_node(net, "B");
+    tr_node c = tr_net_node(net, "C"), d = tr_net_node(net, "D");
+    ASSERT(a && b && c && d, "missing a node");
+
+    tr_iface ab = tr_node_iface(a, "AB"), ba = tr_node_iface(b, "BA");
+    tr_iface bc = tr_node_iface(b, "BC"), cb = tr_node_iface(c, "CB");
+    tr_iface d0 = tr_node_iface(d, "D0");
+    ASSERT(ab && ba && bc && cb && d0, "missing an interface");
+
+    EQUAL(tr_iface_mac(ab), TR_ANY_MAC_ADDR);
+    EQUAL(tr_iface_ip(ab), TR_ANY_IP_ADDR);
+    EQUAL(tr_iface_subnet_mask(ab), TR_ANY_SUBNET_MASK);
+    EQUAL(strcmp(tr_iface_mac(bc), "02:00:00:00:00:01"), 0);
+    EQUAL(strcmp(tr_iface_ip(bc), "10.0.0.1"), 0);
+    EQUAL(tr_iface_subnet_mask(bc), 24);
+
+    ASSERT(tr_iface_has_link(ab, ba), "AB isn't linked to BA");
+    EQUAL(tr_link_latency(tr_iface_link(ab, ba)), 0);
+
+    tr_link l = tr_iface_link(bc, cb);
+    EQUAL(tr_link_latency(l), 150);
+    EQUAL(tr_link_variance(l), 75);
+
+    // Links can name interfaces that come later
+    l = tr_iface_link(cb, d0);
+    ASSERT(l != NULL, "CB isn't linked to D0");
+    ASSERT(tr_link_droprate(l) > 0.0499f && tr_link_droprate(l) < 0.0501f,
+           "droprate is %f", tr_link_droprate(l));
+    EQUAL(tr_link_traffic(l), 7);
+
+    // Unnamed things are named like generated ones
+    tr_node n0 = tr_net_node(net, "node0");
+    ASSERT(n0 != NULL, "the unnamed node isn't node0");
+    EQUAL(tr_node_num_ifaces(n0), 2);
+    EQUAL(strcmp(tr_iface_ip(tr_node_iface(n0, "node0-1")), "10.0.0.2"), 0);
+    ASSERT(tr_node_iface(n0, "node0-0") != NULL, "missing node0-0");
+
+    SUCCEED(tr_net_delete(net));
+
+    // Each kind of quote can quote the other
+    SUCCEED(test_conf_text("node `O'Brien` { interface 'say `hi`' }", &net, &error));
+    tr_node ob = tr_net_node(net, "O'Brien");
+    ASSERT(ob != NULL, "the name was cut short");
+    ASSERT(tr_node_iface(ob, "say `hi`") != NULL, "the interface name was cut short");
+    SUCCEED(tr_net_delete(net));
+
+    // An empty config is an empty network
+    SUCCEED(test_conf_text(" # nothing\n\n", &net, &error));
+    EQUAL(tr_net_num_nodes(net), 0);
+    SUCCEED(tr_net_delete(net));
+
+    return true;
+}
+
+bool test_conf_errors()
+{
+    static const struct {
+        const char *text;
+        unsigned line, column;
+        const char *message;
+    } cases[] = {
+        { "nod 'A'", 1, 1, "expected node or link, but found 'nod'" },
+        { "node 'A' {\n  interface 'x\n}", 2, 13, "string has no closing quote" },
+        { "node 'abc`", 1, 6, "string has no closing quote" },
+        { "node 'A' { interface 'x' }\nnode 'x'", 2, 6, "the name 'x' is already taken" },
+        { "node 'A' {\n  interface 'a' { mac '01:02' }\n}", 2, 23, "a MAC address looks like" },
+        { "node 'A' { interface 'a' { ip '1.2.3.256' } }", 1, 31, "an IP address looks like" },
+        { "node 'A' { interface 'a' { subnet '33' } }", 1, 35, "a subnet mask is" },
+        { "node 'A' { interface 'a' { ip 'auto' ip 'auto' } }", 1, 38, "ip is already set" },
+        { "node 'A' { hub switch }", 1, 16, "the node is already a hub" },
+        { "node 'A' { app { command 'x $(a.ip)' } }", 1, 29, "macros look like" },
+        { "node 'A' { app { command '$('a'.port)' } }", 1, 27, "macros look like" },
+        { "node 'A' { switch { strategy 'telepathy' } }", 1, 30, "strategy must be" },
+        { "node 'A' { interface 'a' }\nlink { from 'a' }", 2, 17, "the link needs both a from and a to" },
+        { "node 'A' { interface 'a' }\nlink { from 'a' to 'a' }", 2, 20, "an interface can't be linked to itself" },
+        { "node 'A' { interface 'a' interface 'b' }\n"
+          "link { from 'a' to 'b' }\nlink { to 'a' from 'b' }", 3, 1, "'b' and 'a' are already linked" },
+        { "node 'A' { interface 'a' }\n\nlink { from 'a' to 'zz' }", 3, 20, "there's no interface named 'zz'" },
+        { "node 'A' { interface 'a' interface 'b' }\n"
+          "link { from 'a' to 'b' latency '0.5 ms' }", 2, 32, "latency is a whole number" },
+        { "node 'A' { interface 'a' interface 'b' }\n"
+          "link { from 'a' to 'b' droprate '2' }", 2, 33, "droprate is a ratio" },
+        { "node 'A' { interface 'a' interface 'b' }\n"
+          "link { from 'a' to 'b' jitter '2' }", 2, 24, "expected from, to" },
+        { "node 'A' {\n\tinterface 'a' ; }", 2, 16, "unexpected character" },
+        { "node 'A' { interface 'a'", 1, 25, "expected interface, hub, switch, app or '}', but found the end" },
+    };
+
+    for (unsigned int k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k) {
+        tr_network net;
+        tr_conferror error;
+
+        tr_err err = test_conf_text(cases[k].text, &net, &error);
+        ASSERT(err == TR_ESYNTAX, "case %u returned %d", k, err);
+        ASSERT(error.line == cases[k].line && error.column == cases[k].column,
+               "case %u failed at %u:%u, not %u:%u (%s)", k, error.line,
+               error.column, cases[k].line, cases[k].column, error.message);
+        ASSERT(strncmp(error.message, cases[k].message, strlen(cases[k].message)) == 0,
+               "case %u failed with \"%s\"", k, error.message);
+
+        SUCCEED(tr_net_delete(net));
+    }
+
+    return true;
+}
+
+bool test_conf_file()
+{
+    static const char *path = "test_conf_file.conf";
+
+    FILE *f = fopen(path, "w");
+    ASSERT(f != NULL, "can't write %s", path);
+    fputs("node 'A' { interface 'AB' }\n"
+          "node 'B' { interface 'BA' }\n"
+          "link { from 'AB' to 'BA' latency '1.5 s' }\n", f);
+    fclose(f);
+
+    tr_network net = NULL;
+    SUCCEED(tr_conf_read(path, &net));
+    EQUAL(strcmp(tr_net_name(net), path), 0);
+    EQUAL(tr_net_num_nodes(net), 2);
+
+    tr_iface ab = tr_node_iface(tr_net_node(net, "A"), "AB");
+    tr_iface ba = tr_node_iface(tr_net_node(net, "B"), "BA");
+    EQUAL(tr_link_latency(tr_iface_link(ab, ba)), 1500);
+    SUCCEED(tr_net_delete(net));
+
+    // A bad config leaves net alone
+    f = fopen(path, "w");
+    ASSERT(f != NULL, "can't write %s", path);
+    fputs("node 'A' {\n  interface 'AB'\n  interface 'AB'\n}\n", f);
+    fclose(f);
+
+    tr_conferror error;
+    net = NULL;
+    EQUAL(tr_conf_parse(path, &net, &error), TR_ESYNTAX);
+    EQUAL(net, NULL);
+    EQUAL(error.line, 3);
+    EQUAL(error.column, 13);
+
+    remove(path);
+    EQUAL(tr_conf_parse(path, &net, &error), TR_EIO);
+    EQUAL(error.line, 0);
+    EQUAL(net, NULL);
+
+    return true;
+}
+
+// Reads a whole file into a new buffer, setting len
+//
+static char *test_conf_slurp(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (char *)malloc(*len ? *len : 1);
+    if (data && fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(f);
+    return data;
+}
+
+bool test_conf_write()
+{
+    static const char *text =
+        "node 'A' { interface 'AB' { mac '02:00:00:00:00:0a' subnet '16' } }\n"
+        "node 'B' { interface 'BA' interface 'BC' { ip '10.0.0.1' } switch }\n"
+        "node 'C' { interface 'CB' interface 'CA' }\n"
+        "node 'lonely'\n"
+        "link { from 'AB' to 'BA' latency '150 ms' variance '75 ms' }\n"
+        "link { from 'BC' to 'CB' droprate '0.1' traffic '9' enabled 'false' }\n"
+        "link { from 'CA' to 'AB' droprate '3%' }\n";
+
+    // Named like the text config, so that it reads back the same
+    tr_network net = tr_net_create("test_conf_write.conf");
+    tr_conferror error;
+    SUCCEED(tr_conf_parse_text((network *)net, text, strlen(text), &error));
+
+    // Both formats read back as the same network, and compiling a loaded
+    // topology again gives the same image
+    SUCCEED(tr_conf_write(net, "test_conf_write.conf", TR_CONF_TEXT));
+    SUCCEED(tr_conf_write(net, "test_conf_write.topo", TR_CONF_COMPILED));
+    SUCCEED(tr_net_delete(net));
+
+    tr_network fromtext = NULL, fromimage = NULL;
+    SUCCEED(tr_conf_parse("test_conf_write.conf", &fromtext, &error));
+    SUCCEED(tr_conf_parse("test_conf_write.topo", &fromimage, &error));
+    SUCCEED(tr_conf_write(fromtext, "test_conf_write.topo2", TR_CONF_COMPILED));
+    SUCCEED(tr_conf_write(fromimage, "test_conf_write.topo3", TR_CONF_COMPILED));
+
+    size_t len1 = 0, len2 = 0, len3 = 0;
+    char *image1 = test_conf_slurp("test_conf_write.topo", &len1);
+    char *image2 = test_conf_slurp("test_conf_write.topo2", &len2);
+    char *image3 = test_conf_slurp("test_conf_write.topo3", &len3);
+    ASSERT(image1 && image2 && image3, "can't read the images back");
+    EQUAL(len1 % 8, 0);
+    ASSERT(len1 == len2 && memcmp(image1, image2, len1) == 0, "text didn't round trip");
+    ASSERT(len1 == len3 && memcmp(image1, image3, len1) == 0, "image didn't round trip");
+
+    EQUAL(tr_net_num_nodes(fromimage), 4);
+    EQUAL(strcmp(tr_net_name(fromimage), "test_conf_write.conf"), 0);
+
+    tr_node a = tr_net_node(fromimage, "A"), b = tr_net_node(fromimage, "B");
+    tr_node c = tr_net_node(fromimage, "C");
+    ASSERT(a && b && c && tr_net_node(fromimage, "lonely"), "missing a node");
+    EQUAL(tr_node_num_ifaces(b), 2);
+
+    tr_iface ab = tr_node_iface(a, "AB"), ba = tr_node_iface(b, "BA");
+    tr_iface bc = tr_node_iface(b, "BC"), cb = tr_node_iface(c, "CB");
+    tr_iface ca = tr_node_iface(c, "CA");
+    EQUAL(strcmp(tr_iface_mac(ab), "02:00:00:00:00:0a"), 0);
+    EQUAL(tr_iface_subnet_mask(ab), 16);
+    EQUAL(tr_iface_ip(ab), TR_ANY_IP_ADDR);
+    EQUAL(strcmp(tr_iface_ip(bc), "10.0.0.1"), 0);
+    EQUAL(tr_iface_num_links(ab), 2);
+
+    tr_link l = tr_iface_link(ab, ba);
+    EQUAL(tr_link_latency(l), 150);
+    EQUAL(tr_link_variance(l), 75);
+    ASSERT(tr_link_is_enabled(l), "AB-BA is disabled");
+
+    l = tr_iface_link(bc, cb);
+    ASSERT(tr_link_droprate(l) == 0.1f, "droprate is %f", tr_link_droprate(l));
+    EQUAL(tr_link_traffic(l), 9);
+    ASSERT(!tr_link_is_enabled(l), "BC-CB is enabled");
+    ASSERT(tr_link_droprate(tr_iface_link(ca, ab)) == 0.03f, "droprate didn't survive");
+
+    // A bound network is written from its snapshot
+    SUCCEED(tr_net_bind(fromimage));
+    SUCCEED(tr_conf_write(fromimage, "test_conf_write.topo3", TR_CONF_COMPILED));
+    free(image3);
+    image3 = test_conf_slurp("test_conf_write.topo3", &len3);
+    ASSERT(image3 && len1 == len3 && memcmp(image1, image3, len1) == 0,
+           "bound network wrote a different image");
+
+    EQUAL(tr_conf_write(fromimage, "test_conf_write.conf", 2), TR_EOUTOFRANGE);
+    EQUAL(tr_conf_write(NULL, "test_conf_write.conf", TR_CONF_TEXT), TR_EPOINTER);
+    EQUAL(tr_conf_write(fromimage, NULL, TR_CONF_TEXT), TR_EPOINTER);
+    EQUAL(tr_conf_write(fromimage, "no/such/dir/net.conf", TR_CONF_TEXT), TR_EIO);
+
+    SUCCEED(tr_net_delete(fromimage));
+    SUCCEED(tr_net_delete(fromtext));
+
+    // IDs with one kind of quote in them are written in the other
+    net = tr_net_create("quotes");
+    ASSERT(tr_node_create(net, "it's") != NULL, "can't create a node");
+    SUCCEED(tr_conf_write(net, "test_conf_write.conf", TR_CONF_TEXT));
+    SUCCEED(tr_net_delete(net));
+
+    SUCCEED(tr_conf_read("test_conf_write.conf", &net));
+    ASSERT(tr_net_node(net, "it's") != NULL, "lost the node");
+    SUCCEED(tr_net_delete(net));
+
+    // IDs with both in them can be compiled, but not written as text
+    net = tr_net_create("quotes");
+    ASSERT(tr_node_create(net, "it's `x`") != NULL, "can't create a node");
+    EQUAL(tr_conf_write(net, "test_conf_write.conf", TR_CONF_TEXT), TR_ESYNTAX);
+    SUCCEED(tr_conf_write(net, "test_conf_write.topo2", TR_CONF_COMPILED));
+    SUCCEED(tr_net_delete(net));
+
+    SUCCEED(tr_conf_read("test_conf_write.topo2", &net));
+    ASSERT(tr_net_node(net, "it's `x`") != NULL, "lost the node");
+    SUCCEED(tr_net_delete(net));
+
+    free(image1);
+    free(image2);
+    free(image3);
+    remove("test_conf_write.conf");
+    remove("test_conf_write.topo");
+    remove("test_conf_write.topo2");
+    remove("test_conf_write.topo3");
+    return true;
+}
+
+// Loads a copy of an image with one word of it changed, checking it fails
+// to load with the given message
+//
+static bool test_conf_corrupt(const char *image, size_t len, size_t at,
+                              uint32_t value, const char *message)
+{
+    char *copy = (char *)malloc(len);
+    memcpy(copy, image, len);
+    memcpy(copy + at, &value, sizeof(value));
+
+    tr_network net = tr_net_create("corrupt");
+    tr_conferror error;
+    EQUAL(tr_conf_load_image((network *)net, copy, len, &error), TR_ESYNTAX);
+    ASSERT(strncmp(error.message, message, strlen(message)) == 0,
+           "failed with \"%s\", not \"%s\"", error.message, message);
+    EQUAL(error.line, 0);
+
+    SUCCEED(tr_net_delete(net));
+    free(copy);
+    return true;
+}
+
+bool test_conf_compile()
+{
+    static const char *source = "test_conf_compile.conf";
+    static const char *dest = "test_conf_compile.topo";
+
+    FILE *f = fopen(source, "w");
+    ASSERT(f != NULL, "can't write %s", source);
+    fputs("node 'A' { interface 'AB' }\n"
+          "node 'B' { interface 'BA' }\n"
+          "link { from 'AB' to 'BA' latency '5' }\n", f);
+    fclose(f);
+
+    tr_conferror error;
+    SUCCEED(tr_conf_compile(source, dest, &error));
+
+    tr_network net = NULL;
+    SUCCEED(tr_conf_read(dest, &net));
+    tr_iface ab = tr_node_iface(tr_net_node(net, "A"), "AB");
+    tr_iface ba = tr_node_iface(tr_net_node(net, "B"), "BA");
+    EQUAL(tr_link_latency(tr_iface_link(ab, ba)), 5);
+
+    // The network is named after the config, not the compiled copy
+    EQUAL(strcmp(tr_net_name(net), source), 0);
+    SUCCEED(tr_net_delete(net));
+
+    size_t len = 0;
+    char *image = test_conf_slurp(dest, &len);
+    ASSERT(image != NULL, "can't read %s", dest);
+
+    const imageheader *h = (const imageheader *)image;
+    EQUAL(h->version, TR_IMAGE_VERSION);
+    EQUAL(h->numnodes, 2);
+    EQUAL(h->numifaces, 2);
+    EQUAL(h->numlinks, 1);
+
+    // Images from other versions, and damaged ones, are turned away before
+    // anything reads past their ends
+    size_t links = h->sections[TR_IMAGE_LINKS].offset;
+    ASSERT(test_conf_corrupt(image, len, offsetof(imageheader, version),
+                             TR_IMAGE_VERSION + 1, "the topology was compiled by a different version"),
+           "loaded another version's image");
+    ASSERT(test_conf_corrupt(image, len, offsetof(imageheader, byteorder),
+                             0x04030201, "the topology was compiled on a machine with a different byte order"),
+           "loaded an image with the wrong byte order");
+    ASSERT(test_conf_corrupt(image, len, offsetof(imageheader, numlinks),
+                             2, "the compiled topology is truncated"),
+           "loaded an image with too many links");
+    ASSERT(test_conf_corrupt(image, len, links, 7, "the compiled topology's links are corrupt"),
+           "loaded a link to nowhere");
+    ASSERT(test_conf_corrupt(image, len, links + 4, 0, "the compiled topology's links are corrupt"),
+           "loaded a link to itself");
+    ASSERT(test_conf_corrupt(image, len, h->sections[TR_IMAGE_NODES].offset + 4, 0,
+                             "the compiled topology uses a name twice"),
+           "loaded two nodes with the same name");
+
+    // The network's name has to end inside the image
+    const imagesection *name = &h->sections[TR_IMAGE_NAME];
+    ASSERT(test_conf_corrupt(image, len, name->offset + name->size - 4, 0x78787878,
+                             "the compiled topology is truncated"),
+           "loaded an image with an unterminated name");
+
+    tr_network trunc = tr_net_create("truncated");
+    EQUAL(tr_conf_load_image((network *)trunc, image, len - 8, &error), TR_ESYNTAX);
+    EQUAL(tr_conf_load_image((network *)trunc, image, 16, &error), TR_ESYNTAX);
+    EQUAL(tr_net_num_nodes(trunc), 0);
+    SUCCEED(tr_net_delete(trunc));
+
+    free(image);
+
+    // Compiling fails as parsing does
+    remove(source);
+    EQUAL(tr_conf_compile(source, dest, &error), TR_EIO);
+    EQUAL(tr_conf_compile(NULL, dest, &error), TR_EPOINTER);
+
+    remove(dest);
+    return true;
+}
+
+// Writes text to the file at path
+//
+static bool test_conf_put(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    ASSERT(f != NULL, "can't write %s", path);
+    fputs(text, f);
+    fclose(f);
+    return true;
+}
+
+// Checks what a reload changed
+//
+static bool test_conf_changes(const tr_confchanges *c, unsigned addednodes,
+                              unsigned removednodes, unsigned addedifaces,
+                              unsigned removedifaces, unsigned readdressed,
+                              unsigned addedlinks, unsigned removedlinks,
+                              unsigned changedlinks)
+{
+    EQUAL(c->addednodes, addednodes);
+    EQUAL(c->removednodes, removednodes);
+    EQUAL(c->addedifaces, addedifaces);
+    EQUAL(c->removedifaces, removedifaces);
+    EQUAL(c->readdressedifaces, readdressed);
+    EQUAL(c->addedlinks, addedlinks);
+    EQUAL(c->removedlinks, removedlinks);
+    EQUAL(c->changedlinks, changedlinks);
+    return true;
+}
+
+bool test_conf_reload()
+{
+    static const char *path = "test_conf_reload.conf";
+    static const char *first =
+        "node 'A' { interface 'AB' interface 'AC' }\n"
+        "node 'B' { interface 'BA' interface 'BC' }\n"
+        "node 'C' { interface 'CA' interface 'CB' }\n"
+        "link { from 'AB' to 'BA' latency '10' }\n"
+        "link { from 'BC' to 'CB' }\n"
+        "link { from 'CA' to 'AC' }\n";
+
+    // Only links' characteristics change
+    static const char *retuned =
+        "node 'A' { interface 'AB' interface 'AC' }\n"
+        "node 'B' { interface 'BA' interface 'BC' }\n"
+        "node 'C' { interface 'CA' interface 'CB' }\n"
+        "link { from 'AB' to 'BA' latency '20' }\n"
+        "link { from 'CB' to 'BC' enabled 'false' }\n"
+        "link { from 'CA' to 'AC' }\n";
+
+    // C goes, D arrives, and AC moves to D
+    static const char *reshaped =
+        "node 'A' { interface 'AB' }\n"
+        "node 'B' { interface 'BA' { mac '02:00:00:00:00:0b' } interface 'BC' interface 'BD' }\n"
+        "node 'D' { interface 'DB' { ip '10.0.0.4' } interface 'AC' }\n"
+        "link { from 'AB' to 'BA' latency '20' }\n"
+        "link { from 'BD' to 'DB' traffic '5' }\n";
+
+    tr_conferror error;
+    tr_confchanges changes;
+    tr_network net = NULL;
+
+    // A network that isn't bound is just edited
+    ASSERT(test_conf_put(path, first), "can't write the config");
+    SUCCEED(tr_conf_read(path, &net));
+    tr_node a = tr_net_node(net, "A");
+
+    ASSERT(test_conf_put(path, reshaped), "can't write the config");
+    SUCCEED(tr_conf_reload(net, path, &changes, &error));
+    ASSERT(test_conf_changes(&changes, 1, 1, 3, 3, 1, 1, 2, 1), "wrong changes");
+    ASSERT(!tr_net_is_bound(net), "reloading bound the network");
+    EQUAL(tr_net_num_nodes(net), 3);
+    EQUAL(tr_net_node(net, "A"), a);
+    EQUAL(tr_net_node(net, "C"), NULL);
+    EQUAL(tr_node_iface(a, "AC"), NULL);
+    ASSERT(tr_node_iface(tr_net_node(net, "D"), "AC") != NULL, "AC didn't move");
+
+    // Reloading the same config changes nothing
+    SUCCEED(tr_conf_reload(net, path, &changes, &error));
+    ASSERT(test_conf_changes(&changes, 0, 0, 0, 0, 0, 0, 0, 0), "reloading changed something");
+    SUCCEED(tr_net_delete(net));
+
+    // A running network
+    ASSERT(test_conf_put(path, first), "can't write the config");
+    SUCCEED(tr_conf_read(path, &net));
+    SUCCEED(tr_net_partition(net, 2, 0.5f, NULL));
+    SUCCEED(tr_net_start(net));
+
+    network *n = (network *)net;
+    a = tr_net_node(net, "A");
+    tr_node b = tr_net_node(net, "B");
+    tr_iface ab = tr_node_iface(a, "AB"), ba = tr_node_iface(b, "BA");
+    tr_iface bc = tr_node_iface(b, "BC");
+    tr_link l = tr_iface_link(ab, ba);
+    int parta = tr_node_part(a), partb = tr_node_part(b);
+    snapshot *snap = n->frozen;
+
+    // Link changes are made to the snapshot in place
+    ASSERT(test_conf_put(path, retuned), "can't write the config");
+    SUCCEED(tr_conf_reload(net, path, &changes, &error));
+    ASSERT(test_conf_changes(&changes, 0, 0, 0, 0, 0, 0, 0, 2), "wrong changes");
+    EQUAL(n->frozen, snap);
+    EQUAL(tr_link_latency(l), 20);
+    EQUAL(snap->latency[((link *)tr_link_get(l))->index], 20);
+    ASSERT(!tr_link_is_enabled(tr_iface_link(bc, tr_node_iface(tr_net_node(net, "C"), "CB"))),
+           "BC-CB is still enabled");
+
+    // Topology changes recompile it, without stopping the network
+    ASSERT(test_conf_put(path, reshaped), "can't write the config");
+    SUCCEED(tr_conf_reload(net, path, &changes, &error));
+    ASSERT(test_conf_changes(&changes, 1, 1, 3, 3, 1, 1, 2, 0), "wrong changes");
+    ASSERT(tr_net_is_simulating(net), "reloading stopped the network");
+    ASSERT(n->frozen != snap, "the topology wasn't recompiled");
+    EQUAL(n->frozen->num_nodes, 3);
+    EQUAL(n->frozen->num_links, 2);
+
+    // Handles to what stayed still work, and nodes keep their threads
+    EQUAL(tr_net_node(net, "A"), a);
+    EQUAL(tr_link_latency(l), 20);
+    EQUAL(tr_iface_link(ab, ba), l);
+    EQUAL(strcmp(tr_iface_mac(ba), "02:00:00:00:00:0b"), 0);
+    EQUAL(tr_node_part(a), parta);
+    EQUAL(tr_node_part(b), partb);
+
+    tr_node d = tr_net_node(net, "D");
+    EQUAL(tr_node_part(d), partb);
+    EQUAL(strcmp(tr_iface_ip(tr_node_iface(d, "DB")), "10.0.0.4"), 0);
+    EQUAL(tr_link_traffic(tr_iface_link(tr_node_iface(b, "BD"), tr_node_iface(d, "DB"))), 5);
+
+    tr_partinfo info;
+    SUCCEED(tr_net_placement(net, &info));
+    EQUAL(info.parts, 2);
+    EQUAL(info.largest + info.smallest, 3);
+
+    // A bad config leaves the network as it was
+    ASSERT(test_conf_put(path, "node 'A' { interface 'AB' interface 'AB' }\n"),
+           "can't write the config");
+    EQUAL(tr_conf_reload(net, path, &changes, &error), TR_ESYNTAX);
+    EQUAL(error.line, 1);
+    EQUAL(tr_net_num_nodes(net), 3);
+    EQUAL(n->frozen->num_nodes, 3);
+
+    remove(path);
+    EQUAL(tr_conf_reload(net, path, &changes, &error), TR_EIO);
+    EQUAL(tr_conf_reload(NULL, path, &changes, &error), TR_EPOINTER);
+    EQUAL(tr_conf_reload(net, NULL, &changes, &error), TR_EPOINTER);
+
+    SUCCEED(tr_net_stop(net));
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+// Reader thread: asks for routes and parts while the network is reloaded,
+// as a forwarding thread would
+//
+struct _reloadctx
+{
+    tr_node a, c, e;    // A and C are always there; E was, at first
+    tr_iface ab, ac;    // A's ways toward C
+    int done;           // Set once the reloads are over
+    bool failed;
+};
+
+typedef struct _reloadctx reloadctx;
+
+static void *test_conf_reader(void *arg)
+{
+    reloadctx *ctx = (reloadctx *)arg;
+
+    while (!__atomic_load_n(&ctx->done, __ATOMIC_ACQUIRE)) {
+        int hops = tr_node_hops(ctx->a, ctx->c);
+        tr_iface next = tr_node_next_hop(ctx->a, ctx->c);
+        int part = tr_node_part(ctx->a);
+        int gone = tr_node_hops(ctx->a, ctx->e);
+
+        if ((hops != 1 && hops != 2) || (next != ctx->ab && next != ctx->ac) ||
+            (part != 0 && part != 1) || (gone != -1 && gone != 3)) {
+            ctx->failed = true;
+        }
+    }
+
+    return NULL;
+}
+
+bool test_conf_reload_concurrent()
+{
+    static const char *paths[2] = {
+        "test_conf_reload_concurrent0.conf",
+        "test_conf_reload_concurrent1.conf"
+    };
+
+    // The route from A to C takes two hops, then one, and E comes and goes
+    static const char *configs[2] = {
+        "node 'A' { interface 'AB' interface 'AC' }\n"
+        "node 'B' { interface 'BA' interface 'BC' }\n"
+        "node 'C' { interface 'CB' interface 'CA' interface 'CE' }\n"
+        "node 'E' { interface 'EC' }\n"
+        "link { from 'AB' to 'BA' }\n"
+        "link { from 'BC' to 'CB' }\n"
+        "link { from 'CE' to 'EC' }\n",
+
+        "node 'A' { interface 'AB' interface 'AC' }\n"
+        "node 'B' { interface 'BA' interface 'BC' }\n"
+        "node 'C' { interface 'CB' interface 'CA' interface 'CE' }\n"
+        "link { from 'AB' to 'BA' }\n"
+        "link { from 'BC' to 'CB' }\n"
+        "link { from 'AC' to 'CA' }\n"
+    };
+
+    tr_network net = NULL;
+    ASSERT(test_conf_put(paths[0], configs[0]), "can't write the config");
+    ASSERT(test_conf_put(paths[1], configs[1]), "can't write the config");
+    SUCCEED(tr_conf_read(paths[0], &net));
+    SUCCEED(tr_net_partition(net, 2, 0.5f, NULL));
+    SUCCEED(tr_net_start(net));
+
+    tr_node a = tr_net_node(net, "A");
+    reloadctx ctx = {
+        a, tr_net_node(net, "C"), tr_net_node(net, "E"),
+        tr_node_iface(a, "AB"), tr_node_iface(a, "AC"), 0, false
+    };
+
+    EQUAL(tr_node_hops(ctx.a, ctx.e), 3);
+
+    pthread_t readers[4];
+    for (int t = 0; t < 4; ++t) {
+        pthread_create(&readers[t], NULL, test_conf_reader, &ctx);
+    }
+
+    tr_confchanges changes;
+    tr_conferror error;
+    tr_err err = TR_OK;
+
+    for (int k = 1; err >= 0 && k <= 200; ++k) {
+        err = tr_conf_reload(net, paths[k % 2], &changes, &error);
+    }
+
+    __atomic_store_n(&ctx.done, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(readers[t], NULL);
+    }
+
+    SUCCEED(err);
+    ASSERT(!ctx.failed, "a reader saw a route or part that was never there");
+    ASSERT(tr_net_is_simulating(net), "reloading stopped the network");
+    EQUAL(tr_node_hops(ctx.a, ctx.c), 2);
+    EQUAL(tr_node_hops(ctx.a, ctx.e), -1);
+
+    remove(paths[0]);
+    remove(paths[1]);
+    SUCCEED(tr_net_stop(net));
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
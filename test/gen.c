@@ -0,0 +1,237 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// gen.c - Topology generator unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "network.h"
+#include "node.h"
+#include "snapshot.h"
+#include "test.h"
+
+// Counts the links in the network by binding it and looking at the
+// snapshot, then unbinds it again
+//
+static unsigned int test_gen_num_links(tr_network net)
+{
+    tr_net_bind(net);
+    unsigned int count = ((network *)net)->frozen->num_links;
+    tr_net_unbind(net);
+
+    return count;
+}
+
+// Gets the number of interfaces (which is the number of links) on the node
+// with the given name, or -1 if there's no such node
+//
+static int test_gen_degree(tr_network net, const char *name)
+{
+    tr_node n = tr_net_node(net, name);
+    return n ? (int)tr_node_num_ifaces(n) : -1;
+}
+
+bool test_gen_regular()
+{
+    tr_network net = tr_net_create("ring");
+    SUCCEED(tr_gen_ring(net, 10, NULL));
+    EQUAL(tr_net_num_nodes(net), 10);
+    EQUAL(test_gen_num_links(net), 10);
+    EQUAL(test_gen_degree(net, "r0"), 2);
+    EQUAL(test_gen_degree(net, "r9"), 2);
+
+    // Links take each node's interfaces in order
+    tr_iface r0 = tr_node_iface(tr_net_node(net, "r0"), "r0-0");
+    tr_iface r1 = tr_node_iface(tr_net_node(net, "r1"), "r1-0");
+    ASSERT(tr_iface_has_link(r0, r1), "r0 and r1 should be linked");
+
+    EQUAL(tr_gen_ring(net, 2, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    // Every node in a torus has two links per dimension
+    net = tr_net_create("torus");
+    unsigned dims[3] = { 4, 5, 3 };
+    SUCCEED(tr_gen_torus(net, dims, 3, NULL));
+    EQUAL(tr_net_num_nodes(net), 60);
+    EQUAL(test_gen_num_links(net), 180);
+    EQUAL(test_gen_degree(net, "t0"), 6);
+    EQUAL(test_gen_degree(net, "t59"), 6);
+
+    tr_genopts prefixed = { 0, "flat-", 0, 0, 0 };
+    SUCCEED(tr_gen_torus(net, dims, 2, &prefixed));
+    EQUAL(tr_net_num_nodes(net), 80);
+    EQUAL(test_gen_degree(net, "flat-t19"), 4);
+
+    unsigned thin[2] = { 4, 2 };
+    EQUAL(tr_gen_torus(net, thin, 2, NULL), TR_EOUTOFRANGE);
+    EQUAL(tr_gen_torus(net, dims, 4, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    // A 4-ary fat tree has 4 core, 8 aggregation and 8 edge switches, and
+    // 16 hosts. Every switch has 4 ports.
+    net = tr_net_create("fattree");
+    SUCCEED(tr_gen_fat_tree(net, 4, NULL));
+    EQUAL(tr_net_num_nodes(net), 36);
+    EQUAL(test_gen_num_links(net), 48);
+    EQUAL(test_gen_degree(net, "core3"), 4);
+    EQUAL(test_gen_degree(net, "agg7"), 4);
+    EQUAL(test_gen_degree(net, "edge7"), 4);
+    EQUAL(test_gen_degree(net, "host15"), 1);
+    EQUAL(test_gen_degree(net, "host16"), -1);
+
+    EQUAL(tr_gen_fat_tree(net, 5, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    net = tr_net_create("stars");
+    SUCCEED(tr_gen_star_of_stars(net, 3, 4, NULL));
+    EQUAL(tr_net_num_nodes(net), 16);
+    EQUAL(test_gen_num_links(net), 15);
+    EQUAL(test_gen_degree(net, "hub0"), 3);
+    EQUAL(test_gen_degree(net, "arm2"), 5);
+    EQUAL(test_gen_degree(net, "leaf11"), 1);
+
+    EQUAL(tr_gen_star_of_stars(net, 3, 0, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    return true;
+}
+
+// Builds a random topology with the given seed and lists its links as
+// pairs of node names, one pair per line
+//
+static char *test_gen_describe(bool erdos, unsigned long long seed)
+{
+    tr_network net = tr_net_create(NULL);
+    tr_genopts opts = { seed, NULL, 0, 0, 0 };
+
+    if (erdos) {
+        tr_gen_erdos_renyi(net, 200, 0.05, &opts);
+    }
+    else {
+        tr_gen_barabasi_albert(net, 200, 3, &opts);
+    }
+
+    tr_net_bind(net);
+    snapshot *snap = ((network *)net)->frozen;
+
+    char *text = (char *)calloc(snap->num_links, 32);
+    char *end = text;
+
+    for (unsigned int k = 0; k < snap->num_links; ++k) {
+        node *a = snap->nodes[snap->iface_node[snap->link_ends[2 * k]]];
+        node *b = snap->nodes[snap->iface_node[snap->link_ends[2 * k + 1]]];
+        end += sprintf(end, "%s %s\n", a->name, b->name);
+    }
+
+    tr_net_unbind(net);
+    tr_net_delete(net);
+    return text;
+}
+
+bool test_gen_random()
+{
+    // G(200, 0.05) has 995 links on average, with a standard deviation of
+    // about 31
+    tr_network net = tr_net_create("erdos");
+    tr_genopts opts = { 42, NULL, 0, 0, 0 };
+    SUCCEED(tr_gen_erdos_renyi(net, 200, 0.05, &opts));
+    EQUAL(tr_net_num_nodes(net), 200);
+
+    unsigned int links = test_gen_num_links(net);
+    ASSERT(links > 850 && links < 1150, "G(200, 0.05) had %u links", links);
+    SUCCEED(tr_net_delete(net));
+
+    net = tr_net_create("complete");
+    SUCCEED(tr_gen_erdos_renyi(net, 20, 1, NULL));
+    EQUAL(test_gen_num_links(net), 190);
+    SUCCEED(tr_gen_erdos_renyi(net, 5, 0, &(tr_genopts){ 0, "empty", 0, 0, 0 }));
+    EQUAL(test_gen_num_links(net), 190);
+    EQUAL(tr_gen_erdos_renyi(net, 5, 1.5, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    // Preferential attachment makes exactly m links per node after the
+    // first m + 1, which are all linked to each other
+    net = tr_net_create("barabasi");
+    SUCCEED(tr_gen_barabasi_albert(net, 1000, 3, NULL));
+    EQUAL(tr_net_num_nodes(net), 1000);
+    EQUAL(test_gen_num_links(net), 6 + 996 * 3);
+    EQUAL(test_gen_degree(net, "n999"), 3);
+
+    // ... and the early nodes collect far more than that
+    ASSERT(test_gen_degree(net, "n0") > 20, "n0 should be a hub");
+
+    EQUAL(tr_gen_barabasi_albert(net, 3, 3, NULL), TR_EOUTOFRANGE);
+    SUCCEED(tr_net_delete(net));
+
+    // The same seed always builds the same topology; different ones don't
+    for (int erdos = 0; erdos < 2; ++erdos) {
+        char *a = test_gen_describe(erdos, 7);
+        char *b = test_gen_describe(erdos, 7);
+        char *c = test_gen_describe(erdos, 8);
+
+        ASSERT(strcmp(a, b) == 0, "Same seed built different topologies");
+        ASSERT(strcmp(a, c) != 0, "Different seeds built the same topology");
+
+        free(a);
+        free(b);
+        free(c);
+    }
+
+    return true;
+}
+
+bool test_gen_options()
+{
+    tr_network net = tr_net_create("options");
+
+    // Every link gets the characteristics in the options
+    tr_genopts opts = { 0, NULL, 25, 5, 0.125f };
+    SUCCEED(tr_gen_ring(net, 4, &opts));
+
+    tr_iface r0 = tr_node_iface(tr_net_node(net, "r0"), "r0-0");
+    tr_link l;
+    SUCCEED(tr_iface_links(r0, &l, 1));
+    EQUAL(tr_link_latency(l), 25);
+    EQUAL(tr_link_variance(l), 5);
+    ASSERT(tr_link_droprate(l) == 0.125f, "Wrong drop rate");
+
+    opts.droprate = 2;
+    EQUAL(tr_gen_ring(net, 4, &opts), TR_EOUTOFRANGE);
+
+    // Generators build everything or nothing. Here the ring's nodes can be
+    // made, but a star's hub can't, since its name is taken by a node, so
+    // none of the star is built.
+    tr_node_create(net, "s-hub0");
+    tr_genopts star = { 0, "s-", 0, 0, 0 };
+    EQUAL(tr_gen_star_of_stars(net, 2, 2, &star), TR_ENAMETAKEN);
+    EQUAL(tr_net_num_nodes(net), 5);
+    EQUAL(tr_net_has_node(net, "s-arm0"), false);
+
+    // An interface name can be taken too, after the nodes are made
+    tr_iface_create(tr_net_node(net, "s-hub0"), "x-r1-0");
+    tr_genopts ring = { 0, "x-", 0, 0, 0 };
+    EQUAL(tr_gen_ring(net, 3, &ring), TR_ENAMETAKEN);
+    EQUAL(tr_net_num_nodes(net), 5);
+    EQUAL(tr_net_has_node(net, "x-r0"), false);
+
+    // Once the name's free, the same generator works
+    SUCCEED(tr_iface_delete(tr_node_iface(tr_net_node(net, "s-hub0"), "x-r1-0")));
+    SUCCEED(tr_gen_ring(net, 3, &ring));
+    EQUAL(tr_net_num_nodes(net), 8);
+
+    // Nothing can be added to a bound network
+    SUCCEED(tr_net_bind(net));
+    EQUAL(tr_gen_ring(net, 3, NULL), TR_ENETBOUND);
+    SUCCEED(tr_net_unbind(net));
+
+    EQUAL(tr_gen_ring(NULL, 3, NULL), TR_EPOINTER);
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
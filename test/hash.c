@@ -10,6 +10,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "hash.h"
 #include "memory.h"
@@ -156,3 +157,369 @@ bool test_strhash_hashfunc()
 
     return true;
 }
+
+bool test_hash_growshrink()
+{
+    tr_hash hash = tr_inthash_create(sizeof(int));
+
+    for (int i = 0; i < 100000; ++i) {
+        int value = -i;
+        SUCCEED(tr_inthash_set(hash, i, &value));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 100000);
+
+    for (int i = 0; i < 100000; ++i) {
+        int *value = tr_inthash_get(hash, i);
+        ASSERT(value != NULL, "Missing key: %d", i);
+        EQUAL(*value, -i);
+    }
+
+    EQUAL(tr_inthash_get(hash, 100000), NULL);
+    EQUAL(tr_inthash_get(hash, -1), NULL);
+
+    // Remove every odd key, leaving tombstones behind
+    for (int i = 1; i < 100000; i += 2) {
+        SUCCEED(tr_inthash_clear(hash, i));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 50000);
+    EQUAL(tr_inthash_clear(hash, 1), TR_ENOTFOUND);
+
+    for (int i = 0; i < 100000; ++i) {
+        EQUAL(tr_inthash_contains(hash, i), i % 2 == 0);
+    }
+
+    // Churn through new keys so tombstones get reused or purged
+    for (int i = 100000; i < 300000; ++i) {
+        SUCCEED(tr_inthash_set(hash, i, &i));
+        SUCCEED(tr_inthash_clear(hash, i));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 50000);
+
+    for (int i = 0; i < 100000; i += 2) {
+        SUCCEED(tr_inthash_clear(hash, i));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 0);
+    EQUAL(tr_inthash_contains(hash, 0), false);
+
+    SUCCEED(tr_inthash_delete(hash));
+    return true;
+}
+
+bool test_strhash_basics()
+{
+    const char *keys[] = { "alpha", "beta", "gamma", "delta" };
+    tr_hash hash = tr_strhash_create(sizeof(int));
+
+    for (int i = 0; i < 4; ++i) {
+        SUCCEED(tr_strhash_set(hash, keys[i], &i));
+    }
+
+    // Lookups compare by value, not by pointer
+    char buf[16];
+    for (int i = 0; i < 4; ++i) {
+        snprintf(buf, sizeof(buf), "%s", keys[i]);
+        ASSERT(tr_strhash_contains(hash, buf), "Missing key: %s", buf);
+        EQUAL(*(int*)tr_strhash_get(hash, buf), i);
+    }
+
+    EQUAL(tr_strhash_contains(hash, "epsilon"), false);
+
+    int value = 42;
+    SUCCEED(tr_strhash_set(hash, "beta", &value));
+    EQUAL(tr_strhash_num_keys(hash), 4);
+    EQUAL(*(int*)tr_strhash_get(hash, "beta"), 42);
+
+    SUCCEED(tr_strhash_delete(hash));
+    return true;
+}
+
+bool test_hash_incremental()
+{
+    tr_hash hash = tr_inthash_create(sizeof(int));
+    SUCCEED(tr_hash_set_incremental(hash, true));
+    EQUAL(tr_hash_is_incremental(hash), true);
+
+    // Check every key after each insert, so lookups run against both the
+    // old and new tables while a migration is in flight.
+    for (int i = 0; i < 5000; ++i) {
+        SUCCEED(tr_inthash_set(hash, i, &i));
+        EQUAL(tr_inthash_num_keys(hash), i + 1);
+
+        for (int j = 0; j <= i; j += 1 + i / 64) {
+            ASSERT(tr_inthash_contains(hash, j), "Missing key %d after %d", j, i);
+        }
+    }
+
+    for (int i = 0; i < 100000; ++i) {
+        SUCCEED(tr_inthash_set(hash, i, &i));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 100000);
+
+    for (int i = 0; i < 100000; ++i) {
+        int *value = tr_inthash_get(hash, i);
+        ASSERT(value != NULL, "Missing key: %d", i);
+        EQUAL(*value, i);
+    }
+
+    // Overwriting keys mid-migration must not duplicate them
+    for (int i = 0; i < 100000; i += 3) {
+        int value = -i;
+        SUCCEED(tr_inthash_set(hash, i, &value));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 100000);
+
+    tr_vector keys = tr_inthash_keys(hash);
+    EQUAL(tr_vec_size(keys), 100000);
+    tr_vec_delete(keys);
+
+    // Shrink back down, checking the survivors as we go
+    for (int i = 0; i < 99990; ++i) {
+        SUCCEED(tr_inthash_clear(hash, i));
+    }
+
+    EQUAL(tr_inthash_num_keys(hash), 10);
+
+    for (int i = 99990; i < 100000; ++i) {
+        int *value = tr_inthash_get(hash, i);
+        ASSERT(value != NULL, "Missing key: %d", i);
+        EQUAL(*value, i % 3 == 0 ? -i : i);
+    }
+
+    SUCCEED(tr_hash_set_incremental(hash, false));
+    EQUAL(tr_inthash_num_keys(hash), 10);
+    EQUAL(tr_inthash_contains(hash, 99999), true);
+
+    SUCCEED(tr_inthash_delete(hash));
+    return true;
+}
+
+// Walks a hashtable with a cursor, checking that every key in [0, n) comes
+// back exactly once, with its own value, and that nothing else does.
+//
+static bool check_cursor(tr_hash hash, int n, bool *seen)
+{
+    memset(seen, 0, n * sizeof(bool));
+
+    int count = 0;
+    tr_hash_iter it;
+
+    tr_hash_foreach(it, hash) {
+        int key = *(int *)it.key;
+        ASSERT(key >= 0 && key < n, "Cursor found bogus key %d", key);
+        ASSERT(!seen[key], "Cursor visited key %d twice", key);
+        EQUAL(*(int *)it.value, key);
+
+        seen[key] = true;
+        ++count;
+    }
+
+    EQUAL(count, n);
+    return true;
+}
+
+bool test_hash_cursor()
+{
+    bool *seen = (bool *)malloc(20000 * sizeof(bool));
+
+    // Empty tables yield nothing
+    tr_hash hash = tr_inthash_create(sizeof(int));
+    ASSERT(check_cursor(hash, 0, seen), "Empty table walked wrong");
+
+    // Values point into the table, so they can be updated in place
+    for (int i = 0; i < 1000; ++i) {
+        int bogus = -1;
+        SUCCEED(tr_inthash_set(hash, i, &bogus));
+    }
+
+    tr_hash_iter it;
+    tr_hash_foreach(it, hash) {
+        *(int *)it.value = *(int *)it.key;
+    }
+
+    ASSERT(check_cursor(hash, 1000, seen), "Table walked wrong");
+    SUCCEED(tr_inthash_delete(hash));
+
+    // In incremental mode the cursor has to cover both tables while a
+    // migration is in flight
+    hash = tr_inthash_create(sizeof(int));
+    SUCCEED(tr_hash_set_incremental(hash, true));
+
+    for (int i = 0; i < 20000; ++i) {
+        SUCCEED(tr_inthash_set(hash, i, &i));
+
+        if (i % 97 == 0) {
+            ASSERT(check_cursor(hash, i + 1, seen), "Walked wrong after %d", i);
+        }
+    }
+
+    SUCCEED(tr_inthash_delete(hash));
+
+    free(seen);
+    return true;
+}
+
+// Checks that the low and high bytes of a hash are both spread evenly
+//
+static bool check_hash64_spread(unsigned int *low, unsigned int *high,
+                                unsigned int total)
+{
+    // Allow ~6 standard deviations
+    unsigned int expected = total / 256;
+    unsigned int tolerance = 400;
+
+    for (int i = 0; i < 256; ++i) {
+        ASSERT(low[i] + tolerance > expected && low[i] < expected + tolerance,
+               "Low bits are biased");
+        ASSERT(high[i] + tolerance > expected && high[i] < expected + tolerance,
+               "High bits are biased");
+    }
+
+    return true;
+}
+
+bool test_hash64_hashfuncs()
+{
+    static const unsigned int COUNT = 1000000;
+    uint64_t seed = 0x1234;
+
+    // Sequential ints
+    unsigned int low[256] = { 0 }, high[256] = { 0 };
+    for (unsigned int i = 0; i < COUNT; ++i) {
+        uint64_t h = tr_hashfunc64_int(&i, seed);
+        low[h & 0xFF]++;
+        high[h >> 56]++;
+    }
+
+    ASSERT(check_hash64_spread(low, high, COUNT), "Int hash is biased");
+
+    // MACs from one vendor prefix, with sequential low bytes
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    for (unsigned int i = 0; i < COUNT; ++i) {
+        unsigned char mac[6] = { 0x00, 0x1b, 0x21, i >> 16, i >> 8, i };
+        uint64_t h = tr_hashfunc64_mac(mac, seed);
+        low[h & 0xFF]++;
+        high[h >> 56]++;
+    }
+
+    ASSERT(check_hash64_spread(low, high, COUNT), "MAC hash is biased");
+
+    // Addresses in one /12
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    for (unsigned int i = 0; i < COUNT; ++i) {
+        unsigned char addr[4] = { 10, 0x10 | (i >> 16), i >> 8, i };
+        uint64_t h = tr_hashfunc64_ipv4(addr, seed);
+        low[h & 0xFF]++;
+        high[h >> 56]++;
+    }
+
+    ASSERT(check_hash64_spread(low, high, COUNT), "IPv4 hash is biased");
+
+    // Similar strings
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    char buf[64];
+    for (unsigned int i = 0; i < COUNT; ++i) {
+        const char *str = buf;
+        sprintf(buf, "node_%u.eth%u", i / 4, i % 4);
+
+        uint64_t h = tr_hashfunc64_str(&str, seed);
+        low[h & 0xFF]++;
+        high[h >> 56]++;
+    }
+
+    ASSERT(check_hash64_spread(low, high, COUNT), "String hash is biased");
+
+    return true;
+}
+
+bool test_hash_seeded()
+{
+    // Every prefix of a buffer hashes differently, at every length
+    // through the short-key, loop and three-lane paths
+    char data[200];
+    for (int i = 0; i < 200; ++i) {
+        data[i] = (char)(i * 7);
+    }
+
+    uint64_t hashes[201];
+    for (int len = 0; len <= 200; ++len) {
+        hashes[len] = tr_hash64_bytes(data, len, 42);
+        EQUAL(tr_hash64_bytes(data, len, 42), hashes[len]);
+        ASSERT(tr_hash64_bytes(data, len, 43) != hashes[len], "Seed is ignored");
+
+        for (int j = 0; j < len; ++j) {
+            ASSERT(hashes[j] != hashes[len], "Prefixes %d and %d collide", j, len);
+        }
+    }
+
+    // Flipping any one bit changes the hash
+    for (int bit = 0; bit < 100 * 8; ++bit) {
+        data[bit / 8] ^= 1 << (bit % 8);
+        ASSERT(tr_hash64_bytes(data, 100, 42) != hashes[100], "Bit %d is ignored", bit);
+        data[bit / 8] ^= 1 << (bit % 8);
+    }
+
+    // Tables pick their own seeds
+    tr_hash h1 = tr_hash_create_seeded(6, sizeof(int), tr_hashfunc64_mac, tr_equalfunc_mac);
+    tr_hash h2 = tr_strhash_create(0);
+    ASSERT(h1 != NULL && h2 != NULL, "tr_hash_create_seeded failed!");
+    ASSERT(tr_hash_seed(h1) != tr_hash_seed(h2), "Tables share a seed");
+
+    for (int i = 0; i < 10000; ++i) {
+        unsigned char mac[6] = { 0x02, 0, 0, 0, i >> 8, i };
+        SUCCEED(tr_hash_set(h1, mac, &i));
+    }
+
+    EQUAL(tr_hash_num_keys(h1), 10000);
+
+    for (int i = 0; i < 10000; ++i) {
+        unsigned char mac[6] = { 0x02, 0, 0, 0, i >> 8, i };
+        int *value = (int *)tr_hash_get(h1, mac);
+        ASSERT(value && *value == i, "Lost MAC %d", i);
+    }
+
+    unsigned char other[6] = { 0x02, 0, 0, 1, 0, 0 };
+    EQUAL(tr_hash_contains(h1, other), false);
+
+    SUCCEED(tr_hash_delete(h1));
+    SUCCEED(tr_strhash_delete(h2));
+    return true;
+}
+
+bool test_hash_reserve()
+{
+    tr_hash hash = tr_inthash_create(sizeof(int));
+    ASSERT(hash != NULL, "tr_inthash_create failed!");
+    SUCCEED(tr_hash_set_incremental(hash, true));
+
+    for (int i = 0; i < 100; ++i) {
+        SUCCEED(tr_inthash_set(hash, i, &i));
+    }
+
+    // Reserving keeps what's in the table, and never shrinks it
+    SUCCEED(tr_hash_reserve(hash, 10000));
+    SUCCEED(tr_hash_reserve(hash, 10));
+    EQUAL(tr_inthash_num_keys(hash), 100);
+
+    for (int i = 100; i < 10000; ++i) {
+        tr_hash_prefetch(hash, &i);
+        SUCCEED(tr_inthash_set(hash, i, &i));
+    }
+
+    for (int i = 0; i < 10000; ++i) {
+        int *value = (int *)tr_inthash_get(hash, i);
+        ASSERT(value && *value == i, "Lost item %d", i);
+    }
+
+    EQUAL(tr_hash_reserve(NULL, 10), TR_EPOINTER);
+    SUCCEED(tr_inthash_delete(hash));
+    return true;
+}
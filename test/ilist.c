@@ -0,0 +1,137 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ilist.c - Intrusive linked list unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ilist.h"
+#include "test.h"
+
+struct _item
+{
+    int value;
+    tr_ilink link;          // Link for the 'all' list
+    tr_ilink oddlink;       // Link for the 'odd' list
+};
+
+typedef struct _item item;
+
+// Checks that a list holds exactly the given values, walking it both ways
+//
+static bool check_list(tr_ilist *list, const int *values, int count)
+{
+    int i = 0;
+    tr_ilist_foreach(link, list) {
+        ASSERT(i < count, "List is too long");
+        EQUAL(tr_ilist_entry(link, item, link)->value, values[i]);
+        ++i;
+    }
+
+    EQUAL(i, count);
+
+    for (tr_ilink *link = tr_ilist_last(list); link; link = tr_ilist_prev(list, link)) {
+        --i;
+        EQUAL(tr_ilist_entry(link, item, link)->value, values[i]);
+    }
+
+    EQUAL(i, 0);
+    return true;
+}
+
+bool test_ilist_basics()
+{
+    tr_ilist list;
+    tr_ilist_init(&list);
+
+    EQUAL(tr_ilist_empty(&list), true);
+    EQUAL(tr_ilist_first(&list), NULL);
+    EQUAL(tr_ilist_last(&list), NULL);
+    EQUAL(tr_ilist_remove_first(&list), NULL);
+
+    item items[5];
+    for (int i = 0; i < 5; ++i) {
+        items[i].value = i;
+        tr_ilink_init(&items[i].link);
+        EQUAL(tr_ilink_linked(&items[i].link), false);
+    }
+
+    SUCCEED(tr_ilist_add(&list, &items[1].link));
+    SUCCEED(tr_ilist_append(&list, &items[3].link));
+    SUCCEED(tr_ilist_prepend(&list, &items[0].link));
+    SUCCEED(tr_ilist_add_before(&items[3].link, &items[2].link));
+    SUCCEED(tr_ilist_add_after(&items[3].link, &items[4].link));
+
+    EQUAL(tr_ilist_empty(&list), false);
+    EQUAL(tr_ilink_linked(&items[2].link), true);
+
+    int all[] = { 0, 1, 2, 3, 4 };
+    ASSERT(check_list(&list, all, 5), "Wrong list after adds");
+
+    // Unlinking works from any position, without touching the items
+    SUCCEED(tr_ilist_remove(&items[2].link));
+    EQUAL(tr_ilink_linked(&items[2].link), false);
+    EQUAL(tr_ilist_remove(&items[2].link), TR_ENOTFOUND);
+
+    int nomiddle[] = { 0, 1, 3, 4 };
+    ASSERT(check_list(&list, nomiddle, 4), "Wrong list after remove");
+
+    EQUAL(tr_ilist_remove_first(&list), &items[0].link);
+    EQUAL(tr_ilist_remove_last(&list), &items[4].link);
+
+    int inner[] = { 1, 3 };
+    ASSERT(check_list(&list, inner, 2), "Wrong list after remove_first/last");
+
+    // Removal while walking
+    tr_ilist_foreach_safe(link, next, &list) {
+        SUCCEED(tr_ilist_remove(link));
+    }
+
+    EQUAL(tr_ilist_empty(&list), true);
+    return true;
+}
+
+bool test_ilist_multiple()
+{
+    tr_ilist all, odd;
+    tr_ilist_init(&all);
+    tr_ilist_init(&odd);
+
+    item items[10];
+    for (int i = 0; i < 10; ++i) {
+        items[i].value = i;
+        SUCCEED(tr_ilist_append(&all, &items[i].link));
+
+        if (i % 2) {
+            SUCCEED(tr_ilist_prepend(&odd, &items[i].oddlink));
+        }
+    }
+
+    int oddvalues[] = { 9, 7, 5, 3, 1 };
+    int count = 0;
+    tr_ilist_foreach(link, &odd) {
+        EQUAL(tr_ilist_entry(link, item, oddlink)->value, oddvalues[count]);
+        ++count;
+    }
+
+    EQUAL(count, 5);
+
+    // Pulling an item off one list leaves it on the other
+    SUCCEED(tr_ilist_remove(&items[5].link));
+    EQUAL(tr_ilink_linked(&items[5].oddlink), true);
+
+    count = 0;
+    tr_ilist_foreach(link, &all) {
+        ASSERT(tr_ilist_entry(link, item, link)->value != 5, "Item 5 still listed");
+        ++count;
+    }
+
+    EQUAL(count, 9);
+    return true;
+}
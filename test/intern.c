@@ -0,0 +1,72 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// intern.c - String interning unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "intern.h"
+#include "test.h"
+
+bool test_intern_basics()
+{
+    tr_intern in = tr_intern_create();
+    EQUAL(tr_intern_count(in), 0);
+    EQUAL(tr_intern_find(in, "alpha"), TR_NO_ATOM);
+
+    tr_atom alpha = tr_intern_atom(in, "alpha");
+    tr_atom beta = tr_intern_atom(in, "beta");
+    EQUAL(alpha, 0);
+    EQUAL(beta, 1);
+    EQUAL(tr_intern_count(in), 2);
+
+    // Interning again returns the same atom, whatever the key's storage
+    char buf[16];
+    strcpy(buf, "alpha");
+    EQUAL(tr_intern_atom(in, buf), alpha);
+    EQUAL(tr_intern_find(in, buf), alpha);
+    EQUAL(tr_intern_count(in), 2);
+
+    // Length-bounded lookups don't need NUL-terminated input
+    EQUAL(tr_intern_find_n(in, "betamax", 4), beta);
+    EQUAL(tr_intern_find_n(in, "betamax", 5), TR_NO_ATOM);
+
+    ASSERT(strcmp(tr_intern_str(in, alpha), "alpha") == 0, "Wrong string");
+    ASSERT(strcmp(tr_intern_str(in, beta), "beta") == 0, "Wrong string");
+    EQUAL(tr_intern_str(in, 2), NULL);
+
+    SUCCEED(tr_intern_delete(in));
+    return true;
+}
+
+bool test_intern_many()
+{
+    tr_intern in = tr_intern_create();
+    char buf[32];
+
+    for (int i = 0; i < 50000; ++i) {
+        snprintf(buf, sizeof(buf), "entity-%d", i);
+        EQUAL(tr_intern_atom(in, buf), i);
+    }
+
+    // Interned strings must not move as the table grows
+    const char *first = tr_intern_str(in, 0);
+
+    for (int i = 0; i < 50000; ++i) {
+        snprintf(buf, sizeof(buf), "entity-%d", i);
+        EQUAL(tr_intern_find(in, buf), i);
+        ASSERT(strcmp(tr_intern_str(in, i), buf) == 0, "Wrong string: %d", i);
+    }
+
+    EQUAL(tr_intern_str(in, 0), first);
+
+    SUCCEED(tr_intern_delete(in));
+    return true;
+}
@@ -29,22 +29,90 @@ typedef struct _test test;
 
 static test g_tests[] = 
 {
+    { "test_memory_pools", test_memory_pools },
+    { "test_memory_arena", test_memory_arena },
+    { "test_memory_depot", test_memory_depot },
+    { "test_memory_stats", test_memory_stats },
+
     { "test_vector_basics", test_vector_basics },
     { "test_vector_enum", test_vector_enum },
     { "test_vector_stackfuncs", test_vector_stackfuncs },
     { "test_vector_growshrink", test_vector_growshrink },
+    { "test_vector_bulk", test_vector_bulk },
+    { "test_vector_reserve", test_vector_reserve },
 
     { "test_list_basics", test_list_basics },
     { "test_list_enum", test_list_enum },
     { "test_list_addremove", test_list_addremove },
 
+    { "test_ilist_basics", test_ilist_basics },
+    { "test_ilist_multiple", test_ilist_multiple },
+
     { "test_hash_basics", test_hash_basics },
     { "test_hash_enum", test_hash_enum },
     { "test_inthash_hashfunc", test_inthash_hashfunc },
     { "test_strhash_hashfunc", test_strhash_hashfunc },
+    { "test_hash_growshrink", test_hash_growshrink },
+    { "test_strhash_basics", test_strhash_basics },
+    { "test_hash_incremental", test_hash_incremental },
+    { "test_hash_cursor", test_hash_cursor },
+    { "test_hash64_hashfuncs", test_hash64_hashfuncs },
+    { "test_hash_seeded", test_hash_seeded },
+    { "test_hash_reserve", test_hash_reserve },
+
+    { "test_typed_hash", test_typed_hash },
+    { "test_typed_vec", test_typed_vec },
+
+    { "test_chash_basics", test_chash_basics },
+    { "test_chash_concurrent", test_chash_concurrent },
+    { "test_chash_update", test_chash_update },
+    { "test_ring_basics", test_ring_basics },
+    { "test_ring_spsc_stress", test_ring_spsc_stress },
+    { "test_ring_mpsc_stress", test_ring_mpsc_stress },
+    { "test_wheel_basics", test_wheel_basics },
+    { "test_wheel_cascade", test_wheel_cascade },
+    { "test_wheel_expire", test_wheel_expire },
+    { "test_wheel_endoftime", test_wheel_endoftime },
+    { "test_wheel_wallclock", test_wheel_wallclock },
 
     { "test_set_basics", test_set_basics },
     { "test_set_enum", test_set_enum },
+    { "test_set_cursor", test_set_cursor },
+    { "test_intset_dense", test_intset_dense },
+    { "test_strset_basics", test_strset_basics },
+
+    { "test_intern_basics", test_intern_basics },
+    { "test_intern_many", test_intern_many },
+
+    { "test_slotmap_basics", test_slotmap_basics },
+    { "test_slotmap_many", test_slotmap_many },
+
+    { "test_network_nodes", test_network_nodes },
+    { "test_network_ifaces", test_network_ifaces },
+    { "test_network_bind", test_network_bind },
+    { "test_network_links", test_network_links },
+    { "test_network_bulk", test_network_bulk },
+    { "test_network_handles", test_network_handles },
+
+    { "test_gen_regular", test_gen_regular },
+    { "test_gen_random", test_gen_random },
+    { "test_gen_options", test_gen_options },
+
+    { "test_route_basics", test_route_basics },
+    { "test_route_flaps", test_route_flaps },
+    { "test_route_carry", test_route_carry },
+    { "test_route_cache", test_route_cache },
+    { "test_part_balance", test_part_balance },
+    { "test_part_traffic", test_part_traffic },
+    { "test_part_runtime", test_part_runtime },
+    { "test_part_carry", test_part_carry },
+    { "test_conf_parse", test_conf_parse },
+    { "test_conf_errors", test_conf_errors },
+    { "test_conf_file", test_conf_file },
+    { "test_conf_write", test_conf_write },
+    { "test_conf_compile", test_conf_compile },
+    { "test_conf_reload", test_conf_reload },
+    { "test_conf_reload_concurrent", test_conf_reload_concurrent },
 };
 
 
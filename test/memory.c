@@ -0,0 +1,290 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// memory.c - Memory allocator unit tests
+//
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "test.h"
+
+// Checks that a block holds the byte pattern written by fill()
+//
+static bool check(const unsigned char *mem, unsigned int size, unsigned char seed)
+{
+    for (unsigned int i = 0; i < size; ++i) {
+        if (mem[i] != (unsigned char)(seed + i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void fill(unsigned char *mem, unsigned int size, unsigned char seed)
+{
+    for (unsigned int i = 0; i < size; ++i) {
+        mem[i] = (unsigned char)(seed + i);
+    }
+}
+
+bool test_memory_pools()
+{
+    // Sizes on either side of each size class boundary, plus large ones
+    static const unsigned int sizes[] = {
+        0, 1, 15, 16, 17, 100, 128, 129, 200, 256, 257, 500, 512, 513, 4096, 100000
+    };
+    static const int numsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    unsigned char *blocks[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (int i = 0; i < numsizes; ++i) {
+        blocks[i] = (unsigned char *)tr_malloc(sizes[i]);
+        ASSERT(blocks[i], "tr_malloc(%u) failed", sizes[i]);
+        ASSERT(((uintptr_t)blocks[i] & 15) == 0, "Block isn't 16-byte aligned");
+        fill(blocks[i], sizes[i], (unsigned char)i);
+    }
+
+    // Neighbouring blocks mustn't have overwritten each other
+    for (int i = 0; i < numsizes; ++i) {
+        ASSERT(check(blocks[i], sizes[i], (unsigned char)i), "Block %d clobbered", i);
+    }
+
+    // Growing and shrinking keeps the common prefix, across size classes
+    // and between pooled and large blocks
+    for (int i = 0; i < numsizes; ++i) {
+        unsigned int bigger = sizes[i] * 3 + 7;
+        blocks[i] = (unsigned char *)tr_realloc(blocks[i], bigger);
+        ASSERT(check(blocks[i], sizes[i], (unsigned char)i), "Grow lost data");
+
+        unsigned int smaller = sizes[i] / 2;
+        blocks[i] = (unsigned char *)tr_realloc(blocks[i], smaller);
+        ASSERT(check(blocks[i], smaller, (unsigned char)i), "Shrink lost data");
+    }
+
+    for (int i = 0; i < numsizes; ++i) {
+        tr_free(blocks[i]);
+    }
+
+    // Freed blocks are handed out again, and tr_calloc still zeroes them
+    for (int i = 0; i < numsizes; ++i) {
+        unsigned char *mem = (unsigned char *)tr_calloc(1, sizes[i]);
+        for (unsigned int b = 0; b < sizes[i]; ++b) {
+            ASSERT(mem[b] == 0, "tr_calloc(%u) byte %u not zeroed", sizes[i], b);
+        }
+
+        tr_free(mem);
+    }
+
+    // Lots of churn in one size class
+    void *churn[1000];
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            churn[i] = tr_malloc(48);
+            fill((unsigned char *)churn[i], 48, (unsigned char)(i + round));
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT(check((unsigned char *)churn[i], 48, (unsigned char)(i + round)),
+                   "Churned block %d clobbered", i);
+            tr_free(churn[i]);
+        }
+    }
+
+    tr_free(NULL);
+    return true;
+}
+
+bool test_memory_arena()
+{
+    tr_arena arena = tr_arena_create();
+    ASSERT(arena, "Couldn't create arena");
+
+    // Allocations are aligned and don't overlap, including oversized ones
+    unsigned char *small[256];
+    for (int i = 0; i < 256; ++i) {
+        unsigned int size = 1 + (i * 37) % 700;
+        small[i] = (unsigned char *)tr_arena_alloc(arena, size);
+        ASSERT(((uintptr_t)small[i] & 15) == 0, "Allocation isn't 16-byte aligned");
+        fill(small[i], size, (unsigned char)i);
+    }
+
+    unsigned char *big = (unsigned char *)tr_arena_alloc(arena, 1 << 20);
+    fill(big, 1 << 20, 7);
+
+    for (int i = 0; i < 256; ++i) {
+        unsigned int size = 1 + (i * 37) % 700;
+        ASSERT(check(small[i], size, (unsigned char)i), "Allocation %d clobbered", i);
+    }
+
+    ASSERT(check(big, 1 << 20, 7), "Oversized allocation clobbered");
+
+    // Freed memory is reused by the next allocation of the same size
+    void *a = tr_arena_alloc(arena, 40);
+    tr_arena_free(arena, a, 40);
+    EQUAL(tr_arena_alloc(arena, 40), a);
+
+    // Everything goes at once
+    tr_arena_delete(arena);
+
+    EQUAL(tr_arena_alloc(NULL, 16), NULL);
+    tr_arena_delete(NULL);
+    return true;
+}
+
+#if !defined(TR_SYSTEM_MALLOC)
+
+// Frees blocks it allocates itself, leaving them in its pool as it exits
+//
+static void *churn_and_exit(void *arg)
+{
+    void **blocks = (void **)arg;
+
+    for (int i = 0; i < 100; ++i) {
+        blocks[i] = tr_malloc(488);
+    }
+
+    for (int i = 99; i >= 0; --i) {
+        tr_free(blocks[i]);
+    }
+
+    return NULL;
+}
+
+// Allocates one block, from a pool that starts out empty
+//
+static void *alloc_fresh(void *arg)
+{
+    *(void **)arg = tr_malloc(488);
+    return NULL;
+}
+
+#endif
+
+bool test_memory_depot()
+{
+    // Without the pools, there's nothing to leave behind
+#if !defined(TR_SYSTEM_MALLOC)
+    void *blocks[100];
+    void *fresh = NULL;
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, churn_and_exit, blocks);
+    pthread_join(thread, NULL);
+
+    // The next thread to need a block of that size takes up the first one
+    // the exited thread freed, rather than carving a new one
+    pthread_create(&thread, NULL, alloc_fresh, &fresh);
+    pthread_join(thread, NULL);
+
+    EQUAL(fresh, blocks[0]);
+    tr_free(fresh);
+#endif
+
+    return true;
+}
+
+#if !defined(TR_SYSTEM_MALLOC) && !defined(TR_NO_MEM_STATS)
+
+static void *free_elsewhere(void *mem)
+{
+    tr_free(mem);
+    return NULL;
+}
+
+#endif
+
+bool test_memory_stats()
+{
+    tr_memstats before, after;
+    (void)before;
+
+    // Only the pools know the size of what's freed
+#if !defined(TR_SYSTEM_MALLOC) && !defined(TR_NO_MEM_STATS)
+    // Nothing in the library allocates as capture yet, so counts are exact
+    SUCCEED(tr_mem_stats(TR_MEM_CAPTURE, &before));
+
+    tr_memtag tag = tr_mem_set_tag(TR_MEM_CAPTURE);
+    void *small = tr_malloc(100);
+    void *large = tr_malloc(1000);
+    tr_mem_set_tag(tag);
+
+    // Pooled blocks count their size class's size (100 bytes come from 112)
+    SUCCEED(tr_mem_stats(TR_MEM_CAPTURE, &after));
+    EQUAL(after.bytes - before.bytes, 1112);
+    EQUAL(after.allocs - before.allocs, 2);
+    EQUAL(after.frees - before.frees, 0);
+    EQUAL(after.histogram[3] - before.histogram[3], 1);     // (64, 128]
+    EQUAL(after.histogram[6] - before.histogram[6], 1);     // (512, 1024]
+    ASSERT(after.peak >= after.bytes, "Peak is below the current count");
+
+    // Resized blocks stay with the tag they were allocated with
+    large = tr_realloc(large, 2000);
+    small = tr_realloc(small, 300);
+
+    SUCCEED(tr_mem_stats(TR_MEM_CAPTURE, &after));
+    EQUAL(after.bytes - before.bytes, 2320);
+
+    // Freeing on another thread credits the bytes back
+    pthread_t thread;
+    pthread_create(&thread, NULL, free_elsewhere, large);
+    pthread_join(thread, NULL);
+    tr_free(small);
+
+    SUCCEED(tr_mem_stats(TR_MEM_CAPTURE, &after));
+    EQUAL(after.bytes, before.bytes);
+    EQUAL(after.allocs - before.allocs, 3);
+    EQUAL(after.frees - before.frees, 3);
+
+    // Peaks outlive the memory
+    tr_mem_set_tag(TR_MEM_CAPTURE);
+    tr_free(tr_malloc(1 << 20));
+    tr_mem_set_tag(tag);
+
+    SUCCEED(tr_mem_stats(TR_MEM_CAPTURE, &after));
+    ASSERT(after.peak >= 1 << 19, "Peak %lld missed a 1MB allocation", after.peak);
+#endif
+
+#if !defined(TR_NO_MEM_STATS)
+    // Networks are topology, and give back what they took
+    tr_memstats topo;
+    SUCCEED(tr_mem_stats(TR_MEM_TOPOLOGY, &before));
+
+    tr_network net = tr_net_create("stats");
+    for (int i = 0; i < 100; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "n%d", i);
+        tr_node n = tr_node_create(net, name);
+
+        snprintf(name, sizeof(name), "i%d", i);
+        tr_iface_create(n, name);
+    }
+
+    SUCCEED(tr_mem_stats(TR_MEM_TOPOLOGY, &topo));
+    ASSERT(topo.bytes - before.bytes > 100 * 16, "Topology wasn't counted");
+
+    SUCCEED(tr_net_delete(net));
+    SUCCEED(tr_mem_stats(TR_MEM_TOPOLOGY, &after));
+    EQUAL(after.bytes, before.bytes);
+
+    // All tags together
+    SUCCEED(tr_mem_stats(TR_MEM_ALL, &after));
+    ASSERT(after.allocs >= topo.allocs, "Totals are less than a part");
+#endif
+
+    EQUAL(tr_mem_stats(TR_MEM_ALL, NULL), TR_EPOINTER);
+    EQUAL(tr_mem_stats(TR_MEM_NUM_TAGS, &after), TR_EOUTOFRANGE);
+    EQUAL(strcmp(tr_mem_tag_name(TR_MEM_TOPOLOGY), "topology"), 0);
+    EQUAL(tr_mem_tag_name(TR_MEM_NUM_TAGS), NULL);
+
+    return true;
+}
@@ -0,0 +1,480 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// network.c - Network modeling unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "network.h"
+#include "node.h"
+#include "iface.h"
+#include "link.h"
+#include "test.h"
+
+bool test_network_nodes()
+{
+    tr_network net = tr_net_create("test");
+    ASSERT(strcmp(tr_net_name(net), "test") == 0, "Wrong network name");
+    EQUAL(tr_net_num_nodes(net), 0);
+
+    tr_node a = tr_node_create(net, "A");
+    tr_node b = tr_node_create(net, "B");
+    ASSERT(a != NULL, "tr_node_create failed");
+    ASSERT(b != NULL, "tr_node_create failed");
+
+    EQUAL(tr_node_create(net, "A"), NULL);
+    EQUAL(tr_net_num_nodes(net), 2);
+
+    ASSERT(strcmp(tr_node_name(a), "A") == 0, "Wrong node name");
+    EQUAL(tr_node_network(a), net);
+
+    EQUAL(tr_net_has_node(net, "A"), true);
+    EQUAL(tr_net_has_node(net, "C"), false);
+    EQUAL(tr_net_node(net, "A"), a);
+    EQUAL(tr_net_node(net, "B"), b);
+    EQUAL(tr_net_node(net, "C"), NULL);
+
+    tr_node nodes[2];
+    SUCCEED(tr_net_nodes(net, nodes, 2));
+    ASSERT((nodes[0] == a && nodes[1] == b) || (nodes[0] == b && nodes[1] == a),
+           "tr_net_nodes returned the wrong nodes");
+
+    tr_node small[1];
+    EQUAL(tr_net_nodes(net, small, 1), TR_EARRAYLEN);
+
+    // Deleting a node frees up its name
+    SUCCEED(tr_node_delete(a));
+    EQUAL(tr_net_num_nodes(net), 1);
+    EQUAL(tr_net_has_node(net, "A"), false);
+
+    a = tr_node_create(net, "A");
+    ASSERT(a != NULL, "Couldn't reuse a deleted node's name");
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_network_ifaces()
+{
+    tr_network net = tr_net_create(NULL);
+    EQUAL(tr_net_name(net), NULL);
+
+    tr_node a = tr_node_create(net, "A");
+    tr_node b = tr_node_create(net, "B");
+
+    tr_iface ab = tr_iface_create(a, "AB");
+    tr_iface ba = tr_iface_create(b, "BA");
+    ASSERT(ab != NULL, "tr_iface_create failed");
+    ASSERT(ba != NULL, "tr_iface_create failed");
+
+    // IDs are unique across all entities in the network
+    EQUAL(tr_iface_create(b, "AB"), NULL);
+    EQUAL(tr_iface_create(b, "A"), NULL);
+    EQUAL(tr_node_create(net, "BA"), NULL);
+
+    EQUAL(tr_node_num_ifaces(a), 1);
+    EQUAL(tr_iface_node(ab), a);
+    ASSERT(strcmp(tr_iface_name(ab), "AB") == 0, "Wrong iface name");
+
+    EQUAL(tr_node_has_iface(a, "AB"), true);
+    EQUAL(tr_node_has_iface(a, "BA"), false);
+    EQUAL(tr_node_iface(a, "AB"), ab);
+    EQUAL(tr_node_iface(b, "AB"), NULL);
+
+    tr_iface ifaces[1];
+    SUCCEED(tr_node_ifaces(b, ifaces, 1));
+    EQUAL(ifaces[0], ba);
+
+    // Addresses are picked at bind time unless they're set
+    EQUAL(tr_iface_mac(ba), TR_ANY_MAC_ADDR);
+    EQUAL(tr_iface_ip(ba), TR_ANY_IP_ADDR);
+    EQUAL(tr_iface_subnet_mask(ba), TR_ANY_SUBNET_MASK);
+
+    SUCCEED(tr_iface_set_mac(ba, "0a:1B:2c:3D:4e:5F"));
+    SUCCEED(tr_iface_set_ip(ba, "192.168.0.10"));
+    SUCCEED(tr_iface_set_subnet_mask(ba, 16));
+    ASSERT(strcmp(tr_iface_mac(ba), "0a:1B:2c:3D:4e:5F") == 0, "Wrong MAC");
+    ASSERT(strcmp(tr_iface_ip(ba), "192.168.0.10") == 0, "Wrong IP");
+    EQUAL(tr_iface_subnet_mask(ba), 16);
+
+    EQUAL(tr_iface_set_mac(ba, "0a:1b:2c:3d:4e"), TR_EOUTOFRANGE);
+    EQUAL(tr_iface_set_mac(ba, "0a:1b:2c:3d:4e:5g"), TR_EOUTOFRANGE);
+    EQUAL(tr_iface_set_ip(ba, "192.168.0"), TR_EOUTOFRANGE);
+    EQUAL(tr_iface_set_ip(ba, "192.168.0.256"), TR_EOUTOFRANGE);
+    EQUAL(tr_iface_set_ip(ba, "1.2.3.4.5"), TR_EOUTOFRANGE);
+    EQUAL(tr_iface_set_subnet_mask(ba, 33), TR_EOUTOFRANGE);
+    ASSERT(strcmp(tr_iface_ip(ba), "192.168.0.10") == 0, "Wrong IP");
+
+    SUCCEED(tr_iface_set_ip(ba, TR_ANY_IP_ADDR));
+    EQUAL(tr_iface_ip(ba), TR_ANY_IP_ADDR);
+
+    SUCCEED(tr_iface_delete(ab));
+    EQUAL(tr_node_num_ifaces(a), 0);
+    ASSERT(tr_iface_create(b, "AB") != NULL, "Couldn't reuse iface name");
+
+    // Deleting a node deletes its interfaces and frees their names
+    SUCCEED(tr_node_delete(b));
+    ASSERT(tr_node_create(net, "BA") != NULL, "Couldn't reuse iface name");
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_network_bind()
+{
+    tr_network net = tr_net_create("bind");
+    EQUAL(tr_net_is_bound(net), false);
+
+    // Created out of order, so hash order and creation order differ
+    tr_node c = tr_node_create(net, "C");
+    tr_node a = tr_node_create(net, "A");
+    tr_node b = tr_node_create(net, "B");
+
+    tr_iface c2 = tr_iface_create(c, "C2");
+    tr_iface c1 = tr_iface_create(c, "C1");
+    tr_iface a1 = tr_iface_create(a, "A1");
+
+    SUCCEED(tr_net_bind(net));
+    EQUAL(tr_net_is_bound(net), true);
+    EQUAL(tr_node_is_bound(a), true);
+    EQUAL(tr_iface_is_bound(c1), true);
+    EQUAL(tr_net_is_simulating(net), false);
+
+    // Entities are numbered in creation order, ifaces grouped by node
+    snapshot *snap = ((network *)net)->frozen;
+    ASSERT(snap != NULL, "Binding didn't freeze the network");
+    EQUAL(snap->num_nodes, 3);
+    EQUAL(snap->num_ifaces, 3);
+    EQUAL(snap->num_links, 0);
+
+    EQUAL(snap->nodes[0], tr_node_get(c));
+    EQUAL(snap->nodes[1], tr_node_get(a));
+    EQUAL(snap->nodes[2], tr_node_get(b));
+    EQUAL(tr_node_get(a)->index, 1);
+
+    EQUAL(snap->node_ifaces[0], 0);
+    EQUAL(snap->node_ifaces[1], 2);
+    EQUAL(snap->node_ifaces[2], 3);
+    EQUAL(snap->node_ifaces[3], 3);
+
+    EQUAL(snap->ifaces[0], tr_iface_get(c2));
+    EQUAL(snap->ifaces[1], tr_iface_get(c1));
+    EQUAL(snap->ifaces[2], tr_iface_get(a1));
+    EQUAL(snap->iface_node[2], 1);
+    EQUAL(tr_iface_get(c1)->index, 1);
+    EQUAL(snap->iface_links[3], 0);
+
+    // The topology is frozen while bound
+    EQUAL(tr_node_create(net, "D"), NULL);
+    EQUAL(tr_iface_create(b, "B1"), NULL);
+    EQUAL(tr_iface_delete(a1), TR_ENETBOUND);
+    EQUAL(tr_node_delete(b), TR_ENETBOUND);
+
+    // Binding again is harmless
+    SUCCEED(tr_net_bind(net));
+    EQUAL(((network *)net)->frozen, snap);
+
+    // Can't unbind (or delete) a running simulation
+    SUCCEED(tr_net_start(net));
+    EQUAL(tr_net_is_simulating(net), true);
+    EQUAL(tr_net_unbind(net), TR_ENETINUSE);
+    EQUAL(tr_net_delete(net), TR_ENETINUSE);
+
+    SUCCEED(tr_net_stop(net));
+    SUCCEED(tr_net_unbind(net));
+    EQUAL(tr_net_is_bound(net), false);
+    EQUAL(tr_iface_is_bound(c1), false);
+
+    // Once unbound, changes show up in the next snapshot
+    SUCCEED(tr_node_delete(c));
+    ASSERT(tr_iface_create(b, "B1") != NULL, "Couldn't add iface after unbind");
+
+    SUCCEED(tr_net_start(net));
+    EQUAL(tr_net_is_bound(net), true);
+
+    snap = ((network *)net)->frozen;
+    EQUAL(snap->num_nodes, 2);
+    EQUAL(snap->num_ifaces, 2);
+    EQUAL(snap->nodes[0], tr_node_get(a));
+    EQUAL(snap->node_ifaces[2], 2);
+
+    // Deleting a bound network unbinds it
+    SUCCEED(tr_net_stop(net));
+    SUCCEED(tr_net_delete(net));
+
+    EQUAL(tr_net_bind(NULL), TR_EPOINTER);
+    EQUAL(tr_net_is_bound(NULL), false);
+    return true;
+}
+
+bool test_network_links()
+{
+    tr_network net = tr_net_create("links");
+    tr_node a = tr_node_create(net, "A");
+    tr_node b = tr_node_create(net, "B");
+    tr_node hub = tr_node_create(net, "hub");
+
+    tr_iface a1 = tr_iface_create(a, "A1");
+    tr_iface b1 = tr_iface_create(b, "B1");
+
+    tr_link ab;
+    SUCCEED(tr_net_link(net, a1, b1, &ab));
+    ASSERT(ab != NULL, "tr_net_link didn't return the link");
+    EQUAL(tr_link_endpoint(ab, 0), a1);
+    EQUAL(tr_link_endpoint(ab, 1), b1);
+    EQUAL(tr_link_endpoint(ab, 2), NULL);
+
+    // Links go both ways, and can only be made once
+    EQUAL(tr_iface_link(a1, b1), ab);
+    EQUAL(tr_iface_link(b1, a1), ab);
+    EQUAL(tr_iface_has_link(b1, a1), true);
+    EQUAL(tr_net_link(net, b1, a1, NULL), TR_ELINKED);
+    EQUAL(tr_net_link(net, a1, a1, NULL), TR_EPOINTER);
+
+    // Defaults, and attributes
+    EQUAL(tr_link_latency(ab), 0);
+    EQUAL(tr_link_is_enabled(ab), true);
+    SUCCEED(tr_link_set_latency(ab, 150));
+    SUCCEED(tr_link_set_variance(ab, 75));
+    SUCCEED(tr_link_set_droprate(ab, 0.25f));
+    EQUAL(tr_link_set_droprate(ab, 1.5f), TR_EOUTOFRANGE);
+    EQUAL(tr_link_set_latency(ab, -1), TR_EOUTOFRANGE);
+    EQUAL(tr_link_latency(ab), 150);
+    EQUAL(tr_link_variance(ab), 75);
+    EQUAL(tr_link_droprate(ab) == 0.25f, true);
+
+    // A hub with many ports, each linked to a port on A
+    enum { PORTS = 1000 };
+    tr_iface ports[PORTS], peers[PORTS];
+    for (int i = 0; i < PORTS; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "hub%d", i);
+        ports[i] = tr_iface_create(hub, name);
+
+        snprintf(name, sizeof(name), "A-hub%d", i);
+        peers[i] = tr_iface_create(a, name);
+
+        SUCCEED(tr_net_link(net, ports[i], peers[i], NULL));
+    }
+
+    // And one port shared with every other (a dense mesh)
+    for (int i = 1; i < PORTS; ++i) {
+        SUCCEED(tr_net_link(net, ports[0], ports[i], NULL));
+    }
+
+    EQUAL(tr_iface_num_links(ports[0]), PORTS);
+    EQUAL(tr_iface_num_links(ports[7]), 2);
+    EQUAL(tr_iface_has_link(ports[7], ports[0]), true);
+    EQUAL(tr_iface_has_link(ports[7], ports[8]), false);
+
+    tr_link found[PORTS];
+    EQUAL(tr_iface_links(ports[0], found, PORTS - 1), TR_EARRAYLEN);
+    SUCCEED(tr_iface_links(ports[0], found, PORTS));
+    for (int i = 1; i < PORTS; ++i) {
+        EQUAL(found[i], tr_iface_link(ports[0], ports[i]));
+    }
+
+    // Deleting links and interfaces keeps the rest intact
+    SUCCEED(tr_link_delete(tr_iface_link(ports[0], ports[500])));
+    EQUAL(tr_iface_has_link(ports[500], ports[0]), false);
+    EQUAL(tr_iface_num_links(ports[0]), PORTS - 1);
+    EQUAL(tr_iface_num_links(ports[500]), 1);
+
+    SUCCEED(tr_iface_delete(ports[3]));
+    EQUAL(tr_iface_num_links(ports[0]), PORTS - 2);
+    EQUAL(tr_iface_num_links(peers[3]), 0);
+
+    for (int i = 1; i < PORTS; ++i) {
+        if (i == 3) continue;
+        EQUAL(tr_iface_has_link(ports[0], ports[i]), i != 500);
+        EQUAL(tr_iface_has_link(ports[i], peers[i]), true);
+    }
+
+    // Bound networks carry links in their snapshots, and keep taking
+    // attribute changes (but not new links)
+    SUCCEED(tr_net_bind(net));
+    snapshot *snap = ((network *)net)->frozen;
+    EQUAL(snap->num_links, 1 + (PORTS - 1) + (PORTS - 3));
+
+    unsigned int l = tr_link_get(ab)->index;
+    EQUAL(snap->latency[l], 150);
+    EQUAL(snap->link_ends[2 * l], tr_iface_get(a1)->index);
+    EQUAL(snap->link_ends[2 * l + 1], tr_iface_get(b1)->index);
+
+    unsigned int hubport = tr_iface_get(ports[0])->index;
+    EQUAL(snap->iface_links[hubport + 1] - snap->iface_links[hubport], PORTS - 2);
+
+    unsigned int adj = snap->iface_links[tr_iface_get(a1)->index];
+    EQUAL(snap->adj_link[adj], l);
+    EQUAL(snap->adj_peer[adj], tr_iface_get(b1)->index);
+
+    SUCCEED(tr_link_disable(ab));
+    EQUAL(snap->enabled[l], 0);
+    EQUAL(tr_net_link(net, a1, ports[1], NULL), TR_ENETBOUND);
+    EQUAL(tr_link_delete(ab), TR_ENETBOUND);
+
+    SUCCEED(tr_net_unbind(net));
+
+    // Deleting a node takes its interfaces' links with it
+    SUCCEED(tr_node_delete(b));
+    EQUAL(tr_iface_num_links(a1), 0);
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_network_bulk()
+{
+    tr_network net = tr_net_create("bulk");
+    SUCCEED(tr_net_reserve(net, 100, 400, 100));
+
+    tr_node routers[100];
+    SUCCEED(tr_node_create_seq(net, "r", 0, 100, routers));
+    EQUAL(tr_net_num_nodes(net), 100);
+    EQUAL(tr_net_node(net, "r42"), routers[42]);
+    ASSERT(strcmp(tr_node_name(routers[7]), "r7") == 0, "Wrong node name");
+
+    tr_iface ports[100][4];
+    SUCCEED(tr_iface_create_seq(routers, 100, "-eth", 0, 4, &ports[0][0]));
+
+    EQUAL(tr_node_num_ifaces(routers[3]), 4);
+    EQUAL(tr_node_iface(routers[3], "r3-eth2"), ports[3][2]);
+    ASSERT(strcmp(tr_iface_name(ports[99][3]), "r99-eth3") == 0, "Wrong iface name");
+
+    // Batches that name something twice, or take a name that's in use,
+    // create nothing
+    const char *dup[] = { "h0", "h1", "h0" };
+    const char *taken[] = { "h0", "r5" };
+    const char *null[] = { "h0", NULL };
+    EQUAL(tr_node_create_many(net, dup, 3, NULL), TR_ENAMETAKEN);
+    EQUAL(tr_node_create_many(net, taken, 2, NULL), TR_ENAMETAKEN);
+    EQUAL(tr_node_create_many(net, null, 2, NULL), TR_EPOINTER);
+    EQUAL(tr_iface_create_seq(routers, 1, "-eth", 3, 2, NULL), TR_ENAMETAKEN);
+    EQUAL(tr_net_num_nodes(net), 100);
+    EQUAL(tr_node_num_ifaces(routers[0]), 4);
+
+    // Nodes in a batch have to share a network
+    tr_network other = tr_net_create("other");
+    tr_node mixed[] = { routers[0], tr_node_create(other, "o") };
+    EQUAL(tr_iface_create_seq(mixed, 2, "-lo", 0, 1, NULL), TR_ENOTFOUND);
+    SUCCEED(tr_net_delete(other));
+
+    tr_node hosts[2];
+    const char *names[] = { "h0", "h1" };
+    SUCCEED(tr_node_create_many(net, names, 2, hosts));
+    EQUAL(tr_net_node(net, "h1"), hosts[1]);
+
+    const char *nics[] = { "h0-nic" };
+    tr_iface nic;
+    SUCCEED(tr_iface_create_many(hosts[0], nics, 1, &nic));
+    EQUAL(tr_iface_node(nic), hosts[0]);
+
+    // A ring of routers, each eth0 linked to the next one's eth1
+    tr_iface ends[200];
+    tr_link ring[100];
+    for (int i = 0; i < 100; ++i) {
+        ends[2 * i] = ports[i][0];
+        ends[2 * i + 1] = ports[(i + 1) % 100][1];
+    }
+
+    SUCCEED(tr_net_link_many(net, ends, 100, ring));
+    EQUAL(tr_iface_link(ports[99][0], ports[0][1]), ring[99]);
+    EQUAL(tr_iface_num_links(ports[50][0]), 1);
+
+    // A batch that repeats a pair, or relinks one, is undone entirely
+    tr_iface again[] = { nic, ports[0][2], ports[1][2], ports[2][2], nic, ports[0][2] };
+    EQUAL(tr_net_link_many(net, again, 3, NULL), TR_ELINKED);
+    EQUAL(tr_net_link_many(net, ends + 10, 1, NULL), TR_ELINKED);
+    EQUAL(tr_iface_num_links(nic), 0);
+    EQUAL(tr_iface_has_link(ports[1][2], ports[2][2]), false);
+
+    SUCCEED(tr_net_bind(net));
+    EQUAL(((network *)net)->frozen->num_links, 100);
+    EQUAL(tr_node_create_seq(net, "x", 0, 1, NULL), TR_ENETBOUND);
+    EQUAL(tr_iface_create_seq(routers, 1, "-eth", 4, 1, NULL), TR_ENETBOUND);
+    EQUAL(tr_net_link_many(net, again, 1, NULL), TR_ENETBOUND);
+    EQUAL(tr_net_reserve(net, 1, 1, 1), TR_ENETBOUND);
+    SUCCEED(tr_net_unbind(net));
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_network_handles()
+{
+    tr_network net = tr_net_create("handles");
+    tr_node a = tr_node_create(net, "A");
+    tr_node b = tr_node_create(net, "B");
+    tr_iface a1 = tr_iface_create(a, "A1");
+    tr_iface b1 = tr_iface_create(b, "B1");
+
+    tr_link ab;
+    SUCCEED(tr_net_link(net, a1, b1, &ab));
+
+    // Handles survive the tables behind them growing
+    tr_node *many = (tr_node *)malloc(5000 * sizeof(tr_node));
+    SUCCEED(tr_node_create_seq(net, "n", 0, 5000, many));
+    EQUAL(tr_net_node(net, "A"), a);
+    EQUAL(tr_node_iface(a, "A1"), a1);
+    EQUAL(tr_iface_link(a1, b1), ab);
+    EQUAL(tr_link_endpoint(ab, 1), b1);
+
+    // Deleting a link makes its handle stale
+    SUCCEED(tr_link_delete(ab));
+    EQUAL(tr_link_delete(ab), TR_ESTALE);
+    EQUAL(tr_link_set_latency(ab, 10), TR_ESTALE);
+    EQUAL(tr_link_endpoint(ab, 0), NULL);
+    EQUAL(tr_link_is_enabled(ab), false);
+
+    // ... even once a new link reuses its slot
+    tr_link again;
+    SUCCEED(tr_net_link(net, a1, b1, &again));
+    ASSERT(again != ab, "A new link got a deleted link's handle");
+    EQUAL(tr_link_latency(ab), 0);
+    EQUAL(tr_link_disable(ab), TR_ESTALE);
+    EQUAL(tr_iface_link(a1, b1), again);
+
+    // Deleting a node makes its handle and its interfaces' handles stale,
+    // and the interfaces' links go with them
+    SUCCEED(tr_node_delete(a));
+    EQUAL(tr_node_name(a), NULL);
+    EQUAL(tr_node_num_ifaces(a), 0);
+    EQUAL(tr_node_delete(a), TR_ESTALE);
+    EQUAL(tr_iface_node(a1), NULL);
+    EQUAL(tr_iface_delete(a1), TR_ESTALE);
+    EQUAL(tr_link_delete(again), TR_ESTALE);
+    EQUAL(tr_iface_create(a, "A2"), NULL);
+    EQUAL(tr_net_link(net, a1, b1, NULL), TR_ESTALE);
+    EQUAL(tr_iface_num_links(b1), 0);
+
+    tr_node c = tr_node_create(net, "A");
+    ASSERT(c != a, "A new node got a deleted node's handle");
+    EQUAL(tr_node_name(a), NULL);
+    ASSERT(strcmp(tr_node_name(c), "A") == 0, "Wrong node name");
+
+    // Deleting the network makes everything in it stale, even once another
+    // network takes its place
+    SUCCEED(tr_net_delete(net));
+    EQUAL(tr_node_name(b), NULL);
+    EQUAL(tr_iface_name(b1), NULL);
+
+    for (int k = 0; k < 2000; ++k) {
+        tr_network other = tr_net_create("other");
+        tr_node x = tr_node_create(other, "B");
+        ASSERT(x != b && x != c, "A new network reused a handle");
+        EQUAL(tr_node_name(b), NULL);
+        EQUAL(tr_node_name(many[0]), NULL);
+        EQUAL(tr_node_delete(c), TR_ESTALE);
+        SUCCEED(tr_net_delete(other));
+    }
+
+    free(many);
+    return true;
+}
@@ -0,0 +1,186 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// part.c - Thread placement unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+
+#include "network.h"
+#include "part.h"
+#include "snapshot.h"
+#include "test.h"
+
+bool test_part_balance()
+{
+    static const unsigned dims[2] = { 16, 16 };
+
+    tr_network net = tr_net_create("torus");
+    SUCCEED(tr_gen_torus(net, dims, 2, NULL));
+
+    tr_partinfo info;
+    SUCCEED(tr_net_partition(net, 4, 0.03f, &info));
+    EQUAL(info.parts, 4);
+    EQUAL(info.traffic, 512);
+    ASSERT(info.largest <= 66, "largest part has %u nodes", info.largest);
+    ASSERT(info.smallest >= 60, "smallest part has %u nodes", info.smallest);
+    ASSERT(info.imbalance <= 0.04, "imbalance is %f", info.imbalance);
+    ASSERT(info.levels > 1, "took %u levels", info.levels);
+
+    // Four quadrants cut 64 links; splitting at random would cut about 384
+    ASSERT(info.cutlinks <= 96, "cut %u links", info.cutlinks);
+    EQUAL(info.cut, info.cutlinks);
+
+    // Every node is placed, and the sizes add up
+    unsigned int n = tr_net_num_nodes(net);
+    tr_node *nodes = (tr_node *)malloc(n * sizeof(tr_node));
+    SUCCEED(tr_net_nodes(net, nodes, n));
+
+    unsigned int sizes[4] = { 0 };
+    for (unsigned int i = 0; i < n; ++i) {
+        int p = tr_node_part(nodes[i]);
+        ASSERT(p >= 0 && p < 4, "node %u is in part %d", i, p);
+        ++sizes[p];
+    }
+
+    for (unsigned int p = 0; p < 4; ++p) {
+        ASSERT(sizes[p] >= info.smallest && sizes[p] <= info.largest,
+               "part %u has %u nodes", p, sizes[p]);
+    }
+
+    tr_partinfo again;
+    SUCCEED(tr_net_placement(net, &again));
+    EQUAL(again.cutlinks, info.cutlinks);
+
+    // A part per node is as even as it gets
+    SUCCEED(tr_net_partition(net, n, 0, &info));
+    EQUAL(info.largest, 1);
+    EQUAL(info.smallest, 1);
+    EQUAL(info.cutlinks, 512);
+
+    free(nodes);
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_part_traffic()
+{
+    tr_network net = tr_net_create("ring");
+    SUCCEED(tr_gen_ring(net, 64, NULL));
+
+    // Every other link around the ring is busy, so a good split only ever
+    // cuts the quiet ones
+    tr_node r0 = tr_net_node(net, "r0");
+    tr_iface i = tr_node_iface(r0, "r0-0");
+    for (unsigned int k = 0; k < 64; ++k) {
+        tr_link l;
+        SUCCEED(tr_iface_links(i, &l, 1));
+        EQUAL(tr_link_traffic(l), 1);
+
+        if (k % 2 == 0) {
+            SUCCEED(tr_link_set_traffic(l, 1000));
+            EQUAL(tr_link_traffic(l), 1000);
+        }
+
+        // Step to the next node's outward interface
+        tr_iface far = tr_link_endpoint(l, 0) == i ? tr_link_endpoint(l, 1)
+                                                   : tr_link_endpoint(l, 0);
+        tr_node next = tr_iface_node(far);
+        tr_iface both[2];
+        SUCCEED(tr_node_ifaces(next, both, 2));
+        i = both[0] == far ? both[1] : both[0];
+    }
+
+    tr_partinfo info;
+    SUCCEED(tr_net_partition(net, 4, 0.03f, &info));
+    EQUAL(info.traffic, 32 * 1000 + 32);
+    EQUAL(info.cutlinks, 4);
+    EQUAL(info.cut, 4);
+    EQUAL(info.largest, 16);
+
+    // Traffic can be changed while bound, and counts from the next split
+    tr_link l;
+    SUCCEED(tr_iface_links(tr_node_iface(r0, "r0-0"), &l, 1));
+    SUCCEED(tr_link_set_traffic(l, 0));
+    SUCCEED(tr_net_partition(net, 2, 0.03f, &info));
+    EQUAL(info.traffic, 31 * 1000 + 32);
+
+    EQUAL(tr_link_set_traffic(NULL, 1), TR_EPOINTER);
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_part_runtime()
+{
+    tr_network net = tr_net_create("ring");
+    SUCCEED(tr_gen_ring(net, 5, NULL));
+    tr_node r0 = tr_net_node(net, "r0");
+
+    tr_partinfo info;
+    EQUAL(tr_net_placement(net, &info), TR_ENOTFOUND);
+    EQUAL(tr_node_part(r0), -1);
+
+    EQUAL(tr_net_partition(net, 0, 0.03f, NULL), TR_EOUTOFRANGE);
+    EQUAL(tr_net_partition(net, 6, 0.03f, NULL), TR_EOUTOFRANGE);
+    EQUAL(tr_net_partition(net, 2, -1, NULL), TR_EOUTOFRANGE);
+    EQUAL(tr_net_partition(NULL, 2, 0.03f, NULL), TR_EPOINTER);
+    EQUAL(tr_net_is_bound(net), false);
+
+    // Starting places the nodes if nobody else has
+    SUCCEED(tr_net_start(net));
+    SUCCEED(tr_net_placement(net, &info));
+    ASSERT(info.parts >= 1 && info.parts <= 5, "made %u parts", info.parts);
+    ASSERT(tr_node_part(r0) >= 0, "r0 is in part %d", tr_node_part(r0));
+    SUCCEED(tr_net_stop(net));
+
+    // ... and leaves an earlier placement alone
+    SUCCEED(tr_net_partition(net, 5, 0, NULL));
+    SUCCEED(tr_net_start(net));
+    SUCCEED(tr_net_placement(net, &info));
+    EQUAL(info.parts, 5);
+    SUCCEED(tr_net_stop(net));
+
+    // The placement goes away with the binding
+    SUCCEED(tr_net_unbind(net));
+    EQUAL(tr_net_placement(net, &info), TR_ENOTFOUND);
+    EQUAL(tr_node_part(r0), -1);
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_part_carry()
+{
+    // Every node is linked to every other, so each new node is drawn to
+    // whichever part has the most nodes so far
+    tr_network net = tr_net_create("mesh");
+    SUCCEED(tr_gen_erdos_renyi(net, 12, 1, NULL));
+    SUCCEED(tr_net_bind(net));
+
+    snapshot *snap = ((network *)net)->frozen;
+    placement old = { NULL, 2, NULL, 0 };
+    unsigned int prev[12];
+    for (unsigned int v = 0; v < 12; ++v) {
+        prev[v] = v < 4 ? 0 : TR_NO_PART;
+    }
+
+    // Half of 12, plus the one node parts may always go over by
+    placement *p = tr_part_carry(snap, &old, prev);
+    ASSERT(p != NULL, "tr_part_carry failed!");
+    EQUAL(p->parts, 2);
+    EQUAL(p->info.largest, 7);
+    EQUAL(p->info.smallest, 5);
+
+    for (unsigned int v = 0; v < 4; ++v) {
+        EQUAL(p->part[v], 0);
+    }
+
+    tr_part_delete(p);
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
@@ -0,0 +1,221 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// ring.c - Ring buffer unit tests
+//
+
+#define _POSIX_C_SOURCE 200112L // for sched_yield
+
+#include <traffic.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ring.h"
+#include "test.h"
+
+#define NUM_PRODUCERS 4
+
+bool test_ring_basics()
+{
+    EQUAL(tr_ring_create_spsc(0, 8), NULL);
+    EQUAL(tr_ring_create_spsc(sizeof(int), 0), NULL);
+
+    // Capacity rounds up to a power of two
+    tr_ring ring = tr_ring_create_spsc(sizeof(int), 5);
+    ASSERT(ring != NULL, "tr_ring_create_spsc failed!");
+    EQUAL(tr_ring_capacity(ring), 8);
+    EQUAL(tr_ring_size(ring), 0);
+
+    int value = 0;
+    EQUAL(tr_ring_pop(ring, &value), TR_EEMPTY);
+    EQUAL(tr_ring_wait(ring, 0), TR_EEMPTY);
+
+    for (int i = 0; i < 8; ++i) {
+        SUCCEED(tr_ring_push(ring, &i));
+    }
+
+    EQUAL(tr_ring_size(ring), 8);
+    EQUAL(tr_ring_push(ring, &value), TR_EFULL);
+    SUCCEED(tr_ring_wait(ring, -1));
+
+    for (int i = 0; i < 5; ++i) {
+        SUCCEED(tr_ring_pop(ring, &value));
+        EQUAL(value, i);
+    }
+
+    // Batches wrap around the end of the array, and stop when full
+    int items[8] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+    EQUAL(tr_ring_push_n(ring, items, 8), 5);
+    EQUAL(tr_ring_size(ring), 8);
+    EQUAL(tr_ring_push_n(ring, items, 8), 0);
+
+    int out[16];
+    EQUAL(tr_ring_pop_n(ring, out, 16), 8);
+    EQUAL(out[0], 5);
+    EQUAL(out[2], 7);
+    EQUAL(out[3], 10);
+    EQUAL(out[7], 14);
+    EQUAL(tr_ring_pop_n(ring, out, 16), 0);
+
+    // Arming an empty ring leaves it armed until a push
+    ASSERT(tr_ring_fd(ring) >= 0, "tr_ring_fd failed!");
+    EQUAL(tr_ring_arm(ring), true);
+    SUCCEED(tr_ring_push(ring, &value));
+    EQUAL(tr_ring_arm(ring), false);
+    tr_ring_disarm(ring);
+
+    SUCCEED(tr_ring_delete(ring));
+
+    // Multi-producer rings behave the same from one thread
+    ring = tr_ring_create_mpsc(sizeof(int), 4);
+    ASSERT(ring != NULL, "tr_ring_create_mpsc failed!");
+
+    for (int round = 0; round < 3; ++round) {
+        EQUAL(tr_ring_push_n(ring, items, 3), 3);
+        EQUAL(tr_ring_push_n(ring, items + 3, 3), 1);
+        EQUAL(tr_ring_push(ring, &value), TR_EFULL);
+
+        EQUAL(tr_ring_pop_n(ring, out, 2), 2);
+        EQUAL(out[1], 11);
+        EQUAL(tr_ring_pop_n(ring, out, 16), 2);
+        EQUAL(out[0], 12);
+        EQUAL(out[1], 13);
+        EQUAL(tr_ring_pop(ring, &value), TR_EEMPTY);
+    }
+
+    SUCCEED(tr_ring_delete(ring));
+    return true;
+}
+
+// An item identifying its producer, and its place in that producer's stream
+//
+struct _ringitem
+{
+    int producer;
+    int seq;
+};
+
+typedef struct _ringitem ringitem;
+
+struct _ringctx
+{
+    tr_ring ring;
+    int producer;
+    int count;
+};
+
+typedef struct _ringctx ringctx;
+
+// Producer thread: pushes its stream in batches of varying size
+//
+static void *ring_producer(void *arg)
+{
+    ringctx *ctx = (ringctx *)arg;
+    ringitem batch[37];
+    int seq = 0;
+
+    while (seq < ctx->count) {
+        int n = 1 + seq % 37;
+        if (n > ctx->count - seq) {
+            n = ctx->count - seq;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            batch[i].producer = ctx->producer;
+            batch[i].seq = seq + i;
+        }
+
+        unsigned int pushed = tr_ring_push_n(ctx->ring, batch, n);
+        if (pushed == 0) {
+            sched_yield();
+        }
+
+        seq += pushed;
+    }
+
+    return NULL;
+}
+
+// Consumes every item from nproducers producers of count items each,
+// sleeping whenever the ring runs dry. Checks each stream arrives in order.
+// Keeps draining after a bad item so the producers can still finish.
+//
+static bool ring_consume(tr_ring ring, int nproducers, int count)
+{
+    int next[NUM_PRODUCERS] = { 0 };
+    int remaining = nproducers * count;
+    bool inorder = true;
+    ringitem batch[64];
+
+    while (remaining > 0) {
+        unsigned int n = tr_ring_pop_n(ring, batch, 64);
+        if (n == 0) {
+            SUCCEED(tr_ring_wait(ring, -1));
+            continue;
+        }
+
+        for (unsigned int i = 0; i < n; ++i) {
+            int p = batch[i].producer;
+            if (p < 0 || p >= nproducers || batch[i].seq != next[p]) {
+                inorder = false;
+                continue;
+            }
+
+            next[p]++;
+        }
+
+        remaining -= n;
+    }
+
+    ASSERT(inorder, "Items arrived out of order!");
+    EQUAL(tr_ring_size(ring), 0);
+    return true;
+}
+
+bool test_ring_spsc_stress()
+{
+    tr_ring ring = tr_ring_create_spsc(sizeof(ringitem), 256);
+    ASSERT(ring != NULL, "tr_ring_create_spsc failed!");
+
+    ringctx ctx = { ring, 0, 500000 };
+    pthread_t thread;
+    EQUAL(pthread_create(&thread, NULL, ring_producer, &ctx), 0);
+
+    bool ok = ring_consume(ring, 1, ctx.count);
+    pthread_join(thread, NULL);
+    ASSERT(ok, "Consumer failed!");
+
+    SUCCEED(tr_ring_delete(ring));
+    return true;
+}
+
+bool test_ring_mpsc_stress()
+{
+    tr_ring ring = tr_ring_create_mpsc(sizeof(ringitem), 256);
+    ASSERT(ring != NULL, "tr_ring_create_mpsc failed!");
+
+    ringctx ctx[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+
+    for (int t = 0; t < NUM_PRODUCERS; ++t) {
+        ringctx c = { ring, t, 200000 };
+        ctx[t] = c;
+        EQUAL(pthread_create(&threads[t], NULL, ring_producer, &ctx[t]), 0);
+    }
+
+    bool ok = ring_consume(ring, NUM_PRODUCERS, ctx[0].count);
+
+    for (int t = 0; t < NUM_PRODUCERS; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    ASSERT(ok, "Consumer failed!");
+
+    SUCCEED(tr_ring_delete(ring));
+    return true;
+}
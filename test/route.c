@@ -0,0 +1,318 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// route.c - Psychic routing unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iface.h"
+#include "link.h"
+#include "memory.h"
+#include "network.h"
+#include "node.h"
+#include "route.h"
+#include "test.h"
+
+bool test_route_basics()
+{
+    tr_network net = tr_net_create("ring");
+    SUCCEED(tr_gen_ring(net, 6, NULL));
+
+    tr_node r0 = tr_net_node(net, "r0"), r2 = tr_net_node(net, "r2");
+    tr_node r3 = tr_net_node(net, "r3"), r4 = tr_net_node(net, "r4");
+
+    // No routes until the network is bound
+    EQUAL(tr_node_next_hop(r0, r2), NULL);
+    EQUAL(tr_node_hops(r0, r2), -1);
+
+    SUCCEED(tr_net_bind(net));
+
+    // Interfaces are made in link order, so r0-0 goes to r1 and r0-1 to r5.
+    // Ties go to whichever way the search from the destination found first.
+    EQUAL(tr_node_next_hop(r0, r2), tr_node_iface(r0, "r0-0"));
+    EQUAL(tr_node_hops(r0, r2), 2);
+    EQUAL(tr_node_next_hop(r0, r4), tr_node_iface(r0, "r0-1"));
+    EQUAL(tr_node_hops(r0, r3), 3);
+    EQUAL(tr_node_next_hop(r0, r0), NULL);
+    EQUAL(tr_node_hops(r0, r0), -1);
+
+    // Cutting r0 off from r1 sends everything the other way around
+    tr_link l;
+    SUCCEED(tr_iface_links(tr_node_iface(r0, "r0-0"), &l, 1));
+    SUCCEED(tr_link_disable(l));
+    EQUAL(tr_node_next_hop(r0, r2), tr_node_iface(r0, "r0-1"));
+    EQUAL(tr_node_hops(r0, r2), 4);
+    EQUAL(tr_node_hops(r2, r0), 4);
+
+    // ... and cutting it off from r5 too leaves it stranded
+    tr_link m;
+    SUCCEED(tr_iface_links(tr_node_iface(r0, "r0-1"), &m, 1));
+    SUCCEED(tr_link_disable(m));
+    EQUAL(tr_node_next_hop(r0, r2), NULL);
+    EQUAL(tr_node_hops(r3, r0), -1);
+
+    SUCCEED(tr_link_enable(l));
+    EQUAL(tr_node_hops(r0, r2), 2);
+    EQUAL(tr_node_hops(r4, r0), 4);
+
+    SUCCEED(tr_link_enable(m));
+    EQUAL(tr_node_hops(r4, r0), 2);
+
+    // Routes go away with the binding
+    SUCCEED(tr_net_unbind(net));
+    EQUAL(tr_node_next_hop(r0, r2), NULL);
+
+    tr_network other = tr_net_create("other");
+    tr_node stranger = tr_node_create(other, "stranger");
+    SUCCEED(tr_net_bind(net));
+    EQUAL(tr_node_next_hop(r0, stranger), NULL);
+    EQUAL(tr_net_prepare_routes(net, &stranger, 1), TR_ENOTFOUND);
+
+    SUCCEED(tr_net_delete(other));
+    SUCCEED(tr_net_unbind(net));
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+// Checks every cached tree against one built from scratch. Distances must
+// match exactly. Routes may differ where there are ties, but each must
+// leave over an enabled link toward a node one hop closer.
+//
+static bool test_route_check(routes *r, routetree *scratch, routeworker *w)
+{
+    snapshot *snap = r->snap;
+
+    for (unsigned int s = 0; s < r->numcached; ++s) {
+        routetree *tree = r->cache[s];
+        scratch->dest = tree->dest;
+        tr_routes_build(r, w, scratch);
+
+        for (unsigned int v = 0; v < snap->num_nodes; ++v) {
+            if (tree->dist[v] != scratch->dist[v]) {
+                return false;
+            }
+
+            if (v == tree->dest || tree->dist[v] == TR_NO_ROUTE) {
+                continue;
+            }
+
+            unsigned int l = tree->via[v];
+            unsigned int a = snap->iface_node[snap->link_ends[2 * l]];
+            unsigned int b = snap->iface_node[snap->link_ends[2 * l + 1]];
+            unsigned int next = a == v ? b : a;
+
+            if (!snap->enabled[l] || (a != v && b != v) ||
+                tree->dist[next] + 1 != tree->dist[v]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool test_route_flaps()
+{
+    tr_network net = tr_net_create("flaps");
+    tr_genopts opts = { 5, NULL, 0, 0, 0 };
+    SUCCEED(tr_gen_erdos_renyi(net, 300, 0.012, &opts));
+    SUCCEED(tr_net_bind(net));
+
+    network *nw = (network *)net;
+    routes *r = nw->routes;
+    snapshot *snap = nw->frozen;
+    unsigned int nn = snap->num_nodes, nl = snap->num_links;
+
+    tr_node nodes[300];
+    SUCCEED(tr_net_nodes(net, nodes, 300));
+    SUCCEED(tr_net_prepare_routes(net, nodes, 40));
+    EQUAL(r->numcached, 40);
+
+    routetree scratch;
+    routeworker w;
+    memset(&w, 0, sizeof(w));
+    scratch.dist = (unsigned int *)malloc(nn * sizeof(unsigned int));
+    scratch.via = (unsigned int *)malloc(nn * sizeof(unsigned int));
+    w.queue = (unsigned int *)malloc(nn * sizeof(unsigned int));
+
+    ASSERT(test_route_check(r, &scratch, &w), "Prepared routes are wrong");
+
+    // Flap links at random, taking down up to a third of them, and check
+    // that the repaired trees still match fresh ones
+    unsigned int seed = 1;
+    for (int k = 0; k < 600; ++k) {
+        seed = seed * 1103515245 + 12345;
+        link *l = snap->links[(seed >> 8) % nl];
+
+        tr_link handle = tr_link_handle(l);
+        if (l->attrs.enabled && (seed >> 4) % 3 != 0) {
+            SUCCEED(tr_link_disable(handle));
+        }
+        else {
+            SUCCEED(tr_link_enable(handle));
+        }
+
+        if (!test_route_check(r, &scratch, &w)) {
+            FAIL("Routes are wrong after %d link changes", k + 1);
+        }
+    }
+
+    free(w.queue);
+    free(scratch.via);
+    free(scratch.dist);
+
+    SUCCEED(tr_net_unbind(net));
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_route_carry()
+{
+    tr_network net = tr_net_create("carry");
+    tr_genopts opts = { 7, NULL, 0, 0, 0 };
+    SUCCEED(tr_gen_erdos_renyi(net, 300, 0.012, &opts));
+    SUCCEED(tr_net_bind(net));
+
+    network *nw = (network *)net;
+    snapshot *snap = nw->frozen;
+    unsigned int nl = snap->num_links;
+
+    tr_node nodes[300];
+    SUCCEED(tr_net_nodes(net, nodes, 300));
+    SUCCEED(tr_net_prepare_routes(net, nodes, 40));
+
+    // Turn a batch of links off all at once
+    link *batch[20];
+    linkattrs attrs[20];
+    for (unsigned int k = 0; k < 20; ++k) {
+        batch[k] = snap->links[(k * 37) % nl];
+        attrs[k] = batch[k]->attrs;
+        attrs[k].enabled = false;
+    }
+
+    SUCCEED(tr_link_update_many(batch, attrs, 20));
+
+    routetree scratch;
+    routeworker w;
+    memset(&w, 0, sizeof(w));
+    scratch.dist = (unsigned int *)malloc(400 * sizeof(unsigned int));
+    scratch.via = (unsigned int *)malloc(400 * sizeof(unsigned int));
+    w.queue = (unsigned int *)malloc(400 * sizeof(unsigned int));
+
+    ASSERT(test_route_check(nw->routes, &scratch, &w), "Routes are wrong after a batch of link changes");
+
+    // Change the topology behind the snapshot's back: take out links, a
+    // node that's a destination and one that isn't, turn some links back
+    // on, and add links and a node
+    tr_link removed[10];
+    for (unsigned int k = 0; k < 10; ++k) {
+        removed[k] = snap->link_handles[(k * 53 + 11) % nl];
+    }
+
+    for (unsigned int k = 0; k < 10; ++k) {
+        link *l = tr_link_get(removed[k]);
+        if (l) {
+            tr_link_remove(nw, l);
+        }
+    }
+
+    unsigned int gone[2] = {
+        tr_node_get(nodes[0])->index, tr_node_get(nodes[50])->index
+    };
+    SUCCEED(tr_node_remove(nw, tr_node_get(nodes[0])));
+    SUCCEED(tr_node_remove(nw, tr_node_get(nodes[50])));
+
+    for (unsigned int k = 0; k < 20; k += 2) {
+        link *l = tr_link_get(snap->link_handles[(k * 37) % nl]);
+        if (l) {
+            l->attrs.enabled = true;
+        }
+    }
+
+    for (unsigned int k = 1; k < 30; k += 3) {
+        link *l = NULL;
+        tr_err err = tr_link_add(nw, snap->ifaces[snap->node_ifaces[k]],
+                                 snap->ifaces[snap->node_ifaces[k + 150]], &l);
+        ASSERT(err >= 0 || err == TR_ELINKED, "Couldn't add a link");
+    }
+
+    tr_atom id = tr_net_intern(nw, "extra"), iid = tr_net_intern(nw, "extra-0");
+    tr_node extra;
+    tr_iface port;
+    SUCCEED(tr_node_make_many(nw, &id, 1, &extra));
+    node *en = tr_node_get(extra);
+    SUCCEED(tr_iface_make_many(nw, &en, 1, &iid, 1, &port));
+    link *l = NULL;
+    SUCCEED(tr_link_add(nw, tr_iface_get(port), snap->ifaces[snap->node_ifaces[100]], &l));
+
+    SUCCEED(tr_net_refreeze(nw, gone, 2));
+
+    // Every tree but the removed destination's was carried over, and they
+    // all match ones built from scratch
+    routes *r = nw->routes;
+    EQUAL(r->numcached, 39);
+    ASSERT(test_route_check(r, &scratch, &w), "Carried routes are wrong");
+    ASSERT(tr_node_hops(extra, nodes[1]) > 0, "The new node has no routes");
+
+    free(w.queue);
+    free(scratch.via);
+    free(scratch.dist);
+
+    SUCCEED(tr_net_unbind(net));
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
+
+bool test_route_cache()
+{
+    tr_network net = tr_net_create("cache");
+    SUCCEED(tr_gen_ring(net, 10, NULL));
+    SUCCEED(tr_net_set_route_cache(net, 3));
+
+    tr_memstats before, after;
+    (void)after;
+    SUCCEED(tr_mem_stats(TR_MEM_ROUTING, &before));
+    EQUAL(strcmp(tr_mem_tag_name(TR_MEM_ROUTING), "routing"), 0);
+
+    tr_node nodes[10];
+    SUCCEED(tr_net_nodes(net, nodes, 10));
+
+    // Preparing binds the network
+    EQUAL(tr_net_prepare_routes(net, nodes, 4), TR_EFULL);
+    SUCCEED(tr_net_prepare_routes(net, nodes, 3));
+    EQUAL(tr_net_is_bound(net), true);
+
+    routes *r = ((network *)net)->routes;
+    EQUAL(r->numcached, 3);
+
+    // Asking for other destinations drops the ones used least lately
+    for (int k = 0; k < 10; ++k) {
+        EQUAL(tr_node_hops(nodes[(k + 5) % 10], nodes[k]), 5);
+        ASSERT(r->numcached <= 3, "Cached %u trees", r->numcached);
+    }
+
+    SUCCEED(tr_net_set_route_cache(net, 1));
+    EQUAL(r->numcached, 1);
+    EQUAL(tr_node_hops(nodes[0], nodes[1]), 1);
+
+    // Only the pools know the size of what's freed
+#if !defined(TR_SYSTEM_MALLOC) && !defined(TR_NO_MEM_STATS)
+    SUCCEED(tr_mem_stats(TR_MEM_ROUTING, &after));
+    ASSERT(after.bytes > before.bytes, "Routes weren't accounted for");
+#endif
+
+    SUCCEED(tr_net_unbind(net));
+#if !defined(TR_SYSTEM_MALLOC) && !defined(TR_NO_MEM_STATS)
+    SUCCEED(tr_mem_stats(TR_MEM_ROUTING, &after));
+    EQUAL(after.bytes, before.bytes);
+#endif
+
+    SUCCEED(tr_net_delete(net));
+    return true;
+}
@@ -81,3 +81,147 @@ bool test_set_enum()
     tr_intset_delete(set);
     return true;
 }
+
+bool test_set_cursor()
+{
+    tr_set set = tr_intset_create();
+    for (int i = 0; i < 500; ++i) {
+        SUCCEED(tr_intset_add(set, i * 7));
+    }
+
+    for (int i = 0; i < 500; i += 2) {
+        SUCCEED(tr_intset_remove(set, i * 7));
+    }
+
+    // Only the odd multiples survive, and each is visited once
+    int count = 0;
+    int sum = 0;
+    tr_set_iter it;
+
+    tr_set_foreach(it, set) {
+        int value = *(int *)it.key;
+        ASSERT(value % 7 == 0 && (value / 7) % 2 == 1, "Bogus value %d", value);
+
+        sum += value;
+        ++count;
+    }
+
+    EQUAL(count, 250);
+    EQUAL(sum, 7 * 250 * 250);
+
+    tr_intset_delete(set);
+    return true;
+}
+
+bool test_intset_dense()
+{
+    tr_set set = tr_intset_create();
+
+    // Scattered items stay in a hashtable
+    for (int i = 0; i < 1000; ++i) {
+        SUCCEED(tr_intset_add(set, i * 1000));
+    }
+
+    EQUAL(tr_intset_dense(set), false);
+    EQUAL(tr_set_size(set), 1000);
+
+    for (int i = 0; i < 1000; ++i) {
+        SUCCEED(tr_intset_remove(set, i * 1000));
+    }
+
+    // Sequential IDs (including negative ones) become a bitmap
+    for (int i = -100; i < 10000; ++i) {
+        SUCCEED(tr_intset_add(set, i));
+    }
+
+    EQUAL(tr_intset_dense(set), true);
+    EQUAL(tr_set_size(set), 10100);
+    SUCCEED(tr_intset_add(set, 5));
+    EQUAL(tr_set_size(set), 10100);
+
+    EQUAL(tr_intset_contains(set, -101), false);
+    EQUAL(tr_intset_contains(set, -100), true);
+    EQUAL(tr_intset_contains(set, 9999), true);
+    EQUAL(tr_intset_contains(set, 10000), false);
+
+    int key = 42;
+    EQUAL(tr_set_contains(set, &key), true);
+
+    for (int i = 0; i < 10000; i += 3) {
+        SUCCEED(tr_intset_remove(set, i));
+    }
+
+    EQUAL(tr_intset_remove(set, 3), TR_ENOTFOUND);
+    EQUAL(tr_intset_dense(set), true);
+
+    long long sum = 0;
+    int count = 0;
+    tr_set_iter it;
+
+    tr_set_foreach(it, set) {
+        int value = *(int *)it.key;
+        ASSERT(value < 0 || value % 3 != 0, "Bogus value %d", value);
+
+        sum += value;
+        ++count;
+    }
+
+    EQUAL(count, 100 + 6666);
+    EQUAL(sum, -5050 + (9999LL * 10000 / 2 - 3LL * 3333 * 3334 / 2));
+
+    tr_vector items = tr_intset_items(set);
+    EQUAL(tr_vec_size(items), 6766);
+    EQUAL(*(int *)tr_vec_item(items, 0), -100);
+    tr_vec_delete(items);
+
+    // Far-off items and heavy removal turn it back into a hashtable
+    SUCCEED(tr_intset_add(set, 100000000));
+    EQUAL(tr_intset_dense(set), false);
+    EQUAL(tr_intset_contains(set, 100000000), true);
+    EQUAL(tr_intset_contains(set, 9998), true);
+    SUCCEED(tr_intset_remove(set, 100000000));
+
+    // Once the outlier's gone, enough new adds notice it's dense again
+    for (int i = 0; i < 1000; ++i) {
+        SUCCEED(tr_intset_add(set, 20000 + i));
+    }
+
+    EQUAL(tr_intset_dense(set), true);
+
+    for (int i = -100; i < 21000; ++i) {
+        if (i % 500 != 0) {
+            tr_intset_remove(set, i);
+        }
+    }
+
+    EQUAL(tr_intset_dense(set), false);
+    EQUAL(tr_set_size(set), 15);
+    EQUAL(tr_intset_contains(set, 20500), true);
+
+    SUCCEED(tr_intset_delete(set));
+    return true;
+}
+
+bool test_strset_basics()
+{
+    tr_set set = tr_strset_create();
+    const char *names[] = { "eth0", "eth1", "lo" };
+
+    for (int i = 0; i < 3; ++i) {
+        SUCCEED(tr_strset_add(set, names[i]));
+    }
+
+    EQUAL(tr_set_size(set), 3);
+    EQUAL(tr_strset_contains(set, "eth1"), true);
+    EQUAL(tr_strset_contains(set, "eth2"), false);
+
+    SUCCEED(tr_strset_remove(set, "lo"));
+    EQUAL(tr_strset_contains(set, "lo"), false);
+
+    tr_vector items = tr_strset_items(set);
+    EQUAL(tr_vec_size(items), 2);
+    tr_vec_delete(items);
+
+    SUCCEED(tr_strset_delete(set));
+    return true;
+}
@@ -0,0 +1,117 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// slotmap.c - Generational slot map unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+
+#include "memory.h"
+#include "slotmap.h"
+#include "test.h"
+
+bool test_slotmap_basics()
+{
+    tr_arena arena = tr_arena_create();
+    tr_slotmap map = tr_slotmap_create_in(arena, sizeof(int), 0);
+    EQUAL(tr_slotmap_count(map), 0);
+    EQUAL(tr_slotmap_next(map, NULL), NULL);
+
+    int *a = (int *)tr_slotmap_alloc(map);
+    int *b = (int *)tr_slotmap_alloc(map);
+    *a = 1;
+    *b = 2;
+
+    EQUAL(tr_slotmap_count(map), 2);
+    EQUAL(tr_slotmap_index(a), 0);
+    EQUAL(tr_slotmap_index(b), 1);
+    ASSERT(tr_slotmap_gen(a) & 1, "Live generations should be odd");
+
+    unsigned int ai = tr_slotmap_index(a), ag = tr_slotmap_gen(a);
+    EQUAL(tr_slotmap_get(map, ai, ag), a);
+    EQUAL(tr_slotmap_get(map, ai, ag + 2), NULL);
+    EQUAL(tr_slotmap_get(map, 2, ag), NULL);
+
+    // Freeing makes the pair stale, and it stays stale once the slot is
+    // reused
+    tr_slotmap_free(map, a);
+    EQUAL(tr_slotmap_count(map), 1);
+    EQUAL(tr_slotmap_get(map, ai, ag), NULL);
+
+    int *c = (int *)tr_slotmap_alloc(map);
+    EQUAL(c, a);
+    EQUAL(tr_slotmap_index(c), ai);
+    ASSERT(tr_slotmap_gen(c) != ag, "Reused slot kept its generation");
+    ASSERT(tr_slotmap_gen(c) & 1, "Live generations should be odd");
+    EQUAL(tr_slotmap_get(map, ai, ag), NULL);
+    EQUAL(tr_slotmap_get(map, ai, tr_slotmap_gen(c)), c);
+
+    // A later map starting where this one left off never repeats a pair
+    unsigned int next = tr_slotmap_next_gen(map);
+    ASSERT(next > tr_slotmap_gen(b) && next > tr_slotmap_gen(c),
+           "Next generation should be past every one handed out");
+
+    tr_slotmap later = tr_slotmap_create_in(arena, sizeof(int), next);
+    int *d = (int *)tr_slotmap_alloc(later);
+    EQUAL(tr_slotmap_index(d), 0);
+    EQUAL(tr_slotmap_get(later, 0, ag), NULL);
+    EQUAL(tr_slotmap_get(later, 0, tr_slotmap_gen(c)), NULL);
+    EQUAL(tr_slotmap_get(later, 0, tr_slotmap_gen(d)), d);
+
+    SUCCEED(tr_slotmap_delete(later));
+    SUCCEED(tr_slotmap_delete(map));
+    tr_arena_delete(arena);
+    return true;
+}
+
+bool test_slotmap_many()
+{
+    tr_arena arena = tr_arena_create();
+    tr_slotmap map = tr_slotmap_create_in(arena, sizeof(unsigned int), 0);
+
+    // Enough items to span many pages, none of which may move
+    static const unsigned int COUNT = 5000;
+    unsigned int **items = (unsigned int **)malloc(COUNT * sizeof(unsigned int *));
+
+    for (unsigned int k = 0; k < COUNT; ++k) {
+        items[k] = (unsigned int *)tr_slotmap_alloc(map);
+        *items[k] = k;
+    }
+
+    for (unsigned int k = 0; k < COUNT; ++k) {
+        EQUAL(*items[k], k);
+        EQUAL(tr_slotmap_get(map, k, tr_slotmap_gen(items[k])), items[k]);
+    }
+
+    // Free every third item, during a walk
+    unsigned int walked = 0;
+    tr_slotmap_foreach(unsigned int *, item, map) {
+        EQUAL(*item, walked);
+        if (walked % 3 == 1) {
+            tr_slotmap_free(map, items[walked - 1]);
+        }
+
+        ++walked;
+    }
+
+    EQUAL(walked, COUNT);
+
+    // The walk now skips the freed ones
+    walked = 0;
+    tr_slotmap_foreach(unsigned int *, item, map) {
+        ASSERT(*item % 3 != 0, "Walked a freed item");
+        ++walked;
+    }
+
+    EQUAL(walked, tr_slotmap_count(map));
+    EQUAL(walked, COUNT - (COUNT + 2) / 3);
+
+    free(items);
+    SUCCEED(tr_slotmap_delete(map));
+    tr_arena_delete(arena);
+    return true;
+}
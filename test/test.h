@@ -70,12 +70,21 @@ extern char *g_lastTestError;
 //
 
 
+// Tests for memory allocator
+//
+bool test_memory_pools();
+bool test_memory_arena();
+bool test_memory_depot();
+bool test_memory_stats();
+
 // Tests for vector utility
 //
 bool test_vector_basics();
 bool test_vector_enum();
 bool test_vector_stackfuncs();
 bool test_vector_growshrink();
+bool test_vector_bulk();
+bool test_vector_reserve();
 
 // Tests for list utility
 //
@@ -83,15 +92,104 @@ bool test_list_basics();
 bool test_list_enum();
 bool test_list_addremove();
 
+// Tests for intrusive list utility
+//
+bool test_ilist_basics();
+bool test_ilist_multiple();
+
 // Tests for hashtable utility
 //
 bool test_hash_basics();
 bool test_hash_enum();
 bool test_inthash_hashfunc();
 bool test_strhash_hashfunc();
+bool test_hash_growshrink();
+bool test_strhash_basics();
+bool test_hash_incremental();
+bool test_hash_cursor();
+bool test_hash64_hashfuncs();
+bool test_hash_seeded();
+bool test_hash_reserve();
+
+// Tests for typed container generators
+//
+bool test_typed_hash();
+bool test_typed_vec();
+
+// Tests for concurrent hashtable utility
+//
+bool test_chash_basics();
+bool test_chash_concurrent();
+bool test_chash_update();
+
+// Tests for ring buffer utility
+//
+bool test_ring_basics();
+bool test_ring_spsc_stress();
+bool test_ring_mpsc_stress();
+
+// Tests for timing wheel utility
+//
+bool test_wheel_basics();
+bool test_wheel_cascade();
+bool test_wheel_expire();
+bool test_wheel_endoftime();
+bool test_wheel_wallclock();
 
 // Tests for hash set utility
 //
 bool test_set_basics();
 bool test_set_enum();
+bool test_set_cursor();
+bool test_intset_dense();
+bool test_strset_basics();
+
+// Tests for string interning utility
+//
+bool test_intern_basics();
+bool test_intern_many();
+
+// Tests for generational slot maps
+//
+bool test_slotmap_basics();
+bool test_slotmap_many();
+
+// Tests for network modeling
+//
+bool test_network_nodes();
+bool test_network_ifaces();
+bool test_network_bind();
+bool test_network_links();
+bool test_network_bulk();
+bool test_network_handles();
+
+// Tests for topology generators
+//
+bool test_gen_regular();
+bool test_gen_random();
+bool test_gen_options();
+
+// Tests for psychic routing
+//
+bool test_route_basics();
+bool test_route_flaps();
+bool test_route_carry();
+bool test_route_cache();
+
+// Tests for thread placement
+//
+bool test_part_balance();
+bool test_part_traffic();
+bool test_part_runtime();
+bool test_part_carry();
+
+// Tests for config files
+//
+bool test_conf_parse();
+bool test_conf_errors();
+bool test_conf_file();
+bool test_conf_write();
+bool test_conf_compile();
+bool test_conf_reload();
+bool test_conf_reload_concurrent();
 
@@ -0,0 +1,196 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// typed.c - Typed container unit tests
+//
+
+#include <traffic.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "typed.h"
+#include "test.h"
+
+struct _testmac
+{
+    unsigned char bytes[6];
+};
+
+typedef struct _testmac testmac;
+
+#define testmac_hash(m, seed) tr_hash64_mac((m).bytes, (seed))
+#define testmac_equal(m1, m2) (memcmp((m1).bytes, (m2).bytes, 6) == 0)
+
+TR_HASH_DEFINE(testmachash, testmac, int, testmac_hash, testmac_equal)
+TR_HASH_DEFINE(testinthash, int, double, tr_hash64_int, tr_typed_equal)
+
+static testmac test_mac(unsigned int i)
+{
+    testmac mac = { { 0x02, 0x00, i >> 24, i >> 16, i >> 8, i } };
+    return mac;
+}
+
+#define NUM_MACS 5000
+
+bool test_typed_hash()
+{
+    tr_testmachash *macs = tr_testmachash_create();
+    ASSERT(macs != NULL, "tr_testmachash_create failed!");
+    EQUAL(tr_testmachash_num_keys(macs), 0);
+    EQUAL(tr_testmachash_get(macs, test_mac(1)), NULL);
+    EQUAL(tr_testmachash_first(macs), NULL);
+
+    for (int i = 0; i < NUM_MACS; ++i) {
+        SUCCEED(tr_testmachash_set(macs, test_mac(i), i));
+    }
+
+    EQUAL(tr_testmachash_num_keys(macs), NUM_MACS);
+
+    for (int i = 0; i < NUM_MACS; ++i) {
+        int *port = tr_testmachash_get(macs, test_mac(i));
+        ASSERT(port != NULL, "Missing MAC!");
+        EQUAL(*port, i);
+    }
+
+    EQUAL(tr_testmachash_contains(macs, test_mac(NUM_MACS)), false);
+
+    // put finds existing keys, and adds new ones
+    bool added = true;
+    int *port = tr_testmachash_put(macs, test_mac(7), &added);
+    EQUAL(added, false);
+    EQUAL(*port, 7);
+    *port = 70;
+    EQUAL(*tr_testmachash_get(macs, test_mac(7)), 70);
+
+    port = tr_testmachash_put(macs, test_mac(NUM_MACS), &added);
+    EQUAL(added, true);
+    *port = NUM_MACS;
+    EQUAL(tr_testmachash_num_keys(macs), NUM_MACS + 1);
+
+    // Clear the odd MACs, and most of the table after that, so it shrinks
+    for (int i = 1; i <= NUM_MACS; i += 2) {
+        SUCCEED(tr_testmachash_clear(macs, test_mac(i)));
+    }
+
+    EQUAL(tr_testmachash_clear(macs, test_mac(1)), TR_ENOTFOUND);
+    EQUAL(tr_testmachash_num_keys(macs), NUM_MACS / 2 + 1);
+
+    for (int i = 0; i < NUM_MACS; ++i) {
+        EQUAL(tr_testmachash_contains(macs, test_mac(i)), i % 2 == 0);
+    }
+
+    unsigned int capacity = macs->capacity;
+    for (int i = 100; i <= NUM_MACS; i += 2) {
+        SUCCEED(tr_testmachash_clear(macs, test_mac(i)));
+    }
+
+    ASSERT(macs->capacity < capacity, "Table didn't shrink!");
+
+    // Walking the table visits each item once
+    unsigned int count = 0;
+    int sum = 0;
+    tr_typed_foreach(testmachash, item, macs) {
+        count++;
+        sum += item->value;
+        EQUAL(memcmp(item->key.bytes, test_mac(item->value).bytes, 6), 0);
+    }
+
+    EQUAL(count, 50);
+    EQUAL(sum, 2450);
+
+    SUCCEED(tr_testmachash_delete(macs));
+
+    // Plain keys compare with ==, and tables rehash in place when they're
+    // mostly tombstones
+    tr_testinthash *ints = tr_testinthash_create();
+    ASSERT(ints != NULL, "tr_testinthash_create failed!");
+
+    SUCCEED(tr_testinthash_set(ints, 1, 0.5));
+    for (int i = 2; i < 10000; ++i) {
+        SUCCEED(tr_testinthash_set(ints, i, i * 0.5));
+        SUCCEED(tr_testinthash_clear(ints, i));
+    }
+
+    EQUAL(tr_testinthash_num_keys(ints), 1);
+    EQUAL(ints->capacity, 16);
+    EQUAL(*tr_testinthash_get(ints, 1) == 0.5, true);
+
+    // Reserving grows the table up front, so filling it doesn't
+    SUCCEED(tr_testinthash_reserve(ints, 1000));
+    EQUAL(ints->capacity, 2048);
+    for (int i = 2; i <= 1000; ++i) {
+        SUCCEED(tr_testinthash_set(ints, i, i * 0.5));
+    }
+
+    EQUAL(ints->capacity, 2048);
+    EQUAL(*tr_testinthash_get(ints, 1) == 0.5, true);
+    SUCCEED(tr_testinthash_reserve(ints, 10));
+    EQUAL(ints->capacity, 2048);
+
+    SUCCEED(tr_testinthash_delete(ints));
+    EQUAL(tr_testinthash_delete(NULL), TR_EPOINTER);
+
+    return true;
+}
+
+struct _testpkt
+{
+    unsigned int id;
+    unsigned short len;
+    testmac dst;
+};
+
+typedef struct _testpkt testpkt;
+
+TR_VEC_DEFINE(testpktvec, testpkt)
+
+bool test_typed_vec()
+{
+    tr_testpktvec *vec = tr_testpktvec_create(0);
+    ASSERT(vec != NULL, "tr_testpktvec_create failed!");
+    EQUAL(tr_testpktvec_size(vec), 0);
+    EQUAL(tr_testpktvec_peek(vec), NULL);
+    EQUAL(tr_testpktvec_pop(vec), TR_ESTACKEMPTY);
+    EQUAL(tr_testpktvec_first(vec), NULL);
+
+    for (unsigned int i = 0; i < 1000; ++i) {
+        testpkt pkt = { i, (unsigned short)(64 + i), test_mac(i) };
+        SUCCEED(tr_testpktvec_append(vec, pkt));
+    }
+
+    EQUAL(tr_testpktvec_size(vec), 1000);
+    ASSERT(tr_testpktvec_capacity(vec) >= 1000, "Vector didn't grow!");
+    EQUAL(tr_testpktvec_item(vec, 500)->len, 564);
+    EQUAL(tr_testpktvec_items(vec)[999].id, 999);
+    EQUAL(tr_testpktvec_peek(vec)->id, 999);
+
+    SUCCEED(tr_testpktvec_pop(vec));
+    SUCCEED(tr_testpktvec_remove_at(vec, 0));
+    EQUAL(tr_testpktvec_remove_at(vec, 998), TR_EOUTOFRANGE);
+    EQUAL(tr_testpktvec_size(vec), 998);
+
+    unsigned int expected = 1;
+    tr_typed_foreach(testpktvec, pkt, vec) {
+        EQUAL(pkt->id, expected);
+        EQUAL(pkt->dst.bytes[5], expected & 0xFF);
+        expected++;
+    }
+
+    EQUAL(expected, 999);
+
+    // Clearing keeps the memory for reuse
+    unsigned int capacity = tr_testpktvec_capacity(vec);
+    tr_testpktvec_clear(vec);
+    EQUAL(tr_testpktvec_size(vec), 0);
+    EQUAL(tr_testpktvec_capacity(vec), capacity);
+
+    SUCCEED(tr_testpktvec_reserve(vec, 5000));
+    EQUAL(tr_testpktvec_capacity(vec), 5000);
+
+    SUCCEED(tr_testpktvec_delete(vec));
+    return true;
+}
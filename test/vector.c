@@ -193,3 +193,118 @@ bool test_vector_growshrink()
     SUCCEED(tr_vec_delete(vec));
     return true;
 }
+
+bool test_vector_bulk()
+{
+    int items[100];
+    for (int i = 0; i < 100; ++i) {
+        items[i] = i;
+    }
+
+    tr_vector vec = tr_vec_create(sizeof(int), 4);
+
+    // [0, 10) ++ [90, 100), then [10, 90) into the middle
+    SUCCEED(tr_vec_append_n(vec, items, 10));
+    SUCCEED(tr_vec_append_n(vec, items + 90, 10));
+    SUCCEED(tr_vec_insert_n(vec, 10, items + 10, 80));
+    EQUAL(tr_vec_size(vec), 100);
+
+    for (int i = 0; i < 100; ++i) {
+        EQUAL(*(int*)tr_vec_item(vec, i), i);
+    }
+
+    // Cut out [20, 70)
+    SUCCEED(tr_vec_remove_range(vec, 20, 50));
+    EQUAL(tr_vec_size(vec), 50);
+
+    for (int i = 0; i < 50; ++i) {
+        EQUAL(*(int*)tr_vec_item(vec, i), i < 20 ? i : i + 50);
+    }
+
+    EQUAL(tr_vec_insert_n(vec, 51, items, 1), TR_EOUTOFRANGE);
+    EQUAL(tr_vec_remove_range(vec, 40, 11), TR_EOUTOFRANGE);
+    SUCCEED(tr_vec_append_n(vec, NULL, 0));
+    SUCCEED(tr_vec_remove_range(vec, 0, 50));
+    EQUAL(tr_vec_size(vec), 0);
+
+    SUCCEED(tr_vec_delete(vec));
+    return true;
+}
+
+bool test_vector_reserve()
+{
+    // Small vectors start out inline, and keep their items when they move
+    // out to the heap and back again
+    tr_vector vec = tr_vec_create(sizeof(int), 4);
+    EQUAL(tr_vec_capacity(vec), 4);
+
+    for (int i = 0; i < 4; ++i) {
+        SUCCEED(tr_vec_push(vec, &i));
+    }
+
+    // Filling the vector doesn't grow it; the next push does
+    EQUAL(tr_vec_capacity(vec), 4);
+
+    for (int i = 4; i < 100; ++i) {
+        SUCCEED(tr_vec_push(vec, &i));
+    }
+
+    EQUAL(tr_vec_capacity(vec), 128);
+
+    SUCCEED(tr_vec_remove_range(vec, 3, 97));
+    EQUAL(tr_vec_capacity(vec), 8);
+
+    SUCCEED(tr_vec_pop(vec));
+    EQUAL(tr_vec_capacity(vec), 4);
+
+    for (int i = 0; i < 2; ++i) {
+        EQUAL(*(int*)tr_vec_item(vec, i), i);
+    }
+
+    // Pushing and popping across a boundary doesn't thrash, since the
+    // vector never shrinks below its initial capacity
+    for (int i = 0; i < 10; ++i) {
+        SUCCEED(tr_vec_pop(vec));
+        SUCCEED(tr_vec_pop(vec));
+        EQUAL(tr_vec_capacity(vec), 4);
+
+        int value = 0;
+        SUCCEED(tr_vec_push(vec, &value));
+        value = 1;
+        SUCCEED(tr_vec_push(vec, &value));
+        SUCCEED(tr_vec_push(vec, &value));
+        SUCCEED(tr_vec_pop(vec));
+    }
+
+    // Reserved capacity is a floor for automatic shrinking...
+    SUCCEED(tr_vec_reserve(vec, 1000));
+    EQUAL(tr_vec_capacity(vec), 1000);
+
+    for (int i = 0; i < 2; ++i) {
+        EQUAL(*(int*)tr_vec_item(vec, i), i);
+    }
+
+    SUCCEED(tr_vec_pop(vec));
+    EQUAL(tr_vec_capacity(vec), 1000);
+
+    // ...until it's dropped
+    SUCCEED(tr_vec_shrink_to_fit(vec));
+    EQUAL(tr_vec_size(vec), 1);
+    EQUAL(tr_vec_capacity(vec), 4);
+    EQUAL(*(int*)tr_vec_item(vec, 0), 0);
+
+    SUCCEED(tr_vec_delete(vec));
+
+    // Big vectors fit to their size exactly
+    vec = tr_vec_create(sizeof(int), 100);
+    for (int i = 0; i < 30; ++i) {
+        SUCCEED(tr_vec_push(vec, &i));
+    }
+
+    SUCCEED(tr_vec_shrink_to_fit(vec));
+    EQUAL(tr_vec_capacity(vec), 30);
+    EQUAL(*(int*)tr_vec_item(vec, 29), 29);
+
+    SUCCEED(tr_vec_delete(vec));
+    return true;
+}
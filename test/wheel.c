@@ -0,0 +1,315 @@
+
+//
+// traffic - A Simple Network Simulator
+// Copyright (c) Dave Kilian 2014
+//
+// wheel.c - Timing wheel unit tests
+//
+
+#include <traffic.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "wheel.h"
+#include "test.h"
+
+// A timer that records when it fired
+//
+struct _testtimer
+{
+    tr_timer timer;
+    uint64_t when;          // Time it was scheduled for
+    uint64_t fired;         // Wheel time it fired at, or 0
+    int order;              // Order it fired in
+};
+
+typedef struct _testtimer testtimer;
+
+struct _firelog
+{
+    tr_wheel wheel;
+    int fired;
+    bool late;              // Whether any timer fired on the wrong tick
+};
+
+typedef struct _firelog firelog;
+
+static void wheel_record(tr_timer *timer, void *ctx)
+{
+    firelog *log = (firelog *)ctx;
+    testtimer *t = tr_ilist_entry(timer, testtimer, timer);
+
+    t->fired = tr_wheel_now(log->wheel);
+    t->order = log->fired++;
+
+    // Timers fire on the first tick at or after their time
+    uint64_t gran = tr_wheel_granularity(log->wheel);
+    if (t->fired < t->when || t->fired - t->when >= gran) {
+        log->late = true;
+    }
+}
+
+bool test_wheel_basics()
+{
+    EQUAL(tr_wheel_create(0), NULL);
+
+    tr_wheel wheel = tr_wheel_create(1000);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+    EQUAL(tr_wheel_now(wheel), 0);
+    EQUAL(tr_wheel_next(wheel), UINT64_MAX);
+
+    firelog log = { wheel, 0, false };
+    testtimer t[4];
+    for (int i = 0; i < 4; ++i) {
+        tr_timer_init(&t[i].timer, wheel_record, &log);
+        t[i].fired = 0;
+    }
+
+    EQUAL(tr_timer_scheduled(&t[0].timer), false);
+
+    t[0].when = 5000;
+    t[1].when = 2500;
+    t[2].when = 2000;
+    t[3].when = 9000;
+
+    for (int i = 0; i < 4; ++i) {
+        SUCCEED(tr_wheel_schedule(wheel, &t[i].timer, t[i].when));
+    }
+
+    EQUAL(tr_wheel_num_timers(wheel), 4);
+    EQUAL(tr_timer_scheduled(&t[0].timer), true);
+    EQUAL(tr_wheel_next(wheel), 2000);
+
+    // Cancelling works once
+    SUCCEED(tr_wheel_cancel(wheel, &t[3].timer));
+    EQUAL(tr_wheel_cancel(wheel, &t[3].timer), TR_ENOTFOUND);
+    EQUAL(tr_wheel_num_timers(wheel), 3);
+
+    // 2500 rounds up to the tick at 3000
+    EQUAL(tr_wheel_advance(wheel, 2999), 1);
+    EQUAL(t[2].fired, 2000);
+    EQUAL(t[1].fired, 0);
+    EQUAL(tr_wheel_now(wheel), 2999);
+
+    EQUAL(tr_wheel_advance(wheel, 10000), 2);
+    EQUAL(t[1].fired, 3000);
+    EQUAL(t[0].fired, 5000);
+    EQUAL(t[3].fired, 0);
+    EQUAL(t[1].order, 1);
+    EQUAL(t[0].order, 2);
+
+    // Past times fire on the next tick
+    t[3].when = 10500;
+    SUCCEED(tr_wheel_schedule_at(wheel, &t[3].timer, 10));
+    SUCCEED(tr_wheel_schedule(wheel, &t[0].timer, 100000));
+    EQUAL(tr_wheel_advance(wheel, 11000), 1);
+    EQUAL(t[3].fired, 11000);
+
+    // Rescheduling moves a timer rather than adding it twice
+    t[0].when = 11500;
+    SUCCEED(tr_wheel_schedule(wheel, &t[0].timer, 500));
+    EQUAL(tr_wheel_num_timers(wheel), 1);
+    EQUAL(tr_wheel_advance(wheel, 1000000), 1);
+    EQUAL(t[0].fired, 12000);
+
+    EQUAL(tr_wheel_num_timers(wheel), 0);
+    EQUAL(log.late, false);
+
+    // Time doesn't go backwards
+    EQUAL(tr_wheel_advance(wheel, 5), 0);
+    EQUAL(tr_wheel_now(wheel), 1000000);
+
+    SUCCEED(tr_wheel_delete(wheel));
+    return true;
+}
+
+#define NUM_TIMERS 20000
+
+bool test_wheel_cascade()
+{
+    tr_wheel wheel = tr_wheel_create(1);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+
+    firelog log = { wheel, 0, false };
+    testtimer *timers = (testtimer *)malloc(NUM_TIMERS * sizeof(testtimer));
+
+    // Due times spread across many levels of the wheel, with plenty of
+    // timers sharing ticks
+    srand(1234);
+    for (int i = 0; i < NUM_TIMERS; ++i) {
+        tr_timer_init(&timers[i].timer, wheel_record, &log);
+        timers[i].fired = 0;
+        timers[i].when = 1 + ((uint64_t)rand() << (rand() % 24)) % (1ull << 36);
+        SUCCEED(tr_wheel_schedule_at(wheel, &timers[i].timer, timers[i].when));
+    }
+
+    // Cancel every tenth timer
+    for (int i = 0; i < NUM_TIMERS; i += 10) {
+        SUCCEED(tr_wheel_cancel(wheel, &timers[i].timer));
+    }
+
+    EQUAL(tr_wheel_num_timers(wheel), NUM_TIMERS - NUM_TIMERS / 10);
+
+    // Advance in uneven steps
+    uint64_t now = 0;
+    while (tr_wheel_num_timers(wheel) > 0) {
+        now += 1 + ((uint64_t)rand() << (rand() % 20));
+        tr_wheel_advance(wheel, now);
+    }
+
+    EQUAL(log.fired, NUM_TIMERS - NUM_TIMERS / 10);
+    EQUAL(log.late, false);
+
+    // Timers fired in order of due time
+    for (int i = 0; i < NUM_TIMERS; ++i) {
+        if (i % 10 == 0) {
+            EQUAL(timers[i].fired, 0);
+            continue;
+        }
+
+        for (int j = i + 1; j < NUM_TIMERS && j < i + 50; ++j) {
+            if (j % 10 != 0 && timers[j].when < timers[i].when) {
+                ASSERT(timers[j].order < timers[i].order, "Timers fired out of order!");
+            }
+        }
+    }
+
+    free(timers);
+    SUCCEED(tr_wheel_delete(wheel));
+    return true;
+}
+
+// Reschedules itself a fixed number of times
+//
+static void wheel_repeat(tr_timer *timer, void *ctx)
+{
+    tr_wheel wheel = *(tr_wheel *)ctx;
+    testtimer *t = tr_ilist_entry(timer, testtimer, timer);
+
+    if (++t->order < 10) {
+        tr_wheel_schedule(wheel, timer, 7);
+    }
+}
+
+bool test_wheel_expire()
+{
+    tr_wheel wheel = tr_wheel_create(10);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+
+    // Timers rescheduled from callbacks are relative to the tick they fired on
+    testtimer repeat;
+    tr_timer_init(&repeat.timer, wheel_repeat, &wheel);
+    repeat.order = 0;
+
+    SUCCEED(tr_wheel_schedule(wheel, &repeat.timer, 10));
+    EQUAL(tr_wheel_advance(wheel, 200), 10);
+    EQUAL(repeat.order, 10);
+    EQUAL(tr_timer_scheduled(&repeat.timer), false);
+
+    // Expiring collects timers without firing them
+    testtimer t[6];
+    for (int i = 0; i < 6; ++i) {
+        tr_timer_init(&t[i].timer, NULL, NULL);
+        SUCCEED(tr_wheel_schedule(wheel, &t[i].timer, 100 * (6 - i)));
+    }
+
+    tr_ilist expired;
+    tr_ilist_init(&expired);
+
+    EQUAL(tr_wheel_expire(wheel, 150, &expired), 0);
+    EQUAL(tr_ilist_empty(&expired), true);
+
+    EQUAL(tr_wheel_expire(wheel, 500, &expired), 3);
+    EQUAL(tr_wheel_num_timers(wheel), 3);
+
+    int i = 5;
+    tr_ilist_foreach(link, &expired) {
+        tr_timer *timer = tr_ilist_entry(link, tr_timer, link);
+        EQUAL(timer, &t[i].timer);
+        EQUAL(tr_timer_scheduled(timer), false);
+        i--;
+    }
+
+    EQUAL(i, 2);
+
+    SUCCEED(tr_wheel_delete(wheel));
+    EQUAL(tr_timer_scheduled(&t[0].timer), false);
+    return true;
+}
+
+bool test_wheel_endoftime()
+{
+    // With one-nanosecond ticks, UINT64_MAX is a real tick as well as the
+    // largest time; advancing to it on an empty wheel must still finish
+    tr_wheel wheel = tr_wheel_create(1);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+    EQUAL(tr_wheel_advance(wheel, UINT64_MAX), 0);
+    EQUAL(tr_wheel_now(wheel), UINT64_MAX);
+    SUCCEED(tr_wheel_delete(wheel));
+
+    wheel = tr_wheel_create(1);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+
+    firelog log = { wheel, 0, false };
+    testtimer t[3];
+    for (int i = 0; i < 3; ++i) {
+        tr_timer_init(&t[i].timer, wheel_record, &log);
+        t[i].fired = 0;
+    }
+
+    // A delay that overflows saturates to the last tick
+    t[0].when = UINT64_MAX;
+    t[1].when = UINT64_MAX - 1;
+    EQUAL(tr_wheel_advance(wheel, 10), 0);
+    SUCCEED(tr_wheel_schedule(wheel, &t[0].timer, UINT64_MAX));
+    SUCCEED(tr_wheel_schedule_at(wheel, &t[1].timer, t[1].when));
+    ASSERT(tr_wheel_next(wheel) <= UINT64_MAX - 1, "Timer would be skipped!");
+
+    EQUAL(tr_wheel_advance(wheel, UINT64_MAX), 2);
+    EQUAL(t[1].order, 0);
+    EQUAL(t[0].order, 1);
+    EQUAL(t[0].fired, UINT64_MAX);
+    EQUAL(log.late, false);
+    EQUAL(tr_wheel_num_timers(wheel), 0);
+    EQUAL(tr_wheel_next(wheel), UINT64_MAX);
+
+    // There's no tick after the last one, so this timer never fires, but
+    // it mustn't wrap around to tick 0 either
+    t[2].when = UINT64_MAX;
+    SUCCEED(tr_wheel_schedule(wheel, &t[2].timer, 0));
+    EQUAL(tr_timer_scheduled(&t[2].timer), true);
+    EQUAL(tr_wheel_advance(wheel, UINT64_MAX), 0);
+    EQUAL(log.fired, 2);
+
+    SUCCEED(tr_wheel_delete(wheel));
+    return true;
+}
+
+bool test_wheel_wallclock()
+{
+    // One-millisecond ticks against the real clock
+    tr_wheel wheel = tr_wheel_create(1000000);
+    ASSERT(wheel != NULL, "tr_wheel_create failed!");
+
+    firelog log = { wheel, 0, false };
+    testtimer t;
+    tr_timer_init(&t.timer, wheel_record, &log);
+    t.when = 2000000;
+    t.fired = 0;
+
+    SUCCEED(tr_wheel_schedule(wheel, &t.timer, t.when));
+
+    // Give up after a few seconds
+    for (int spins = 0; spins < 100000000 && log.fired == 0; ++spins) {
+        tr_wheel_poll(wheel);
+    }
+
+    EQUAL(log.fired, 1);
+    EQUAL(log.late, false);
+    ASSERT(tr_wheel_now(wheel) >= t.when, "Timer fired early!");
+
+    SUCCEED(tr_wheel_delete(wheel));
+    return true;
+}
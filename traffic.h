@@ -22,6 +22,11 @@ typedef void *tr_node;     // A simulated machine
 typedef void *tr_iface;    // A network interface on a simulated machine
 typedef void *tr_link;     // A link between simulated network interfaces
 
+// Nodes, interfaces and links are named by handles, which stay valid until
+// the thing they name (or its network) is deleted, and then go stale. A
+// stale handle never names anything again. Functions that return a tr_err
+// fail with TR_ESTALE when given one; the rest act as if given NULL.
+
 
 // 
 // Error codes
@@ -36,6 +41,14 @@ static const tr_err TR_EPOINTER = -5;
 static const tr_err TR_ESTACKEMPTY = -6;
 static const tr_err TR_EOUTOFRANGE = -7;
 static const tr_err TR_EINTERNAL = -8;
+static const tr_err TR_ENOMEM = -9;
+static const tr_err TR_EFULL = -10;
+static const tr_err TR_EEMPTY = -11;
+static const tr_err TR_ENETBOUND = -12;
+static const tr_err TR_ELINKED = -13;
+static const tr_err TR_ESTALE = -14;
+static const tr_err TR_ESYNTAX = -15;
+static const tr_err TR_EIO = -16;
 
 // Gets an English string explaining the given error code
 //
@@ -46,17 +59,108 @@ const char *tr_errstr(tr_err error);
 // Configuration files
 //
 
+// Where and why a config file couldn't be parsed
+//
+struct _conferror
+{
+    unsigned line;              // Line of the problem, from 1 (0 if it
+                                // isn't in the text, e.g. the file's
+                                // missing)
+    unsigned column;            // Column of the problem, from 1
+    char message[128];          // What the problem is
+};
+
+typedef struct _conferror tr_conferror;
+
+typedef int tr_confformat; // How a network is saved to a file
+
+// Networks can be saved as config text, or compiled into a binary image of
+// their topology. Compiled topologies load many times faster than configs
+// do, but only by the version of traffic that compiled them, on a machine
+// with the same byte order.
+//
+static const tr_confformat TR_CONF_TEXT = 0;        // A config file
+static const tr_confformat TR_CONF_COMPILED = 1;    // A compiled topology
+
 // Opens and parses the config file at the given path.
 // If successful, returns TR_OK and sets net.
 // Otherwise returns an error and does not modify net
 //
+// The file can be a compiled topology instead; either way, the network is
+// the same. Networks are named after their config file, and compiled ones
+// after the config they were compiled from.
+//
 tr_err tr_conf_read(const char *path, tr_network *net);
 
-// Saves the given network to the config file at the given path.
-// If the file doesn't not exist, it will be created;
-// otherwise it will be overwritten.
-//
-tr_err tr_conf_write(tr_network net, const char *path);
+// Like tr_conf_read, but if the file can't be parsed, says where and why in
+// error (if it isn't NULL). Fails with TR_EIO if the file can't be read,
+// and TR_ESYNTAX if it isn't a valid config (or compiled topology).
+//
+tr_err tr_conf_parse(const char *path, tr_network *net, tr_conferror *error);
+
+// Saves the given network to the file at the given path, in the given
+// format. If the file doesn't exist, it will be created;
+// otherwise it will be overwritten, all at once: readers see the old file
+// or the new one, never part of either.
+//
+// Nodes' behavior isn't saved, since it isn't modeled yet. Fails with
+// TR_ESYNTAX if an ID can't be written as config text, because it has
+// both kinds of quote, a newline or "$(" in it, and with TR_EIO if the file
+// can't be written.
+//
+tr_err tr_conf_write(tr_network net, const char *path, tr_confformat format);
+
+// Compiles the config file at source into a compiled topology at dest.
+// Fails as tr_conf_parse does if source can't be read or parsed, saying
+// why in error (if it isn't NULL), and with TR_EIO if dest can't be
+// written.
+//
+tr_err tr_conf_compile(const char *source, const char *dest,
+                       tr_conferror *error);
+
+// What reloading a network's config changed
+//
+struct _confchanges
+{
+    unsigned addednodes;        // Nodes added
+    unsigned removednodes;      // Nodes removed
+    unsigned addedifaces;       // Interfaces added (to old nodes or new)
+    unsigned removedifaces;     // Interfaces removed (from nodes that
+                                // stayed, or with them)
+    unsigned readdressedifaces; // Interfaces whose addresses changed
+    unsigned addedlinks;        // Links added
+    unsigned removedlinks;      // Links removed
+    unsigned changedlinks;      // Links whose characteristics changed
+};
+
+typedef struct _confchanges tr_confchanges;
+
+// Rereads the config file (or compiled topology) at path, as a new version
+// of the network, and changes the network to match. Nodes, interfaces and
+// links are matched up by ID (links by the interfaces they connect); new
+// ones are added, ones that are gone are removed, and changed link
+// characteristics and interface addresses are updated. Everything else is
+// left alone, handles included. An interface that moved to another node
+// counts as removed and added.
+//
+// Networks can be reloaded while they're bound, and while they're running.
+// Meanwhile, other threads may go on calling tr_node_next_hop,
+// tr_node_hops and tr_node_part, which see the routes and placement as
+// they were or as they are, never part of the change; nothing else may be
+// called on the network until the reload returns. Changes to links'
+// characteristics are made in place, and links turned on or off are
+// switched in the routes all at once. Adding or removing anything
+// recompiles the topology; the routes worked out so far are carried over
+// and repaired, and nodes that stay keep their threads.
+//
+// If changes isn't NULL, it receives what changed. If the file can't be
+// parsed, fails as tr_conf_parse does, and leaves the network as it was.
+// If memory runs out while the changes are being made, fails with
+// TR_ENOMEM, and leaves the network part changed, as changes says. If the
+// topology can't be recompiled then, the network is stopped and unbound.
+//
+tr_err tr_conf_reload(tr_network net, const char *path,
+                      tr_confchanges *changes, tr_conferror *error);
 
 
 //
@@ -115,7 +219,8 @@ bool tr_net_has_node(tr_network net, const char *name);
 tr_node tr_net_node(tr_network net, const char *name);
 
 // Frees memory in use by the network topology, its nodes, their interfaces,
-// and the links between those interfaces.
+// and the links between those interfaces. Unbinds the network first if need
+// be, but fails with TR_ENETINUSE if it's simulating.
 //
 tr_err tr_net_delete(tr_network net);
 
@@ -123,6 +228,7 @@ tr_err tr_net_delete(tr_network net);
 // Adds a new node to the given network.
 // If name is NULL, traffic will assign the node a unique name.
 // Otherwise, name must unique among all other names in the network.
+// Returns NULL if the network is bound.
 //
 tr_node tr_node_create(tr_network net, const char *name);
 
@@ -158,6 +264,7 @@ tr_iface tr_node_iface(tr_node node, const char *name);
 // TODO work out how we'll model routing behavior and running applications
 
 // Deletes this node and removes it from the network it belongs to.
+// Fails with TR_ENETBOUND if the network is bound.
 //
 tr_err tr_node_delete(tr_node node);
 
@@ -165,6 +272,7 @@ tr_err tr_node_delete(tr_node node);
 // Adds a virtual network interface to the given virtual node.
 // If name is NULL, traffic will assign the interface a unique name.
 // Otherwise, name must unique among all other names in the network.
+// Returns NULL if the network is bound.
 //
 tr_iface tr_iface_create(tr_node node, const char *name);
 
@@ -190,7 +298,9 @@ const char *tr_iface_mac(tr_iface iface);
 // traffic will choose a unique MAC for the interface when it is bound.
 //
 // The default value for this parameter is TR_ANY_MAC_ADDR.
-// Otherwise the value must be a list of hex bytes ("01:23:45:67:89:ab").
+// Otherwise the value must be a list of hex bytes ("01:23:45:67:89:ab"),
+// or this fails with TR_EOUTOFRANGE. Fails with TR_ENETBOUND if the
+// network is bound.
 //
 tr_err tr_iface_set_mac(tr_iface iface, const char *macaddr);
 
@@ -208,7 +318,9 @@ const char *tr_iface_ip(tr_iface iface);
 // traffic will choose a unique IP for the interface when it is bound.
 //
 // The default value for this parameter is TR_ANY_IP_ADDR.
-// Otherwise the value must be a list of decimal bytes ("111.222.33.4").
+// Otherwise the value must be a list of decimal bytes ("111.222.33.4"),
+// or this fails with TR_EOUTOFRANGE. Fails with TR_ENETBOUND if the
+// network is bound.
 //
 tr_err tr_iface_set_ip(tr_iface iface, const char *ip);
 
@@ -228,7 +340,8 @@ int tr_iface_subnet_mask(tr_iface iface);
 //
 // The default value for this parameter is TR_ANY_SUBNET_MASK.
 // Otherwise the value must be the number of IP address bits
-// that are common to all nodes in the subnet.
+// that are common to all nodes in the subnet (0 to 32), or this fails with
+// TR_EOUTOFRANGE. Fails with TR_ENETBOUND if the network is bound.
 //
 tr_err tr_iface_set_subnet_mask(tr_iface iface, int subnet);
 
@@ -251,7 +364,8 @@ bool tr_iface_has_link(tr_iface iface, tr_iface other);
 //
 tr_link tr_iface_link(tr_iface iface, tr_iface other);
 
-// Deletes this interface from its node
+// Deletes this interface from its node.
+// Fails with TR_ENETBOUND if the network is bound.
 //
 tr_err tr_iface_delete(tr_iface iface);
 
@@ -291,6 +405,18 @@ float tr_link_droprate(tr_link link);
 //
 tr_err tr_link_set_droprate(tr_link link, float droprate);
 
+// Gets how much traffic this link is expected to carry, relative to the
+// network's other links. The default value is 1.
+//
+unsigned tr_link_traffic(tr_link link);
+
+// Sets how much traffic this link is expected to carry, relative to the
+// network's other links. The default value is 1. Nodes are placed on
+// forwarding threads so that busy links cross between threads as little as
+// possible (see tr_net_partition).
+//
+tr_err tr_link_set_traffic(tr_link link, unsigned traffic);
+
 // Indicates whether this link is enabled.
 // A disabled link does not ferry any traffic (as if a cable was unplugged).
 //
@@ -311,6 +437,136 @@ tr_err tr_link_disable(tr_link);
 tr_err tr_link_delete(tr_link link);
 
 
+//
+// Bulk construction
+//
+// Building a large topology one tr_node_create or tr_iface_create at a time
+// spends most of its time growing tables and formatting names. These build
+// it in batches instead. Each batch checks all of its names (or interface
+// pairs) up front and either creates everything or, on failure, nothing.
+// Like their one-at-a-time counterparts, they fail with TR_ENETBOUND if the
+// network is bound.
+//
+
+// Sizes the network's tables for the given total numbers of nodes,
+// interfaces and links, so building a topology that big doesn't have to
+// grow them along the way. The counts are hints; going past them is fine.
+//
+tr_err tr_net_reserve(tr_network net, unsigned nodes, unsigned ifaces,
+                      unsigned links);
+
+// Adds count nodes to the network, named names[0] through names[count - 1].
+// If nodes isn't NULL, it receives the new nodes in the same order.
+// If any name is NULL, fails with TR_EPOINTER. If any name is taken, or
+// appears twice, fails with TR_ENAMETAKEN.
+//
+tr_err tr_node_create_many(tr_network net, const char *const *names,
+                           unsigned count, tr_node *nodes);
+
+// Like tr_node_create_many, but names the nodes prefix followed by a number,
+// counting up from first: "r", 0, 3 makes r0, r1 and r2.
+//
+tr_err tr_node_create_seq(tr_network net, const char *prefix, unsigned first,
+                          unsigned count, tr_node *nodes);
+
+// Adds count interfaces to the node, named names[0] through
+// names[count - 1]. If ifaces isn't NULL, it receives the new interfaces in
+// the same order. Fails as tr_node_create_many does.
+//
+tr_err tr_iface_create_many(tr_node node, const char *const *names,
+                            unsigned count, tr_iface *ifaces);
+
+// Gives each of the numnodes nodes count new interfaces, named after the
+// node: the node's name, then suffix, then a number counting up from first.
+// On node r0, "-eth", 0, 2 makes r0-eth0 and r0-eth1. If ifaces isn't NULL,
+// it receives the first node's new interfaces, then the second's, and so on.
+// The nodes must all be in the same network (otherwise TR_ENOTFOUND), which
+// checks all the names at once, as tr_iface_create_many does.
+//
+tr_err tr_iface_create_seq(const tr_node *nodes, unsigned numnodes,
+                           const char *suffix, unsigned first, unsigned count,
+                           tr_iface *ifaces);
+
+// Adds count links to the network, between ends[0] and ends[1], ends[2] and
+// ends[3], and so on. If links isn't NULL, it receives the new links in the
+// same order. Fails as tr_net_link does if any pair can't be linked,
+// including with TR_ELINKED if a pair appears twice.
+//
+tr_err tr_net_link_many(tr_network net, const tr_iface *ends, unsigned count,
+                        tr_link *links);
+
+
+//
+// Topology generators
+//
+// These add standard topologies to a network, for scaling benchmarks and
+// capacity tests, building them through the bulk construction functions.
+// Each names its nodes by role and number (prefixed by opts->prefix, if
+// set), and each node's interfaces after the node: node r0's are r0-0,
+// r0-1 and so on, in the order its links were made. A generator either
+// builds the whole topology or, on failure, nothing: it fails with
+// TR_ENAMETAKEN if a name it needs is taken, TR_ENETBOUND if the network is
+// bound, and TR_EOUTOFRANGE if a parameter is out of range.
+//
+
+struct _genopts
+{
+    unsigned long long seed;    // Random generators with the same seed (and
+                                // parameters) build the same topology
+    const char *prefix;         // Prepended to every node's name, or NULL
+    long latency;               // Every link's mean latency, in milliseconds
+    long variance;              // Every link's latency variance, in ms
+    float droprate;             // Every link's ratio of dropped packets
+};
+
+typedef struct _genopts tr_genopts;
+
+// Passing NULL for opts means seed 0, no prefix and default link
+// characteristics (see tr_link_latency and friends).
+//
+
+// A ring of n nodes, r0 through r(n - 1), each linked to the next.
+// n must be at least 3.
+//
+tr_err tr_gen_ring(tr_network net, unsigned n, const tr_genopts *opts);
+
+// A 2D or 3D torus: a dims[0] x dims[1] (x dims[2]) grid of nodes t0, t1
+// and so on, numbered with the first dimension varying fastest. Each node is
+// linked to its neighbors in every dimension, and the edges wrap around.
+// ndims must be 2 or 3, and each dimension at least 3.
+//
+tr_err tr_gen_torus(tr_network net, const unsigned *dims, unsigned ndims,
+                    const tr_genopts *opts);
+
+// A k-ary fat tree: (k/2)^2 core switches, then k pods of k/2 aggregation
+// and k/2 edge switches each, with k/2 hosts on every edge switch. Every
+// switch has k ports. Nodes are core, agg, edge and host, numbered pod by
+// pod. k must be even and at least 2.
+//
+tr_err tr_gen_fat_tree(tr_network net, unsigned k, const tr_genopts *opts);
+
+// A star of stars: a hub0 node linked to arms arm nodes, each linked to its
+// own leaves leaf nodes. arms and leaves must both be at least 1.
+//
+tr_err tr_gen_star_of_stars(tr_network net, unsigned arms, unsigned leaves,
+                            const tr_genopts *opts);
+
+// An Erdos-Renyi random graph: n nodes, n0 through n(n - 1), where each pair
+// of nodes is linked with probability p (0 through 1). Takes time in
+// proportion to the number of links, not the number of pairs.
+//
+tr_err tr_gen_erdos_renyi(tr_network net, unsigned n, double p,
+                          const tr_genopts *opts);
+
+// A Barabasi-Albert preferential attachment graph: n nodes, n0 through
+// n(n - 1), starting from m + 1 fully linked nodes. Each node after that is
+// linked to m distinct earlier nodes, picked in proportion to how many
+// links they have. m must be at least 1, and n more than m.
+//
+tr_err tr_gen_barabasi_albert(tr_network net, unsigned n, unsigned m,
+                              const tr_genopts *opts);
+
+
 //
 // Network simulations
 //
@@ -320,10 +576,16 @@ tr_err tr_link_delete(tr_link link);
 // This does not actually begin the network simulation,
 // so no packets will be moving through the bound network.
 //
+// Binding freezes the topology: until the network is unbound, nodes and
+// interfaces can't be added or deleted (TR_ENETBOUND).
+//
+// For now, no host devices are created: binding only compiles the topology
+// into the read-only form routing works from, so that routes can be looked
+// up (tr_node_next_hop) and nodes placed on threads (tr_net_partition).
+//
 tr_err tr_net_bind(tr_network net);
 
-// Indicates whether virtual network devices for this network have been created
-// on the host operating system.
+// Indicates whether the network has been bound with tr_net_bind
 //
 bool tr_net_is_bound(tr_network net);
 
@@ -331,9 +593,14 @@ bool tr_net_is_bound(tr_network net);
 // If the nework isn't bound, calls tr_net_bind for you.
 // Then launches any node apps and begins routing packets.
 //
+// For now, no apps are launched and no packets move: starting binds the
+// network, places its nodes on a forwarding thread per core if they
+// haven't been placed already, and marks the network as simulating, so
+// that it can't be unbound until it's stopped.
+//
 tr_err tr_net_start(tr_network net);
 
-// Indicates whether the virtual network is bound and routing packets
+// Indicates whether the network has been started and not stopped since
 //
 bool tr_net_is_simulating(tr_network net);
 
@@ -374,6 +641,146 @@ const char *tr_iface_cur_ip(tr_iface iface);
 int tr_iface_cur_subnet_mask(tr_iface iface);
 
 
+//
+// Psychic routing
+//
+
+// Psychic switches route along the shortest path (in hops, over enabled
+// links) to each destination, using the bound network's topology. Routes
+// to a destination are worked out the first time they're asked for, for
+// every node at once, and kept for as long as they're used often enough.
+// Enabling or disabling a link updates the routes that are kept.
+//
+// Routes only exist while the network is bound.
+//
+
+// Gets the interface a packet at the node should leave by to reach dest.
+// Returns NULL if the network isn't bound, the node is dest, there's no
+// route, or either node handle is stale or they're in different networks.
+//
+tr_iface tr_node_next_hop(tr_node node, tr_node dest);
+
+// Gets the number of links a packet crosses on its way from the node to
+// dest, or -1 if there's no route (see tr_node_next_hop).
+//
+int tr_node_hops(tr_node node, tr_node dest);
+
+// Works out routes to the given destinations ahead of time, spread across
+// the machine's cores, so that they're ready when packets start moving.
+// If the network isn't bound, calls tr_net_bind for you.
+// Fails with TR_EFULL if there are more destinations than routes are kept
+// for (see tr_net_set_route_cache).
+//
+tr_err tr_net_prepare_routes(tr_network net, const tr_node *dests,
+                             unsigned count);
+
+// Sets how many destinations routes are kept for. Each takes 8 bytes per
+// node in the network. 0 (the default) keeps as many as fit in 256MB.
+//
+tr_err tr_net_set_route_cache(tr_network net, unsigned dests);
+
+
+//
+// Thread placement
+//
+
+// A running network's nodes are split among forwarding threads, so that
+// each thread has about the same number of nodes, and as little traffic
+// as possible crosses between threads. Unless a placement was made first,
+// tr_net_start makes one with a thread per core. The placement lasts
+// until the network is unbound.
+//
+
+struct _partinfo
+{
+    unsigned parts;                 // Number of parts (threads)
+    unsigned cutlinks;              // Links between nodes in different parts
+    unsigned long long cut;         // Expected traffic over those links
+    unsigned long long traffic;     // Expected traffic over all links (but
+                                    // those from a node to itself)
+    unsigned largest;               // Nodes in the largest part
+    unsigned smallest;              // Nodes in the smallest part
+    double imbalance;               // How much bigger than average the
+                                    // largest part is (0.03 is 3%)
+    unsigned levels;                // Coarsening levels the split took
+};
+
+typedef struct _partinfo tr_partinfo;
+
+// Places the network's nodes into the given number of parts, each at most
+// (1 + imbalance) times the average size where that's possible, replacing
+// any placement the network had. If the network isn't bound, calls
+// tr_net_bind for you. If info isn't NULL, it receives how good the split
+// is. Fails with TR_EOUTOFRANGE if parts is 0 or more than the number of
+// nodes, or imbalance is negative.
+//
+tr_err tr_net_partition(tr_network net, unsigned parts, float imbalance,
+                        tr_partinfo *info);
+
+// Gets how good the network's current placement is.
+// Fails with TR_ENOTFOUND if it hasn't been placed.
+//
+tr_err tr_net_placement(tr_network net, tr_partinfo *info);
+
+// Gets the part (thread) the node is placed in, from 0, or -1 if its
+// network hasn't been placed.
+//
+int tr_node_part(tr_node node);
+
+
+//
+// Memory accounting
+//
+
+typedef int tr_memtag; // The subsystem an allocation is accounted to
+
+// Memory is accounted to the subsystem that allocated it. Anything that
+// isn't allocated on behalf of a particular subsystem (e.g. containers you
+// create through the library directly) counts as TR_MEM_CONTAINERS.
+//
+static const tr_memtag TR_MEM_CONTAINERS = 0;   // General-purpose containers
+static const tr_memtag TR_MEM_TOPOLOGY = 1;     // Networks, nodes, interfaces, links
+static const tr_memtag TR_MEM_PACKETS = 2;      // Packets in flight
+static const tr_memtag TR_MEM_CAPTURE = 3;      // Packet capture buffers
+static const tr_memtag TR_MEM_ROUTING = 4;      // Psychic switch routes
+static const tr_memtag TR_MEM_ALL = -1;         // Every subsystem combined
+
+#define TR_MEM_NUM_TAGS 5
+
+// Allocation sizes are histogrammed in powers of two: bucket i counts
+// allocations of more than (8 << i) and at most (16 << i) bytes. The first
+// bucket also counts smaller allocations, and the last one larger.
+//
+#define TR_MEM_HIST_BUCKETS 20
+
+struct _memstats
+{
+    long long bytes;                // Bytes currently allocated
+    long long peak;                 // Most bytes allocated at once
+    unsigned long long allocs;      // Allocations made
+    unsigned long long frees;       // Allocations freed
+    unsigned long long histogram[TR_MEM_HIST_BUCKETS]; // Allocations by size
+};
+
+typedef struct _memstats tr_memstats;
+
+// Gets memory statistics for one subsystem, or for all of them with
+// TR_MEM_ALL. Counts cover every thread, including ones that have exited.
+// Bytes count the blocks handed out (small requests are rounded up to one
+// of the allocator's size classes) but not the allocator's own headers.
+//
+// Peaks are only tracked when a thread's memory grows by 64KB or so at a
+// time, so they may be low by about that much per thread. Only arenas are
+// counted when libtraffic is built with TR_SYSTEM_MALLOC, and nothing is
+// counted when it's built with TR_NO_MEM_STATS.
+//
+tr_err tr_mem_stats(tr_memtag tag, tr_memstats *stats);
+
+// Gets the name of a memory accounting tag ("topology", say)
+//
+const char *tr_mem_tag_name(tr_memtag tag);
+
+
 //
 // Simulation monitoring
 //